@@ -18,6 +18,13 @@
 #include <debug.h>
 
 
+extern RTL_CRITICAL_SECTION ConsoleOutputLock;
+
+/* Output buffer shared with the console server, see IntWriteConsoleShared */
+static PVOID ConsoleOutputBuffer = NULL;
+static ULONG ConsoleOutputBufferSize = 0;
+static BOOLEAN ConsoleOutputBufferFailed = FALSE;
+
 /* See consrv/include/rect.h */
 #define ConioRectHeight(Rect) \
     (((Rect)->Top > (Rect)->Bottom) ? 0 : ((Rect)->Bottom - (Rect)->Top + 1))
@@ -593,6 +600,149 @@ IntReadConsoleOutputCode(IN HANDLE hConsoleOutput,
  * Write functions *
  *******************/
 
+/*
+ * Maps the output buffer shared with the console server on first use.
+ * The caller holds the output buffer lock.
+ */
+static
+BOOLEAN
+IntMapConsoleOutputBuffer(VOID)
+{
+    CONSOLE_API_MESSAGE ApiMessage;
+    PCONSOLE_MAPOUTPUTBUFFER MapOutputBufferRequest = &ApiMessage.Data.MapOutputBufferRequest;
+
+    if (ConsoleOutputBuffer != NULL) return TRUE;
+    if (ConsoleOutputBufferFailed) return FALSE;
+
+    MapOutputBufferRequest->ConsoleHandle = NtCurrentPeb()->ProcessParameters->ConsoleHandle;
+
+    CsrClientCallServer((PCSR_API_MESSAGE)&ApiMessage,
+                        NULL,
+                        CSR_CREATE_API_NUMBER(CONSRV_SERVERDLL_INDEX, ConsolepMapOutputBuffer),
+                        sizeof(*MapOutputBufferRequest));
+    if (!NT_SUCCESS(ApiMessage.Status))
+    {
+        DPRINT1("Cannot map the console output buffer, Status = 0x%08lx\n", ApiMessage.Status);
+        /* Do not ask again, use capture buffers from now on */
+        ConsoleOutputBufferFailed = TRUE;
+        return FALSE;
+    }
+
+    ConsoleOutputBufferSize = MapOutputBufferRequest->Size;
+    ConsoleOutputBuffer = MapOutputBufferRequest->Buffer;
+    return TRUE;
+}
+
+/*
+ * Writes through the output buffer shared with the console server.
+ * The string is copied there and written by the server in chunks of
+ * the buffer size, each one with a single call without capture buffer.
+ * Returns FALSE with *pbHandled == FALSE if the buffer is not available.
+ */
+static
+BOOL
+IntWriteConsoleShared(IN HANDLE hConsoleOutput,
+                      IN PVOID lpBuffer,
+                      IN DWORD nNumberOfCharsToWrite,
+                      OUT LPDWORD lpNumberOfCharsWritten,
+                      IN BOOLEAN bUnicode,
+                      OUT PBOOLEAN pbHandled)
+{
+    CONSOLE_API_MESSAGE ApiMessage;
+    PCONSOLE_WRITECONSOLE WriteConsoleRequest = &ApiMessage.Data.WriteConsoleRequest;
+    ULONG CharSize = (bUnicode ? sizeof(WCHAR) : sizeof(CHAR));
+    ULONG CharsWritten = 0, ChunkChars, i;
+    UINT CodePage = 0;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PUCHAR pChunk;
+
+    RtlEnterCriticalSection(&ConsoleOutputLock);
+
+    *pbHandled = IntMapConsoleOutputBuffer();
+    if (!*pbHandled)
+    {
+        RtlLeaveCriticalSection(&ConsoleOutputLock);
+        return FALSE;
+    }
+
+    pChunk = ConsoleOutputBuffer;
+
+    while (CharsWritten < nNumberOfCharsToWrite)
+    {
+        ChunkChars = min(nNumberOfCharsToWrite - CharsWritten,
+                         ConsoleOutputBufferSize / CharSize);
+
+        _SEH2_TRY
+        {
+            RtlCopyMemory(pChunk,
+                          (PUCHAR)lpBuffer + CharsWritten * CharSize,
+                          ChunkChars * CharSize);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            Status = STATUS_ACCESS_VIOLATION;
+        }
+        _SEH2_END;
+        if (!NT_SUCCESS(Status)) break;
+
+        /* Do not split a double-byte character between two chunks */
+        if (!bUnicode && CharsWritten + ChunkChars < nNumberOfCharsToWrite)
+        {
+            if (CodePage == 0) CodePage = GetConsoleOutputCP();
+            for (i = 0; i < ChunkChars; i++)
+            {
+                if (IsDBCSLeadByteEx(CodePage, pChunk[i]) && ++i == ChunkChars)
+                {
+                    ChunkChars--;
+                    break;
+                }
+            }
+        }
+
+        WriteConsoleRequest->ConsoleHandle = NtCurrentPeb()->ProcessParameters->ConsoleHandle;
+        WriteConsoleRequest->OutputHandle  = hConsoleOutput;
+        WriteConsoleRequest->Unicode       = bUnicode;
+        WriteConsoleRequest->Reserved1     = 0;
+        WriteConsoleRequest->Buffer        = pChunk;
+        WriteConsoleRequest->NumBytes      = ChunkChars * CharSize;
+        WriteConsoleRequest->UsingStaticBuffer = FALSE;
+
+        CsrClientCallServer((PCSR_API_MESSAGE)&ApiMessage,
+                            NULL,
+                            CSR_CREATE_API_NUMBER(CONSRV_SERVERDLL_INDEX, ConsolepWriteConsole),
+                            sizeof(*WriteConsoleRequest));
+        Status = ApiMessage.Status;
+        if (!NT_SUCCESS(Status)) break;
+
+        CharsWritten += WriteConsoleRequest->NumBytes / CharSize;
+        if (WriteConsoleRequest->NumBytes < ChunkChars * CharSize) break;
+    }
+
+    RtlLeaveCriticalSection(&ConsoleOutputLock);
+
+    if (!NT_SUCCESS(Status))
+    {
+        if (Status == STATUS_ACCESS_VIOLATION)
+            SetLastError(ERROR_INVALID_ACCESS);
+        else
+            BaseSetLastNTError(Status);
+        return FALSE;
+    }
+
+    _SEH2_TRY
+    {
+        *lpNumberOfCharsWritten = CharsWritten;
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        SetLastError(ERROR_INVALID_ACCESS);
+        _SEH2_YIELD(return FALSE);
+    }
+    _SEH2_END;
+
+    return TRUE;
+}
+
 static
 BOOL
 IntWriteConsole(IN HANDLE hConsoleOutput,
@@ -652,6 +802,17 @@ IntWriteConsole(IN HANDLE hConsoleOutput,
     }
     else
     {
+        BOOLEAN bHandled;
+
+        /* Larger writes go through the output buffer shared with the server */
+        Success = IntWriteConsoleShared(hConsoleOutput,
+                                        lpBuffer,
+                                        nNumberOfCharsToWrite,
+                                        lpNumberOfCharsWritten,
+                                        bUnicode,
+                                        &bHandled);
+        if (bHandled) return Success;
+
         /* Allocate a Capture Buffer */
         CaptureBuffer = CsrAllocateCaptureBuffer(1, SizeBytes);
         if (CaptureBuffer == NULL)
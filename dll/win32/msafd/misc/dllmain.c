@@ -20,7 +20,10 @@ HANDLE GlobalHeap;
 WSPUPCALLTABLE Upcalls;
 DWORD CatalogEntryId; /* CatalogEntryId for upcalls */
 LPWPUCOMPLETEOVERLAPPEDREQUEST lpWPUCompleteOverlappedRequest;
-PSOCKET_INFORMATION SocketListHead = NULL;
+/* Sockets are looked up by handle on every call, so keep them hashed */
+#define SOCKET_HASH_BUCKETS 256
+#define SOCKET_HASH(Handle) (((ULONG_PTR)(Handle) >> 2) % SOCKET_HASH_BUCKETS)
+PSOCKET_INFORMATION SocketHashTable[SOCKET_HASH_BUCKETS];
 CRITICAL_SECTION SocketListLock;
 LIST_ENTRY SockHelpersListHead = { NULL, NULL };
 ULONG SockAsyncThreadRefCount;
@@ -402,8 +405,8 @@ ok:
 
     /* Save in Process Sockets List */
     EnterCriticalSection(&SocketListLock);
-    Socket->NextSocket = SocketListHead;
-    SocketListHead = Socket;
+    Socket->NextSocket = SocketHashTable[SOCKET_HASH(Socket->Handle)];
+    SocketHashTable[SOCKET_HASH(Socket->Handle)] = Socket;
     LeaveCriticalSection(&SocketListLock);
 
     /* Create the Socket Context */
@@ -791,13 +794,13 @@ WSPCloseSocket(IN SOCKET Handle,
     Socket->TdiConnectionHandle = NULL;
 ok:
     EnterCriticalSection(&SocketListLock);
-    if (SocketListHead == Socket)
+    if (SocketHashTable[SOCKET_HASH(Socket->Handle)] == Socket)
     {
-        SocketListHead = SocketListHead->NextSocket;
+        SocketHashTable[SOCKET_HASH(Socket->Handle)] = Socket->NextSocket;
     }
     else
     {
-        CurrentSocket = SocketListHead;
+        CurrentSocket = SocketHashTable[SOCKET_HASH(Socket->Handle)];
         while (CurrentSocket->NextSocket)
         {
             if (CurrentSocket->NextSocket == Socket)
@@ -1413,6 +1416,199 @@ WSPSelect(IN int nfds,
     return HandleCount;
 }
 
+static
+INT
+MsafdPoll(IN OUT LPWSAPOLLDATA PollData,
+          OUT LPINT lpErrno)
+{
+    IO_STATUS_BLOCK     IOSB;
+    PAFD_POLL_INFO      PollInfo;
+    NTSTATUS            Status;
+    ULONG               PollBufferSize;
+    ULONG               HandleCount = 0;
+    ULONG               i, j;
+    HANDLE              SockEvent;
+    PSOCKET_INFORMATION Socket;
+    ULONG               Events;
+    SHORT               REvents;
+    INT                 Count = 0;
+    PULONG              HandleIndex;
+
+    /* Entries map to AFD handles one to one, without going through fd_sets */
+    PollBufferSize = FIELD_OFFSET(AFD_POLL_INFO, Handles) + PollData->fds * sizeof(AFD_HANDLE);
+    PollInfo = HeapAlloc(GlobalHeap, HEAP_ZERO_MEMORY, PollBufferSize);
+    HandleIndex = HeapAlloc(GlobalHeap, 0, PollData->fds * sizeof(ULONG));
+    if (!PollInfo || !HandleIndex)
+    {
+        if (PollInfo) HeapFree(GlobalHeap, 0, PollInfo);
+        if (HandleIndex) HeapFree(GlobalHeap, 0, HandleIndex);
+        if (lpErrno) *lpErrno = WSAENOBUFS;
+        return SOCKET_ERROR;
+    }
+
+    for (i = 0; i < PollData->fds; i++)
+    {
+        PollData->fdArray[i].revents = 0;
+
+        /* Negative descriptors are ignored */
+        if ((INT_PTR)PollData->fdArray[i].fd < 0)
+            continue;
+
+        if (PollData->fdArray[i].events & ~(POLLIN | POLLOUT))
+        {
+            HeapFree(GlobalHeap, 0, HandleIndex);
+            HeapFree(GlobalHeap, 0, PollInfo);
+            if (lpErrno) *lpErrno = WSAEINVAL;
+            return SOCKET_ERROR;
+        }
+
+        Socket = GetSocketStructure(PollData->fdArray[i].fd);
+        if (!Socket)
+        {
+            PollData->fdArray[i].revents = POLLNVAL;
+            Count++;
+            continue;
+        }
+
+        /* Errors and hangups are always reported */
+        Events = AFD_EVENT_DISCONNECT |
+                 AFD_EVENT_ABORT |
+                 AFD_EVENT_CLOSE |
+                 AFD_EVENT_CONNECT_FAIL;
+        if (PollData->fdArray[i].events & POLLRDNORM)
+        {
+            Events |= AFD_EVENT_RECEIVE | AFD_EVENT_ACCEPT;
+            if (Socket->SharedData->OobInline != 0)
+                Events |= AFD_EVENT_OOB_RECEIVE;
+        }
+        if ((PollData->fdArray[i].events & POLLRDBAND) &&
+            Socket->SharedData->OobInline == 0)
+        {
+            Events |= AFD_EVENT_OOB_RECEIVE;
+        }
+        if (PollData->fdArray[i].events & POLLWRNORM)
+            Events |= AFD_EVENT_SEND | AFD_EVENT_CONNECT;
+
+        PollInfo->Handles[HandleCount].Handle = PollData->fdArray[i].fd;
+        PollInfo->Handles[HandleCount].Events = Events;
+        HandleIndex[HandleCount] = i;
+        HandleCount++;
+    }
+
+    if (HandleCount == 0)
+    {
+        HeapFree(GlobalHeap, 0, HandleIndex);
+        HeapFree(GlobalHeap, 0, PollInfo);
+        if (lpErrno) *lpErrno = NO_ERROR;
+        return Count;
+    }
+
+    /* Invalid descriptors make the call return right away */
+    if (Count != 0 || PollData->timeout == 0)
+    {
+        PollInfo->Timeout.QuadPart = 0;
+    }
+    else if (PollData->timeout < 0)
+    {
+        PollInfo->Timeout.u.LowPart = -1;
+        PollInfo->Timeout.u.HighPart = 0x7FFFFFFF;
+    }
+    else
+    {
+        PollInfo->Timeout = RtlEnlargedIntegerMultiply(PollData->timeout, -10000);
+    }
+    PollInfo->HandleCount = HandleCount;
+    PollInfo->Exclusive = FALSE;
+    PollBufferSize = FIELD_OFFSET(AFD_POLL_INFO, Handles) + HandleCount * sizeof(AFD_HANDLE);
+
+    Status = NtCreateEvent(&SockEvent,
+                           EVENT_ALL_ACCESS,
+                           NULL,
+                           SynchronizationEvent,
+                           FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        ERR("NtCreateEvent failed, 0x%08x\n", Status);
+        HeapFree(GlobalHeap, 0, HandleIndex);
+        HeapFree(GlobalHeap, 0, PollInfo);
+        if (lpErrno) *lpErrno = WSAEFAULT;
+        return SOCKET_ERROR;
+    }
+
+    Status = NtDeviceIoControlFile((HANDLE)PollInfo->Handles[0].Handle,
+                                   SockEvent,
+                                   NULL,
+                                   NULL,
+                                   &IOSB,
+                                   IOCTL_AFD_SELECT,
+                                   PollInfo,
+                                   PollBufferSize,
+                                   PollInfo,
+                                   PollBufferSize);
+
+    TRACE("DeviceIoControlFile => %x\n", Status);
+
+    if (Status == STATUS_PENDING)
+    {
+        WaitForSingleObject(SockEvent, INFINITE);
+        Status = IOSB.Status;
+    }
+
+    NtClose(SockEvent);
+
+    if (Status != STATUS_SUCCESS &&
+        Status != STATUS_TIMEOUT &&
+        Status != STATUS_CANCELLED)
+    {
+        HeapFree(GlobalHeap, 0, HandleIndex);
+        HeapFree(GlobalHeap, 0, PollInfo);
+        return MsafdReturnWithErrno(Status, lpErrno, 0, NULL);
+    }
+
+    for (j = 0; j < HandleCount; j++)
+    {
+        i = HandleIndex[j];
+        Events = PollInfo->Handles[j].Events;
+        REvents = 0;
+
+        /* The poll is cancelled when one of its sockets gets closed */
+        if (Status == STATUS_CANCELLED && !GetSocketStructure(PollData->fdArray[i].fd))
+        {
+            REvents = POLLNVAL;
+        }
+        else
+        {
+            Socket = GetSocketStructure(PollData->fdArray[i].fd);
+
+            if (Events & (AFD_EVENT_RECEIVE | AFD_EVENT_ACCEPT))
+                REvents |= POLLRDNORM;
+            if (Events & AFD_EVENT_OOB_RECEIVE)
+                REvents |= (Socket && Socket->SharedData->OobInline != 0) ? POLLRDNORM : POLLRDBAND;
+            if (Events & (AFD_EVENT_SEND | AFD_EVENT_CONNECT))
+                REvents |= POLLWRNORM;
+            if (Events & (AFD_EVENT_DISCONNECT | AFD_EVENT_ABORT | AFD_EVENT_CLOSE))
+                REvents |= POLLHUP;
+            if (Events & AFD_EVENT_CONNECT_FAIL)
+                REvents |= POLLERR;
+
+            if (Socket && (Events & AFD_EVENT_ABORT))
+                Socket->SharedData->SocketLastError = WSAECONNABORTED;
+            else if (Socket && (Events & (AFD_EVENT_DISCONNECT | AFD_EVENT_CLOSE)))
+                Socket->SharedData->SocketLastError = WSAECONNRESET;
+        }
+
+        PollData->fdArray[i].revents = REvents;
+        if (REvents)
+            Count++;
+    }
+
+    HeapFree(GlobalHeap, 0, HandleIndex);
+    HeapFree(GlobalHeap, 0, PollInfo);
+
+    if (lpErrno) *lpErrno = NO_ERROR;
+    return Count;
+}
+
 DWORD
 GetCurrentTimeInSeconds(VOID)
 {
@@ -2486,6 +2682,8 @@ WSPIoctl(IN  SOCKET Handle,
                 GUID ConnectExGUID = WSAID_CONNECTEX;
                 GUID DisconnectExGUID = WSAID_DISCONNECTEX;
                 GUID GetAcceptExSockaddrsGUID = WSAID_GETACCEPTEXSOCKADDRS;
+                GUID TransmitFileGUID = WSAID_TRANSMITFILE;
+                GUID TransmitPacketsGUID = WSAID_TRANSMITPACKETS;
 
                 if (IsEqualGUID(&AcceptExGUID, lpvInBuffer))
                 {
@@ -2515,6 +2713,20 @@ WSPIoctl(IN  SOCKET Handle,
                     Errno = NO_ERROR;
                     Ret = NO_ERROR;
                 }
+                else if (IsEqualGUID(&TransmitFileGUID, lpvInBuffer))
+                {
+                    *((PVOID *)lpvOutBuffer) = WSPTransmitFile;
+                    cbRet = sizeof(PVOID);
+                    Errno = NO_ERROR;
+                    Ret = NO_ERROR;
+                }
+                else if (IsEqualGUID(&TransmitPacketsGUID, lpvInBuffer))
+                {
+                    *((PVOID *)lpvOutBuffer) = WSPTransmitPackets;
+                    cbRet = sizeof(PVOID);
+                    Errno = NO_ERROR;
+                    Ret = NO_ERROR;
+                }
                 else
                 {
                     ERR("Querying unknown extension function: %x\n", ((GUID*)lpvInBuffer)->Data1);
@@ -2523,6 +2735,36 @@ WSPIoctl(IN  SOCKET Handle,
             }
 
             break;
+        case SIO_EXT_POLL:
+        {
+            LPWSAPOLLDATA PollData = lpvOutBuffer;
+
+            if (IS_INTRESOURCE(lpvInBuffer) || IS_INTRESOURCE(lpvOutBuffer) ||
+                cbInBuffer < FIELD_OFFSET(WSAPOLLDATA, fdArray) ||
+                cbOutBuffer < cbInBuffer)
+            {
+                Errno = WSAEFAULT;
+                break;
+            }
+            if (((LPWSAPOLLDATA)lpvInBuffer)->fds == 0 ||
+                ((LPWSAPOLLDATA)lpvInBuffer)->fds >
+                    (cbInBuffer - FIELD_OFFSET(WSAPOLLDATA, fdArray)) / sizeof(WSAPOLLFD))
+            {
+                Errno = WSAEINVAL;
+                break;
+            }
+
+            if (lpvOutBuffer != lpvInBuffer)
+                RtlMoveMemory(lpvOutBuffer, lpvInBuffer, cbInBuffer);
+
+            PollData->result = MsafdPoll(PollData, &Errno);
+            if (PollData->result != SOCKET_ERROR)
+            {
+                cbRet = cbInBuffer;
+                Ret = NO_ERROR;
+            }
+            break;
+        }
         case SIO_ADDRESS_LIST_QUERY:
             if (IS_INTRESOURCE(lpvOutBuffer) || cbOutBuffer == 0)
             {
@@ -2890,10 +3132,6 @@ WSPSetSockOpt(
                   return SOCKET_ERROR;
               }
 
-              /* FIXME: We should not have to limit the packet receive buffer size like this. workaround for CORE-15804 */
-              if (*(PULONG)optval > 0x2000)
-                  *(PULONG)optval = 0x2000;
-
               SetSocketInformation(Socket,
                                    AFD_INFO_RECEIVE_WINDOW_SIZE,
                                    NULL,
@@ -3514,7 +3752,7 @@ GetSocketStructure(SOCKET Handle)
 
     EnterCriticalSection(&SocketListLock);
 
-    CurrentSocket = SocketListHead;
+    CurrentSocket = SocketHashTable[SOCKET_HASH(Handle)];
     while (CurrentSocket)
     {
         if (CurrentSocket->Handle == Handle)
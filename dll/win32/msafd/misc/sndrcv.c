@@ -914,6 +914,267 @@ WSPSendTo(SOCKET Handle,
     return MsafdReturnWithErrno(Status, lpErrno, IOSB->Information, lpNumberOfBytesSent);
 }
 
+static
+NTSTATUS
+GetTransmitFileOffset(IN HANDLE hFile,
+                      IN LPOVERLAPPED lpOverlapped,
+                      OUT PLARGE_INTEGER Offset)
+{
+    FILE_POSITION_INFORMATION Position;
+    IO_STATUS_BLOCK IoStatus;
+    NTSTATUS Status;
+
+    /* Overlapped requests carry the offset, others start at the file pointer */
+    if (lpOverlapped)
+    {
+        Offset->LowPart = lpOverlapped->Offset;
+        Offset->HighPart = lpOverlapped->OffsetHigh;
+        return STATUS_SUCCESS;
+    }
+
+    Status = NtQueryInformationFile(hFile,
+                                    &IoStatus,
+                                    &Position,
+                                    sizeof(Position),
+                                    FilePositionInformation);
+    if (NT_SUCCESS(Status))
+        *Offset = Position.CurrentByteOffset;
+
+    return Status;
+}
+
+static
+BOOL
+SockTransmit(IN SOCKET Handle,
+             IN PAFD_TRANSMIT_ELEMENT Elements,
+             IN DWORD ElementCount,
+             IN DWORD SendSize,
+             IN LPOVERLAPPED lpOverlapped,
+             IN DWORD dwFlags)
+{
+    PIO_STATUS_BLOCK        IOSB;
+    IO_STATUS_BLOCK         DummyIOSB;
+    AFD_TRANSMIT_FILE_INFO  TransmitInfo;
+    NTSTATUS                Status;
+    PVOID                   APCContext = NULL;
+    HANDLE                  Event;
+    HANDLE                  SockEvent;
+    PSOCKET_INFORMATION     Socket;
+
+    Socket = GetSocketStructure(Handle);
+    if (!Socket)
+    {
+        SetLastError(WSAENOTSOCK);
+        return FALSE;
+    }
+
+    Status = NtCreateEvent(&SockEvent, EVENT_ALL_ACCESS,
+                           NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(TranslateNtStatusError(Status));
+        return FALSE;
+    }
+
+    TransmitInfo.ElementArray = Elements;
+    TransmitInfo.ElementCount = ElementCount;
+    TransmitInfo.SendSize = SendSize;
+    TransmitInfo.Flags = 0;
+    TransmitInfo.AfdFlags = Socket->SharedData->NonBlocking ? AFD_IMMEDIATE : 0;
+
+    if (dwFlags & TF_DISCONNECT)
+        TransmitInfo.Flags |= AFD_TF_DISCONNECT;
+    if (dwFlags & TF_REUSE_SOCKET)
+        TransmitInfo.Flags |= AFD_TF_REUSE_SOCKET;
+
+    if (lpOverlapped == NULL)
+    {
+        Event = SockEvent;
+        IOSB = &DummyIOSB;
+    }
+    else
+    {
+        /* Completion ports get the OVERLAPPED back as the key context */
+        APCContext = lpOverlapped;
+        Event = lpOverlapped->hEvent;
+        IOSB = (PIO_STATUS_BLOCK)&lpOverlapped->Internal;
+        TransmitInfo.AfdFlags |= AFD_OVERLAPPED;
+    }
+
+    IOSB->Status = STATUS_PENDING;
+
+    Status = NtDeviceIoControlFile((HANDLE)Handle,
+                                   Event,
+                                   NULL,
+                                   APCContext,
+                                   IOSB,
+                                   IOCTL_AFD_TRANSMIT_FILE,
+                                   &TransmitInfo,
+                                   sizeof(TransmitInfo),
+                                   NULL,
+                                   0);
+
+    /* Wait for completion of not overlapped */
+    if (Status == STATUS_PENDING && lpOverlapped == NULL)
+    {
+        WaitForSingleObject(SockEvent, INFINITE);
+        Status = IOSB->Status;
+    }
+
+    NtClose(SockEvent);
+
+    if (Status != STATUS_PENDING)
+    {
+        /* Re-enable Async Event */
+        SockReenableAsyncSelectEvent(Socket, FD_WRITE);
+    }
+
+    TRACE("Leaving (%lx, %Iu)\n", Status, IOSB->Information);
+
+    if (Status != STATUS_SUCCESS)
+    {
+        SetLastError(TranslateNtStatusError(Status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL
+WSPAPI
+WSPTransmitFile(IN SOCKET hSocket,
+                IN HANDLE hFile,
+                IN DWORD nNumberOfBytesToWrite,
+                IN DWORD nNumberOfBytesPerSend,
+                IN OUT LPOVERLAPPED lpOverlapped,
+                IN LPTRANSMIT_FILE_BUFFERS lpTransmitBuffers,
+                IN DWORD dwFlags)
+{
+    AFD_TRANSMIT_ELEMENT Elements[3];
+    DWORD Count = 0;
+    NTSTATUS Status;
+
+    RtlZeroMemory(Elements, sizeof(Elements));
+
+    if (lpTransmitBuffers && lpTransmitBuffers->Head && lpTransmitBuffers->HeadLength)
+    {
+        Elements[Count].Flags = AFD_TRANSMIT_ELEMENT_MEMORY;
+        Elements[Count].Buffer = lpTransmitBuffers->Head;
+        Elements[Count].Length = lpTransmitBuffers->HeadLength;
+        Count++;
+    }
+
+    if (hFile)
+    {
+        Status = GetTransmitFileOffset(hFile, lpOverlapped, &Elements[Count].FileOffset);
+        if (!NT_SUCCESS(Status))
+        {
+            SetLastError(TranslateNtStatusError(Status));
+            return FALSE;
+        }
+
+        Elements[Count].Flags = AFD_TRANSMIT_ELEMENT_FILE;
+        Elements[Count].FileHandle = hFile;
+        Elements[Count].Length = nNumberOfBytesToWrite;
+        Count++;
+    }
+
+    if (lpTransmitBuffers && lpTransmitBuffers->Tail && lpTransmitBuffers->TailLength)
+    {
+        Elements[Count].Flags = AFD_TRANSMIT_ELEMENT_MEMORY;
+        Elements[Count].Buffer = lpTransmitBuffers->Tail;
+        Elements[Count].Length = lpTransmitBuffers->TailLength;
+        Count++;
+    }
+
+    /* Nothing to send is fine, it may still be asked to disconnect */
+    if (!Count)
+    {
+        Elements[0].Flags = AFD_TRANSMIT_ELEMENT_MEMORY;
+        Count = 1;
+    }
+
+    return SockTransmit(hSocket, Elements, Count, nNumberOfBytesPerSend, lpOverlapped, dwFlags);
+}
+
+BOOL
+WSPAPI
+WSPTransmitPackets(IN SOCKET hSocket,
+                   IN LPTRANSMIT_PACKETS_ELEMENT lpPacketArray,
+                   IN DWORD nElementCount,
+                   IN DWORD nSendSize,
+                   IN OUT LPOVERLAPPED lpOverlapped,
+                   IN DWORD dwFlags)
+{
+    PAFD_TRANSMIT_ELEMENT Elements;
+    AFD_TRANSMIT_ELEMENT Empty;
+    NTSTATUS Status = STATUS_SUCCESS;
+    DWORD i;
+    BOOL Ret;
+
+    /* Nothing to send is fine, it may still be asked to disconnect */
+    if (!nElementCount)
+    {
+        RtlZeroMemory(&Empty, sizeof(Empty));
+        Empty.Flags = AFD_TRANSMIT_ELEMENT_MEMORY;
+        return SockTransmit(hSocket, &Empty, 1, nSendSize, lpOverlapped, dwFlags);
+    }
+
+    if (!lpPacketArray)
+    {
+        SetLastError(WSAEFAULT);
+        return FALSE;
+    }
+
+    Elements = HeapAlloc(GlobalHeap, HEAP_ZERO_MEMORY, nElementCount * sizeof(*Elements));
+    if (!Elements)
+    {
+        SetLastError(WSAENOBUFS);
+        return FALSE;
+    }
+
+    for (i = 0; i < nElementCount && NT_SUCCESS(Status); i++)
+    {
+        /* TP_ELEMENT_EOP only matters for the packet boundaries, which a
+         * stream transport does not keep anyway */
+        if (lpPacketArray[i].dwElFlags & TP_ELEMENT_FILE)
+        {
+            Elements[i].Flags = AFD_TRANSMIT_ELEMENT_FILE;
+            Elements[i].FileHandle = lpPacketArray[i].hFile;
+            Elements[i].Length = lpPacketArray[i].cLength;
+            Elements[i].FileOffset = lpPacketArray[i].nFileOffset;
+
+            /* An offset of -1 means the current file position */
+            if (Elements[i].FileOffset.QuadPart == -1)
+                Status = GetTransmitFileOffset(lpPacketArray[i].hFile, NULL, &Elements[i].FileOffset);
+        }
+        else if (lpPacketArray[i].dwElFlags & TP_ELEMENT_MEMORY)
+        {
+            Elements[i].Flags = AFD_TRANSMIT_ELEMENT_MEMORY;
+            Elements[i].Buffer = lpPacketArray[i].pBuffer;
+            Elements[i].Length = lpPacketArray[i].cLength;
+        }
+        else
+        {
+            Status = STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        HeapFree(GlobalHeap, 0, Elements);
+        SetLastError(TranslateNtStatusError(Status));
+        return FALSE;
+    }
+
+    /* AFD captures the elements before the request returns */
+    Ret = SockTransmit(hSocket, Elements, nElementCount, nSendSize, lpOverlapped, dwFlags);
+
+    HeapFree(GlobalHeap, 0, Elements);
+
+    return Ret;
+}
+
 INT
 WSPAPI
 WSPRecvDisconnect(IN  SOCKET s,
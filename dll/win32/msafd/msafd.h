@@ -457,6 +457,27 @@ WSPDisconnectEx(
     IN DWORD dwFlags,
     IN DWORD reserved);
 
+BOOL
+WSPAPI
+WSPTransmitFile(
+    IN SOCKET hSocket,
+    IN HANDLE hFile,
+    IN DWORD nNumberOfBytesToWrite,
+    IN DWORD nNumberOfBytesPerSend,
+    IN OUT LPOVERLAPPED lpOverlapped,
+    IN LPTRANSMIT_FILE_BUFFERS lpTransmitBuffers,
+    IN DWORD dwFlags);
+
+BOOL
+WSPAPI
+WSPTransmitPackets(
+    IN SOCKET hSocket,
+    IN LPTRANSMIT_PACKETS_ELEMENT lpPacketArray,
+    IN DWORD nElementCount,
+    IN DWORD nSendSize,
+    IN OUT LPOVERLAPPED lpOverlapped,
+    IN DWORD dwFlags);
+
 VOID
 WSPAPI
 WSPGetAcceptExSockaddrs(
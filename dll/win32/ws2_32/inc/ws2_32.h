@@ -35,6 +35,7 @@
 
 #include <nsp_dns.h>
 #include <iptypes.h>
+#include <mswsock.h>
 
 /* Missing definitions */
 #define SO_OPENTYPE                 0x7008
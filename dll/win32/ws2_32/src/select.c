@@ -114,6 +114,123 @@ select(IN INT s,
     return SOCKET_ERROR;
 }
 
+/*
+ * @implemented
+ */
+INT
+WSAAPI
+WSAPoll(IN OUT LPWSAPOLLFD fdArray,
+        IN ULONG fds,
+        IN INT timeout)
+{
+    PWSSOCKET Socket = NULL;
+    LPWSAPOLLDATA PollData;
+    LPWSATHREADID ThreadId;
+    SOCKET Handle = INVALID_SOCKET;
+    DWORD PollDataSize;
+    DWORD BytesReturned;
+    INT Status;
+    INT ErrorCode;
+    ULONG i;
+
+    DPRINT("WSAPoll: %p %lu %d\n", fdArray, fds, timeout);
+
+    /* Check for WSAStartup */
+    if ((ErrorCode = WsQuickPrologTid(&ThreadId)) != ERROR_SUCCESS)
+    {
+        SetLastError(ErrorCode);
+        return SOCKET_ERROR;
+    }
+
+    if (!fds)
+    {
+        SetLastError(WSAEINVAL);
+        return SOCKET_ERROR;
+    }
+
+    if (!fdArray ||
+        fds > (MAXDWORD - FIELD_OFFSET(WSAPOLLDATA, fdArray)) / sizeof(WSAPOLLFD))
+    {
+        SetLastError(WSAEFAULT);
+        return SOCKET_ERROR;
+    }
+
+    /* The provider of the first valid socket handles the whole set */
+    for (i = 0; i < fds && !Socket; i++)
+    {
+        if ((INT_PTR)fdArray[i].fd >= 0)
+        {
+            Handle = fdArray[i].fd;
+            Socket = WsSockGetSocket(Handle);
+        }
+    }
+
+    if (!Socket)
+    {
+        /* Nothing to wait on, every descriptor is either ignored or invalid */
+        Status = 0;
+        for (i = 0; i < fds; i++)
+        {
+            fdArray[i].revents = 0;
+            if ((INT_PTR)fdArray[i].fd >= 0)
+            {
+                fdArray[i].revents = POLLNVAL;
+                Status++;
+            }
+        }
+        return Status;
+    }
+
+    PollDataSize = FIELD_OFFSET(WSAPOLLDATA, fdArray) + fds * sizeof(WSAPOLLFD);
+    PollData = HeapAlloc(WsSockHeap, 0, PollDataSize);
+    if (!PollData)
+    {
+        WsSockDereference(Socket);
+        SetLastError(WSAENOBUFS);
+        return SOCKET_ERROR;
+    }
+
+    PollData->result = 0;
+    PollData->fds = fds;
+    PollData->timeout = timeout;
+    RtlCopyMemory(PollData->fdArray, fdArray, fds * sizeof(WSAPOLLFD));
+
+    /* Make the call */
+    Status = Socket->Provider->Service.lpWSPIoctl(Handle,
+                                                  SIO_EXT_POLL,
+                                                  PollData,
+                                                  PollDataSize,
+                                                  PollData,
+                                                  PollDataSize,
+                                                  &BytesReturned,
+                                                  NULL,
+                                                  NULL,
+                                                  ThreadId,
+                                                  &ErrorCode);
+
+    /* Deference the Socket Context */
+    WsSockDereference(Socket);
+
+    if (Status != SOCKET_ERROR)
+    {
+        for (i = 0; i < fds; i++)
+            fdArray[i].revents = PollData->fdArray[i].revents;
+        Status = PollData->result;
+        HeapFree(WsSockHeap, 0, PollData);
+        return Status;
+    }
+
+    HeapFree(WsSockHeap, 0, PollData);
+
+    /* If everything seemed fine, then the WSP call failed itself */
+    if (ErrorCode == NO_ERROR)
+        ErrorCode = WSASYSCALLFAILURE;
+
+    /* Return with an error */
+    SetLastError(ErrorCode);
+    return SOCKET_ERROR;
+}
+
 /*
  * @unimplemented
  */
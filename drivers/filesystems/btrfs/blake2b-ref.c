@@ -13,12 +13,13 @@
    https://blake2.net.
 */
 
-#include <stdint.h>
-#include <string.h>
-#include <stdio.h>
-
+#include "btrfs_drv.h"
 #include "blake2-impl.h"
 
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+#include <tmmintrin.h>
+#endif
+
 static const uint64_t blake2b_IV[8] =
 {
   0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
@@ -138,7 +139,7 @@ static void blake2b_init( blake2b_state *S, size_t outlen )
     G(r,7,v[ 3],v[ 4],v[ 9],v[14]); \
   } while(0)
 
-static void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+void blake2b_compress_ref( uint64_t *h, const uint64_t *t, const uint64_t *f, const uint8_t *block )
 {
   uint64_t m[16];
   uint64_t v[16];
@@ -149,17 +150,17 @@ static void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOC
   }
 
   for( i = 0; i < 8; ++i ) {
-    v[i] = S->h[i];
+    v[i] = h[i];
   }
 
   v[ 8] = blake2b_IV[0];
   v[ 9] = blake2b_IV[1];
   v[10] = blake2b_IV[2];
   v[11] = blake2b_IV[3];
-  v[12] = blake2b_IV[4] ^ S->t[0];
-  v[13] = blake2b_IV[5] ^ S->t[1];
-  v[14] = blake2b_IV[6] ^ S->f[0];
-  v[15] = blake2b_IV[7] ^ S->f[1];
+  v[12] = blake2b_IV[4] ^ t[0];
+  v[13] = blake2b_IV[5] ^ t[1];
+  v[14] = blake2b_IV[6] ^ f[0];
+  v[15] = blake2b_IV[7] ^ f[1];
 
   ROUND( 0 );
   ROUND( 1 );
@@ -175,13 +176,15 @@ static void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOC
   ROUND( 11 );
 
   for( i = 0; i < 8; ++i ) {
-    S->h[i] = S->h[i] ^ v[i] ^ v[i + 8];
+    h[i] = h[i] ^ v[i] ^ v[i + 8];
   }
 }
 
 #undef G
 #undef ROUND
 
+blake2b_compress_func blake2b_compress = blake2b_compress_ref;
+
 static int blake2b_update( blake2b_state *S, const void *pin, size_t inlen )
 {
   const unsigned char * in = (const unsigned char *)pin;
@@ -194,11 +197,11 @@ static int blake2b_update( blake2b_state *S, const void *pin, size_t inlen )
       S->buflen = 0;
       memcpy( S->buf + left, in, fill ); /* Fill buffer */
       blake2b_increment_counter( S, BLAKE2B_BLOCKBYTES );
-      blake2b_compress( S, S->buf ); /* Compress */
+      blake2b_compress( S->h, S->t, S->f, S->buf ); /* Compress */
       in += fill; inlen -= fill;
       while(inlen > BLAKE2B_BLOCKBYTES) {
         blake2b_increment_counter(S, BLAKE2B_BLOCKBYTES);
-        blake2b_compress( S, in );
+        blake2b_compress( S->h, S->t, S->f, in );
         in += BLAKE2B_BLOCKBYTES;
         inlen -= BLAKE2B_BLOCKBYTES;
       }
@@ -223,7 +226,7 @@ static int blake2b_final( blake2b_state *S, void *out, size_t outlen )
   blake2b_increment_counter( S, S->buflen );
   blake2b_set_lastblock( S );
   memset( S->buf + S->buflen, 0, BLAKE2B_BLOCKBYTES - S->buflen ); /* Padding */
-  blake2b_compress( S, S->buf );
+  blake2b_compress( S->h, S->t, S->f, S->buf );
 
   for( i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
     store64( buffer + sizeof( S->h[i] ) * i, S->h[i] );
@@ -243,3 +246,126 @@ void blake2b( void *out, size_t outlen, const void *in, size_t inlen )
   blake2b_update( S, ( const uint8_t * )in, inlen );
   blake2b_final( S, out, outlen );
 }
+
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+/* The same rounds as above, with the sixteen words of v held two to an XMM register. */
+
+#define G1_SSSE3(b0,b1)                                                    \
+  do {                                                                     \
+    row1l = _mm_add_epi64(_mm_add_epi64(row1l, b0), row2l);                \
+    row1h = _mm_add_epi64(_mm_add_epi64(row1h, b1), row2h);                \
+    row4l = _mm_shuffle_epi32(_mm_xor_si128(row4l, row1l), 0xb1);          \
+    row4h = _mm_shuffle_epi32(_mm_xor_si128(row4h, row1h), 0xb1);          \
+    row3l = _mm_add_epi64(row3l, row4l);                                   \
+    row3h = _mm_add_epi64(row3h, row4h);                                   \
+    row2l = _mm_shuffle_epi8(_mm_xor_si128(row2l, row3l), r24);            \
+    row2h = _mm_shuffle_epi8(_mm_xor_si128(row2h, row3h), r24);            \
+  } while(0)
+
+#define G2_SSSE3(b0,b1)                                                    \
+  do {                                                                     \
+    row1l = _mm_add_epi64(_mm_add_epi64(row1l, b0), row2l);                \
+    row1h = _mm_add_epi64(_mm_add_epi64(row1h, b1), row2h);                \
+    row4l = _mm_shuffle_epi8(_mm_xor_si128(row4l, row1l), r16);            \
+    row4h = _mm_shuffle_epi8(_mm_xor_si128(row4h, row1h), r16);            \
+    row3l = _mm_add_epi64(row3l, row4l);                                   \
+    row3h = _mm_add_epi64(row3h, row4h);                                   \
+    row2l = _mm_xor_si128(row2l, row3l);                                   \
+    row2h = _mm_xor_si128(row2h, row3h);                                   \
+    row2l = _mm_xor_si128(_mm_srli_epi64(row2l, 63), _mm_add_epi64(row2l, row2l)); \
+    row2h = _mm_xor_si128(_mm_srli_epi64(row2h, 63), _mm_add_epi64(row2h, row2h)); \
+  } while(0)
+
+#define MSG_SSSE3(r,a,b) _mm_set_epi64x( m[blake2b_sigma[r][b]], m[blake2b_sigma[r][a]] )
+
+SSSE3_FUNC
+void blake2b_compress_ssse3( uint64_t *h, const uint64_t *t, const uint64_t *f, const uint8_t *block )
+{
+  const __m128i r16 = _mm_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9 );
+  const __m128i r24 = _mm_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10 );
+  __m128i row1l, row1h, row2l, row2h, row3l, row3h, row4l, row4h, t0, t1;
+  uint64_t m[16];
+  size_t i, r;
+
+  for( i = 0; i < 16; ++i ) {
+    m[i] = load64( block + i * sizeof( m[i] ) );
+  }
+
+  row1l = _mm_loadu_si128( (const __m128i *)&h[0] );
+  row1h = _mm_loadu_si128( (const __m128i *)&h[2] );
+  row2l = _mm_loadu_si128( (const __m128i *)&h[4] );
+  row2h = _mm_loadu_si128( (const __m128i *)&h[6] );
+  row3l = _mm_loadu_si128( (const __m128i *)&blake2b_IV[0] );
+  row3h = _mm_loadu_si128( (const __m128i *)&blake2b_IV[2] );
+  row4l = _mm_xor_si128( _mm_loadu_si128( (const __m128i *)&blake2b_IV[4] ), _mm_loadu_si128( (const __m128i *)t ) );
+  row4h = _mm_xor_si128( _mm_loadu_si128( (const __m128i *)&blake2b_IV[6] ), _mm_loadu_si128( (const __m128i *)f ) );
+
+  for( r = 0; r < 12; ++r ) {
+    /* Columns */
+    G1_SSSE3( MSG_SSSE3( r, 0, 2 ), MSG_SSSE3( r, 4, 6 ) );
+    G2_SSSE3( MSG_SSSE3( r, 1, 3 ), MSG_SSSE3( r, 5, 7 ) );
+
+    /* Rotate rows 2-4 so that the diagonals line up as columns */
+    t0 = _mm_alignr_epi8( row2h, row2l, 8 );
+    t1 = _mm_alignr_epi8( row2l, row2h, 8 );
+    row2l = t0; row2h = t1;
+    t0 = row3l; row3l = row3h; row3h = t0;
+    t0 = _mm_alignr_epi8( row4h, row4l, 8 );
+    t1 = _mm_alignr_epi8( row4l, row4h, 8 );
+    row4l = t1; row4h = t0;
+
+    /* Diagonals */
+    G1_SSSE3( MSG_SSSE3( r, 8, 10 ), MSG_SSSE3( r, 12, 14 ) );
+    G2_SSSE3( MSG_SSSE3( r, 9, 11 ), MSG_SSSE3( r, 13, 15 ) );
+
+    /* And back again */
+    t0 = _mm_alignr_epi8( row2l, row2h, 8 );
+    t1 = _mm_alignr_epi8( row2h, row2l, 8 );
+    row2l = t0; row2h = t1;
+    t0 = row3l; row3l = row3h; row3h = t0;
+    t0 = _mm_alignr_epi8( row4h, row4l, 8 );
+    t1 = _mm_alignr_epi8( row4l, row4h, 8 );
+    row4l = t0; row4h = t1;
+  }
+
+  _mm_storeu_si128( (__m128i *)&h[0], _mm_xor_si128( _mm_loadu_si128( (const __m128i *)&h[0] ), _mm_xor_si128( row1l, row3l ) ) );
+  _mm_storeu_si128( (__m128i *)&h[2], _mm_xor_si128( _mm_loadu_si128( (const __m128i *)&h[2] ), _mm_xor_si128( row1h, row3h ) ) );
+  _mm_storeu_si128( (__m128i *)&h[4], _mm_xor_si128( _mm_loadu_si128( (const __m128i *)&h[4] ), _mm_xor_si128( row2l, row4l ) ) );
+  _mm_storeu_si128( (__m128i *)&h[6], _mm_xor_si128( _mm_loadu_si128( (const __m128i *)&h[6] ), _mm_xor_si128( row2h, row4h ) ) );
+}
+
+#undef G1_SSSE3
+#undef G2_SSSE3
+#undef MSG_SSSE3
+
+/* Checks a compression function against the reference one. */
+bool blake2b_check_compress( blake2b_compress_func func )
+{
+  uint8_t block[BLAKE2B_BLOCKBYTES];
+  uint64_t h1[8], h2[8], t[2], f[2];
+  size_t i, j;
+
+  for( i = 0; i < 8; ++i ) {
+    h1[i] = h2[i] = blake2b_IV[i] ^ ( 0x0101010101010101ULL * i );
+  }
+
+  for( i = 0; i < 64; ++i ) {
+    for( j = 0; j < BLAKE2B_BLOCKBYTES; ++j ) {
+      block[j] = ( uint8_t )( i * 131 + j * 7 + 1 );
+    }
+
+    t[0] = ( i + 1 ) * BLAKE2B_BLOCKBYTES;
+    t[1] = i;
+    f[0] = ( i & 1 ) ? ( uint64_t )-1 : 0;
+    f[1] = 0;
+
+    blake2b_compress_ref( h1, t, f, block );
+    func( h2, t, f, block );
+
+    if( RtlCompareMemory( h1, h2, sizeof( h1 ) ) != sizeof( h1 ) )
+      return false;
+  }
+
+  return true;
+}
+#endif
@@ -5877,18 +5877,53 @@ static void init_serial(bool first_time) {
 #if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
 static void check_cpu() {
     unsigned int cpuInfo[4];
-    bool have_sse42;
+    bool have_sse42, have_sse41, have_ssse3, have_osxsave, have_avx2 = false, have_sha = false;
 
 #ifndef _MSC_VER
     __get_cpuid(1, &cpuInfo[0], &cpuInfo[1], &cpuInfo[2], &cpuInfo[3]);
     have_sse42 = cpuInfo[2] & bit_SSE4_2;
+    have_sse41 = cpuInfo[2] & bit_SSE4_1;
+    have_ssse3 = cpuInfo[2] & bit_SSSE3;
+    have_osxsave = cpuInfo[2] & bit_OSXSAVE;
     have_sse2 = cpuInfo[3] & bit_SSE2;
+
+    if (__get_cpuid_count(7, 0, &cpuInfo[0], &cpuInfo[1], &cpuInfo[2], &cpuInfo[3])) {
+        have_avx2 = cpuInfo[1] & bit_AVX2;
+        have_sha = cpuInfo[1] & bit_SHA;
+    }
 #else
+    __cpuid(cpuInfo, 0);
+    if (cpuInfo[0] >= 7) {
+        __cpuidex(cpuInfo, 7, 0);
+        have_avx2 = cpuInfo[1] & (1 << 5);
+        have_sha = cpuInfo[1] & (1 << 29);
+    }
+
     __cpuid(cpuInfo, 1);
     have_sse42 = cpuInfo[2] & (1 << 20);
+    have_sse41 = cpuInfo[2] & (1 << 19);
+    have_ssse3 = cpuInfo[2] & (1 << 9);
+    have_osxsave = cpuInfo[2] & (1 << 27);
     have_sse2 = cpuInfo[3] & (1 << 26);
 #endif
 
+    // check Windows has enabled AVX - the YMM registers need OSXSAVE and XCR0 bits 1 and 2
+    if (have_avx2) {
+        if (have_osxsave) {
+            uint32_t xcr0;
+
+#ifdef _MSC_VER
+            xcr0 = (uint32_t)_xgetbv(0);
+#else
+            __asm__("xgetbv" : "=a" (xcr0) : "c" (0) : "edx");
+#endif
+
+            if ((xcr0 & 6) != 6)
+                have_avx2 = false;
+        } else
+            have_avx2 = false;
+    }
+
     if (have_sse42) {
         TRACE("SSE4.2 is supported\n");
         calc_crc32c = calc_crc32c_hw;
@@ -5899,6 +5934,34 @@ static void check_cpu() {
         TRACE("SSE2 is supported\n");
     else
         TRACE("SSE2 is not supported\n");
+
+    if (have_avx2 && galois_check_funcs(galois_double_avx2, galois_mul_avx2, galois_mul_xor_avx2)) {
+        TRACE("using AVX2 for RAID6 parity\n");
+        galois_double = galois_double_avx2;
+        galois_mul = galois_mul_avx2;
+        galois_mul_xor = galois_mul_xor_avx2;
+    } else if (have_ssse3 && galois_check_funcs(galois_double_sse2, galois_mul_ssse3, galois_mul_xor_ssse3)) {
+        TRACE("using SSSE3 for RAID6 parity\n");
+        galois_double = galois_double_sse2;
+        galois_mul = galois_mul_ssse3;
+        galois_mul_xor = galois_mul_xor_ssse3;
+    } else if (have_sse2) {
+        galois_double = galois_double_sse2;
+    }
+
+    // the SHA instructions work on XMM registers, and need SSE4.1 for the state shuffling
+    if (have_sha && have_sse41 && sha256_check_funcs(sha256_blocks_shani, NULL)) {
+        TRACE("using SHA extensions for SHA-256\n");
+        sha256_blocks = sha256_blocks_shani;
+    } else if (have_avx2 && sha256_check_funcs(NULL, sha256_x8_avx2)) {
+        TRACE("using AVX2 for SHA-256\n");
+        sha256_x8 = sha256_x8_avx2;
+    }
+
+    if (have_ssse3 && blake2b_check_compress(blake2b_compress_ssse3)) {
+        TRACE("using SSSE3 for BLAKE2b\n");
+        blake2b_compress = blake2b_compress_ssse3;
+    }
 }
 #endif
 
@@ -68,6 +68,17 @@
 
 #if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
 #include <emmintrin.h>
+
+// GCC only lets us use intrinsics beyond SSE2 in functions built for them
+#ifdef __GNUC__
+#define SSSE3_FUNC __attribute__((target("ssse3")))
+#define SHA_FUNC __attribute__((target("sha,sse4.1")))
+#define AVX2_FUNC __attribute__((target("avx2")))
+#else
+#define SSSE3_FUNC
+#define SHA_FUNC
+#define AVX2_FUNC
+#endif
 #endif
 
 #ifdef __REACTOS__
@@ -1244,11 +1255,33 @@ void _free_fcb(_Inout_ fcb* fcb, _In_ const char* func);
 void init_fast_io_dispatch(FAST_IO_DISPATCH** fiod);
 
 // in sha256.c
+typedef void (*sha256_blocks_func)(uint32_t* h, const uint8_t* data, size_t blocks);
+typedef void (*sha256_x8_func)(uint8_t* hash, const uint8_t* input, size_t len);
+
+extern sha256_blocks_func sha256_blocks;
+extern sha256_x8_func sha256_x8;
+
 void calc_sha256(uint8_t* hash, const void* input, size_t len);
+void calc_sha256_multi(uint8_t* hash, const uint8_t* input, size_t len, unsigned int num);
+void sha256_blocks_sw(uint32_t* h, const uint8_t* data, size_t blocks);
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+void sha256_blocks_shani(uint32_t* h, const uint8_t* data, size_t blocks);
+void sha256_x8_avx2(uint8_t* hash, const uint8_t* input, size_t len);
+bool sha256_check_funcs(sha256_blocks_func blocks_func, sha256_x8_func x8_func);
+#endif
 #define SHA256_HASH_SIZE 32
 
 // in blake2b-ref.c
+typedef void (*blake2b_compress_func)(uint64_t* h, const uint64_t* t, const uint64_t* f, const uint8_t* block);
+
+extern blake2b_compress_func blake2b_compress;
+
 void blake2b(void *out, size_t outlen, const void* in, size_t inlen);
+void blake2b_compress_ref(uint64_t* h, const uint64_t* t, const uint64_t* f, const uint8_t* block);
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+void blake2b_compress_ssse3(uint64_t* h, const uint64_t* t, const uint64_t* f, const uint8_t* block);
+bool blake2b_check_compress(blake2b_compress_func func);
+#endif
 #define BLAKE2_HASH_SIZE 32
 
 typedef struct {
@@ -1556,7 +1589,26 @@ NTSTATUS lzo_compress(uint8_t* inbuf, uint32_t inlen, uint8_t* outbuf, uint32_t
 NTSTATUS zstd_compress(uint8_t* inbuf, uint32_t inlen, uint8_t* outbuf, uint32_t outlen, uint32_t level, unsigned int* space_left);
 
 // in galois.c
-void galois_double(uint8_t* data, uint32_t len);
+typedef void (*galois_double_func)(uint8_t* data, uint32_t len);
+typedef void (*galois_mul_func)(uint8_t* data, uint8_t c, uint32_t len);
+typedef void (*galois_mul_xor_func)(uint8_t* out, uint8_t* in, uint8_t c, uint32_t len);
+
+extern galois_double_func galois_double;
+extern galois_mul_func galois_mul;
+extern galois_mul_xor_func galois_mul_xor;
+
+void galois_double_sw(uint8_t* data, uint32_t len);
+void galois_mul_sw(uint8_t* data, uint8_t c, uint32_t len);
+void galois_mul_xor_sw(uint8_t* out, uint8_t* in, uint8_t c, uint32_t len);
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+void galois_double_sse2(uint8_t* data, uint32_t len);
+void galois_mul_ssse3(uint8_t* data, uint8_t c, uint32_t len);
+void galois_mul_xor_ssse3(uint8_t* out, uint8_t* in, uint8_t c, uint32_t len);
+void galois_double_avx2(uint8_t* data, uint32_t len);
+void galois_mul_avx2(uint8_t* data, uint8_t c, uint32_t len);
+void galois_mul_xor_avx2(uint8_t* out, uint8_t* in, uint8_t c, uint32_t len);
+#endif
+bool galois_check_funcs(galois_double_func double_func, galois_mul_func mul_func, galois_mul_xor_func mul_xor_func);
 void galois_divpower(uint8_t* data, uint8_t div, uint32_t readlen);
 uint8_t gpow2(uint8_t e);
 uint8_t gmul(uint8_t a, uint8_t b);
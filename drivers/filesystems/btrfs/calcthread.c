@@ -19,12 +19,16 @@
 #include "xxhash.h"
 #include "crc32c.h"
 
+// most sectors a thread takes from a checksum job at a time - a multiple of the eight lanes of sha256_x8
+#define CALC_BATCH_SECTORS 16
+
 void calc_thread_main(device_extension* Vcb, calc_job* cj) {
     while (true) {
         KIRQL irql;
         calc_job* cj2;
         uint8_t* src;
         void* dest;
+        uint32_t count = 1, i;
         bool last_one = false;
 
         KeAcquireSpinLock(&Vcb->calcthreads.spinlock, &irql);
@@ -53,15 +57,24 @@ void calc_thread_main(device_extension* Vcb, calc_job* cj) {
             case calc_thread_xxhash:
             case calc_thread_sha256:
             case calc_thread_blake2:
-                cj2->in = (uint8_t*)cj2->in + Vcb->superblock.sector_size;
-                cj2->out = (uint8_t*)cj2->out + Vcb->csum_size;
+                // Take a run of sectors rather than one at a time, so the SIMD code can hash
+                // eight at once, but leave enough for the other threads to share.
+                count = (uint32_t)cj2->not_started / (Vcb->calcthreads.num_threads + 1);
+
+                if (count > CALC_BATCH_SECTORS)
+                    count = CALC_BATCH_SECTORS;
+                else if (count < 8)
+                    count = min((uint32_t)cj2->not_started, 8);
+
+                cj2->in = (uint8_t*)cj2->in + (count * Vcb->superblock.sector_size);
+                cj2->out = (uint8_t*)cj2->out + (count * Vcb->csum_size);
             break;
 
             default:
                 break;
         }
 
-        cj2->not_started--;
+        cj2->not_started -= (LONG)count;
 
         if (cj2->not_started == 0) {
             RemoveEntryList(&cj2->list_entry);
@@ -72,19 +85,28 @@ void calc_thread_main(device_extension* Vcb, calc_job* cj) {
 
         switch (cj2->type) {
             case calc_thread_crc32c:
-                *(uint32_t*)dest = ~calc_crc32c(0xffffffff, src, Vcb->superblock.sector_size);
+                for (i = 0; i < count; i++) {
+                    ((uint32_t*)dest)[i] = ~calc_crc32c(0xffffffff, src, Vcb->superblock.sector_size);
+                    src += Vcb->superblock.sector_size;
+                }
             break;
 
             case calc_thread_xxhash:
-                *(uint64_t*)dest = XXH64(src, Vcb->superblock.sector_size, 0);
+                for (i = 0; i < count; i++) {
+                    ((uint64_t*)dest)[i] = XXH64(src, Vcb->superblock.sector_size, 0);
+                    src += Vcb->superblock.sector_size;
+                }
             break;
 
             case calc_thread_sha256:
-                calc_sha256(dest, src, Vcb->superblock.sector_size);
+                calc_sha256_multi(dest, src, Vcb->superblock.sector_size, count);
             break;
 
             case calc_thread_blake2:
-                blake2b(dest, BLAKE2_HASH_SIZE, src, Vcb->superblock.sector_size);
+                for (i = 0; i < count; i++) {
+                    blake2b((uint8_t*)dest + (i * BLAKE2_HASH_SIZE), BLAKE2_HASH_SIZE, src, Vcb->superblock.sector_size);
+                    src += Vcb->superblock.sector_size;
+                }
             break;
 
             case calc_thread_decomp_zlib:
@@ -130,7 +152,7 @@ void calc_thread_main(device_extension* Vcb, calc_job* cj) {
             break;
         }
 
-        if (InterlockedDecrement(&cj2->left) == 0)
+        if (InterlockedExchangeAdd(&cj2->left, -(LONG)count) == (LONG)count)
             KeSetEvent(&cj2->event, 0, false);
 
         if (last_one)
@@ -17,6 +17,11 @@
 
 #include "btrfs_drv.h"
 
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+#include <tmmintrin.h>
+#include <immintrin.h>
+#endif
+
 static const uint8_t glog[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
                              0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
                              0x9d, 0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
@@ -51,21 +56,6 @@ static const uint8_t gilog[] = {0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6,
                               0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
                               0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf};
 
-// divides the bytes in data by 2^div
-void galois_divpower(uint8_t* data, uint8_t div, uint32_t len) {
-    while (len > 0) {
-        if (data[0] != 0) {
-            if (gilog[data[0]] <= div)
-                data[0] = glog[(gilog[data[0]] + (255 - div)) % 255];
-            else
-                data[0] = glog[(gilog[data[0]] - div) % 255];
-        }
-
-        data++;
-        len--;
-    }
-}
-
 uint8_t gpow2(uint8_t e) {
     return glog[e%255];
 }
@@ -94,6 +84,10 @@ uint8_t gdiv(uint8_t a, uint8_t b) {
 // "The mathematics of RAID-6", by H. Peter Anvin.
 // https://www.kernel.org/pub/linux/kernel/people/hpa/raid6.pdf
 
+galois_double_func galois_double = galois_double_sw;
+galois_mul_func galois_mul = galois_mul_sw;
+galois_mul_xor_func galois_mul_xor = galois_mul_xor_sw;
+
 #if defined(_AMD64_) || defined(_ARM64_)
 __inline static uint64_t galois_double_mask64(uint64_t v) {
     v &= 0x8080808080808080;
@@ -106,9 +100,7 @@ __inline static uint32_t galois_double_mask32(uint32_t v) {
 }
 #endif
 
-void galois_double(uint8_t* data, uint32_t len) {
-    // FIXME - SIMD?
-
+void galois_double_sw(uint8_t* data, uint32_t len) {
 #if defined(_AMD64_) || defined(_ARM64_)
     while (len > sizeof(uint64_t)) {
         uint64_t v = *((uint64_t*)data), vv;
@@ -139,3 +131,284 @@ void galois_double(uint8_t* data, uint32_t len) {
         len--;
     }
 }
+
+// Multiplying by a constant is linear, so c*x is c*(x & 0xf) ^ c*(x & 0xf0), which
+// only needs two 16-entry tables per constant. These are also what PSHUFB looks up.
+static void galois_nibble_tables(uint8_t c, uint8_t* lo, uint8_t* hi) {
+    unsigned int i;
+
+    for (i = 0; i < 16; i++) {
+        lo[i] = gmul(c, (uint8_t)i);
+        hi[i] = gmul(c, (uint8_t)(i << 4));
+    }
+}
+
+void galois_mul_sw(uint8_t* data, uint8_t c, uint32_t len) {
+    uint8_t lo[16], hi[16];
+
+    galois_nibble_tables(c, lo, hi);
+
+    while (len > 0) {
+        data[0] = lo[data[0] & 0xf] ^ hi[data[0] >> 4];
+        data++;
+        len--;
+    }
+}
+
+void galois_mul_xor_sw(uint8_t* out, uint8_t* in, uint8_t c, uint32_t len) {
+    uint8_t lo[16], hi[16];
+
+    galois_nibble_tables(c, lo, hi);
+
+    while (len > 0) {
+        out[0] ^= lo[in[0] & 0xf] ^ hi[in[0] >> 4];
+        out++;
+        in++;
+        len--;
+    }
+}
+
+// divides the bytes in data by 2^div
+void galois_divpower(uint8_t* data, uint8_t div, uint32_t len) {
+    galois_mul(data, gpow2(255 - (div % 255)), len);
+}
+
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+void galois_double_sse2(uint8_t* data, uint32_t len) {
+    __m128i poly = _mm_set1_epi8(0x1d), zero = _mm_setzero_si128();
+
+    while (len >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i*)data);
+        __m128i carry = _mm_and_si128(_mm_cmpgt_epi8(zero, v), poly); // bytes with their top bit set
+
+        v = _mm_xor_si128(_mm_add_epi8(v, v), carry);
+        _mm_storeu_si128((__m128i*)data, v);
+
+        data += 16;
+        len -= 16;
+    }
+
+    galois_double_sw(data, len);
+}
+
+SSSE3_FUNC
+static __inline __m128i galois_mul_ssse3_vec(__m128i v, __m128i lo, __m128i hi, __m128i mask) {
+    __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(v, mask));
+    __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(v, 4), mask));
+
+    return _mm_xor_si128(l, h);
+}
+
+SSSE3_FUNC
+void galois_mul_ssse3(uint8_t* data, uint8_t c, uint32_t len) {
+    uint8_t tl[16], th[16];
+    __m128i lo, hi, mask = _mm_set1_epi8(0x0f);
+
+    galois_nibble_tables(c, tl, th);
+    lo = _mm_loadu_si128((__m128i*)tl);
+    hi = _mm_loadu_si128((__m128i*)th);
+
+    while (len >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i*)data);
+
+        _mm_storeu_si128((__m128i*)data, galois_mul_ssse3_vec(v, lo, hi, mask));
+
+        data += 16;
+        len -= 16;
+    }
+
+    while (len > 0) {
+        data[0] = tl[data[0] & 0xf] ^ th[data[0] >> 4];
+        data++;
+        len--;
+    }
+}
+
+SSSE3_FUNC
+void galois_mul_xor_ssse3(uint8_t* out, uint8_t* in, uint8_t c, uint32_t len) {
+    uint8_t tl[16], th[16];
+    __m128i lo, hi, mask = _mm_set1_epi8(0x0f);
+
+    galois_nibble_tables(c, tl, th);
+    lo = _mm_loadu_si128((__m128i*)tl);
+    hi = _mm_loadu_si128((__m128i*)th);
+
+    while (len >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i*)in);
+        __m128i o = _mm_loadu_si128((__m128i*)out);
+
+        _mm_storeu_si128((__m128i*)out, _mm_xor_si128(o, galois_mul_ssse3_vec(v, lo, hi, mask)));
+
+        in += 16;
+        out += 16;
+        len -= 16;
+    }
+
+    while (len > 0) {
+        out[0] ^= tl[in[0] & 0xf] ^ th[in[0] >> 4];
+        out++;
+        in++;
+        len--;
+    }
+}
+
+// Saving the AVX state isn't free, so short buffers stay on the SSE versions.
+#define AVX2_MIN_LEN 256
+
+AVX2_FUNC
+void galois_double_avx2(uint8_t* data, uint32_t len) {
+    XSTATE_SAVE s;
+    __m256i poly, zero;
+
+    if (len < AVX2_MIN_LEN || !NT_SUCCESS(KeSaveExtendedProcessorState(XSTATE_MASK_AVX, &s))) {
+        galois_double_sse2(data, len);
+        return;
+    }
+
+    poly = _mm256_set1_epi8(0x1d);
+    zero = _mm256_setzero_si256();
+
+    while (len >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i*)data);
+        __m256i carry = _mm256_and_si256(_mm256_cmpgt_epi8(zero, v), poly);
+
+        v = _mm256_xor_si256(_mm256_add_epi8(v, v), carry);
+        _mm256_storeu_si256((__m256i*)data, v);
+
+        data += 32;
+        len -= 32;
+    }
+
+    KeRestoreExtendedProcessorState(&s);
+
+    galois_double_sse2(data, len);
+}
+
+AVX2_FUNC
+static __inline __m256i galois_mul_avx2_vec(__m256i v, __m256i lo, __m256i hi, __m256i mask) {
+    __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask));
+    __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(v, 4), mask));
+
+    return _mm256_xor_si256(l, h);
+}
+
+AVX2_FUNC
+void galois_mul_avx2(uint8_t* data, uint8_t c, uint32_t len) {
+    XSTATE_SAVE s;
+    uint8_t tl[16], th[16];
+    __m256i lo, hi, mask;
+
+    if (len < AVX2_MIN_LEN || !NT_SUCCESS(KeSaveExtendedProcessorState(XSTATE_MASK_AVX, &s))) {
+        galois_mul_ssse3(data, c, len);
+        return;
+    }
+
+    galois_nibble_tables(c, tl, th);
+    lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)tl));
+    hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)th));
+    mask = _mm256_set1_epi8(0x0f);
+
+    while (len >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i*)data);
+
+        _mm256_storeu_si256((__m256i*)data, galois_mul_avx2_vec(v, lo, hi, mask));
+
+        data += 32;
+        len -= 32;
+    }
+
+    KeRestoreExtendedProcessorState(&s);
+
+    galois_mul_ssse3(data, c, len);
+}
+
+AVX2_FUNC
+void galois_mul_xor_avx2(uint8_t* out, uint8_t* in, uint8_t c, uint32_t len) {
+    XSTATE_SAVE s;
+    uint8_t tl[16], th[16];
+    __m256i lo, hi, mask;
+
+    if (len < AVX2_MIN_LEN || !NT_SUCCESS(KeSaveExtendedProcessorState(XSTATE_MASK_AVX, &s))) {
+        galois_mul_xor_ssse3(out, in, c, len);
+        return;
+    }
+
+    galois_nibble_tables(c, tl, th);
+    lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)tl));
+    hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)th));
+    mask = _mm256_set1_epi8(0x0f);
+
+    while (len >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i*)in);
+        __m256i o = _mm256_loadu_si256((__m256i*)out);
+
+        _mm256_storeu_si256((__m256i*)out, _mm256_xor_si256(o, galois_mul_avx2_vec(v, lo, hi, mask)));
+
+        in += 32;
+        out += 32;
+        len -= 32;
+    }
+
+    KeRestoreExtendedProcessorState(&s);
+
+    galois_mul_xor_ssse3(out, in, c, len);
+}
+#endif
+
+#define GALOIS_TEST_LEN 1031 // not a multiple of the vector sizes, so that the tails get tested too
+
+// Checks accelerated versions against the table-based ones, before we trust them with parity.
+bool galois_check_funcs(galois_double_func double_func, galois_mul_func mul_func, galois_mul_xor_func mul_xor_func) {
+    uint8_t* buf;
+    uint8_t *data, *ref, *out, *refout;
+    unsigned int c, i;
+    bool ret = false;
+
+    buf = ExAllocatePoolWithTag(PagedPool, GALOIS_TEST_LEN * 4, ALLOC_TAG);
+    if (!buf) {
+        ERR("out of memory\n");
+        return false;
+    }
+
+    data = buf;
+    ref = data + GALOIS_TEST_LEN;
+    out = ref + GALOIS_TEST_LEN;
+    refout = out + GALOIS_TEST_LEN;
+
+    for (i = 0; i < GALOIS_TEST_LEN; i++) {
+        data[i] = (uint8_t)((i * 167) + (i >> 8));
+    }
+
+    RtlCopyMemory(ref, data, GALOIS_TEST_LEN);
+    double_func(ref, GALOIS_TEST_LEN);
+
+    for (i = 0; i < GALOIS_TEST_LEN; i++) {
+        if (ref[i] != gmul(data[i], 2))
+            goto end;
+    }
+
+    for (c = 0; c < 256; c++) {
+        RtlCopyMemory(ref, data, GALOIS_TEST_LEN);
+        mul_func(ref, (uint8_t)c, GALOIS_TEST_LEN);
+
+        for (i = 0; i < GALOIS_TEST_LEN; i++) {
+            out[i] = refout[i] = data[GALOIS_TEST_LEN - 1 - i];
+        }
+
+        mul_xor_func(out, data, (uint8_t)c, GALOIS_TEST_LEN);
+
+        for (i = 0; i < GALOIS_TEST_LEN; i++) {
+            uint8_t m = gmul(data[i], (uint8_t)c);
+
+            if (ref[i] != m || out[i] != (refout[i] ^ m))
+                goto end;
+        }
+    }
+
+    ret = true;
+
+end:
+    ExFreePool(buf);
+
+    return ret;
+}
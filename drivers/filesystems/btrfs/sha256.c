@@ -1,17 +1,14 @@
-#include <stdint.h>
-#include <string.h>
+#include "btrfs_drv.h"
 
-// Public domain code from https://github.com/amosnier/sha-2
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+#include <immintrin.h>
+#endif
 
-// FIXME - x86 SHA extensions
+// Public domain code from https://github.com/amosnier/sha-2
 
 #define CHUNK_SIZE 64
 #define TOTAL_LEN_LEN 8
 
-/*
- * ABOUT bool: this file does not use bool in order to be as pre-C99 compatible as possible.
- */
-
 /*
  * Comments from pseudo-code at https://en.wikipedia.org/wiki/SHA-2 are reproduced here.
  * When useful for clarification, portions of the pseudo-code are reproduced here too.
@@ -32,14 +29,6 @@ static const uint32_t k[] = {
 	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
 };
 
-struct buffer_state {
-	const uint8_t * p;
-	size_t len;
-	size_t total_len;
-	int single_one_delivered; /* bool */
-	int total_len_delivered; /* bool */
-};
-
 static inline uint32_t right_rot(uint32_t value, unsigned int count)
 {
 	/*
@@ -49,109 +38,18 @@ static inline uint32_t right_rot(uint32_t value, unsigned int count)
 	return value >> count | value << (32 - count);
 }
 
-static void init_buf_state(struct buffer_state * state, const void * input, size_t len)
-{
-	state->p = input;
-	state->len = len;
-	state->total_len = len;
-	state->single_one_delivered = 0;
-	state->total_len_delivered = 0;
-}
-
-/* Return value: bool */
-static int calc_chunk(uint8_t chunk[CHUNK_SIZE], struct buffer_state * state)
-{
-	size_t space_in_chunk;
-
-	if (state->total_len_delivered) {
-		return 0;
-	}
-
-	if (state->len >= CHUNK_SIZE) {
-		memcpy(chunk, state->p, CHUNK_SIZE);
-		state->p += CHUNK_SIZE;
-		state->len -= CHUNK_SIZE;
-		return 1;
-	}
-
-	memcpy(chunk, state->p, state->len);
-	chunk += state->len;
-	space_in_chunk = CHUNK_SIZE - state->len;
-	state->p += state->len;
-	state->len = 0;
-
-	/* If we are here, space_in_chunk is one at minimum. */
-	if (!state->single_one_delivered) {
-		*chunk++ = 0x80;
-		space_in_chunk -= 1;
-		state->single_one_delivered = 1;
-	}
-
-	/*
-	 * Now:
-	 * - either there is enough space left for the total length, and we can conclude,
-	 * - or there is too little space left, and we have to pad the rest of this chunk with zeroes.
-	 * In the latter case, we will conclude at the next invokation of this function.
-	 */
-	if (space_in_chunk >= TOTAL_LEN_LEN) {
-		const size_t left = space_in_chunk - TOTAL_LEN_LEN;
-		size_t len = state->total_len;
-		int i;
-		memset(chunk, 0x00, left);
-		chunk += left;
-
-		/* Storing of len * 8 as a big endian 64-bit without overflow. */
-		chunk[7] = (uint8_t) (len << 3);
-		len >>= 5;
-		for (i = 6; i >= 0; i--) {
-			chunk[i] = (uint8_t) len;
-			len >>= 8;
-		}
-		state->total_len_delivered = 1;
-	} else {
-		memset(chunk, 0x00, space_in_chunk);
-	}
-
-	return 1;
-}
-
 /*
- * Limitations:
- * - Since input is a pointer in RAM, the data to hash should be in RAM, which could be a problem
- *   for large data sizes.
- * - SHA algorithms theoretically operate on bit strings. However, this implementation has no support
- *   for bit string lengths that are not multiples of eight, and it really operates on arrays of bytes.
- *   In particular, the len parameter is a number of bytes.
+ * Compresses whole 64-byte chunks of data into the hash state h. This is the portable
+ * version, the others are picked by check_cpu in btrfs.c.
  */
-void calc_sha256(uint8_t* hash, const void* input, size_t len)
+void sha256_blocks_sw(uint32_t* h, const uint8_t* data, size_t blocks)
 {
-	/*
-	 * Note 1: All integers (expect indexes) are 32-bit unsigned integers and addition is calculated modulo 2^32.
-	 * Note 2: For each round, there is one round constant k[i] and one entry in the message schedule array w[i], 0 = i = 63
-	 * Note 3: The compression function uses 8 working variables, a through h
-	 * Note 4: Big-endian convention is used when expressing the constants in this pseudocode,
-	 *     and when parsing message block data from bytes to words, for example,
-	 *     the first word of the input message "abc" after padding is 0x61626380
-	 */
-
-	/*
-	 * Initialize hash values:
-	 * (first 32 bits of the fractional parts of the square roots of the first 8 primes 2..19):
-	 */
-	uint32_t h[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
 	unsigned i, j;
 
-	/* 512-bit chunks is what we will operate on. */
-	uint8_t chunk[64];
-
-	struct buffer_state state;
-
-	init_buf_state(&state, input, len);
-
-	while (calc_chunk(chunk, &state)) {
+	while (blocks > 0) {
 		uint32_t ah[8];
 
-		const uint8_t *p = chunk;
+		const uint8_t *p = data;
 
 		/* Initialize working variables to current hash value: */
 		for (i = 0; i < 8; i++)
@@ -210,7 +108,62 @@ void calc_sha256(uint8_t* hash, const void* input, size_t len)
 		/* Add the compressed chunk to the current hash value: */
 		for (i = 0; i < 8; i++)
 			h[i] += ah[i];
+
+		data += CHUNK_SIZE;
+		blocks--;
 	}
+}
+
+sha256_blocks_func sha256_blocks = sha256_blocks_sw;
+sha256_x8_func sha256_x8 = NULL;
+
+/*
+ * Limitations:
+ * - Since input is a pointer in RAM, the data to hash should be in RAM, which could be a problem
+ *   for large data sizes.
+ * - SHA algorithms theoretically operate on bit strings. However, this implementation has no support
+ *   for bit string lengths that are not multiples of eight, and it really operates on arrays of bytes.
+ *   In particular, the len parameter is a number of bytes.
+ */
+static void sha256_hash(sha256_blocks_func blocks_func, uint8_t* hash, const void* input, size_t len)
+{
+	/*
+	 * Note 1: All integers (expect indexes) are 32-bit unsigned integers and addition is calculated modulo 2^32.
+	 * Note 2: For each round, there is one round constant k[i] and one entry in the message schedule array w[i], 0 = i = 63
+	 * Note 3: The compression function uses 8 working variables, a through h
+	 * Note 4: Big-endian convention is used when expressing the constants in this pseudocode,
+	 *     and when parsing message block data from bytes to words, for example,
+	 *     the first word of the input message "abc" after padding is 0x61626380
+	 */
+
+	/*
+	 * Initialize hash values:
+	 * (first 32 bits of the fractional parts of the square roots of the first 8 primes 2..19):
+	 */
+	uint32_t h[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	size_t blocks = len / CHUNK_SIZE, left = len % CHUNK_SIZE, padded;
+	unsigned i, j;
+	uint64_t bits;
+
+	/* 512-bit chunks is what we will operate on. The tail may need two of them. */
+	uint8_t chunk[2 * CHUNK_SIZE];
+
+	/* Whole chunks are compressed straight from the input, without copying. */
+	if (blocks > 0)
+		blocks_func(h, input, blocks);
+
+	/* The rest is followed by a single one bit, zeroes, and the total length in bits. */
+	memcpy(chunk, (const uint8_t*)input + (blocks * CHUNK_SIZE), left);
+	chunk[left] = 0x80;
+
+	padded = left + 1 + TOTAL_LEN_LEN <= CHUNK_SIZE ? CHUNK_SIZE : 2 * CHUNK_SIZE;
+	memset(chunk + left + 1, 0, padded - left - 1 - TOTAL_LEN_LEN);
+
+	bits = (uint64_t)len << 3;
+	for (i = 0; i < TOTAL_LEN_LEN; i++)
+		chunk[padded - 1 - i] = (uint8_t)(bits >> (i * 8));
+
+	blocks_func(h, chunk, padded / CHUNK_SIZE);
 
 	/* Produce the final hash value (big-endian): */
 	for (i = 0, j = 0; i < 8; i++)
@@ -221,3 +174,269 @@ void calc_sha256(uint8_t* hash, const void* input, size_t len)
 		hash[j++] = (uint8_t) h[i];
 	}
 }
+
+void calc_sha256(uint8_t* hash, const void* input, size_t len)
+{
+	sha256_hash(sha256_blocks, hash, input, len);
+}
+
+/*
+ * Hashes num buffers of len bytes each, lying back to back in input, writing the hashes
+ * back to back in hash. Sectors are always a multiple of the chunk size, which lets the
+ * multi-buffer version work on eight of them at once.
+ */
+void calc_sha256_multi(uint8_t* hash, const uint8_t* input, size_t len, unsigned int num)
+{
+	if (sha256_x8 && len > 0 && len % CHUNK_SIZE == 0) {
+		while (num >= 8) {
+			sha256_x8(hash, input, len);
+			hash += 8 * SHA256_HASH_SIZE;
+			input += 8 * len;
+			num -= 8;
+		}
+	}
+
+	while (num > 0) {
+		calc_sha256(hash, input, len);
+		hash += SHA256_HASH_SIZE;
+		input += len;
+		num--;
+	}
+}
+
+#if !defined(__REACTOS__) && (defined(_X86_) || defined(_AMD64_))
+/* SHA extensions (SHA-NI), doing two rounds per sha256rnds2. */
+SHA_FUNC
+void sha256_blocks_shani(uint32_t* h, const uint8_t* data, size_t blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i state0, state1, tmp, msg, abef, cdgh;
+	__m128i w[4];
+	unsigned int i;
+
+	/* The instructions want the state as ABEF and CDGH. */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&h[0]), 0xb1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&h[4]), 0x1b);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	while (blocks > 0) {
+		abef = state0;
+		cdgh = state1;
+
+		for (i = 0; i < 4; i++)
+			w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + (i * 16))), bswap);
+
+		/*
+		 * Four rounds per iteration. w[] is a ring of the last sixteen schedule words,
+		 * with msg1 and msg2 extending it three and one iterations ahead respectively.
+		 */
+		for (i = 0; i < 16; i++) {
+			msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i*)&k[i * 4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+			if (i >= 3 && i < 15) {
+				tmp = _mm_alignr_epi8(w[i & 3], w[(i - 1) & 3], 4);
+				w[(i + 1) & 3] = _mm_add_epi32(w[(i + 1) & 3], tmp);
+				w[(i + 1) & 3] = _mm_sha256msg2_epu32(w[(i + 1) & 3], w[i & 3]);
+			}
+
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+			if (i >= 1 && i < 13)
+				w[(i - 1) & 3] = _mm_sha256msg1_epu32(w[(i - 1) & 3], w[i & 3]);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+
+		data += CHUNK_SIZE;
+		blocks--;
+	}
+
+	/* Back from ABEF and CDGH to ABCD and EFGH. */
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+	_mm_storeu_si128((__m128i*)&h[0], state0);
+	_mm_storeu_si128((__m128i*)&h[4], state1);
+}
+
+AVX2_FUNC
+static __inline __m256i sha256_rotr_avx2(__m256i x, int n)
+{
+	return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+/* Runs the 64 rounds on eight states at once, each lane of a vector belonging to a different buffer. */
+AVX2_FUNC
+static void sha256_rounds_x8_avx2(__m256i* st, __m256i* w)
+{
+	__m256i a = st[0], b = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], hh = st[7];
+	unsigned int i;
+
+	for (i = 0; i < 64; i++) {
+		__m256i s0, s1, ch, maj, temp1, temp2;
+
+		if (i >= 16) {
+			const __m256i w1 = w[(i + 1) & 0xf], w14 = w[(i + 14) & 0xf];
+
+			s0 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_avx2(w1, 7), sha256_rotr_avx2(w1, 18)),
+					      _mm256_srli_epi32(w1, 3));
+			s1 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_avx2(w14, 17), sha256_rotr_avx2(w14, 19)),
+					      _mm256_srli_epi32(w14, 10));
+			w[i & 0xf] = _mm256_add_epi32(_mm256_add_epi32(w[i & 0xf], s0), _mm256_add_epi32(w[(i + 9) & 0xf], s1));
+		}
+
+		s1 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_avx2(e, 6), sha256_rotr_avx2(e, 11)), sha256_rotr_avx2(e, 25));
+		ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+		temp1 = _mm256_add_epi32(_mm256_add_epi32(hh, s1), _mm256_add_epi32(ch, w[i & 0xf]));
+		temp1 = _mm256_add_epi32(temp1, _mm256_set1_epi32(k[i]));
+		s0 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_avx2(a, 2), sha256_rotr_avx2(a, 13)), sha256_rotr_avx2(a, 22));
+		maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+		temp2 = _mm256_add_epi32(s0, maj);
+
+		hh = g;
+		g = f;
+		f = e;
+		e = _mm256_add_epi32(d, temp1);
+		d = c;
+		c = b;
+		b = a;
+		a = _mm256_add_epi32(temp1, temp2);
+	}
+
+	st[0] = _mm256_add_epi32(st[0], a);
+	st[1] = _mm256_add_epi32(st[1], b);
+	st[2] = _mm256_add_epi32(st[2], c);
+	st[3] = _mm256_add_epi32(st[3], d);
+	st[4] = _mm256_add_epi32(st[4], e);
+	st[5] = _mm256_add_epi32(st[5], f);
+	st[6] = _mm256_add_epi32(st[6], g);
+	st[7] = _mm256_add_epi32(st[7], hh);
+}
+
+/*
+ * Hashes eight buffers of len bytes, back to back in input. len has to be a multiple of
+ * the chunk size, so that the final chunk is nothing but padding and is the same for all lanes.
+ */
+AVX2_FUNC
+void sha256_x8_avx2(uint8_t* hash, const uint8_t* input, size_t len)
+{
+	static const uint32_t iv[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	XSTATE_SAVE s;
+	__m256i st[8], w[16], idx, bswap;
+	uint32_t out[8][8];
+	size_t off;
+	uint64_t bits = (uint64_t)len << 3;
+	unsigned int i, j;
+
+	if (!NT_SUCCESS(KeSaveExtendedProcessorState(XSTATE_MASK_AVX, &s))) {
+		for (i = 0; i < 8; i++) {
+			calc_sha256(hash + (i * SHA256_HASH_SIZE), input + (i * len), len);
+		}
+
+		return;
+	}
+
+	for (i = 0; i < 8; i++) {
+		st[i] = _mm256_set1_epi32(iv[i]);
+	}
+
+	idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)len));
+	bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+				 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (off = 0; off < len; off += CHUNK_SIZE) {
+		for (j = 0; j < 16; j++) {
+			w[j] = _mm256_i32gather_epi32((const int*)(input + off + (j * 4)), idx, 1);
+			w[j] = _mm256_shuffle_epi8(w[j], bswap);
+		}
+
+		sha256_rounds_x8_avx2(st, w);
+	}
+
+	w[0] = _mm256_set1_epi32((int)0x80000000);
+	for (j = 1; j < 14; j++) {
+		w[j] = _mm256_setzero_si256();
+	}
+	w[14] = _mm256_set1_epi32((int)(uint32_t)(bits >> 32));
+	w[15] = _mm256_set1_epi32((int)(uint32_t)bits);
+
+	sha256_rounds_x8_avx2(st, w);
+
+	for (i = 0; i < 8; i++) {
+		_mm256_storeu_si256((__m256i*)out[i], st[i]);
+	}
+
+	KeRestoreExtendedProcessorState(&s);
+
+	for (j = 0; j < 8; j++) {
+		uint8_t* p = hash + (j * SHA256_HASH_SIZE);
+
+		for (i = 0; i < 8; i++) {
+			*p++ = (uint8_t)(out[i][j] >> 24);
+			*p++ = (uint8_t)(out[i][j] >> 16);
+			*p++ = (uint8_t)(out[i][j] >> 8);
+			*p++ = (uint8_t)out[i][j];
+		}
+	}
+}
+
+#define SHA256_TEST_LEN (8 * 256)
+#define SHA256_TEST_HASHES (8 * SHA256_HASH_SIZE)
+
+/* Checks an implementation against the portable code, over messages of every padding shape. */
+bool sha256_check_funcs(sha256_blocks_func blocks_func, sha256_x8_func x8_func)
+{
+	uint8_t *buf, *h1, *h2;
+	unsigned int i, j;
+	bool ret = false;
+
+	buf = ExAllocatePoolWithTag(PagedPool, SHA256_TEST_LEN + (2 * SHA256_TEST_HASHES), ALLOC_TAG);
+	if (!buf) {
+		ERR("out of memory\n");
+		return false;
+	}
+
+	h1 = buf + SHA256_TEST_LEN;
+	h2 = h1 + SHA256_TEST_HASHES;
+
+	for (i = 0; i < SHA256_TEST_LEN; i++) {
+		buf[i] = (uint8_t)(i * 167 + 13);
+	}
+
+	if (blocks_func) {
+		for (i = 0; i <= 256; i++) {
+			sha256_hash(sha256_blocks_sw, h1, buf, i);
+			sha256_hash(blocks_func, h2, buf, i);
+
+			if (RtlCompareMemory(h1, h2, SHA256_HASH_SIZE) != SHA256_HASH_SIZE)
+				goto end;
+		}
+	}
+
+	if (x8_func) {
+		for (i = 64; i <= 256; i += 64) {
+			for (j = 0; j < 8; j++) {
+				sha256_hash(sha256_blocks_sw, h1 + (j * SHA256_HASH_SIZE), buf + (j * i), i);
+			}
+
+			x8_func(h2, buf, i);
+
+			if (RtlCompareMemory(h1, h2, SHA256_TEST_HASHES) != SHA256_TEST_HASHES)
+				goto end;
+		}
+	}
+
+	ret = true;
+
+end:
+	ExFreePool(buf);
+
+	return ret;
+}
+#endif
@@ -87,6 +87,9 @@ typedef IO_STACK_LOCATION EXTENDED_IO_STACK_LOCATION, *PEXTENDED_IO_STACK_LOCATI
 
 #define READ_AHEAD_GRANULARITY          (0x10000)
 
+#define DIR_WINDOW_SIZE                 (0x10000)
+#define DIR_READ_AHEAD_SIZE             (0x40000)
+
 #define SUPER_BLOCK                     (Vcb->SuperBlock)
 
 #define INODE_SIZE                      (Vcb->InodeSize)
@@ -299,6 +302,7 @@ Ext2ClearFlag(PULONG Flags, ULONG FlagBit)
 #define EXT2_FLIST_MAGIC        'LF2E'
 #define EXT2_PARAM_MAGIC        'PP2E'
 #define EXT2_RWC_MAGIC          'WR2E'
+#define EXT2_DIRBUF_MAGIC       'WD2E'
 
 //
 // Bug Check Codes Definitions
@@ -1013,6 +1017,15 @@ typedef struct _EXT2_CCB {
 	/* The EA index we are on */
 	ULONG           EaIndex;
 
+    /* Directory blocks kept between QueryDirectory calls */
+    PUCHAR              DirBuffer;
+    ULONGLONG           DirOffset;
+    ULONG               DirLength;
+    __u32               DirVersion;
+
+    /* How far directory read-ahead has been started */
+    ULONGLONG           DirReadAhead;
+
 } EXT2_CCB, *PEXT2_CCB;
 
 //
@@ -3012,6 +3025,15 @@ Ext2ReadInode (
     OUT PULONG              dwReturn
 );
 
+VOID
+Ext2ReadAheadInode (
+    IN PEXT2_IRP_CONTEXT    IrpContext,
+    IN PEXT2_VCB            Vcb,
+    IN PEXT2_FCB            Fcb,
+    IN ULONGLONG            Offset,
+    IN ULONG                Size
+);
+
 NTSTATUS
 Ext2Read (IN PEXT2_IRP_CONTEXT IrpContext);
 
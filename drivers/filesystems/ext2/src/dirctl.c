@@ -520,6 +520,102 @@ errorout:
     return rc;
 }
 
+/*
+ * Start reading the directory blocks after ByteOffset into the volume
+ * cache, so they are there by the time the enumeration gets to them.
+ */
+
+static VOID
+Ext2DirReadAhead(
+    IN PEXT2_IRP_CONTEXT    IrpContext,
+    IN PEXT2_VCB            Vcb,
+    IN PEXT2_FCB            Fcb,
+    IN PEXT2_CCB            Ccb,
+    IN ULONGLONG            ByteOffset
+)
+{
+    ULONGLONG   End = ByteOffset + DIR_READ_AHEAD_SIZE;
+
+    if (End > (ULONGLONG)Fcb->Mcb->Inode.i_size) {
+        End = Fcb->Mcb->Inode.i_size;
+    }
+
+    if (Ccb->DirReadAhead < ByteOffset) {
+        Ccb->DirReadAhead = ByteOffset;
+    }
+
+    /* only start a new read-ahead when there is a decent amount left to get */
+    if (Ccb->DirReadAhead >= End) {
+        return;
+    }
+    if (End - Ccb->DirReadAhead < DIR_WINDOW_SIZE &&
+        End != (ULONGLONG)Fcb->Mcb->Inode.i_size) {
+        return;
+    }
+
+    Ext2ReadAheadInode(IrpContext, Vcb, Fcb, Ccb->DirReadAhead,
+                       (ULONG)(End - Ccb->DirReadAhead));
+    Ccb->DirReadAhead = End;
+}
+
+/*
+ * Make sure the directory window of the Ccb covers ByteOffset. The
+ * window stays valid across QueryDirectory calls until the directory
+ * is changed, so that an enumeration reads every block only once.
+ */
+
+static NTSTATUS
+Ext2LoadDirWindow(
+    IN PEXT2_IRP_CONTEXT    IrpContext,
+    IN PEXT2_VCB            Vcb,
+    IN PEXT2_FCB            Fcb,
+    IN PEXT2_CCB            Ccb,
+    IN ULONGLONG            ByteOffset
+)
+{
+    PEXT2_MCB   Mcb = Fcb->Mcb;
+    ULONGLONG   Start;
+    ULONG       Length;
+    NTSTATUS    Status;
+
+    if (Ccb->DirBuffer != NULL && Ccb->DirVersion == Mcb->Inode.i_version &&
+        ByteOffset >= Ccb->DirOffset &&
+        ByteOffset < Ccb->DirOffset + Ccb->DirLength) {
+        return STATUS_SUCCESS;
+    }
+
+    if (Ccb->DirBuffer == NULL) {
+        Ccb->DirBuffer = Ext2AllocatePool(PagedPool, DIR_WINDOW_SIZE,
+                                          EXT2_DIRBUF_MAGIC);
+        if (Ccb->DirBuffer == NULL) {
+            DEBUG(DL_ERR, ( "Ext2LoadDirWindow: failed to allocate DirBuffer.\n"));
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        INC_MEM_COUNT(PS_DIR_ENTRY, Ccb->DirBuffer, DIR_WINDOW_SIZE);
+    }
+
+    /* the window is block aligned, so no entry ever straddles it */
+    Start = ByteOffset & ~((ULONGLONG)DIR_WINDOW_SIZE - 1);
+    Length = DIR_WINDOW_SIZE;
+    if (Start + Length > (ULONGLONG)Mcb->Inode.i_size) {
+        Length = (ULONG)(Mcb->Inode.i_size - Start);
+    }
+
+    Ccb->DirLength = 0;
+    Status = Ext2ReadInode(IrpContext, Vcb, Mcb, Start, Ccb->DirBuffer,
+                           Length, FALSE, NULL);
+    if (!NT_SUCCESS(Status)) {
+        return Status;
+    }
+
+    Ccb->DirOffset = Start;
+    Ccb->DirLength = Length;
+    Ccb->DirVersion = Mcb->Inode.i_version;
+
+    Ext2DirReadAhead(IrpContext, Vcb, Fcb, Ccb, Start + Length);
+
+    return STATUS_SUCCESS;
+}
 
 NTSTATUS
 Ext2QueryDirectory (IN PEXT2_IRP_CONTEXT IrpContext)
@@ -554,6 +650,7 @@ Ext2QueryDirectory (IN PEXT2_IRP_CONTEXT IrpContext)
 
     ULONG                   ByteOffset;
     ULONG                   RecLen = 0;
+    ULONG                   BlockLeft;
     ULONG                   EntrySize = 0;
 
     EXT2_FILLDIR_CONTEXT    fc = { 0 };
@@ -759,6 +856,7 @@ Ext2QueryDirectory (IN PEXT2_IRP_CONTEXT IrpContext)
         } else {
             if (RestartScan || FirstQuery) {
                 Ccb->filp.f_pos = FileIndex = 0;
+                Ccb->DirReadAhead = 0;
             } else {
                 FileIndex = (ULONG)Ccb->filp.f_pos;
             }
@@ -780,7 +878,12 @@ Ext2QueryDirectory (IN PEXT2_IRP_CONTEXT IrpContext)
                                     EXT3_FEATURE_COMPAT_DIR_INDEX) &&
                 ((EXT3_I(&Mcb->Inode)->i_flags & EXT3_INDEX_FL) ||
                  ((Mcb->Inode.i_size >> BLOCK_BITS) == 1)) ) {
-            int rc = ext3_dx_readdir(&Ccb->filp, Ext2FillEntry, &fc);
+            int rc;
+
+            /* leaf blocks come in hash order, so just bring the whole directory in ahead */
+            Ext2DirReadAhead(IrpContext, Vcb, Fcb, Ccb, Ccb->DirReadAhead);
+
+            rc = ext3_dx_readdir(&Ccb->filp, Ext2FillEntry, &fc);
             Status = fc.efc_status;
             if (rc != ERR_BAD_DX_DIR) {
                 goto errorout;
@@ -798,19 +901,6 @@ Ext2QueryDirectory (IN PEXT2_IRP_CONTEXT IrpContext)
             _SEH2_LEAVE;
         }
 
-        pDir = Ext2AllocatePool(
-                   PagedPool,
-                   sizeof(EXT2_DIR_ENTRY2),
-                   EXT2_DENTRY_MAGIC
-               );
-
-        if (!pDir) {
-            DEBUG(DL_ERR, ( "Ex2QueryDirectory: failed to allocate pDir.\n"));
-            Status = STATUS_INSUFFICIENT_RESOURCES;
-            _SEH2_LEAVE;
-        }
-
-        INC_MEM_COUNT(PS_DIR_ENTRY, pDir, sizeof(EXT2_DIR_ENTRY2));
         ByteOffset = FileIndex;
 
         DEBUG(DL_CP, ("Ex2QueryDirectory: Dir: %wZ Index=%xh Pattern : %wZ.\n",
@@ -819,27 +909,33 @@ Ext2QueryDirectory (IN PEXT2_IRP_CONTEXT IrpContext)
         while ((ByteOffset < Mcb->Inode.i_size) &&
                 (CEILING_ALIGNED(ULONG, fc.efc_start, 8) < Length)) {
 
-            RtlZeroMemory(pDir, sizeof(EXT2_DIR_ENTRY2));
-
-            Status = Ext2ReadInode(
+            Status = Ext2LoadDirWindow(
                          IrpContext,
                          Vcb,
-                         Mcb,
-                         (ULONGLONG)ByteOffset,
-                         (PVOID)pDir,
-                         sizeof(EXT2_DIR_ENTRY2),
-                         FALSE,
-                         &EntrySize);
+                         Fcb,
+                         Ccb,
+                         (ULONGLONG)ByteOffset);
 
             if (!NT_SUCCESS(Status)) {
                 DbgBreak();
                 _SEH2_LEAVE;
             }
 
-            if (pDir->rec_len == 0) {
-                RecLen = BLOCK_SIZE - (ByteOffset & (BLOCK_SIZE - 1));
-            } else {
-                RecLen = ext3_rec_len_from_disk(pDir->rec_len);
+            pDir = (PEXT2_DIR_ENTRY2)(Ccb->DirBuffer +
+                                      (ULONG)(ByteOffset - Ccb->DirOffset));
+            BlockLeft = BLOCK_SIZE - (ByteOffset & (BLOCK_SIZE - 1));
+
+            /* entries point into the window, so never trust them past their block */
+            if (BlockLeft < (ULONG)FIELD_OFFSET(EXT2_DIR_ENTRY2, name)) {
+                RecLen = BlockLeft;
+                goto ProcessNextEntry;
+            }
+
+            RecLen = ext3_rec_len_from_disk(pDir->rec_len);
+            if (RecLen == 0 || RecLen > BlockLeft ||
+                FIELD_OFFSET(EXT2_DIR_ENTRY2, name) + (ULONG)pDir->name_len > RecLen) {
+                RecLen = BlockLeft;
+                goto ProcessNextEntry;
             }
 
             if (!pDir->inode || pDir->inode >= INODES_COUNT) {
@@ -990,11 +1086,6 @@ errorout:
             ExReleaseResourceLite(&Fcb->MainResource);
         }
 
-        if (pDir != NULL) {
-            Ext2FreePool(pDir, EXT2_DENTRY_MAGIC);
-            DEC_MEM_COUNT(PS_DIR_ENTRY, pDir, sizeof(EXT2_DIR_ENTRY2));
-        }
-
         if (Unicode.Buffer != NULL) {
             DEC_MEM_COUNT(PS_INODE_NAME, Unicode.Buffer, Unicode.MaximumLength);
             Ext2FreePool(Unicode.Buffer, EXT2_INAME_MAGIC);
@@ -2109,6 +2109,11 @@ Ext2SetParentEntry (
                          dwBytes,
                          FALSE,
                          &dwBytes );
+
+            /* ".." changed in place, drop the cached directory windows */
+            if (NT_SUCCESS(Status)) {
+                Dcb->Mcb->Inode.i_version++;
+            }
         } else {
             DbgBreak();
         }
@@ -379,6 +379,11 @@ Ext2FreeCcb (IN PEXT2_VCB Vcb, IN PEXT2_CCB Ccb)
         Ext2FreePool(Ccb->DirectorySearchPattern.Buffer, EXT2_DIRSP_MAGIC);
     }
 
+    if (Ccb->DirBuffer != NULL) {
+        DEC_MEM_COUNT(PS_DIR_ENTRY, Ccb->DirBuffer, DIR_WINDOW_SIZE);
+        Ext2FreePool(Ccb->DirBuffer, EXT2_DIRBUF_MAGIC);
+    }
+
     ExFreeToNPagedLookasideList(&(Ext2Global->Ext2CcbLookasideList), Ccb);
     DEC_MEM_COUNT(PS_CCB, Ccb, sizeof(EXT2_CCB));
 }
@@ -17,6 +17,21 @@ extern PEXT2_GLOBAL Ext2Global;
 
 /* DEFINITIONS *************************************************************/
 
+#define EXT2_READAHEAD_MAGIC 'AR2E'
+
+typedef struct _EXT2_READAHEAD_CONTEXT {
+
+    PEXT2_VCB           Vcb;
+    PEXT2_FCB           Fcb;
+    PEXT2_EXTENT        Chain;
+
+    WORK_QUEUE_ITEM     Item;
+
+} EXT2_READAHEAD_CONTEXT, *PEXT2_READAHEAD_CONTEXT;
+
+VOID NTAPI
+Ext2ReadAheadWorker(IN PVOID Parameter);
+
 NTSTATUS
 Ext2ReadComplete (IN PEXT2_IRP_CONTEXT IrpContext);
 
@@ -467,6 +482,110 @@ Ext2ReadInode (
     return Status;
 }
 
+VOID NTAPI
+Ext2ReadAheadWorker(IN PVOID Parameter)
+{
+    PEXT2_READAHEAD_CONTEXT Context = (PEXT2_READAHEAD_CONTEXT) Parameter;
+    PEXT2_VCB       Vcb = Context->Vcb;
+    PEXT2_EXTENT    Extent;
+    LARGE_INTEGER   Offset;
+    ULONG           Length;
+    PVOID           Bcb;
+    PVOID           Buffer;
+
+    _SEH2_TRY {
+
+        for (Extent = Context->Chain; Extent != NULL; Extent = Extent->Next) {
+
+            if (!IsMounted(Vcb) || IsFlagOn(Vcb->Flags, VCB_DISMOUNT_PENDING)) {
+                break;
+            }
+
+            /* mapping the blocks in is enough to bring them into the volume cache */
+            Offset.QuadPart = Extent->Lba;
+            Length = Extent->Length;
+
+            while (Length > 0) {
+
+                ULONG Size = VACB_MAPPING_GRANULARITY -
+                             (ULONG)(Offset.QuadPart & (VACB_MAPPING_GRANULARITY - 1));
+                if (Size > Length) {
+                    Size = Length;
+                }
+
+                if (!CcMapData(Vcb->Volume, &Offset, Size, MAP_WAIT, &Bcb, &Buffer)) {
+                    break;
+                }
+                CcUnpinData(Bcb);
+
+                Offset.QuadPart += Size;
+                Length -= Size;
+            }
+        }
+
+    } _SEH2_EXCEPT (EXCEPTION_EXECUTE_HANDLER) {
+
+        /* read-ahead is only a hint, the real read will report any error */
+        DEBUG(DL_ERR, ("Ext2ReadAheadWorker: exception %xh\n", _SEH2_GetExceptionCode()));
+    } _SEH2_END;
+
+    Ext2DestroyExtentChain(Context->Chain);
+    Ext2ReleaseFcb(Context->Fcb);
+    Ext2FreePool(Context, EXT2_READAHEAD_MAGIC);
+}
+
+/*
+ * Start bringing a range of a file or directory into the volume cache
+ * without waiting for it. Only for blocks that are read through the
+ * volume stream, i.e. directories and other meta-data.
+ */
+
+VOID
+Ext2ReadAheadInode (
+    IN PEXT2_IRP_CONTEXT    IrpContext,
+    IN PEXT2_VCB            Vcb,
+    IN PEXT2_FCB            Fcb,
+    IN ULONGLONG            Offset,
+    IN ULONG                Size
+)
+{
+    PEXT2_READAHEAD_CONTEXT Context;
+    PEXT2_EXTENT            Chain = NULL;
+    NTSTATUS                Status;
+
+    if (Offset >= (ULONGLONG)Fcb->Mcb->Inode.i_size) {
+        return;
+    }
+
+    if (Offset + Size > (ULONGLONG)Fcb->Mcb->Inode.i_size) {
+        Size = (ULONG)(Fcb->Mcb->Inode.i_size - Offset);
+    }
+
+    Status = Ext2BuildExtents(IrpContext, Vcb, Fcb->Mcb, Offset,
+                              Size, FALSE, &Chain);
+    if (!NT_SUCCESS(Status) || Chain == NULL) {
+        return;
+    }
+
+    Context = Ext2AllocatePool(NonPagedPool,
+                               sizeof(EXT2_READAHEAD_CONTEXT),
+                               EXT2_READAHEAD_MAGIC);
+    if (!Context) {
+        Ext2DestroyExtentChain(Chain);
+        return;
+    }
+
+    /* the Fcb keeps the Vcb alive until the worker is done */
+    Ext2ReferXcb(&Fcb->ReferenceCount);
+
+    Context->Vcb = Vcb;
+    Context->Fcb = Fcb;
+    Context->Chain = Chain;
+
+    ExInitializeWorkItem(&Context->Item, Ext2ReadAheadWorker, Context);
+    ExQueueWorkItem(&Context->Item, DelayedWorkQueue);
+}
+
 NTSTATUS
 Ext2ReadFile(IN PEXT2_IRP_CONTEXT IrpContext)
 {
@@ -290,6 +290,33 @@ NpCancelDataQueueIrp(IN PDEVICE_OBJECT DeviceObject,
     NpCompleteDeferredIrps(&DeferredList);
 }
 
+VOID
+NTAPI
+NpLockReadBuffer(IN PIRP Irp,
+                 IN ULONG Length)
+{
+    PMDL Mdl;
+    PAGED_CODE();
+
+    Mdl = IoAllocateMdl(Irp->UserBuffer, Length, FALSE, FALSE, Irp);
+    if (!Mdl) return;
+
+    _SEH2_TRY
+    {
+        MmProbeAndLockPages(Mdl, Irp->RequestorMode, IoWriteAccess);
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        //
+        // Not fatal, the read just takes the buffered path, which will
+        // report the bad buffer when the I/O manager copies to it
+        //
+        IoFreeMdl(Mdl);
+        Irp->MdlAddress = NULL;
+    }
+    _SEH2_END;
+}
+
 NTSTATUS
 NTAPI
 NpAddDataQueueEntry(IN ULONG NamedPipeEnd,
@@ -395,6 +422,21 @@ NpAddDataQueueEntry(IN ULONG NamedPipeEnd,
             {
                 ASSERT(Irp);
 
+                //
+                // For large reads, lock the reader's buffer now, while we are
+                // still in its context. The writer then fills it directly
+                // instead of going through an intermediate pool buffer that
+                // the I/O manager would have to copy again on completion.
+                // No more than the pipe's quota is locked, so a single read
+                // can't pin an arbitrary amount of memory.
+                //
+                if (DataSize >= NPFS_DIRECT_READ_THRESHOLD &&
+                    DataQueue->Quota >= NPFS_DIRECT_READ_THRESHOLD &&
+                    !Irp->MdlAddress)
+                {
+                    NpLockReadBuffer(Irp, min(DataSize, DataQueue->Quota));
+                }
+
                 Status = STATUS_PENDING;
                 ASSERT((DataQueue->QueueState == Empty) ||
                        (DataQueue->QueueState == Who));
@@ -32,6 +32,12 @@
 #define MIN_INDEXED_LENGTH 5
 #define MAX_INDEXED_LENGTH 9
 
+//
+// Pending reads at least this large get their buffer locked down when they
+// are queued, so that writers can copy straight into it
+//
+#define NPFS_DIRECT_READ_THRESHOLD  (2 * PAGE_SIZE)
+
 /* TYPEDEFS & DEFINES *********************************************************/
 
 //
@@ -404,6 +410,11 @@ NpRemoveDataQueueEntry(IN PNP_DATA_QUEUE DataQueue,
                        IN BOOLEAN Flag,
                        IN PLIST_ENTRY List);
 
+VOID
+NTAPI
+NpLockReadBuffer(IN PIRP Irp,
+                 IN ULONG Length);
+
 NTSTATUS
 NTAPI
 NpAddDataQueueEntry(IN ULONG NamedPipeEnd,
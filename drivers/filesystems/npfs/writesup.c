@@ -34,6 +34,7 @@ NpWriteDataQueue(IN PNP_DATA_QUEUE WriteQueue,
     PIRP WriteIrp;
     PIO_STACK_LOCATION IoStack;
     PVOID Buffer;
+    PMDL Mdl;
     NTSTATUS Status;
     PSECURITY_CLIENT_CONTEXT ClientContext;
     PAGED_CODE();
@@ -80,30 +81,32 @@ NpWriteDataQueue(IN PNP_DATA_QUEUE WriteQueue,
         BufferSize = *BytesNotWritten;
         if (BufferSize >= DataSize) BufferSize = DataSize;
 
+        Buffer = DataEntry->Irp->AssociatedIrp.SystemBuffer;
+        AllocatedBuffer = FALSE;
+        Mdl = NULL;
+
         if (DataEntry->DataEntryType != Unbuffered && BufferSize)
         {
-            Buffer = ExAllocatePoolWithTag(NonPagedPool, BufferSize, NPFS_DATA_ENTRY_TAG);
-            if (!Buffer) return STATUS_INSUFFICIENT_RESOURCES;
-            AllocatedBuffer = TRUE;
-        }
-        else
-        {
-            Buffer = DataEntry->Irp->AssociatedIrp.SystemBuffer;
-            AllocatedBuffer = FALSE;
-        }
+            //
+            // Large reads had (part of) their buffer locked when queued (see
+            // NpLockReadBuffer), copy straight into it if the data fits
+            //
+            Buffer = NULL;
+            if (DataEntry->Irp->MdlAddress &&
+                BufferSize <= MmGetMdlByteCount(DataEntry->Irp->MdlAddress))
+            {
+                Mdl = DataEntry->Irp->MdlAddress;
+                Buffer = MmGetSystemAddressForMdlSafe(Mdl, NormalPagePriority);
+                if (!Buffer) Mdl = NULL;
+            }
 
-        _SEH2_TRY
-        {
-            RtlCopyMemory(Buffer,
-                          (PVOID)((ULONG_PTR)OutBuffer + OutBufferSize - *BytesNotWritten),
-                          BufferSize);
-        }
-        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
-        {
-            if (AllocatedBuffer) ExFreePool(Buffer);
-            _SEH2_YIELD(return _SEH2_GetExceptionCode());
+            if (!Buffer)
+            {
+                Buffer = ExAllocatePoolWithTag(NonPagedPool, BufferSize, NPFS_DATA_ENTRY_TAG);
+                if (!Buffer) return STATUS_INSUFFICIENT_RESOURCES;
+                AllocatedBuffer = TRUE;
+            }
         }
-        _SEH2_END;
 
         if (!HaveContext)
         {
@@ -122,7 +125,42 @@ NpWriteDataQueue(IN PNP_DATA_QUEUE WriteQueue,
             }
         }
 
-        WriteIrp = NpRemoveDataQueueEntry(WriteQueue, TRUE, List);
+        //
+        // The reader's own buffer may only be written once its IRP is ours:
+        // a read being cancelled is dropped here and the data goes to the
+        // next entry instead of being lost in a buffer nobody will look at
+        //
+        WriteIrp = NULL;
+        if (Mdl)
+        {
+            WriteIrp = NpRemoveDataQueueEntry(WriteQueue, TRUE, List);
+            if (!WriteIrp) continue;
+        }
+
+        _SEH2_TRY
+        {
+            RtlCopyMemory(Buffer,
+                          (PVOID)((ULONG_PTR)OutBuffer + OutBufferSize - *BytesNotWritten),
+                          BufferSize);
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            if (AllocatedBuffer) ExFreePool(Buffer);
+
+            //
+            // The read is already off the queue, complete it empty
+            //
+            if (WriteIrp)
+            {
+                WriteIrp->IoStatus.Status = STATUS_SUCCESS;
+                WriteIrp->IoStatus.Information = 0;
+                InsertTailList(List, &WriteIrp->Tail.Overlay.ListEntry);
+            }
+            _SEH2_YIELD(return _SEH2_GetExceptionCode());
+        }
+        _SEH2_END;
+
+        if (!Mdl) WriteIrp = NpRemoveDataQueueEntry(WriteQueue, TRUE, List);
         if (WriteIrp)
         {
             *BytesNotWritten -= BufferSize;
@@ -297,6 +297,13 @@ MakeSocketIntoConnection(PAFD_FCB FCB) {
         if( !FCB->Send.Window ) return STATUS_NO_MEMORY;
     }
 
+    /* Buffer sizes requested before the connection existed */
+    if (FCB->TransportRecvSize)
+        AfdSetTransportBufferSize(FCB, TCP_SOCKET_WINDOW, FCB->TransportRecvSize);
+
+    if (FCB->TransportSendSize)
+        AfdSetTransportBufferSize(FCB, TCP_SOCKET_SNDBUF, FCB->TransportSendSize);
+
     FCB->State = SOCKET_STATE_CONNECTED;
 
     Status = TdiReceive( &FCB->ReceiveIrp.InFlightRequest,
@@ -32,11 +32,17 @@ AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     _SEH2_TRY {
         switch( InfoReq->InformationClass ) {
         case AFD_INFO_RECEIVE_WINDOW_SIZE:
-            InfoReq->Information.Ulong = FCB->Recv.Size;
+            if (FCB->TransportRecvSize)
+                InfoReq->Information.Ulong = FCB->TransportRecvSize;
+            else
+                InfoReq->Information.Ulong = FCB->Recv.Size;
             break;
 
         case AFD_INFO_SEND_WINDOW_SIZE:
-            InfoReq->Information.Ulong = FCB->Send.Size;
+            if (FCB->TransportSendSize)
+                InfoReq->Information.Ulong = FCB->TransportSendSize;
+            else
+                InfoReq->Information.Ulong = FCB->Send.Size;
             AFD_DbgPrint(MID_TRACE,("Send window size %u\n", FCB->Send.Size));
             break;
 
@@ -98,6 +104,28 @@ AfdGetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     return UnlockAndMaybeComplete( FCB, Status, Irp, 0 );
 }
 
+NTSTATUS
+AfdSetTransportBufferSize(PAFD_FCB FCB, ULONG Id, ULONG Size)
+{
+    NTSTATUS Status;
+
+    Status = TdiSetInformationEx(FCB->Connection.Object,
+                                 CO_TL_ENTITY,
+                                 0,
+                                 INFO_CLASS_PROTOCOL,
+                                 INFO_TYPE_CONNECTION,
+                                 Id,
+                                 &Size,
+                                 sizeof(Size));
+    if (!NT_SUCCESS(Status))
+    {
+        /* Not fatal, the transport keeps its default */
+        AFD_DbgPrint(MIN_TRACE,("Failed to set transport buffer %u to %u (0x%x)\n", Id, Size, Status));
+    }
+
+    return Status;
+}
+
 NTSTATUS NTAPI
 AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
             PIO_STACK_LOCATION IrpSp ) {
@@ -106,6 +134,7 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     PFILE_OBJECT FileObject = IrpSp->FileObject;
     PAFD_FCB FCB = FileObject->FsContext;
     PCHAR NewBuffer;
+    ULONG WindowSize;
 
     UNREFERENCED_PARAMETER(DeviceObject);
 
@@ -124,21 +153,38 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 FCB->OobInline = InfoReq->Information.Boolean;
                 break;
             case AFD_INFO_RECEIVE_WINDOW_SIZE:
+                WindowSize = InfoReq->Information.Ulong;
+
+                if (!(FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS) && WindowSize > 0)
+                {
+                    /* Stream sockets pass SO_RCVBUF down to the transport, which sizes its
+                     * TCP window from it. It is applied on connect if we're not there yet. */
+                    FCB->TransportRecvSize = WindowSize;
+
+                    if (FCB->State != SOCKET_STATE_CONNECTED)
+                        break;
+
+                    AfdSetTransportBufferSize(FCB, TCP_SOCKET_WINDOW, WindowSize);
+
+                    /* Our own staging buffer stays small (CORE-15804) */
+                    WindowSize = min(WindowSize, AFD_MAX_STAGING_WINDOW);
+                }
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
                     /* FIXME: likely not right, check tcpip.sys for TDI_QUERY_MAX_DATAGRAM_INFO */
-                    if (InfoReq->Information.Ulong > 0 && InfoReq->Information.Ulong < 0xFFFF &&
-                        InfoReq->Information.Ulong != FCB->Recv.Size)
+                    if (WindowSize > 0 && WindowSize < 0xFFFF &&
+                        WindowSize != FCB->Recv.Size)
                     {
                         NewBuffer = ExAllocatePoolWithTag(PagedPool,
-                                                          InfoReq->Information.Ulong,
+                                                          WindowSize,
                                                           TAG_AFD_DATA_BUFFER);
 
                         if (NewBuffer)
                         {
-                            if (FCB->Recv.Content > InfoReq->Information.Ulong)
-                                FCB->Recv.Content = InfoReq->Information.Ulong;
+                            if (FCB->Recv.Content > WindowSize)
+                                FCB->Recv.Content = WindowSize;
 
                             if (FCB->Recv.Window)
                             {
@@ -149,7 +195,7 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                                 ExFreePoolWithTag(FCB->Recv.Window, TAG_AFD_DATA_BUFFER);
                             }
 
-                            FCB->Recv.Size = InfoReq->Information.Ulong;
+                            FCB->Recv.Size = WindowSize;
                             FCB->Recv.Window = NewBuffer;
 
                             Status = STATUS_SUCCESS;
@@ -170,20 +216,38 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 }
                 break;
             case AFD_INFO_SEND_WINDOW_SIZE:
+                WindowSize = InfoReq->Information.Ulong;
+
+                if (!(FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS) && WindowSize > 0)
+                {
+                    /* SO_SNDBUF bounds how much unacknowledged data the transport queues */
+                    FCB->TransportSendSize = WindowSize;
+
+                    if (FCB->State != SOCKET_STATE_CONNECTED)
+                        break;
+
+                    AfdSetTransportBufferSize(FCB, TCP_SOCKET_SNDBUF, WindowSize);
+
+                    WindowSize = min(WindowSize, AFD_MAX_STAGING_WINDOW);
+                }
+
                 if (FCB->State == SOCKET_STATE_CONNECTED ||
                     FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS)
                 {
-                    if (InfoReq->Information.Ulong > 0 && InfoReq->Information.Ulong < 0xFFFF &&
-                        InfoReq->Information.Ulong != FCB->Send.Size)
+                    /* The transport may still be copying from the in-flight part
+                     * of the window, so don't pull it away */
+                    if (WindowSize > 0 && WindowSize < 0xFFFF &&
+                        WindowSize != FCB->Send.Size &&
+                        !FCB->SendIrp.InFlightRequest)
                     {
                         NewBuffer = ExAllocatePoolWithTag(PagedPool,
-                                                          InfoReq->Information.Ulong,
+                                                          WindowSize,
                                                           TAG_AFD_DATA_BUFFER);
 
                         if (NewBuffer)
                         {
-                            if (FCB->Send.BytesUsed > InfoReq->Information.Ulong)
-                                FCB->Send.BytesUsed = InfoReq->Information.Ulong;
+                            if (FCB->Send.BytesUsed > WindowSize)
+                                FCB->Send.BytesUsed = WindowSize;
 
                             if (FCB->Send.Window)
                             {
@@ -194,7 +258,7 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                                 ExFreePoolWithTag(FCB->Send.Window, TAG_AFD_DATA_BUFFER);
                             }
 
-                            FCB->Send.Size = InfoReq->Information.Ulong;
+                            FCB->Send.Size = WindowSize;
                             FCB->Send.Window = NewBuffer;
 
                             Status = STATUS_SUCCESS;
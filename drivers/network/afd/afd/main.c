@@ -367,6 +367,7 @@ AfdCreateSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
 
     InitializeListHead( &FCB->DatagramList );
     InitializeListHead( &FCB->PendingConnections );
+    InitializeListHead( &FCB->PollWaiters );
 
     AFD_DbgPrint(MID_TRACE,("%p: Checking command channel\n", FCB));
 
@@ -451,6 +452,10 @@ AfdCleanupSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         }
     }
 
+    /* A read being filled by the transport isn't on the list */
+    if (FCB->DirectRecvIrp)
+        IoCancelIrp(FCB->DirectRecvIrp);
+
     KillSelectsForFCB( FCB->DeviceExt, FileObject, FALSE );
 
     return UnlockAndMaybeComplete(FCB, STATUS_SUCCESS, Irp, 0);
@@ -516,6 +521,9 @@ AfdCloseSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
     if( FCB->EventSelect )
         ObDereferenceObject( FCB->EventSelect );
 
+    if (FCB->TransmitWorkItem)
+        IoFreeWorkItem(FCB->TransmitWorkItem);
+
     if (FCB->Context)
         ExFreePoolWithTag(FCB->Context, TAG_AFD_SOCKET_CONTEXT);
 
@@ -981,6 +989,9 @@ AfdDispatch(PDEVICE_OBJECT DeviceObject, PIRP Irp)
         case IOCTL_AFD_SEND_DATAGRAM:
             return AfdPacketSocketWriteData( DeviceObject, Irp, IrpSp );
 
+        case IOCTL_AFD_TRANSMIT_FILE:
+            return AfdTransmitFile( DeviceObject, Irp, IrpSp );
+
         case IOCTL_AFD_GET_INFO:
             return AfdGetInfo( DeviceObject, Irp, IrpSp );
 
@@ -1143,6 +1154,7 @@ CleanupPendingIrp(PAFD_FCB FCB, PIRP Irp, PIO_STACK_LOCATION IrpSp, PAFD_ACTIVE_
     PAFD_RECV_INFO RecvReq;
     PAFD_SEND_INFO SendReq;
     PAFD_POLL_INFO PollReq;
+    PAFD_TRANSMIT_FILE_INFO TransmitReq;
 
     if (IrpSp->MajorFunction == IRP_MJ_READ)
     {
@@ -1168,6 +1180,12 @@ CleanupPendingIrp(PAFD_FCB FCB, PIRP Irp, PIO_STACK_LOCATION IrpSp, PAFD_ACTIVE_
             SendReq = GetLockedData(Irp, IrpSp);
             UnlockBuffers(SendReq->BufferArray, SendReq->BufferCount, CheckUnlockExtraBuffers(FCB, IrpSp));
         }
+        else if (IrpSp->Parameters.DeviceIoControl.IoControlCode == IOCTL_AFD_TRANSMIT_FILE)
+        {
+            TransmitReq = GetLockedData(Irp, IrpSp);
+            UnlockTransmitElements(TransmitReq->ElementArray, TransmitReq->ElementCount);
+            FCB->TransmitCount--;
+        }
         else if (IrpSp->Parameters.DeviceIoControl.IoControlCode == IOCTL_AFD_SELECT)
         {
             ASSERT(Poll);
@@ -1228,6 +1246,7 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
 
         case IOCTL_AFD_SEND:
         case IOCTL_AFD_SEND_DATAGRAM:
+        case IOCTL_AFD_TRANSMIT_FILE:
             Function = FUNCTION_SEND;
             break;
 
@@ -1277,6 +1296,26 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
             return;
     }
 
+    if (Function == FUNCTION_RECV && Irp == FCB->DirectRecvIrp)
+    {
+        /* The transport is receiving straight into this read, so pull that
+         * receive back and let ReceiveComplete complete the read */
+        if (FCB->ReceiveIrp.InFlightRequest)
+            IoCancelIrp(FCB->ReceiveIrp.InFlightRequest);
+        SocketStateUnlock(FCB);
+        return;
+    }
+
+    if (Function == FUNCTION_SEND && Irp == FCB->TransmitIrp)
+    {
+        /* This one is being sent; stop its current send and let the send
+         * completion finish it */
+        if (FCB->SendIrp.InFlightRequest)
+            IoCancelIrp(FCB->SendIrp.InFlightRequest);
+        SocketStateUnlock(FCB);
+        return;
+    }
+
     CurrentEntry = FCB->PendingIrpList[Function].Flink;
     while (CurrentEntry != &FCB->PendingIrpList[Function])
     {
@@ -1286,6 +1325,14 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
         {
             RemoveEntryList(CurrentEntry);
             CleanupPendingIrp(FCB, Irp, IrpSp, NULL);
+
+            /* Sends parked behind a TransmitFile that never started can go now */
+            if (IoctlCode == IOCTL_AFD_TRANSMIT_FILE &&
+                !FCB->SendIrp.InFlightRequest && !FCB->TransmitIrp)
+            {
+                ResumeSendQueue(FCB, FALSE);
+            }
+
             UnlockAndMaybeComplete(FCB, STATUS_CANCELLED, Irp, 0);
             return;
         }
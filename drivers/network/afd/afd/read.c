@@ -10,14 +10,92 @@
 
 #include "afd.h"
 
+static PIRP GetDirectRecvRequest( PAFD_FCB FCB )
+{
+    PIRP NextIrp;
+    PIO_STACK_LOCATION NextIrpSp;
+    PAFD_RECV_INFO RecvReq;
+    PAFD_MAPBUF Map;
+
+    /* Buffered data has to be consumed first */
+    if (FCB->Recv.Content != FCB->Recv.BytesUsed) return NULL;
+
+    if (IsListEmpty(&FCB->PendingIrpList[FUNCTION_RECV])) return NULL;
+
+    NextIrp = CONTAINING_RECORD(FCB->PendingIrpList[FUNCTION_RECV].Flink,
+                                IRP, Tail.Overlay.ListEntry);
+    NextIrpSp = IoGetCurrentIrpStackLocation(NextIrp);
+
+    /* QueueUserModeIrp marks reads pending before it queues them */
+    ASSERT(NextIrpSp->Control & SL_PENDING_RETURNED);
+
+    RecvReq = GetLockedData(NextIrp, NextIrpSp);
+
+    if (RecvReq->BufferCount != 1 ||
+        RecvReq->BufferArray[0].len == 0 ||
+        (RecvReq->TdiFlags & TDI_RECEIVE_PEEK))
+        return NULL;
+
+    Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+    if (!Map[0].Mdl) return NULL;
+
+    return NextIrp;
+}
+
+static BOOLEAN ReceiveDirect( PAFD_FCB FCB, PIRP Irp )
+{
+    PAFD_RECV_INFO RecvReq = GetLockedData(Irp, IoGetCurrentIrpStackLocation(Irp));
+    PAFD_MAPBUF Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+    NTSTATUS Status;
+
+    /* The mapping stays cached in the MDL until UnlockBuffers */
+    Map[0].BufferAddress = MmGetSystemAddressForMdlSafe(Map[0].Mdl, NormalPagePriority);
+    if (!Map[0].BufferAddress) return FALSE;
+
+    AFD_DbgPrint(MID_TRACE,("Receiving directly into %p (%p:%u)\n",
+                            Irp, Map[0].BufferAddress,
+                            RecvReq->BufferArray[0].len));
+
+    /* The read belongs to the in flight request until it completes */
+    RemoveEntryList(&Irp->Tail.Overlay.ListEntry);
+    FCB->Recv.Content = 0;
+    FCB->Recv.BytesUsed = 0;
+    FCB->DirectRecvIrp = Irp;
+
+    Status = TdiReceive( &FCB->ReceiveIrp.InFlightRequest,
+                         FCB->Connection.Object,
+                         TDI_RECEIVE_NORMAL,
+                         Map[0].BufferAddress,
+                         RecvReq->BufferArray[0].len,
+                         ReceiveComplete,
+                         FCB );
+    if (Status != STATUS_PENDING)
+    {
+        /* Never reached the transport, so take the read back */
+        FCB->DirectRecvIrp = NULL;
+        InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                       &Irp->Tail.Overlay.ListEntry);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 static VOID RefillSocketBuffer( PAFD_FCB FCB )
 {
+    PIRP NextIrp;
+
     /* Make sure nothing's in flight first */
     if (FCB->ReceiveIrp.InFlightRequest) return;
 
     /* Now ensure that receive is still allowed */
     if (FCB->TdiReceiveClosed) return;
 
+    /* If a read is already waiting on an empty window, let the transport
+     * copy straight into it rather than staging the data in the window */
+    NextIrp = GetDirectRecvRequest(FCB);
+    if (NextIrp && ReceiveDirect(FCB, NextIrp)) return;
+
     /* Check if the buffer is full */
     if (FCB->Recv.Content == FCB->Recv.Size)
     {
@@ -50,6 +128,32 @@ static VOID RefillSocketBuffer( PAFD_FCB FCB )
                 FCB );
 }
 
+static VOID RetargetSocketReceive( PAFD_FCB FCB )
+{
+    PIRP NextIrp;
+    PAFD_RECV_INFO RecvReq;
+
+    if (!FCB->ReceiveIrp.InFlightRequest)
+    {
+        RefillSocketBuffer(FCB);
+        return;
+    }
+
+    if (FCB->DirectRecvIrp || FCB->RecvRetarget || FCB->TdiReceiveClosed) return;
+
+    NextIrp = GetDirectRecvRequest(FCB);
+    if (!NextIrp) return;
+
+    /* Only worth it when the read can take more than the window would give it */
+    RecvReq = GetLockedData(NextIrp, IoGetCurrentIrpStackLocation(NextIrp));
+    if (RecvReq->BufferArray[0].len <= FCB->Recv.Size) return;
+
+    /* Pull back the window receive, ReceiveComplete reissues it into the read.
+     * Anything the transport already had queued stays there. */
+    FCB->RecvRetarget = TRUE;
+    IoCancelIrp(FCB->ReceiveIrp.InFlightRequest);
+}
+
 static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Information )
 {
     FCB->LastReceiveStatus = Status;
@@ -71,11 +175,9 @@ static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Info
             /* Receive is closed */
             FCB->TdiReceiveClosed = TRUE;
         }
-        else
-        {
-            /* Issue another receive IRP to keep the buffer well stocked */
-            RefillSocketBuffer(FCB);
-        }
+
+        /* The next receive is issued by ReceiveActivity once the waiting
+         * reads have been served, so it can go straight into one of them */
     }
     /* Receive failed with no data (unexpected closure) */
     else
@@ -85,6 +187,40 @@ static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Info
     }
 }
 
+static VOID HandleDirectReceiveComplete( PAFD_FCB FCB, PIRP Irp,
+                                         NTSTATUS Status, ULONG_PTR Information )
+{
+    PAFD_RECV_INFO RecvReq = GetLockedData(Irp, IoGetCurrentIrpStackLocation(Irp));
+
+    /* The data is already in the caller's buffer, even if we got closed meanwhile */
+    if (Status == STATUS_SUCCESS && Information != 0)
+    {
+        FCB->LastReceiveStatus = Status;
+    }
+    /* The read itself was cancelled, the connection is fine */
+    else if (Status == STATUS_CANCELLED && Irp->Cancel && !FCB->TdiReceiveClosed)
+    {
+        Information = 0;
+    }
+    else
+    {
+        /* Hand the read back so it is completed like a buffered one */
+        InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                       &Irp->Tail.Overlay.ListEntry);
+        HandleReceiveComplete(FCB, Status, 0);
+        return;
+    }
+
+    AFD_DbgPrint(MID_TRACE,("Completing direct recv %p (%u)\n", Irp,
+                            (UINT)Information));
+    UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, FALSE );
+    Irp->IoStatus.Status = Status;
+    Irp->IoStatus.Information = Information;
+    if( Irp->MdlAddress ) UnlockRequest( Irp, IoGetCurrentIrpStackLocation( Irp ) );
+    (void)IoSetCancelRoutine(Irp, NULL);
+    IoCompleteRequest( Irp, IO_NETWORK_INCREMENT );
+}
+
 static BOOLEAN CantReadMore( PAFD_FCB FCB ) {
     UINT BytesAvailable = FCB->Recv.Content - FCB->Recv.BytesUsed;
 
@@ -120,7 +256,14 @@ static NTSTATUS TryToSatisfyRecvRequestFromBuffer( PAFD_FCB FCB,
             MIN( RecvReq->BufferArray[i].len, BytesAvailable );
 
         if( Map[i].Mdl ) {
-            Map[i].BufferAddress = MmMapLockedPages( Map[i].Mdl, KernelMode );
+            /* The mapping stays cached in the MDL until UnlockBuffers */
+            Map[i].BufferAddress =
+                MmGetSystemAddressForMdlSafe( Map[i].Mdl, NormalPagePriority );
+            if( !Map[i].BufferAddress ) {
+                AFD_DbgPrint(MIN_TRACE,("Failed to map buffer %u\n", i));
+                if( !*TotalBytesCopied ) return STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
 
             AFD_DbgPrint(MID_TRACE,("Buffer %u: %p:%u\n",
                                     i,
@@ -131,8 +274,6 @@ static NTSTATUS TryToSatisfyRecvRequestFromBuffer( PAFD_FCB FCB,
                            FCB->Recv.Window + FcbBytesCopied,
                            BytesToCopy );
 
-            MmUnmapLockedPages( Map[i].BufferAddress, Map[i].Mdl );
-
             *TotalBytesCopied += BytesToCopy;
             FcbBytesCopied += BytesToCopy;
             BytesAvailable -= BytesToCopy;
@@ -142,9 +283,6 @@ static NTSTATUS TryToSatisfyRecvRequestFromBuffer( PAFD_FCB FCB,
         }
     }
 
-    /* Issue another receive IRP to keep the buffer well stocked */
-    RefillSocketBuffer(FCB);
-
     return STATUS_SUCCESS;
 }
 
@@ -233,6 +371,9 @@ static NTSTATUS ReceiveActivity( PAFD_FCB FCB, PIRP Irp ) {
                 IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
             }
         }
+
+        /* Issue another receive IRP to keep the buffer well stocked */
+        RefillSocketBuffer(FCB);
     }
 
     if( FCB->Recv.Content - FCB->Recv.BytesUsed &&
@@ -272,9 +413,10 @@ NTSTATUS NTAPI ReceiveComplete
   PVOID Context ) {
     PAFD_FCB FCB = (PAFD_FCB)Context;
     PLIST_ENTRY NextIrpEntry;
-    PIRP NextIrp;
+    PIRP NextIrp, DirectIrp;
     PAFD_RECV_INFO RecvReq;
     PIO_STACK_LOCATION NextIrpSp;
+    BOOLEAN Retarget;
 
     UNREFERENCED_PARAMETER(DeviceObject);
 
@@ -286,7 +428,16 @@ NTSTATUS NTAPI ReceiveComplete
     ASSERT(FCB->ReceiveIrp.InFlightRequest == Irp);
     FCB->ReceiveIrp.InFlightRequest = NULL;
 
+    DirectIrp = FCB->DirectRecvIrp;
+    FCB->DirectRecvIrp = NULL;
+    Retarget = FCB->RecvRetarget;
+    FCB->RecvRetarget = FALSE;
+
     if( FCB->State == SOCKET_STATE_CLOSED ) {
+        if( DirectIrp )
+            InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                           &DirectIrp->Tail.Overlay.ListEntry);
+
         /* Cleanup our IRP queue because the FCB is being destroyed */
         while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_RECV] ) ) {
             NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_RECV]);
@@ -308,7 +459,16 @@ NTSTATUS NTAPI ReceiveComplete
         return STATUS_INVALID_PARAMETER;
     }
 
-    HandleReceiveComplete( FCB, Irp->IoStatus.Status, Irp->IoStatus.Information );
+    if( DirectIrp ) {
+        HandleDirectReceiveComplete( FCB, DirectIrp,
+                                     Irp->IoStatus.Status,
+                                     Irp->IoStatus.Information );
+    } else if( Retarget && Irp->IoStatus.Status == STATUS_CANCELLED &&
+               !FCB->TdiReceiveClosed ) {
+        /* We only pulled the window receive back to reissue it into a read */
+    } else {
+        HandleReceiveComplete( FCB, Irp->IoStatus.Status, Irp->IoStatus.Information );
+    }
 
     ReceiveActivity( FCB, NULL );
 
@@ -339,8 +499,15 @@ SatisfyPacketRecvRequest( PAFD_FCB FCB, PIRP Irp,
                             RecvReq->BufferArray[0].len));
 
     if( Map[0].Mdl ) {
+        /* The mappings stay cached in the MDLs until UnlockBuffers */
+        Map[0].BufferAddress = MmGetSystemAddressForMdlSafe( Map[0].Mdl, NormalPagePriority );
+        if( !Map[0].BufferAddress ) {
+            AFD_DbgPrint(MIN_TRACE,("Failed to map data buffer\n"));
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+
         /* Copy the address */
-        if( ExtraBuffers && Map[1].Mdl && Map[2].Mdl ) {
+        if( NT_SUCCESS(Status) && ExtraBuffers && Map[1].Mdl && Map[2].Mdl ) {
             AFD_DbgPrint(MID_TRACE,("Checking TAAddressCount\n"));
 
             if( DatagramRecv->Address->TAAddressCount != 1 ) {
@@ -358,42 +525,40 @@ SatisfyPacketRecvRequest( PAFD_FCB FCB, PIRP Irp,
 
             AFD_DbgPrint(MID_TRACE,("Copying %u bytes of address\n", AddrLen));
 
-            Map[1].BufferAddress = MmMapLockedPages( Map[1].Mdl, KernelMode );
-
-            AFD_DbgPrint(MID_TRACE,("Done mapping, copying address\n"));
+            Map[1].BufferAddress = MmGetSystemAddressForMdlSafe( Map[1].Mdl, NormalPagePriority );
+            Map[2].BufferAddress = MmGetSystemAddressForMdlSafe( Map[2].Mdl, NormalPagePriority );
 
-            RtlCopyMemory( Map[1].BufferAddress,
-                          &DatagramRecv->Address->Address->AddressType,
-                          AddrLen );
+            if( Map[1].BufferAddress && Map[2].BufferAddress ) {
+                RtlCopyMemory( Map[1].BufferAddress,
+                              &DatagramRecv->Address->Address->AddressType,
+                              AddrLen );
 
-            MmUnmapLockedPages( Map[1].BufferAddress, Map[1].Mdl );
+                AFD_DbgPrint(MID_TRACE,("Copying address len\n"));
 
-            AFD_DbgPrint(MID_TRACE,("Copying address len\n"));
-
-            Map[2].BufferAddress = MmMapLockedPages( Map[2].Mdl, KernelMode );
-            *((PINT)Map[2].BufferAddress) = AddrLen;
-            MmUnmapLockedPages( Map[2].BufferAddress, Map[2].Mdl );
+                *((PINT)Map[2].BufferAddress) = AddrLen;
+            }
         }
 
-        AFD_DbgPrint(MID_TRACE,("Mapping data buffer pages\n"));
-
-        Map[0].BufferAddress = MmMapLockedPages( Map[0].Mdl, KernelMode );
-
         AFD_DbgPrint(MID_TRACE,("Buffer %d: %p:%u\n",
                                 0,
                                 Map[0].BufferAddress,
                                 BytesToCopy));
 
-        RtlCopyMemory( Map[0].BufferAddress,
-                      DatagramRecv->Buffer,
-                      BytesToCopy );
-
-        MmUnmapLockedPages( Map[0].BufferAddress, Map[0].Mdl );
+        if( NT_SUCCESS(Status) ) {
+            RtlCopyMemory( Map[0].BufferAddress,
+                          DatagramRecv->Buffer,
+                          BytesToCopy );
 
-        *TotalBytesCopied = BytesToCopy;
+            *TotalBytesCopied = BytesToCopy;
+        }
     }
 
-    if (*TotalBytesCopied == DatagramRecv->Len)
+    if (!NT_SUCCESS(Status))
+    {
+        /* The datagram is dropped like any other that could not be delivered */
+        Irp->IoStatus.Status = Status;
+    }
+    else if (*TotalBytesCopied == DatagramRecv->Len)
     {
         /* We copied the whole datagram */
         Status = Irp->IoStatus.Status = STATUS_SUCCESS;
@@ -532,6 +697,9 @@ AfdConnectedSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         AFD_DbgPrint(MID_TRACE,("Leaving read irp\n"));
         IoMarkIrpPending( Irp );
         (void)IoSetCancelRoutine(Irp, AfdCancelHandler);
+
+        /* Now that it is pending, the read can take the data directly */
+        RetargetSocketReceive( FCB );
     } else {
         AFD_DbgPrint(MID_TRACE,("Completed with status %x\n", Status));
     }
@@ -0,0 +1,606 @@
+/*
+ * PROJECT:     ReactOS Ancillary Function Driver
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     TransmitFile and TransmitPackets
+ */
+
+#include "afd.h"
+
+VOID
+UnlockTransmitElements(PAFD_TRANSMIT_ELEMENT Elements, UINT Count)
+{
+    PAFD_TRANSMIT_MAP Map = (PAFD_TRANSMIT_MAP)(Elements + Count);
+    UINT i;
+
+    if (!Elements) return;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (Map[i].Mdl)
+        {
+            MmUnlockPages(Map[i].Mdl);
+            IoFreeMdl(Map[i].Mdl);
+        }
+
+        if (Map[i].FileObject)
+            ObDereferenceObject(Map[i].FileObject);
+    }
+
+    ExFreePoolWithTag(Elements, TAG_AFD_TRANSMIT_ELEMENTS);
+}
+
+/* Captures the element array and takes hold of everything it refers to, since
+ * the worker runs in the system process where neither the caller's buffers nor
+ * its handles are valid */
+static
+PAFD_TRANSMIT_ELEMENT
+LockTransmitElements(PAFD_TRANSMIT_ELEMENT UserElements, UINT Count,
+                     KPROCESSOR_MODE LockMode, PNTSTATUS Status)
+{
+    PAFD_TRANSMIT_ELEMENT Elements;
+    PAFD_TRANSMIT_MAP Map;
+    SIZE_T Size;
+    BOOLEAN LockFailed = FALSE;
+    UINT i;
+
+    if (!Count || Count > MAXULONG / (sizeof(AFD_TRANSMIT_ELEMENT) + sizeof(AFD_TRANSMIT_MAP)))
+    {
+        *Status = STATUS_INVALID_PARAMETER;
+        return NULL;
+    }
+
+    Size = (sizeof(AFD_TRANSMIT_ELEMENT) + sizeof(AFD_TRANSMIT_MAP)) * Count;
+    Elements = ExAllocatePoolWithTag(PagedPool, Size, TAG_AFD_TRANSMIT_ELEMENTS);
+    if (!Elements)
+    {
+        *Status = STATUS_INSUFFICIENT_RESOURCES;
+        return NULL;
+    }
+
+    RtlZeroMemory(Elements, Size);
+    Map = (PAFD_TRANSMIT_MAP)(Elements + Count);
+
+    _SEH2_TRY {
+        if (LockMode != KernelMode)
+            ProbeForRead(UserElements, sizeof(AFD_TRANSMIT_ELEMENT) * Count, sizeof(ULONG));
+        RtlCopyMemory(Elements, UserElements, sizeof(AFD_TRANSMIT_ELEMENT) * Count);
+    } _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER) {
+        AFD_DbgPrint(MIN_TRACE,("Access violation copying transmit elements (%p)\n",
+                                UserElements));
+        ExFreePoolWithTag(Elements, TAG_AFD_TRANSMIT_ELEMENTS);
+        *Status = STATUS_ACCESS_VIOLATION;
+        _SEH2_YIELD(return NULL);
+    } _SEH2_END;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (Elements[i].Flags == AFD_TRANSMIT_ELEMENT_FILE)
+        {
+            *Status = ObReferenceObjectByHandle(Elements[i].FileHandle,
+                                                FILE_READ_DATA,
+                                                *IoFileObjectType,
+                                                LockMode,
+                                                (PVOID*)&Map[i].FileObject,
+                                                NULL);
+            if (!NT_SUCCESS(*Status))
+            {
+                AFD_DbgPrint(MIN_TRACE,("Bad file handle %p (%x)\n",
+                                        Elements[i].FileHandle, *Status));
+                Map[i].FileObject = NULL;
+                break;
+            }
+        }
+        else if (Elements[i].Flags == AFD_TRANSMIT_ELEMENT_MEMORY)
+        {
+            if (!Elements[i].Buffer || !Elements[i].Length)
+                continue;
+
+            Map[i].Mdl = IoAllocateMdl(Elements[i].Buffer,
+                                       Elements[i].Length,
+                                       FALSE,
+                                       FALSE,
+                                       NULL);
+            if (!Map[i].Mdl)
+            {
+                *Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+
+            _SEH2_TRY {
+                MmProbeAndLockPages(Map[i].Mdl, LockMode, IoReadAccess);
+            } _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER) {
+                LockFailed = TRUE;
+            } _SEH2_END;
+
+            if (LockFailed)
+            {
+                AFD_DbgPrint(MIN_TRACE,("Failed to lock pages\n"));
+                IoFreeMdl(Map[i].Mdl);
+                Map[i].Mdl = NULL;
+                *Status = STATUS_ACCESS_VIOLATION;
+                break;
+            }
+        }
+        else
+        {
+            *Status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+    }
+
+    if (i != Count)
+    {
+        UnlockTransmitElements(Elements, Count);
+        return NULL;
+    }
+
+    *Status = STATUS_SUCCESS;
+    return Elements;
+}
+
+static VOID TransmitNext(PAFD_FCB FCB);
+static IO_WORKITEM_ROUTINE TransmitWorker;
+
+static
+NTSTATUS
+TransmitCheckState(PAFD_FCB FCB, PIRP Irp)
+{
+    if (Irp->Cancel)
+        return STATUS_CANCELLED;
+
+    if (FCB->State == SOCKET_STATE_CLOSED)
+        return STATUS_FILE_CLOSED;
+
+    if (FCB->PollState & AFD_EVENT_ABORT)
+        return FCB->PollStatus[FD_CLOSE_BIT];
+
+    return STATUS_SUCCESS;
+}
+
+/* Completes the TransmitFile being sent and lets the queued sends go.
+ * Called with the socket locked, returns with it unlocked. */
+static
+VOID
+TransmitFinish(PAFD_FCB FCB, NTSTATUS Status)
+{
+    PAFD_TRANSMIT_STATE State = &FCB->TransmitState;
+    PIRP Irp = FCB->TransmitIrp;
+    PIO_STACK_LOCATION IrpSp = IoGetCurrentIrpStackLocation(Irp);
+    PAFD_TRANSMIT_FILE_INFO TransmitReq = GetLockedData(Irp, IrpSp);
+    UINT BytesSent = State->BytesSent;
+
+    AFD_DbgPrint(MID_TRACE,("TransmitFile done: %x, %u bytes\n", Status, BytesSent));
+
+    if (State->MdlChain)
+        FsRtlMdlReadComplete(State->FileObject, State->MdlChain);
+
+    if (State->Buffer)
+        ExFreePoolWithTag(State->Buffer, TAG_AFD_TRANSMIT_BUFFER);
+
+    RtlZeroMemory(State, sizeof(*State));
+
+    RemoveEntryList(&Irp->Tail.Overlay.ListEntry);
+    FCB->TransmitIrp = NULL;
+
+    if (NT_SUCCESS(Status) &&
+        (TransmitReq->Flags & (AFD_TF_DISCONNECT | AFD_TF_REUSE_SOCKET)) &&
+        FCB->ConnectCallInfo && !FCB->DisconnectPending)
+    {
+        /* Same as a send shutdown, it goes out once the queued sends are done */
+        FCB->DisconnectFlags = TDI_DISCONNECT_RELEASE;
+        FCB->DisconnectTimeout.QuadPart = 0;
+        FCB->DisconnectPending = TRUE;
+        FCB->SendClosed = TRUE;
+        FCB->PollState &= ~AFD_EVENT_SEND;
+    }
+
+    CleanupPendingIrp(FCB, Irp, IrpSp, NULL);
+
+    ResumeSendQueue(FCB, FALSE);
+
+    UnlockAndMaybeComplete(FCB, Status, Irp, BytesSent);
+}
+
+static IO_COMPLETION_ROUTINE TransmitSendComplete;
+static
+NTSTATUS
+NTAPI
+TransmitSendComplete(PDEVICE_OBJECT DeviceObject, PIRP Irp, PVOID Context)
+{
+    PAFD_FCB FCB = Context;
+    PAFD_TRANSMIT_STATE State = &FCB->TransmitState;
+    NTSTATUS Status = Irp->IoStatus.Status;
+    UINT Sent = (UINT)Irp->IoStatus.Information;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    if (!SocketAcquireStateLock(FCB))
+        return STATUS_FILE_CLOSED;
+
+    ASSERT(FCB->SendIrp.InFlightRequest == Irp);
+    FCB->SendIrp.InFlightRequest = NULL;
+
+    if (NT_SUCCESS(Status) && !Sent)
+        Status = STATUS_UNSUCCESSFUL;
+
+    if (NT_SUCCESS(Status))
+    {
+        State->Data += Sent;
+        State->DataLength -= Sent;
+        State->BytesSent += Sent;
+    }
+
+    if (State->Sending)
+    {
+        /* Completed from within TdiSend, TransmitNext goes on from there
+         * instead of nesting one more send on the stack */
+        State->Sending = FALSE;
+        State->SendStatus = Status;
+        SocketStateUnlock(FCB);
+        return STATUS_SUCCESS;
+    }
+
+    if (NT_SUCCESS(Status))
+        TransmitNext(FCB);
+    else
+        TransmitFinish(FCB, Status);
+
+    return STATUS_SUCCESS;
+}
+
+/* Starts the next TDI send of the TransmitFile, moving on to the next element
+ * when the current one is done. Data of file elements is read by the work item,
+ * everything else happens right here, mostly from the completion of the
+ * previous send. Called with the socket locked, returns with it unlocked. */
+static
+VOID
+TransmitNext(PAFD_FCB FCB)
+{
+    PAFD_TRANSMIT_STATE State = &FCB->TransmitState;
+    PIRP Irp = FCB->TransmitIrp;
+    PAFD_TRANSMIT_FILE_INFO TransmitReq;
+    PAFD_TRANSMIT_ELEMENT Element;
+    PAFD_TRANSMIT_MAP Map;
+    NTSTATUS Status;
+
+    TransmitReq = GetLockedData(Irp, IoGetCurrentIrpStackLocation(Irp));
+
+    for (;;)
+    {
+        Status = TransmitCheckState(FCB, Irp);
+        if (!NT_SUCCESS(Status))
+            break;
+
+        if (State->DataLength)
+        {
+            ASSERT(!FCB->SendIrp.InFlightRequest);
+
+            State->Sending = TRUE;
+            Status = TdiSend(&FCB->SendIrp.InFlightRequest,
+                             FCB->Connection.Object,
+                             0,
+                             State->Data,
+                             MIN(State->DataLength, TransmitReq->SendSize),
+                             TransmitSendComplete,
+                             FCB);
+            if (Status != STATUS_PENDING)
+            {
+                State->Sending = FALSE;
+                break;
+            }
+
+            if (State->Sending)
+            {
+                /* Still in flight, its completion carries on */
+                State->Sending = FALSE;
+                SocketStateUnlock(FCB);
+                return;
+            }
+
+            Status = State->SendStatus;
+            if (!NT_SUCCESS(Status))
+                break;
+
+            continue;
+        }
+
+        /* Rest of the cache read */
+        if (State->Mdl && State->Mdl->Next)
+        {
+            State->Mdl = State->Mdl->Next;
+            State->Data = MmGetSystemAddressForMdlSafe(State->Mdl, NormalPagePriority);
+            if (!State->Data)
+            {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+            State->DataLength = MmGetMdlByteCount(State->Mdl);
+            continue;
+        }
+
+        if (State->FileObject)
+        {
+            if (State->MdlChain || !State->FileEnd)
+            {
+                /* Reading may block, leave it to the work item */
+                IoQueueWorkItem(FCB->TransmitWorkItem, TransmitWorker, DelayedWorkQueue, FCB);
+                SocketStateUnlock(FCB);
+                return;
+            }
+
+            State->FileObject = NULL;
+        }
+
+        if (State->Element == TransmitReq->ElementCount)
+        {
+            Status = STATUS_SUCCESS;
+            break;
+        }
+
+        Element = &TransmitReq->ElementArray[State->Element];
+        Map = (PAFD_TRANSMIT_MAP)(TransmitReq->ElementArray + TransmitReq->ElementCount) + State->Element;
+        State->Element++;
+
+        if (Map->FileObject)
+        {
+            State->FileObject = Map->FileObject;
+            State->FileOffset = Element->FileOffset;
+            State->FileRemaining = Element->Length;
+            State->FileToEnd = !Element->Length;
+            State->FileEnd = FALSE;
+        }
+        else if (Map->Mdl)
+        {
+            State->Data = MmGetSystemAddressForMdlSafe(Map->Mdl, NormalPagePriority);
+            if (!State->Data)
+            {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+            State->DataLength = Element->Length;
+        }
+    }
+
+    TransmitFinish(FCB, Status);
+}
+
+static
+NTSTATUS
+TransmitReadFile(PFILE_OBJECT FileObject, PLARGE_INTEGER Offset,
+                 PVOID Buffer, ULONG Length, PIO_STATUS_BLOCK IoStatus)
+{
+    PDEVICE_OBJECT DeviceObject = IoGetRelatedDeviceObject(FileObject);
+    KEVENT Event;
+    PIRP Irp;
+    NTSTATUS Status;
+
+    KeInitializeEvent(&Event, NotificationEvent, FALSE);
+
+    Irp = IoBuildSynchronousFsdRequest(IRP_MJ_READ,
+                                       DeviceObject,
+                                       Buffer,
+                                       Length,
+                                       Offset,
+                                       &Event,
+                                       IoStatus);
+    if (!Irp)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    IoGetNextIrpStackLocation(Irp)->FileObject = FileObject;
+
+    Status = IoCallDriver(DeviceObject, Irp);
+    if (Status == STATUS_PENDING)
+    {
+        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
+        Status = IoStatus->Status;
+    }
+
+    return Status;
+}
+
+/* Starts the TransmitFile, and reads the next piece of a file element for it.
+ * File data comes straight out of the cache when the file system can hand out
+ * MDLs for it, otherwise it is read through a buffer of our own. */
+static
+VOID
+NTAPI
+TransmitWorker(PDEVICE_OBJECT DeviceObject, PVOID Context)
+{
+    PAFD_FCB FCB = Context;
+    PAFD_TRANSMIT_STATE State = &FCB->TransmitState;
+    PAFD_TRANSMIT_FILE_INFO TransmitReq;
+    PFILE_OBJECT FileObject;
+    LARGE_INTEGER Offset;
+    IO_STATUS_BLOCK IoStatus;
+    PMDL MdlChain;
+    PCHAR Buffer;
+    ULONG Length, Read;
+    BOOLEAN MdlRead;
+    NTSTATUS Status;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    SocketAcquireStateLock(FCB);
+
+    ASSERT(FCB->TransmitIrp);
+    ASSERT(!FCB->SendIrp.InFlightRequest);
+
+    if (!State->FileObject)
+    {
+        TransmitNext(FCB);
+        return;
+    }
+
+    TransmitReq = GetLockedData(FCB->TransmitIrp, IoGetCurrentIrpStackLocation(FCB->TransmitIrp));
+
+    /* Whatever was read last has been sent */
+    FileObject = State->FileObject;
+    MdlChain = State->MdlChain;
+    State->MdlChain = NULL;
+    State->Mdl = NULL;
+
+    /* A zero length means up to the end of the file */
+    Length = State->FileToEnd ? TransmitReq->SendSize : MIN(State->FileRemaining, TransmitReq->SendSize);
+    if (State->FileEnd || !NT_SUCCESS(TransmitCheckState(FCB, FCB->TransmitIrp)))
+        Length = 0;
+
+    Offset = State->FileOffset;
+    Buffer = State->Buffer;
+
+    SocketStateUnlock(FCB);
+
+    if (MdlChain)
+        FsRtlMdlReadComplete(FileObject, MdlChain);
+
+    MdlChain = NULL;
+    MdlRead = FALSE;
+    IoStatus.Status = STATUS_SUCCESS;
+    IoStatus.Information = 0;
+
+    if (Length)
+    {
+        MdlRead = !Buffer && FsRtlMdlRead(FileObject, &Offset, Length, 0, &MdlChain, &IoStatus);
+        if (!MdlRead)
+        {
+            if (!Buffer)
+                Buffer = ExAllocatePoolWithTag(NonPagedPool, TransmitReq->SendSize, TAG_AFD_TRANSMIT_BUFFER);
+
+            if (Buffer)
+                IoStatus.Status = TransmitReadFile(FileObject, &Offset, Buffer, Length, &IoStatus);
+            else
+                IoStatus.Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    SocketAcquireStateLock(FCB);
+
+    State->Buffer = Buffer;
+    State->MdlChain = MdlChain;
+
+    Status = IoStatus.Status;
+    Read = NT_SUCCESS(Status) ? (ULONG)IoStatus.Information : 0;
+
+    if (Status == STATUS_END_OF_FILE)
+        Status = STATUS_SUCCESS;
+
+    if (!NT_SUCCESS(Status))
+    {
+        TransmitFinish(FCB, Status);
+        return;
+    }
+
+    State->FileOffset.QuadPart += Read;
+    if (!State->FileToEnd)
+        State->FileRemaining -= Read;
+
+    /* A short read means we hit the end of the file */
+    if (Read < Length || !Length || (!State->FileToEnd && !State->FileRemaining))
+        State->FileEnd = TRUE;
+
+    if (MdlChain)
+    {
+        State->Mdl = MdlChain;
+        State->Data = MmGetSystemAddressForMdlSafe(MdlChain, NormalPagePriority);
+        if (!State->Data)
+        {
+            TransmitFinish(FCB, STATUS_INSUFFICIENT_RESOURCES);
+            return;
+        }
+        State->DataLength = MmGetMdlByteCount(MdlChain);
+    }
+    else
+    {
+        State->Data = Buffer;
+        State->DataLength = Read;
+    }
+
+    TransmitNext(FCB);
+}
+
+VOID
+StartTransmit(PAFD_FCB FCB, PIRP Irp)
+{
+    ASSERT(!FCB->TransmitIrp);
+    ASSERT(!FCB->SendIrp.InFlightRequest);
+
+    FCB->TransmitIrp = Irp;
+    RtlZeroMemory(&FCB->TransmitState, sizeof(FCB->TransmitState));
+    IoQueueWorkItem(FCB->TransmitWorkItem, TransmitWorker, DelayedWorkQueue, FCB);
+}
+
+NTSTATUS NTAPI
+AfdTransmitFile(PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                PIO_STACK_LOCATION IrpSp)
+{
+    PFILE_OBJECT FileObject = IrpSp->FileObject;
+    PAFD_FCB FCB = FileObject->FsContext;
+    PAFD_TRANSMIT_FILE_INFO TransmitReq;
+    KPROCESSOR_MODE LockMode;
+    NTSTATUS Status;
+
+    AFD_DbgPrint(MID_TRACE,("Called on %p\n", FCB));
+
+    if (!SocketAcquireStateLock(FCB)) return LostSocket(Irp);
+
+    if (IrpSp->Parameters.DeviceIoControl.InputBufferLength < sizeof(AFD_TRANSMIT_FILE_INFO) ||
+        (FCB->Flags & AFD_ENDPOINT_CONNECTIONLESS))
+    {
+        AFD_DbgPrint(MIN_TRACE,("Invalid parameter\n"));
+        return UnlockAndMaybeComplete(FCB, STATUS_INVALID_PARAMETER, Irp, 0);
+    }
+
+    if (FCB->PollState & (AFD_EVENT_CLOSE | AFD_EVENT_ABORT))
+    {
+        AFD_DbgPrint(MIN_TRACE,("Connection closed\n"));
+        return UnlockAndMaybeComplete(FCB, FCB->PollStatus[FD_CLOSE_BIT], Irp, 0);
+    }
+
+    if (FCB->SendClosed)
+    {
+        AFD_DbgPrint(MIN_TRACE,("No more sends\n"));
+        return UnlockAndMaybeComplete(FCB, STATUS_FILE_CLOSED, Irp, 0);
+    }
+
+    if (FCB->State != SOCKET_STATE_CONNECTED)
+    {
+        AFD_DbgPrint(MID_TRACE,("Socket not connected\n"));
+        return UnlockAndMaybeComplete(FCB, STATUS_INVALID_CONNECTION, Irp, 0);
+    }
+
+    if (!FCB->TransmitWorkItem)
+    {
+        FCB->TransmitWorkItem = IoAllocateWorkItem(DeviceObject);
+        if (!FCB->TransmitWorkItem)
+            return UnlockAndMaybeComplete(FCB, STATUS_INSUFFICIENT_RESOURCES, Irp, 0);
+    }
+
+    if (!(TransmitReq = LockRequest(Irp, IrpSp, FALSE, &LockMode)))
+        return UnlockAndMaybeComplete(FCB, STATUS_NO_MEMORY, Irp, 0);
+
+    TransmitReq->ElementArray = LockTransmitElements(TransmitReq->ElementArray,
+                                                     TransmitReq->ElementCount,
+                                                     LockMode,
+                                                     &Status);
+    if (!TransmitReq->ElementArray)
+        return UnlockAndMaybeComplete(FCB, Status, Irp, 0);
+
+    if (!TransmitReq->SendSize)
+        TransmitReq->SendSize = AFD_TRANSMIT_SEND_SIZE;
+
+    /* Sends issued from now on queue up behind us */
+    FCB->TransmitCount++;
+    FCB->PollState &= ~AFD_EVENT_SEND;
+
+    Status = QueueUserModeIrp(FCB, Irp, FUNCTION_SEND);
+    if (Status == STATUS_PENDING &&
+        FCB->PendingIrpList[FUNCTION_SEND].Flink == &Irp->Tail.Overlay.ListEntry &&
+        !FCB->SendIrp.InFlightRequest && !FCB->Send.BytesUsed && !FCB->TransmitIrp)
+    {
+        /* Nothing ahead of us, go right away */
+        StartTransmit(FCB, Irp);
+    }
+
+    SocketStateUnlock(FCB);
+
+    return STATUS_PENDING;
+}
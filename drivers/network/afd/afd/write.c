@@ -21,9 +21,8 @@ static NTSTATUS NTAPI SendComplete
     PIRP NextIrp = NULL;
     PIO_STACK_LOCATION NextIrpSp;
     PAFD_SEND_INFO SendReq = NULL;
-    PAFD_MAPBUF Map;
-    SIZE_T TotalBytesCopied = 0, TotalBytesProcessed = 0, SpaceAvail, i;
-    UINT SendLength, BytesCopied;
+    SIZE_T TotalBytesCopied = 0, TotalBytesProcessed = 0;
+    UINT SendLength;
     BOOLEAN HaltSendQueue;
 
     UNREFERENCED_PARAMETER(DeviceObject);
@@ -54,10 +53,9 @@ static NTSTATUS NTAPI SendComplete
             NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_SEND]);
             NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
             NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
-            SendReq = GetLockedData(NextIrp, NextIrpSp);
             NextIrp->IoStatus.Status = STATUS_FILE_CLOSED;
             NextIrp->IoStatus.Information = 0;
-            UnlockBuffers(SendReq->BufferArray, SendReq->BufferCount, FALSE);
+            CleanupPendingIrp(FCB, NextIrp, NextIrpSp, NULL);
             if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, IoGetCurrentIrpStackLocation( NextIrp ) );
             (void)IoSetCancelRoutine(NextIrp, NULL);
             IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
@@ -78,11 +76,9 @@ static NTSTATUS NTAPI SendComplete
             NextIrp =
                 CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
             NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
-            SendReq = GetLockedData(NextIrp, NextIrpSp);
 
-            UnlockBuffers( SendReq->BufferArray,
-                           SendReq->BufferCount,
-                           FALSE );
+            /* This may also be a TransmitFile queued behind the sends */
+            CleanupPendingIrp(FCB, NextIrp, NextIrpSp, NULL);
 
             NextIrp->IoStatus.Status = Status;
             NextIrp->IoStatus.Information = 0;
@@ -111,7 +107,6 @@ static NTSTATUS NTAPI SendComplete
         NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
         NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
         SendReq = GetLockedData(NextIrp, NextIrpSp);
-        Map = (PAFD_MAPBUF)(SendReq->BufferArray + SendReq->BufferCount);
 
         TotalBytesCopied = (ULONG_PTR)NextIrp->Tail.Overlay.DriverContext[3];
         ASSERT(TotalBytesCopied != 0);
@@ -156,10 +151,43 @@ static NTSTATUS NTAPI SendComplete
 
     ASSERT(SendLength == 0);
 
+    ResumeSendQueue(FCB, HaltSendQueue);
+
+    SocketStateUnlock( FCB );
+
+    return STATUS_SUCCESS;
+}
+
+/* Copies the next queued send into the window (or hands the socket to a queued
+ * TransmitFile) and gets the TDI send going. HaltSendQueue is set when the head
+ * of the queue is still partially in the window. */
+VOID
+ResumeSendQueue(PAFD_FCB FCB, BOOLEAN HaltSendQueue)
+{
+    PLIST_ENTRY NextIrpEntry;
+    PIRP NextIrp;
+    PIO_STACK_LOCATION NextIrpSp;
+    PAFD_SEND_INFO SendReq;
+    PAFD_MAPBUF Map;
+    SIZE_T TotalBytesCopied, SpaceAvail, i;
+    UINT SendLength, BytesCopied;
+
+    ASSERT(!FCB->SendIrp.InFlightRequest);
+
    if ( !HaltSendQueue && !IsListEmpty( &FCB->PendingIrpList[FUNCTION_SEND] ) ) {
         NextIrpEntry = FCB->PendingIrpList[FUNCTION_SEND].Flink;
         NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
         NextIrpSp = IoGetCurrentIrpStackLocation( NextIrp );
+
+        if (NextIrpSp->MajorFunction == IRP_MJ_DEVICE_CONTROL &&
+            NextIrpSp->Parameters.DeviceIoControl.IoControlCode == IOCTL_AFD_TRANSMIT_FILE)
+        {
+            /* A TransmitFile goes out once everything ahead of it was sent */
+            if (!FCB->Send.BytesUsed && !FCB->TransmitIrp)
+                StartTransmit(FCB, NextIrp);
+            goto SendWindow;
+        }
+
         SendReq = GetLockedData(NextIrp, NextIrpSp);
         Map = (PAFD_MAPBUF)(SendReq->BufferArray + SendReq->BufferCount);
 
@@ -222,6 +250,7 @@ static NTSTATUS NTAPI SendComplete
         }
     }
 
+SendWindow:
     if (FCB->Send.Size - FCB->Send.BytesUsed != 0 && !FCB->SendClosed &&
         IsListEmpty(&FCB->PendingIrpList[FUNCTION_SEND]))
     {
@@ -238,23 +267,19 @@ static NTSTATUS NTAPI SendComplete
     /* Some data is still waiting */
     if( FCB->Send.BytesUsed )
     {
-        Status = TdiSend( &FCB->SendIrp.InFlightRequest,
-                          FCB->Connection.Object,
-                          0,
-                          FCB->Send.Window,
-                          FCB->Send.BytesUsed,
-                          SendComplete,
-                          FCB );
+        TdiSend( &FCB->SendIrp.InFlightRequest,
+                 FCB->Connection.Object,
+                 0,
+                 FCB->Send.Window,
+                 FCB->Send.BytesUsed,
+                 SendComplete,
+                 FCB );
     }
-    else
+    else if (!FCB->TransmitIrp)
     {
         /* Nothing is waiting so try to complete a pending disconnect */
         RetryDisconnectCompletion(FCB);
     }
-
-    SocketStateUnlock( FCB );
-
-    return STATUS_SUCCESS;
 }
 
 static IO_COMPLETION_ROUTINE PacketSocketSendComplete;
@@ -457,6 +482,21 @@ AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         return UnlockAndMaybeComplete( FCB, STATUS_INVALID_CONNECTION, Irp, 0 );
     }
 
+    /* Sends issued after a TransmitFile wait until it is done */
+    if (FCB->TransmitCount)
+    {
+        FCB->PollState &= ~AFD_EVENT_SEND;
+
+        if (!(SendReq->AfdFlags & AFD_OVERLAPPED) &&
+            ((SendReq->AfdFlags & AFD_IMMEDIATE) || (FCB->NonBlocking)))
+        {
+            UnlockBuffers( SendReq->BufferArray, SendReq->BufferCount, FALSE );
+            return UnlockAndMaybeComplete( FCB, STATUS_CANT_WAIT, Irp, 0 );
+        }
+
+        return LeaveIrpUntilLater(FCB, Irp, FUNCTION_SEND);
+    }
+
     AFD_DbgPrint(MID_TRACE,("FCB->Send.BytesUsed = %u\n",
                             FCB->Send.BytesUsed));
 
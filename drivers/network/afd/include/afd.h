@@ -51,7 +51,10 @@
 #define TAG_AFD_STORED_DATAGRAM            'gsfA'
 #define TAG_AFD_SNMP_ADDRESS_INFO          'asfA'
 #define TAG_AFD_TDI_CONNECTION_INFORMATION 'cTfA'
+#define TAG_AFD_TDI_SET_INFORMATION        'sTfA'
 #define TAG_AFD_WSA_BUFFER                 'bWfA'
+#define TAG_AFD_TRANSMIT_ELEMENTS          'eTfA'
+#define TAG_AFD_TRANSMIT_BUFFER            'bTfA'
 
 typedef struct IPADDR_ENTRY {
 	ULONG  Addr;
@@ -92,6 +95,13 @@ typedef struct IPADDR_ENTRY {
 
 #define IN_FLIGHT_REQUESTS              5
 
+/* Upper bound for the staging windows of stream sockets when SO_RCVBUF/SO_SNDBUF
+ * is set; the size itself goes to the transport. Larger windows here trip CORE-15804. */
+#define AFD_MAX_STAGING_WINDOW          0x2000
+
+/* Size of each TDI send issued for TransmitFile when the caller leaves it to us */
+#define AFD_TRANSMIT_SEND_SIZE          0x10000
+
 #define EXTRA_LOCK_BUFFERS              2 /* Number of extra buffers needed
 					   * for ancillary data on packet
 					   * requests. */
@@ -107,12 +117,40 @@ typedef struct _AFD_MAPBUF {
     PMDL  Mdl;
 } AFD_MAPBUF, *PAFD_MAPBUF;
 
+typedef struct _AFD_TRANSMIT_MAP {
+    PFILE_OBJECT FileObject; /* Referenced, for file elements */
+    PMDL Mdl; /* Locked, for memory elements */
+} AFD_TRANSMIT_MAP, *PAFD_TRANSMIT_MAP;
+
+typedef struct _AFD_TRANSMIT_STATE {
+    UINT Element; /* Next element to start on */
+    PFILE_OBJECT FileObject; /* File element being read, if any */
+    LARGE_INTEGER FileOffset;
+    ULONG FileRemaining;
+    BOOLEAN FileToEnd; /* Element length was 0, send up to the end of the file */
+    BOOLEAN FileEnd; /* Nothing more to read from the file */
+    PMDL MdlChain; /* Last cache read, handed back once it has been sent */
+    PMDL Mdl; /* Part of MdlChain being sent */
+    PCHAR Buffer; /* For files that can't be read through the cache */
+    PCHAR Data; /* What is left to send of the current piece */
+    UINT DataLength;
+    UINT BytesSent;
+    BOOLEAN Sending; /* Inside TdiSend */
+    NTSTATUS SendStatus; /* Of a send that completed inside TdiSend */
+} AFD_TRANSMIT_STATE, *PAFD_TRANSMIT_STATE;
+
 typedef struct _AFD_DEVICE_EXTENSION {
     PDEVICE_OBJECT DeviceObject;
     LIST_ENTRY Polls;
     KSPIN_LOCK Lock;
 } AFD_DEVICE_EXTENSION, *PAFD_DEVICE_EXTENSION;
 
+typedef struct _AFD_POLL_WAITER {
+    LIST_ENTRY ListEntry; /* In the FCB's PollWaiters */
+    struct _AFD_ACTIVE_POLL *Poll;
+    UINT Index; /* Of the socket in the poll's handle array */
+} AFD_POLL_WAITER, *PAFD_POLL_WAITER;
+
 typedef struct _AFD_ACTIVE_POLL {
     LIST_ENTRY ListEntry;
     PIRP Irp;
@@ -121,6 +159,8 @@ typedef struct _AFD_ACTIVE_POLL {
     KTIMER Timer;
     PKEVENT EventObject;
     BOOLEAN Exclusive;
+    UINT WaiterCount;
+    AFD_POLL_WAITER Waiters[ANYSIZE_ARRAY];
 } AFD_ACTIVE_POLL, *PAFD_ACTIVE_POLL;
 
 typedef struct _IRP_LIST {
@@ -176,6 +216,13 @@ typedef struct _AFD_FCB {
     AFD_TDI_OBJECT AddressFile, Connection;
     AFD_IN_FLIGHT_REQUEST ConnectIrp, ListenIrp, ReceiveIrp, SendIrp, DisconnectIrp;
     AFD_DATA_WINDOW Send, Recv;
+    ULONG TransportSendSize, TransportRecvSize; /* SO_SNDBUF/SO_RCVBUF for the transport, 0 if unset */
+    PIRP DirectRecvIrp; /* Read whose buffer the in flight TDI receive fills, if any */
+    BOOLEAN RecvRetarget; /* In flight TDI receive was cancelled to receive into a read */
+    PIRP TransmitIrp; /* TransmitFile being sent, if any */
+    UINT TransmitCount; /* TransmitFile requests on the send queue */
+    PIO_WORKITEM TransmitWorkItem;
+    AFD_TRANSMIT_STATE TransmitState; /* Progress of TransmitIrp */
     KMUTEX Mutex;
     PKEVENT EventSelect;
     DWORD EventSelectTriggers;
@@ -184,6 +231,7 @@ typedef struct _AFD_FCB {
     PVOID Context;
     DWORD PollState;
     NTSTATUS PollStatus[FD_MAX_EVENTS];
+    LIST_ENTRY PollWaiters; /* Polls including this socket, under DeviceExt->Lock */
     NTSTATUS LastReceiveStatus;
     UINT ContextSize;
     PVOID ConnectData;
@@ -266,6 +314,9 @@ NTSTATUS NTAPI
 AfdGetPeerName( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 PIO_STACK_LOCATION IrpSp );
 
+NTSTATUS
+AfdSetTransportBufferSize(PAFD_FCB FCB, ULONG Id, ULONG Size);
+
 /* listen.c */
 NTSTATUS AfdWaitForListen( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 			   PIO_STACK_LOCATION IrpSp );
@@ -304,6 +355,7 @@ VOID DestroySocket( PAFD_FCB FCB );
 DRIVER_CANCEL AfdCancelHandler;
 VOID RetryDisconnectCompletion(PAFD_FCB FCB);
 BOOLEAN CheckUnlockExtraBuffers(PAFD_FCB FCB, PIO_STACK_LOCATION IrpSp);
+VOID CleanupPendingIrp(PAFD_FCB FCB, PIRP Irp, PIO_STACK_LOCATION IrpSp, PAFD_ACTIVE_POLL Poll);
 
 /* read.c */
 
@@ -402,6 +454,14 @@ NTSTATUS TdiQueryMaxDatagramLength(
         PFILE_OBJECT FileObject,
         PUINT MaxDatagramLength);
 
+/* transmit.c */
+
+NTSTATUS NTAPI
+AfdTransmitFile(PDEVICE_OBJECT DeviceObject, PIRP Irp,
+                PIO_STACK_LOCATION IrpSp);
+VOID StartTransmit(PAFD_FCB FCB, PIRP Irp);
+VOID UnlockTransmitElements(PAFD_TRANSMIT_ELEMENT Elements, UINT Count);
+
 /* write.c */
 
 NTSTATUS NTAPI
@@ -410,5 +470,6 @@ AfdConnectedSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
 NTSTATUS NTAPI
 AfdPacketSocketWriteData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
 			 PIO_STACK_LOCATION IrpSp);
+VOID ResumeSendQueue(PAFD_FCB FCB, BOOLEAN HaltSendQueue);
 
 #endif /* _AFD_H */
@@ -130,6 +130,9 @@ const char* Oid2Str(IN NDIS_OID Oid)
         RETURN_X(OID_802_11_WEP_STATUS);
         RETURN_X(OID_802_11_RELOAD_DEFAULTS);
 
+        /* TCP/IP offload OIDs */
+        RETURN_X(OID_TCP_TASK_OFFLOAD);
+
         /* OID_GEN_MINIPORT_INFO constants */
         RETURN_X(NDIS_MINIPORT_BUS_MASTER);
         RETURN_X(NDIS_MINIPORT_WDM_DRIVER);
@@ -33,6 +33,12 @@ typedef struct _ETH_HEADER {
 
 C_ASSERT(sizeof(ETH_HEADER) == 14);
 
+#define ETH_TYPE_IPV4       0x0800
+
+/* IPv4 protocols the transmit offloads care about */
+#define IPV4_PROTOCOL_TCP   6
+#define IPV4_PROTOCOL_UDP   17
+
 
 typedef enum _E1000_RCVBUF_SIZE
 {
@@ -57,10 +63,15 @@ typedef enum _E1000_RCVBUF_SIZE
 /* 3.2.3 Receive Descriptor Format */
 
 #define E1000_RDESC_STATUS_PIF          (1 << 7)    /* Passed in-exact filter */
+#define E1000_RDESC_STATUS_IPCS         (1 << 6)    /* IP Checksum Calculated on Packet */
+#define E1000_RDESC_STATUS_TCPCS        (1 << 5)    /* TCP/UDP Checksum Calculated on Packet */
 #define E1000_RDESC_STATUS_IXSM         (1 << 2)    /* Ignore Checksum Indication */
 #define E1000_RDESC_STATUS_EOP          (1 << 1)    /* End of Packet */
 #define E1000_RDESC_STATUS_DD           (1 << 0)    /* Descriptor Done */
 
+#define E1000_RDESC_ERR_IPE             (1 << 6)    /* IP Checksum Error */
+#define E1000_RDESC_ERR_TCPE            (1 << 5)    /* TCP/UDP Checksum Error */
+
 typedef struct _E1000_RECEIVE_DESCRIPTOR
 {
     UINT64 Address;
@@ -96,17 +107,82 @@ typedef struct _E1000_TRANSMIT_DESCRIPTOR
 
 } E1000_TRANSMIT_DESCRIPTOR, *PE1000_TRANSMIT_DESCRIPTOR;
 
+
+/* 3.3.6 TCP/IP Context Transmit Descriptor Format */
+
+#define E1000_TDESC_DTYP_CONTEXT        0x0         /* Context Descriptor */
+#define E1000_TDESC_DTYP_DATA           0x1         /* Data Descriptor */
+
+#define E1000_TCTX_CMD_IDE              (1 << 7)    /* Interrupt Delay Enable */
+#define E1000_TCTX_CMD_DEXT             (1 << 5)    /* Descriptor Extension */
+#define E1000_TCTX_CMD_RS               (1 << 3)    /* Report Status */
+#define E1000_TCTX_CMD_TSE              (1 << 2)    /* TCP Segmentation Enable */
+#define E1000_TCTX_CMD_IP               (1 << 1)    /* Packet Type is IPv4 */
+#define E1000_TCTX_CMD_TCP              (1 << 0)    /* Packet Type is TCP */
+
+typedef struct _E1000_CONTEXT_DESCRIPTOR
+{
+    UCHAR IpChecksumStart;
+    UCHAR IpChecksumOffset;
+    USHORT IpChecksumEnd;
+    UCHAR TcpChecksumStart;
+    UCHAR TcpChecksumOffset;
+    USHORT TcpChecksumEnd;
+
+    ULONG PayloadLength : 20;
+    ULONG DescriptorType : 4;
+    ULONG Command : 8;
+    UCHAR Status;
+    UCHAR HeaderLength;
+    USHORT MaximumSegmentSize;
+
+} E1000_CONTEXT_DESCRIPTOR, *PE1000_CONTEXT_DESCRIPTOR;
+
+
+/* 3.3.7 TCP/IP Data Transmit Descriptor Format */
+
+#define E1000_TDATA_CMD_IDE             (1 << 7)    /* Interrupt Delay Enable */
+#define E1000_TDATA_CMD_DEXT            (1 << 5)    /* Descriptor Extension */
+#define E1000_TDATA_CMD_RS              (1 << 3)    /* Report Status */
+#define E1000_TDATA_CMD_TSE             (1 << 2)    /* TCP Segmentation Enable */
+#define E1000_TDATA_CMD_IFCS            (1 << 1)    /* Insert FCS */
+#define E1000_TDATA_CMD_EOP             (1 << 0)    /* End Of Packet */
+
+#define E1000_TDATA_POPTS_TXSM          (1 << 1)    /* Insert TCP/UDP Checksum */
+#define E1000_TDATA_POPTS_IXSM          (1 << 0)    /* Insert IP Checksum */
+
+/* Stay well below the 16288 byte limit of a single data descriptor */
+#define E1000_TDATA_MAX_LENGTH          4096
+
+typedef struct _E1000_DATA_DESCRIPTOR
+{
+    UINT64 Address;
+
+    ULONG Length : 20;
+    ULONG DescriptorType : 4;
+    ULONG Command : 8;
+    UCHAR Status;
+    UCHAR Options;
+    USHORT Special;
+
+} E1000_DATA_DESCRIPTOR, *PE1000_DATA_DESCRIPTOR;
+
 #include <poppack.h>
 
 
 C_ASSERT(sizeof(E1000_RECEIVE_DESCRIPTOR) == 16);
 C_ASSERT(sizeof(E1000_TRANSMIT_DESCRIPTOR) == 16);
+C_ASSERT(sizeof(E1000_CONTEXT_DESCRIPTOR) == 16);
+C_ASSERT(sizeof(E1000_DATA_DESCRIPTOR) == 16);
 
 
 /* Valid Range: 80-256 for 82542 and 82543 gigabit ethernet controllers
-   Valid Range: 80-4096 for 82544 and newer */
-#define NUM_TRANSMIT_DESCRIPTORS        128
-#define NUM_RECEIVE_DESCRIPTORS         128
+   Valid Range: 80-4096 for 82544 and newer
+   The ring length must be a multiple of 128 bytes, so a multiple of 8 descriptors */
+#define MIN_DESCRIPTORS                 80
+#define MAX_DESCRIPTORS_82543           256
+#define MAX_DESCRIPTORS                 4096
+#define DESCRIPTOR_COUNT_ALIGNMENT      8
 
 
 
@@ -143,6 +219,7 @@ C_ASSERT(sizeof(E1000_TRANSMIT_DESCRIPTOR) == 16);
 #define E1000_REG_TADV              0x382C      /* Transmit Absolute Delay Timer, R/W */
 
 
+#define E1000_REG_RXCSUM            0x5000      /* Receive Checksum Control, R/W */
 #define E1000_REG_RAL               0x5400      /* Receive Address Low, R/W */
 #define E1000_REG_RAH               0x5404      /* Receive Address High, R/W */
 
@@ -188,9 +265,8 @@ C_ASSERT(sizeof(E1000_TRANSMIT_DESCRIPTOR) == 16);
 #define E1000_IMS_SRPD              (1 << 16)   /* Small Receive Packet Detection */
 
 
-/* E1000_REG_ITR */
-#define MAX_INTS_PER_SEC        2000
-#define DEFAULT_ITR             1000000000/(MAX_INTS_PER_SEC * 256)
+/* E1000_REG_ITR, the minimum interval between interrupts in units of 256 ns */
+#define E1000_ITR_INTERVAL(IntsPerSec)  (1000000000 / ((IntsPerSec) * 256))
 
 
 /* E1000_REG_RCTL */
@@ -217,6 +293,11 @@ C_ASSERT(sizeof(E1000_TRANSMIT_DESCRIPTOR) == 16);
 #define E1000_TIPG_IPGR2_DEF        (10 << 20)  /* IPG Receive Time 2 */
 
 
+/* E1000_REG_RXCSUM */
+#define E1000_RXCSUM_IPOFL          (1 << 8)    /* IP Checksum Offload Enable */
+#define E1000_RXCSUM_TUOFL          (1 << 9)    /* TCP/UDP Checksum Offload Enable */
+
+
 /* E1000_REG_RAH */
 #define E1000_RAH_AV                (1 << 31)   /* Address Valid */
 
@@ -258,6 +258,39 @@ NICRecognizeHardware(
     {
         if (SupportedDevices[n] == Adapter->DeviceID)
         {
+            /* The 82542 and 82543 have small rings, the 82544 and older can't throttle interrupts */
+            switch (Adapter->DeviceID)
+            {
+            case 0x1000: case 0x1001: case 0x1004:
+                Adapter->MaximumDescriptors = MAX_DESCRIPTORS_82543;
+                Adapter->InterruptThrottling = FALSE;
+                break;
+            case 0x1008: case 0x1009: case 0x100C: case 0x100D:
+                Adapter->MaximumDescriptors = MAX_DESCRIPTORS;
+                Adapter->InterruptThrottling = FALSE;
+                break;
+            default:
+                Adapter->MaximumDescriptors = MAX_DESCRIPTORS;
+                Adapter->InterruptThrottling = TRUE;
+                break;
+            }
+
+            /* The 82542 has no offloads at all, the 82543 can't segment yet */
+            if (Adapter->DeviceID == 0x1000)
+            {
+                Adapter->OffloadCapabilities = 0;
+            }
+            else
+            {
+                Adapter->OffloadCapabilities = E1000_OFFLOAD_TX_IP_CHECKSUM |
+                                               E1000_OFFLOAD_TX_TCP_CHECKSUM |
+                                               E1000_OFFLOAD_TX_UDP_CHECKSUM |
+                                               E1000_OFFLOAD_RX_CHECKSUM;
+
+                if (Adapter->DeviceID != 0x1001 && Adapter->DeviceID != 0x1004)
+                    Adapter->OffloadCapabilities |= E1000_OFFLOAD_LARGE_SEND;
+            }
+
             return TRUE;
         }
     }
@@ -362,8 +395,39 @@ NICAllocateIoResources(
                              Adapter->IoLength);
 
 
+    /* Bookkeeping for the rings */
+    Status = NdisAllocateMemoryWithTag((PVOID*)&Adapter->TransmitPackets,
+                                       sizeof(PNDIS_PACKET) * Adapter->NumTransmitDescriptors,
+                                       E1000_TAG);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate transmit packet array\n"));
+        return NDIS_STATUS_RESOURCES;
+    }
+    RtlZeroMemory(Adapter->TransmitPackets, sizeof(PNDIS_PACKET) * Adapter->NumTransmitDescriptors);
+
+    Status = NdisAllocateMemoryWithTag((PVOID*)&Adapter->ReceivePackets,
+                                       sizeof(PNDIS_PACKET) * Adapter->NumReceiveDescriptors,
+                                       E1000_TAG);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet array\n"));
+        return NDIS_STATUS_RESOURCES;
+    }
+    RtlZeroMemory(Adapter->ReceivePackets, sizeof(PNDIS_PACKET) * Adapter->NumReceiveDescriptors);
+
+    Status = NdisAllocateMemoryWithTag((PVOID*)&Adapter->ReceivePacketHeld,
+                                       sizeof(BOOLEAN) * Adapter->NumReceiveDescriptors,
+                                       E1000_TAG);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet state\n"));
+        return NDIS_STATUS_RESOURCES;
+    }
+    RtlZeroMemory(Adapter->ReceivePacketHeld, sizeof(BOOLEAN) * Adapter->NumReceiveDescriptors);
+
     NdisMAllocateSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * NUM_TRANSMIT_DESCRIPTORS,
+                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * Adapter->NumTransmitDescriptors,
                               FALSE,
                               (PVOID*)&Adapter->TransmitDescriptors,
                               &Adapter->TransmitDescriptorsPa);
@@ -373,7 +437,7 @@ NICAllocateIoResources(
         return NDIS_STATUS_RESOURCES;
     }
 
-    for (n = 0; n < NUM_TRANSMIT_DESCRIPTORS; ++n)
+    for (n = 0; n < Adapter->NumTransmitDescriptors; ++n)
     {
         PE1000_TRANSMIT_DESCRIPTOR Descriptor = Adapter->TransmitDescriptors + n;
         Descriptor->Address = 0;
@@ -381,7 +445,7 @@ NICAllocateIoResources(
     }
 
     NdisMAllocateSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_RECEIVE_DESCRIPTOR) * NUM_RECEIVE_DESCRIPTORS,
+                              sizeof(E1000_RECEIVE_DESCRIPTOR) * Adapter->NumReceiveDescriptors,
                               FALSE,
                               (PVOID*)&Adapter->ReceiveDescriptors,
                               &Adapter->ReceiveDescriptorsPa);
@@ -396,7 +460,7 @@ NICAllocateIoResources(
     Adapter->ReceiveBufferEntrySize = AllocationSize;
 
     NdisMAllocateSharedMemory(Adapter->AdapterHandle,
-                              Adapter->ReceiveBufferEntrySize * NUM_RECEIVE_DESCRIPTORS,
+                              Adapter->ReceiveBufferEntrySize * Adapter->NumReceiveDescriptors,
                               FALSE,
                               (PVOID*)&Adapter->ReceiveBuffer,
                               &Adapter->ReceiveBufferPa);
@@ -407,7 +471,7 @@ NICAllocateIoResources(
         return NDIS_STATUS_RESOURCES;
     }
 
-    for (n = 0; n < NUM_RECEIVE_DESCRIPTORS; ++n)
+    for (n = 0; n < Adapter->NumReceiveDescriptors; ++n)
     {
         PE1000_RECEIVE_DESCRIPTOR Descriptor = Adapter->ReceiveDescriptors + n;
 
@@ -415,6 +479,57 @@ NICAllocateIoResources(
         Descriptor->Address = Adapter->ReceiveBufferPa.QuadPart + n * Adapter->ReceiveBufferEntrySize;
     }
 
+    /* Every receive buffer gets its own packet, so it can be indicated without copying */
+    NdisAllocatePacketPool(&Status,
+                           &Adapter->ReceivePacketPool,
+                           Adapter->NumReceiveDescriptors,
+                           PROTOCOL_RESERVED_SIZE_IN_PACKET);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet pool (0x%x)\n", Status));
+        return NDIS_STATUS_RESOURCES;
+    }
+
+    NdisAllocateBufferPool(&Status,
+                           &Adapter->ReceiveBufferPool,
+                           Adapter->NumReceiveDescriptors);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive buffer pool (0x%x)\n", Status));
+        return NDIS_STATUS_RESOURCES;
+    }
+
+    for (n = 0; n < Adapter->NumReceiveDescriptors; ++n)
+    {
+        PNDIS_PACKET Packet;
+        PNDIS_BUFFER Buffer;
+
+        NdisAllocatePacket(&Status, &Packet, Adapter->ReceivePacketPool);
+        if (Status != NDIS_STATUS_SUCCESS)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive packet (0x%x)\n", Status));
+            return NDIS_STATUS_RESOURCES;
+        }
+
+        NdisAllocateBuffer(&Status,
+                           &Buffer,
+                           Adapter->ReceiveBufferPool,
+                           (PVOID)(Adapter->ReceiveBuffer + n * Adapter->ReceiveBufferEntrySize),
+                           Adapter->ReceiveBufferEntrySize);
+        if (Status != NDIS_STATUS_SUCCESS)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Unable to allocate receive buffer (0x%x)\n", Status));
+            NdisFreePacket(Packet);
+            return NDIS_STATUS_RESOURCES;
+        }
+
+        NdisChainBufferAtFront(Packet, Buffer);
+        NDIS_SET_PACKET_HEADER_SIZE(Packet, sizeof(ETH_HEADER));
+        RECEIVE_PACKET_INDEX(Packet) = n;
+
+        Adapter->ReceivePackets[n] = Packet;
+    }
+
     return NDIS_STATUS_SUCCESS;
 }
 
@@ -464,8 +579,37 @@ NTAPI
 NICReleaseIoResources(
     IN PE1000_ADAPTER Adapter)
 {
+    UINT n;
+
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
+    for (n = 0; Adapter->ReceivePackets != NULL && n < Adapter->NumReceiveDescriptors; ++n)
+    {
+        PNDIS_BUFFER Buffer;
+
+        if (Adapter->ReceivePackets[n] == NULL)
+            continue;
+
+        NdisUnchainBufferAtFront(Adapter->ReceivePackets[n], &Buffer);
+        if (Buffer != NULL)
+            NdisFreeBuffer(Buffer);
+
+        NdisFreePacket(Adapter->ReceivePackets[n]);
+        Adapter->ReceivePackets[n] = NULL;
+    }
+
+    if (Adapter->ReceiveBufferPool != NULL)
+    {
+        NdisFreeBufferPool(Adapter->ReceiveBufferPool);
+        Adapter->ReceiveBufferPool = NULL;
+    }
+
+    if (Adapter->ReceivePacketPool != NULL)
+    {
+        NdisFreePacketPool(Adapter->ReceivePacketPool);
+        Adapter->ReceivePacketPool = NULL;
+    }
+
     if (Adapter->ReceiveDescriptors != NULL)
     {
         /* Disassociate our shared buffer before freeing it to avoid NIC-induced memory corruption */
@@ -476,7 +620,7 @@ NICReleaseIoResources(
         }
 
         NdisMFreeSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_RECEIVE_DESCRIPTOR) * NUM_RECEIVE_DESCRIPTORS,
+                              sizeof(E1000_RECEIVE_DESCRIPTOR) * Adapter->NumReceiveDescriptors,
                               FALSE,
                               Adapter->ReceiveDescriptors,
                               Adapter->ReceiveDescriptorsPa);
@@ -487,7 +631,7 @@ NICReleaseIoResources(
     if (Adapter->ReceiveBuffer != NULL)
     {
         NdisMFreeSharedMemory(Adapter->AdapterHandle,
-                              Adapter->ReceiveBufferEntrySize * NUM_RECEIVE_DESCRIPTORS,
+                              Adapter->ReceiveBufferEntrySize * Adapter->NumReceiveDescriptors,
                               FALSE,
                               Adapter->ReceiveBuffer,
                               Adapter->ReceiveBufferPa);
@@ -507,7 +651,7 @@ NICReleaseIoResources(
         }
 
         NdisMFreeSharedMemory(Adapter->AdapterHandle,
-                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * NUM_TRANSMIT_DESCRIPTORS,
+                              sizeof(E1000_TRANSMIT_DESCRIPTOR) * Adapter->NumTransmitDescriptors,
                               FALSE,
                               Adapter->TransmitDescriptors,
                               Adapter->TransmitDescriptorsPa);
@@ -515,6 +659,24 @@ NICReleaseIoResources(
         Adapter->TransmitDescriptors = NULL;
     }
 
+    if (Adapter->ReceivePacketHeld != NULL)
+    {
+        NdisFreeMemory(Adapter->ReceivePacketHeld, sizeof(BOOLEAN) * Adapter->NumReceiveDescriptors, 0);
+        Adapter->ReceivePacketHeld = NULL;
+    }
+
+    if (Adapter->ReceivePackets != NULL)
+    {
+        NdisFreeMemory(Adapter->ReceivePackets, sizeof(PNDIS_PACKET) * Adapter->NumReceiveDescriptors, 0);
+        Adapter->ReceivePackets = NULL;
+    }
+
+    if (Adapter->TransmitPackets != NULL)
+    {
+        NdisFreeMemory(Adapter->TransmitPackets, sizeof(PNDIS_PACKET) * Adapter->NumTransmitDescriptors, 0);
+        Adapter->TransmitPackets = NULL;
+    }
+
 
 
     if (Adapter->IoPort)
@@ -600,6 +762,23 @@ NICSoftReset(
     return NDIS_STATUS_FAILURE;
 }
 
+static
+VOID
+NICSetInterruptRate(
+    IN PE1000_ADAPTER Adapter,
+    IN ULONG InterruptsPerSecond)
+{
+    if (!Adapter->InterruptThrottling || InterruptsPerSecond == Adapter->CurrentInterruptRate)
+        return;
+
+    NDIS_DbgPrint(MID_TRACE, ("Interrupt rate %u -> %u\n", Adapter->CurrentInterruptRate, InterruptsPerSecond));
+
+    Adapter->CurrentInterruptRate = InterruptsPerSecond;
+    E1000WriteUlong(Adapter,
+                    E1000_REG_ITR,
+                    InterruptsPerSecond ? E1000_ITR_INTERVAL(InterruptsPerSecond) : 0);
+}
+
 NDIS_STATUS
 NTAPI
 NICEnableTxRx(
@@ -618,12 +797,16 @@ NICEnableTxRx(
     E1000WriteUlong(Adapter, E1000_REG_TDBAL, Adapter->TransmitDescriptorsPa.LowPart);
 
     /* Transmit descriptor buffer size */
-    E1000WriteUlong(Adapter, E1000_REG_TDLEN, sizeof(E1000_TRANSMIT_DESCRIPTOR) * NUM_TRANSMIT_DESCRIPTORS);
+    E1000WriteUlong(Adapter, E1000_REG_TDLEN, sizeof(E1000_TRANSMIT_DESCRIPTOR) * Adapter->NumTransmitDescriptors);
 
     /* Transmit descriptor tail / head */
     E1000WriteUlong(Adapter, E1000_REG_TDH, 0);
     E1000WriteUlong(Adapter, E1000_REG_TDT, 0);
     Adapter->CurrentTxDesc = 0;
+    Adapter->LastTxDesc = 0;
+
+    /* The NIC forgot any context it had */
+    Adapter->TxContextValid = FALSE;
 
     /* Set up interrupt timers */
     E1000WriteUlong(Adapter, E1000_REG_TADV, 96); // value is in 1.024 of usec
@@ -643,16 +826,31 @@ NICEnableTxRx(
     E1000WriteUlong(Adapter, E1000_REG_RDBAL, Adapter->ReceiveDescriptorsPa.LowPart);
 
     /* Receive descriptor buffer size */
-    E1000WriteUlong(Adapter, E1000_REG_RDLEN, sizeof(E1000_RECEIVE_DESCRIPTOR) * NUM_RECEIVE_DESCRIPTORS);
+    E1000WriteUlong(Adapter, E1000_REG_RDLEN, sizeof(E1000_RECEIVE_DESCRIPTOR) * Adapter->NumReceiveDescriptors);
 
     /* Receive descriptor tail / head */
     E1000WriteUlong(Adapter, E1000_REG_RDH, 0);
-    E1000WriteUlong(Adapter, E1000_REG_RDT, NUM_RECEIVE_DESCRIPTORS - 1);
+    E1000WriteUlong(Adapter, E1000_REG_RDT, Adapter->NumReceiveDescriptors - 1);
+    Adapter->CurrentRxDesc = 0;
+    Adapter->ReceiveTail = Adapter->NumReceiveDescriptors - 1;
+    RtlZeroMemory(Adapter->ReceivePacketHeld, sizeof(BOOLEAN) * Adapter->NumReceiveDescriptors);
+    Adapter->ReceivePacketsHeld = 0;
+
+    /* Receive checksum offload */
+    NICApplyOffload(Adapter);
 
     /* Set up interrupt timers */
     E1000WriteUlong(Adapter, E1000_REG_RADV, 96);
     E1000WriteUlong(Adapter, E1000_REG_RDTR, 16);
 
+    /* Start out with low latency, the DPC adapts it to the traffic */
+    Adapter->CurrentInterruptRate = 0;
+    Adapter->SamplePackets = 0;
+    NdisGetSystemUpTime(&Adapter->SampleStart);
+    NICSetInterruptRate(Adapter,
+                        Adapter->InterruptThrottleRate == ITR_ADAPTIVE ?
+                        ITR_LOW_LATENCY_RATE : Adapter->InterruptThrottleRate);
+
     /* Some defaults */
     Value = E1000_RCTL_SECRC | E1000_RCTL_EN;
 
@@ -820,35 +1018,178 @@ NICUpdateLinkStatus(
     Adapter->LinkSpeedMbps = SpeedValues[SpeedIndex];
 }
 
+ULONG
+NTAPI
+NICFreeTransmitDescriptors(
+    IN PE1000_ADAPTER Adapter)
+{
+    /* One descriptor always stays unused, a completely filled ring would look empty to the NIC */
+    return (Adapter->LastTxDesc + Adapter->NumTransmitDescriptors - Adapter->CurrentTxDesc - 1) % Adapter->NumTransmitDescriptors;
+}
+
 NDIS_STATUS
 NTAPI
 NICTransmitPacket(
     IN PE1000_ADAPTER Adapter,
-    IN PHYSICAL_ADDRESS PhysicalAddress,
-    IN ULONG Length)
+    IN PNDIS_PACKET Packet,
+    IN PSCATTER_GATHER_LIST SgList,
+    IN PE1000_CONTEXT_DESCRIPTOR Context OPTIONAL,
+    IN UCHAR Command,
+    IN UCHAR Options)
 {
-    volatile PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptor;
+    volatile PE1000_CONTEXT_DESCRIPTOR ContextDescriptor;
+    volatile PE1000_DATA_DESCRIPTOR DataDescriptor = NULL;
+    ULONG DescriptorsNeeded;
+    ULONG Element, Offset, Length;
+    ULONG LastDesc = 0;
 
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
-    TransmitDescriptor = Adapter->TransmitDescriptors + Adapter->CurrentTxDesc;
-    TransmitDescriptor->Address = PhysicalAddress.QuadPart;
-    TransmitDescriptor->Length = Length;
-    TransmitDescriptor->ChecksumOffset = 0;
-    TransmitDescriptor->Command = E1000_TDESC_CMD_RS | E1000_TDESC_CMD_IFCS | E1000_TDESC_CMD_EOP | E1000_TDESC_CMD_IDE;
-    TransmitDescriptor->Status = 0;
-    TransmitDescriptor->ChecksumStartField = 0;
-    TransmitDescriptor->Special = 0;
+    if (Context)
+    {
+        Context->DescriptorType = E1000_TDESC_DTYP_CONTEXT;
+        Context->Command |= E1000_TCTX_CMD_DEXT;
+        Context->Status = 0;
 
-    Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
+        /* The NIC keeps the last context, so only load a different one */
+        if (Adapter->TxContextValid &&
+            RtlEqualMemory(Context, &Adapter->TxContext, sizeof(*Context)))
+        {
+            Context = NULL;
+        }
+    }
 
-    E1000WriteUlong(Adapter, E1000_REG_TDT, Adapter->CurrentTxDesc);
+    DescriptorsNeeded = Context ? 1 : 0;
+    for (Element = 0; Element < SgList->NumberOfElements; Element++)
+    {
+        DescriptorsNeeded += (SgList->Elements[Element].Length + E1000_TDATA_MAX_LENGTH - 1) / E1000_TDATA_MAX_LENGTH;
+    }
+
+    if (DescriptorsNeeded == 0 || DescriptorsNeeded > NICFreeTransmitDescriptors(Adapter))
+    {
+        NDIS_DbgPrint(MID_TRACE, ("Not enough TX descriptors (%u needed)\n", DescriptorsNeeded));
+        return NDIS_STATUS_RESOURCES;
+    }
+
+    if (Context)
+    {
+        ContextDescriptor = (PE1000_CONTEXT_DESCRIPTOR)(Adapter->TransmitDescriptors + Adapter->CurrentTxDesc);
+        RtlCopyMemory(ContextDescriptor, Context, sizeof(*Context));
+
+        Adapter->TxContext = *Context;
+        Adapter->TxContextValid = TRUE;
+
+        Adapter->TransmitPackets[Adapter->CurrentTxDesc] = NULL;
+        Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % Adapter->NumTransmitDescriptors;
+    }
 
-    if (Adapter->CurrentTxDesc == Adapter->LastTxDesc)
+    for (Element = 0; Element < SgList->NumberOfElements; Element++)
     {
-        NDIS_DbgPrint(MID_TRACE, ("All TX descriptors are full now\n"));
-        Adapter->TxFull = TRUE;
+        for (Offset = 0; Offset < SgList->Elements[Element].Length; Offset += Length)
+        {
+            Length = min(SgList->Elements[Element].Length - Offset, E1000_TDATA_MAX_LENGTH);
+
+            DataDescriptor = (PE1000_DATA_DESCRIPTOR)(Adapter->TransmitDescriptors + Adapter->CurrentTxDesc);
+            DataDescriptor->Address = SgList->Elements[Element].Address.QuadPart + Offset;
+            DataDescriptor->Length = Length;
+            DataDescriptor->DescriptorType = E1000_TDESC_DTYP_DATA;
+            DataDescriptor->Command = Command | E1000_TDATA_CMD_DEXT |
+                                      E1000_TDATA_CMD_IFCS | E1000_TDATA_CMD_IDE;
+            DataDescriptor->Status = 0;
+            DataDescriptor->Options = Options;
+            DataDescriptor->Special = 0;
+
+            LastDesc = Adapter->CurrentTxDesc;
+            Adapter->TransmitPackets[Adapter->CurrentTxDesc] = NULL;
+            Adapter->CurrentTxDesc = (Adapter->CurrentTxDesc + 1) % Adapter->NumTransmitDescriptors;
+        }
     }
 
+    /* The packet is completed once its last descriptor is done, which is the only one reporting status */
+    DataDescriptor->Command |= E1000_TDATA_CMD_EOP | E1000_TDATA_CMD_RS;
+    Adapter->TransmitPackets[LastDesc] = Packet;
+
+    E1000WriteUlong(Adapter, E1000_REG_TDT, Adapter->CurrentTxDesc);
+
     return NDIS_STATUS_SUCCESS;
 }
+
+NDIS_STATUS
+NTAPI
+NICApplyOffload(
+    IN PE1000_ADAPTER Adapter)
+{
+    ULONG Value;
+
+    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
+
+    /* The 82542 doesn't have this register */
+    if (!(Adapter->OffloadCapabilities & E1000_OFFLOAD_RX_CHECKSUM))
+        return NDIS_STATUS_SUCCESS;
+
+    E1000ReadUlong(Adapter, E1000_REG_RXCSUM, &Value);
+    Value &= ~(E1000_RXCSUM_IPOFL | E1000_RXCSUM_TUOFL);
+
+    if (Adapter->OffloadFlags & E1000_OFFLOAD_RX_IP_CHECKSUM)
+        Value |= E1000_RXCSUM_IPOFL;
+    if (Adapter->OffloadFlags & (E1000_OFFLOAD_RX_TCP_CHECKSUM | E1000_OFFLOAD_RX_UDP_CHECKSUM))
+        Value |= E1000_RXCSUM_TUOFL;
+
+    E1000WriteUlong(Adapter, E1000_REG_RXCSUM, Value);
+
+    return NDIS_STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+NICUpdateInterruptThrottling(
+    IN PE1000_ADAPTER Adapter,
+    IN ULONG Packets)
+{
+    ULONG Now, Elapsed, PacketRate;
+
+    if (Adapter->InterruptThrottleRate != ITR_ADAPTIVE)
+        return;
+
+    Adapter->SamplePackets += Packets;
+
+    NdisGetSystemUpTime(&Now);
+    Elapsed = Now - Adapter->SampleStart;
+    if (Elapsed < ITR_SAMPLE_INTERVAL)
+        return;
+
+    PacketRate = (ULONG)((ULONGLONG)Adapter->SamplePackets * 1000 / Elapsed);
+    Adapter->SamplePackets = 0;
+    Adapter->SampleStart = Now;
+
+    /* Light traffic gets its interrupts right away, bulk traffic is coalesced */
+    if (PacketRate >= ITR_HEAVY_TRAFFIC)
+        NICSetInterruptRate(Adapter, ITR_BULK_RATE);
+    else if (PacketRate >= ITR_LIGHT_TRAFFIC)
+        NICSetInterruptRate(Adapter, ITR_MODERATE_RATE);
+    else
+        NICSetInterruptRate(Adapter, ITR_LOW_LATENCY_RATE);
+}
+
+VOID
+NTAPI
+NICReturnReceiveDescriptors(
+    IN PE1000_ADAPTER Adapter)
+{
+    ULONG OldTail = Adapter->ReceiveTail;
+
+    /* Called with the receive lock held.
+     * The NIC fills descriptors in order, so stop at the first one a protocol still holds.
+     * The tail itself always stays ours, or the NIC would take a full ring for an empty one. */
+    while ((Adapter->ReceiveTail + 1) % Adapter->NumReceiveDescriptors != Adapter->CurrentRxDesc &&
+           !Adapter->ReceivePacketHeld[Adapter->ReceiveTail])
+    {
+        Adapter->ReceiveDescriptors[Adapter->ReceiveTail].Status = 0;
+        Adapter->ReceiveTail = (Adapter->ReceiveTail + 1) % Adapter->NumReceiveDescriptors;
+    }
+
+    if (Adapter->ReceiveTail != OldTail)
+    {
+        E1000WriteUlong(Adapter, E1000_REG_RDT, Adapter->ReceiveTail);
+    }
+}
@@ -37,6 +37,7 @@ static ULONG SupportedOidList[] =
     OID_802_3_PERMANENT_ADDRESS,
     OID_802_3_CURRENT_ADDRESS,
     OID_802_3_MAXIMUM_LIST_SIZE,
+    OID_TCP_TASK_OFFLOAD,
     /* Statistics */
     OID_GEN_XMIT_OK,
     OID_GEN_RCV_OK,
@@ -45,6 +46,160 @@ static ULONG SupportedOidList[] =
     OID_GEN_RCV_NO_BUFFER,
 };
 
+/* Task offload header followed by the checksum and large send tasks */
+#define TASK_OFFLOAD_BUFFER_SIZE \
+    (sizeof(NDIS_TASK_OFFLOAD_HEADER) + \
+     FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_IP_CHECKSUM) + \
+     FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(NDIS_TASK_TCP_LARGE_SEND))
+
+static
+BOOLEAN
+E1000ValidTaskOffloadHeader(
+    IN PNDIS_TASK_OFFLOAD_HEADER Header)
+{
+    return (Header->Version == NDIS_TASK_OFFLOAD_VERSION &&
+            Header->Size == sizeof(*Header) &&
+            Header->EncapsulationFormat.Encapsulation == IEEE_802_3_Encapsulation);
+}
+
+static
+ULONG
+E1000BuildTaskOffload(
+    IN PE1000_ADAPTER Adapter,
+    IN PNDIS_TASK_OFFLOAD_HEADER RequestHeader,
+    OUT PUCHAR Buffer)
+{
+    PNDIS_TASK_OFFLOAD_HEADER Header = (PNDIS_TASK_OFFLOAD_HEADER)Buffer;
+    PNDIS_TASK_OFFLOAD Task, PreviousTask = NULL;
+    PNDIS_TASK_TCP_IP_CHECKSUM ChecksumTask;
+    PNDIS_TASK_TCP_LARGE_SEND LargeSendTask;
+    ULONG Offset = sizeof(*Header);
+
+    RtlZeroMemory(Buffer, TASK_OFFLOAD_BUFFER_SIZE);
+    *Header = *RequestHeader;
+    Header->OffsetFirstTask = 0;
+
+    if (Adapter->OffloadCapabilities & (E1000_OFFLOAD_TX_TCP_CHECKSUM | E1000_OFFLOAD_RX_CHECKSUM))
+    {
+        Task = (PNDIS_TASK_OFFLOAD)(Buffer + Offset);
+        Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+        Task->Size = sizeof(*Task);
+        Task->Task = TcpIpChecksumNdisTask;
+        Task->TaskBufferLength = sizeof(*ChecksumTask);
+
+        ChecksumTask = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+        ChecksumTask->V4Transmit.IpOptionsSupported = 1;
+        ChecksumTask->V4Transmit.TcpOptionsSupported = 1;
+        ChecksumTask->V4Transmit.TcpChecksum = 1;
+        ChecksumTask->V4Transmit.UdpChecksum = 1;
+        ChecksumTask->V4Transmit.IpChecksum = 1;
+        ChecksumTask->V4Receive.IpOptionsSupported = 1;
+        ChecksumTask->V4Receive.TcpOptionsSupported = 1;
+        ChecksumTask->V4Receive.TcpChecksum = 1;
+        ChecksumTask->V4Receive.UdpChecksum = 1;
+        ChecksumTask->V4Receive.IpChecksum = 1;
+
+        Header->OffsetFirstTask = Offset;
+        PreviousTask = Task;
+        Offset += FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(*ChecksumTask);
+    }
+
+    if (Adapter->OffloadCapabilities & E1000_OFFLOAD_LARGE_SEND)
+    {
+        Task = (PNDIS_TASK_OFFLOAD)(Buffer + Offset);
+        Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+        Task->Size = sizeof(*Task);
+        Task->Task = TcpLargeSendNdisTask;
+        Task->TaskBufferLength = sizeof(*LargeSendTask);
+
+        LargeSendTask = (PNDIS_TASK_TCP_LARGE_SEND)Task->TaskBuffer;
+        LargeSendTask->Version = NDIS_TASK_TCP_LARGE_SEND_V0;
+        LargeSendTask->MaxOffLoadSize = MAXIMUM_LARGE_SEND_SIZE;
+        LargeSendTask->MinSegmentCount = 2;
+        LargeSendTask->TcpOptions = TRUE;
+        LargeSendTask->IpOptions = TRUE;
+
+        if (PreviousTask)
+            PreviousTask->OffsetNextTask = (ULONG)((PUCHAR)Task - (PUCHAR)PreviousTask);
+        else
+            Header->OffsetFirstTask = Offset;
+        Offset += FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + sizeof(*LargeSendTask);
+    }
+
+    return Offset;
+}
+
+static
+NDIS_STATUS
+E1000SetTaskOffload(
+    IN PE1000_ADAPTER Adapter,
+    IN PVOID InformationBuffer,
+    IN ULONG InformationBufferLength)
+{
+    PNDIS_TASK_OFFLOAD_HEADER Header = InformationBuffer;
+    PNDIS_TASK_OFFLOAD Task;
+    PNDIS_TASK_TCP_IP_CHECKSUM ChecksumTask;
+    ULONG Offset, OffloadFlags = 0;
+
+    if (!E1000ValidTaskOffloadHeader(Header))
+        return NDIS_STATUS_NOT_SUPPORTED;
+
+    /* Everything that is not listed gets turned off */
+    for (Offset = Header->OffsetFirstTask; Offset != 0; Offset += Task->OffsetNextTask)
+    {
+        if (Offset > InformationBufferLength ||
+            InformationBufferLength - Offset < FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer))
+        {
+            return NDIS_STATUS_INVALID_LENGTH;
+        }
+
+        Task = (PNDIS_TASK_OFFLOAD)((PUCHAR)InformationBuffer + Offset);
+        if (InformationBufferLength - Offset - FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) < Task->TaskBufferLength)
+            return NDIS_STATUS_INVALID_LENGTH;
+
+        switch (Task->Task)
+        {
+        case TcpIpChecksumNdisTask:
+            if (Task->TaskBufferLength < sizeof(*ChecksumTask))
+                return NDIS_STATUS_INVALID_LENGTH;
+
+            ChecksumTask = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+            if (ChecksumTask->V4Transmit.IpChecksum)
+                OffloadFlags |= E1000_OFFLOAD_TX_IP_CHECKSUM;
+            if (ChecksumTask->V4Transmit.TcpChecksum)
+                OffloadFlags |= E1000_OFFLOAD_TX_TCP_CHECKSUM;
+            if (ChecksumTask->V4Transmit.UdpChecksum)
+                OffloadFlags |= E1000_OFFLOAD_TX_UDP_CHECKSUM;
+            if (ChecksumTask->V4Receive.IpChecksum)
+                OffloadFlags |= E1000_OFFLOAD_RX_IP_CHECKSUM;
+            if (ChecksumTask->V4Receive.TcpChecksum)
+                OffloadFlags |= E1000_OFFLOAD_RX_TCP_CHECKSUM;
+            if (ChecksumTask->V4Receive.UdpChecksum)
+                OffloadFlags |= E1000_OFFLOAD_RX_UDP_CHECKSUM;
+            break;
+
+        case TcpLargeSendNdisTask:
+            OffloadFlags |= E1000_OFFLOAD_LARGE_SEND;
+            break;
+
+        default:
+            NDIS_DbgPrint(MIN_TRACE, ("Unsupported offload task %d\n", Task->Task));
+            return NDIS_STATUS_NOT_SUPPORTED;
+        }
+
+        if (Task->OffsetNextTask == 0)
+            break;
+    }
+
+    if (OffloadFlags & ~Adapter->OffloadCapabilities)
+        return NDIS_STATUS_NOT_SUPPORTED;
+
+    Adapter->OffloadFlags = OffloadFlags;
+
+    NDIS_DbgPrint(MIN_TRACE, ("Offloads enabled: 0x%x\n", OffloadFlags));
+
+    return NICApplyOffload(Adapter);
+}
 
 NDIS_STATUS
 NTAPI
@@ -61,6 +216,7 @@ MiniportQueryInformation(
     ULONG copyLength;
     PVOID copySource;
     NDIS_STATUS status;
+    UCHAR taskOffload[TASK_OFFLOAD_BUFFER_SIZE];
 
     status = NDIS_STATUS_SUCCESS;
     copySource = &genericUlong;
@@ -108,11 +264,11 @@ MiniportQueryInformation(
         break;
 
     case OID_GEN_TRANSMIT_BUFFER_SPACE:
-        genericUlong = MAXIMUM_FRAME_SIZE;
+        genericUlong = MAXIMUM_FRAME_SIZE * Adapter->NumTransmitDescriptors;
         break;
 
     case OID_GEN_RECEIVE_BUFFER_SPACE:
-        genericUlong = RECEIVE_BUFFER_SIZE;
+        genericUlong = RECEIVE_BUFFER_SIZE * Adapter->NumReceiveDescriptors;
         break;
 
     case OID_GEN_VENDOR_ID:
@@ -174,6 +330,24 @@ MiniportQueryInformation(
         copyLength = IEEE_802_ADDR_LENGTH;
         break;
 
+    case OID_TCP_TASK_OFFLOAD:
+        /* The protocol tells us which encapsulation it wants the tasks for */
+        if (InformationBufferLength < sizeof(NDIS_TASK_OFFLOAD_HEADER))
+        {
+            copyLength = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+            break;
+        }
+
+        if (!E1000ValidTaskOffloadHeader(InformationBuffer))
+        {
+            status = NDIS_STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        copySource = taskOffload;
+        copyLength = E1000BuildTaskOffload(Adapter, InformationBuffer, taskOffload);
+        break;
+
     case OID_GEN_XMIT_OK:
         genericUlong = 0;
         break;
@@ -324,6 +498,23 @@ MiniportSetInformation(
         NICUpdateMulticastList(Adapter);
         break;
 
+    case OID_TCP_TASK_OFFLOAD:
+        if (InformationBufferLength < sizeof(NDIS_TASK_OFFLOAD_HEADER))
+        {
+            *BytesRead = 0;
+            *BytesNeeded = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+            status = NDIS_STATUS_INVALID_LENGTH;
+            break;
+        }
+
+        status = E1000SetTaskOffload(Adapter, InformationBuffer, InformationBufferLength);
+        if (status != NDIS_STATUS_SUCCESS)
+        {
+            *BytesRead = 0;
+            *BytesNeeded = 0;
+        }
+        break;
+
     default:
         NDIS_DbgPrint(MIN_TRACE, ("Unknown OID 0x%x(%s)\n", Oid, Oid2Str(Oid)));
         status = NDIS_STATUS_NOT_SUPPORTED;
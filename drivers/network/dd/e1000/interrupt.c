@@ -35,6 +35,50 @@ MiniportISR(
     *QueueMiniportHandleInterrupt = TRUE;
 }
 
+static
+VOID
+E1000SetReceiveChecksumInfo(
+    IN PE1000_ADAPTER Adapter,
+    IN PNDIS_PACKET Packet,
+    IN PE1000_RECEIVE_DESCRIPTOR ReceiveDescriptor)
+{
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+
+    ChecksumInfo.Value = 0;
+
+    /* IXSM is set when the NIC didn't look at the checksums at all */
+    if ((Adapter->OffloadFlags & E1000_OFFLOAD_RX_CHECKSUM) &&
+        !(ReceiveDescriptor->Status & E1000_RDESC_STATUS_IXSM))
+    {
+        if (ReceiveDescriptor->Status & E1000_RDESC_STATUS_IPCS)
+        {
+            if (ReceiveDescriptor->Errors & E1000_RDESC_ERR_IPE)
+                ChecksumInfo.Receive.NdisPacketIpChecksumFailed = 1;
+            else
+                ChecksumInfo.Receive.NdisPacketIpChecksumSucceeded = 1;
+        }
+
+        /* The NIC doesn't tell TCP and UDP apart, but tcpip only uses this for the protocol it gets */
+        if (ReceiveDescriptor->Status & E1000_RDESC_STATUS_TCPCS)
+        {
+            if (ReceiveDescriptor->Errors & E1000_RDESC_ERR_TCPE)
+            {
+                ChecksumInfo.Receive.NdisPacketTcpChecksumFailed = 1;
+                ChecksumInfo.Receive.NdisPacketUdpChecksumFailed = 1;
+            }
+            else
+            {
+                if (Adapter->OffloadFlags & E1000_OFFLOAD_RX_TCP_CHECKSUM)
+                    ChecksumInfo.Receive.NdisPacketTcpChecksumSucceeded = 1;
+                if (Adapter->OffloadFlags & E1000_OFFLOAD_RX_UDP_CHECKSUM)
+                    ChecksumInfo.Receive.NdisPacketUdpChecksumSucceeded = 1;
+            }
+        }
+    }
+
+    NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpIpChecksumPacketInfo) = UlongToPtr(ChecksumInfo.Value);
+}
+
 VOID
 NTAPI
 MiniportHandleInterrupt(
@@ -43,6 +87,7 @@ MiniportHandleInterrupt(
     ULONG InterruptPending;
     PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
     volatile PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptor;
+    ULONG TotalPackets = 0;
 
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
@@ -69,69 +114,102 @@ MiniportHandleInterrupt(
     if (InterruptPending & (E1000_IMS_RXDMT0 | E1000_IMS_RXT0))
     {
         volatile PE1000_RECEIVE_DESCRIPTOR ReceiveDescriptor;
-        PETH_HEADER EthHeader;
-        ULONG BufferOffset;
+        PNDIS_PACKET Packets[RECEIVE_INDICATE_BATCH];
+        PNDIS_BUFFER Buffer;
         BOOLEAN bGotAny = FALSE;
-        ULONG RxDescHead, RxDescTail, CurrRxDesc;
+        BOOLEAN Indicate;
+        BOOLEAN LowResources;
+        ULONG CurrRxDesc;
+        ULONG NumPackets, i;
 
         /* Clear out these interrupts */
         InterruptPending &= ~(E1000_IMS_RXDMT0 | E1000_IMS_RXT0);
 
-        E1000ReadUlong(Adapter, E1000_REG_RDH, &RxDescHead);
-        E1000ReadUlong(Adapter, E1000_REG_RDT, &RxDescTail);
-
-        while (((RxDescTail + 1) % NUM_RECEIVE_DESCRIPTORS) != RxDescHead)
+        do
         {
-            CurrRxDesc = (RxDescTail + 1) % NUM_RECEIVE_DESCRIPTORS;
-            BufferOffset = CurrRxDesc * Adapter->ReceiveBufferEntrySize;
-            ReceiveDescriptor = Adapter->ReceiveDescriptors + CurrRxDesc;
+            NumPackets = 0;
+
+            NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
 
-            /* Check if the hardware have released this descriptor (DD - Descriptor Done) */
-            if (!(ReceiveDescriptor->Status & E1000_RDESC_STATUS_DD))
+            while (NumPackets < RECEIVE_INDICATE_BATCH)
             {
-                /* No need to check descriptors after the first unfinished one */
-                break;
-            }
+                CurrRxDesc = Adapter->CurrentRxDesc;
+                ReceiveDescriptor = Adapter->ReceiveDescriptors + CurrRxDesc;
 
-            /* Ignoring these flags for now */
-            ReceiveDescriptor->Status &= ~(E1000_RDESC_STATUS_IXSM | E1000_RDESC_STATUS_PIF);
+                /* Check if the hardware have released this descriptor (DD - Descriptor Done).
+                 * The tail was never given to the hardware, so it can't have been filled. */
+                if (CurrRxDesc == Adapter->ReceiveTail ||
+                    !(ReceiveDescriptor->Status & E1000_RDESC_STATUS_DD))
+                {
+                    /* No need to check descriptors after the first unfinished one */
+                    break;
+                }
 
-            if (ReceiveDescriptor->Status != (E1000_RDESC_STATUS_EOP | E1000_RDESC_STATUS_DD))
-            {
-                NDIS_DbgPrint(MIN_TRACE, ("Unrecognized ReceiveDescriptor status flag: %u\n", ReceiveDescriptor->Status));
-            }
+                if (!(ReceiveDescriptor->Status & E1000_RDESC_STATUS_EOP))
+                {
+                    NDIS_DbgPrint(MIN_TRACE, ("Unrecognized ReceiveDescriptor status flag: %u\n", ReceiveDescriptor->Status));
+                }
 
-            if (ReceiveDescriptor->Length != 0 && ReceiveDescriptor->Address != 0)
-            {
-                EthHeader = (PETH_HEADER)(Adapter->ReceiveBuffer + BufferOffset);
+                Indicate = (ReceiveDescriptor->Length >= sizeof(ETH_HEADER) &&
+                            (ReceiveDescriptor->Status & E1000_RDESC_STATUS_EOP));
+
+                Adapter->CurrentRxDesc = (CurrRxDesc + 1) % Adapter->NumReceiveDescriptors;
+
+                if (!Indicate)
+                {
+                    NDIS_DbgPrint(MIN_TRACE, ("Got a NULL descriptor"));
+                    continue;
+                }
+
+                /* Keep the descriptor away from the hardware until the packet comes back.
+                 * When the protocols already hold too many, make them copy this one. */
+                LowResources = (Adapter->ReceivePacketsHeld >= Adapter->NumReceiveDescriptors - RECEIVE_LOW_WATERMARK(Adapter));
+                Adapter->ReceivePacketHeld[CurrRxDesc] = TRUE;
+                Adapter->ReceivePacketsHeld++;
+
+                Packets[NumPackets] = Adapter->ReceivePackets[CurrRxDesc];
 
-                NdisMEthIndicateReceive(Adapter->AdapterHandle,
-                                        NULL,
-                                        (PCHAR)EthHeader,
-                                        sizeof(ETH_HEADER),
-                                        (PCHAR)(EthHeader + 1),
-                                        ReceiveDescriptor->Length - sizeof(ETH_HEADER),
-                                        ReceiveDescriptor->Length - sizeof(ETH_HEADER));
+                NdisQueryPacket(Packets[NumPackets], NULL, NULL, &Buffer, NULL);
+                NdisAdjustBufferLength(Buffer, ReceiveDescriptor->Length);
+                NdisRecalculatePacketCounts(Packets[NumPackets]);
 
-                bGotAny = TRUE;
+                E1000SetReceiveChecksumInfo(Adapter, Packets[NumPackets], ReceiveDescriptor);
+                NDIS_SET_PACKET_STATUS(Packets[NumPackets], LowResources ? NDIS_STATUS_RESOURCES : NDIS_STATUS_SUCCESS);
+
+                NumPackets++;
             }
-            else
+
+            NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
+
+            if (NumPackets == 0)
+                break;
+
+            NdisMIndicateReceivePacket(Adapter->AdapterHandle, Packets, NumPackets);
+
+            /* Anything but pending means the packet is ours again */
+            NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+            for (i = 0; i < NumPackets; i++)
             {
-                NDIS_DbgPrint(MIN_TRACE, ("Got a NULL descriptor"));
+                if (NDIS_GET_PACKET_STATUS(Packets[i]) != NDIS_STATUS_PENDING)
+                {
+                    Adapter->ReceivePacketHeld[RECEIVE_PACKET_INDEX(Packets[i])] = FALSE;
+                    Adapter->ReceivePacketsHeld--;
+                }
             }
+            NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
 
-            /* Give the descriptor back */
-            ReceiveDescriptor->Status = 0;
+            TotalPackets += NumPackets;
+            bGotAny = TRUE;
+        } while (NumPackets == RECEIVE_INDICATE_BATCH);
 
-            RxDescTail = CurrRxDesc;
-        }
+        /* Give the free descriptors back and write the new tail value */
+        NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+        NICReturnReceiveDescriptors(Adapter);
+        NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
 
         if (bGotAny)
         {
-            /* Write back new tail value */
-            E1000WriteUlong(Adapter, E1000_REG_RDT, RxDescTail);
-
-            NDIS_DbgPrint(MAX_TRACE, ("Rx done (RDH: %u, RDT: %u)\n", RxDescHead, RxDescTail));
+            NDIS_DbgPrint(MAX_TRACE, ("Rx done (Current: %u, Tail: %u)\n", Adapter->CurrentRxDesc, Adapter->ReceiveTail));
 
             NdisMEthIndicateReceiveComplete(Adapter->AdapterHandle);
         }
@@ -140,32 +218,38 @@ MiniportHandleInterrupt(
     /* Handling transmit interrupts */
     if (InterruptPending & (E1000_IMS_TXD_LOW | E1000_IMS_TXDW | E1000_IMS_TXQE))
     {
-        PNDIS_PACKET AckPackets[40] = {0};
-        ULONG NumPackets = 0, i;
+        PNDIS_PACKET AckPackets = NULL, *AckTail = &AckPackets;
+        PNDIS_PACKET Packet;
+        ULONG NumPackets = 0;
+        ULONG EndTxDesc;
 
         /* Clear out these interrupts */
         InterruptPending &= ~(E1000_IMS_TXD_LOW | E1000_IMS_TXDW | E1000_IMS_TXQE);
 
-        while ((Adapter->TxFull || Adapter->LastTxDesc != Adapter->CurrentTxDesc) && NumPackets < ARRAYSIZE(AckPackets))
+        /* Reap everything that is done before completing anything */
+        while (Adapter->LastTxDesc != Adapter->CurrentTxDesc)
         {
-            TransmitDescriptor = Adapter->TransmitDescriptors + Adapter->LastTxDesc;
-
-            if (TransmitDescriptor->Status & E1000_TDESC_STATUS_DD)
+            /* Only the last descriptor of a packet refers to it and reports status */
+            EndTxDesc = Adapter->LastTxDesc;
+            while (!Adapter->TransmitPackets[EndTxDesc])
             {
-                if (Adapter->TransmitPackets[Adapter->LastTxDesc])
-                {
-                    AckPackets[NumPackets++] = Adapter->TransmitPackets[Adapter->LastTxDesc];
-                    Adapter->TransmitPackets[Adapter->LastTxDesc] = NULL;
-                    TransmitDescriptor->Status = 0;
-                }
-
-                Adapter->LastTxDesc = (Adapter->LastTxDesc + 1) % NUM_TRANSMIT_DESCRIPTORS;
-                Adapter->TxFull = FALSE;
+                EndTxDesc = (EndTxDesc + 1) % Adapter->NumTransmitDescriptors;
+                ASSERT(EndTxDesc != Adapter->CurrentTxDesc);
             }
-            else
-            {
+
+            TransmitDescriptor = Adapter->TransmitDescriptors + EndTxDesc;
+            if (!(TransmitDescriptor->Status & E1000_TDESC_STATUS_DD))
                 break;
-            }
+
+            Packet = Adapter->TransmitPackets[EndTxDesc];
+            Adapter->TransmitPackets[EndTxDesc] = NULL;
+            Adapter->LastTxDesc = (EndTxDesc + 1) % Adapter->NumTransmitDescriptors;
+
+            /* Chain the packets through their MiniportReserved area */
+            *(PNDIS_PACKET*)Packet->MiniportReserved = NULL;
+            *AckTail = Packet;
+            AckTail = (PNDIS_PACKET*)Packet->MiniportReserved;
+            NumPackets++;
         }
 
         if (NumPackets)
@@ -173,12 +257,43 @@ MiniportHandleInterrupt(
             NDIS_DbgPrint(MAX_TRACE, ("Tx: (TDH: %u, TDT: %u)\n", Adapter->CurrentTxDesc, Adapter->LastTxDesc));
             NDIS_DbgPrint(MAX_TRACE, ("Tx Done: %u packets to ack\n", NumPackets));
 
-            for (i = 0; i < NumPackets; ++i)
+            TotalPackets += NumPackets;
+
+            while (AckPackets)
             {
-                NdisMSendComplete(Adapter->AdapterHandle, AckPackets[i], NDIS_STATUS_SUCCESS);
+                Packet = AckPackets;
+                AckPackets = *(PNDIS_PACKET*)Packet->MiniportReserved;
+                NdisMSendComplete(Adapter->AdapterHandle, Packet, NDIS_STATUS_SUCCESS);
             }
         }
     }
 
+    NICUpdateInterruptThrottling(Adapter, TotalPackets);
+
     ASSERT(InterruptPending == 0);
 }
+
+VOID
+NTAPI
+MiniportReturnPacket(
+    IN NDIS_HANDLE MiniportAdapterContext,
+    IN PNDIS_PACKET Packet)
+{
+    PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
+    ULONG Index = RECEIVE_PACKET_INDEX(Packet);
+
+    NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
+
+    ASSERT(Index < Adapter->NumReceiveDescriptors);
+    ASSERT(Adapter->ReceivePackets[Index] == Packet);
+
+    NdisDprAcquireSpinLock(&Adapter->ReceiveLock);
+
+    ASSERT(Adapter->ReceivePacketHeld[Index]);
+    Adapter->ReceivePacketHeld[Index] = FALSE;
+    Adapter->ReceivePacketsHeld--;
+
+    NICReturnReceiveDescriptors(Adapter);
+
+    NdisDprReleaseSpinLock(&Adapter->ReceiveLock);
+}
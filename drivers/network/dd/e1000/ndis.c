@@ -23,6 +23,108 @@ MiniportReset(
     return NDIS_STATUS_FAILURE;
 }
 
+static
+NDIS_STATUS
+E1000BuildTransmitContext(
+    IN PNDIS_PACKET Packet,
+    IN NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo,
+    IN ULONG MaximumSegmentSize,
+    OUT PE1000_CONTEXT_DESCRIPTOR Context,
+    OUT PUCHAR Command,
+    OUT PUCHAR Options)
+{
+    PNDIS_BUFFER Buffer;
+    PUCHAR Header;
+    PUCHAR IpHeader, TcpHeader;
+    UINT FirstLength, TotalLength;
+    ULONG IpHeaderLength, HeaderLength;
+    ULONG Sum;
+    UCHAR Protocol;
+
+    NdisGetFirstBufferFromPacketSafe(Packet,
+                                     &Buffer,
+                                     (PVOID*)&Header,
+                                     &FirstLength,
+                                     &TotalLength,
+                                     NormalPagePriority);
+    if (!Header)
+        return NDIS_STATUS_RESOURCES;
+
+    /* The NIC needs to know where the headers are, they all have to be in the first buffer */
+    IpHeader = Header + sizeof(ETH_HEADER);
+    if (FirstLength < sizeof(ETH_HEADER) + 20 ||
+        ((PETH_HEADER)Header)->PayloadType != RtlUshortByteSwap(ETH_TYPE_IPV4) ||
+        (IpHeader[0] >> 4) != 4)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Offload requested for something that isn't IPv4\n"));
+        return NDIS_STATUS_FAILURE;
+    }
+
+    IpHeaderLength = (IpHeader[0] & 0x0F) * 4;
+    Protocol = IpHeader[9];
+    HeaderLength = sizeof(ETH_HEADER) + IpHeaderLength;
+
+    if (FirstLength < HeaderLength)
+        return NDIS_STATUS_FAILURE;
+
+    RtlZeroMemory(Context, sizeof(*Context));
+    Context->IpChecksumStart = sizeof(ETH_HEADER);
+    Context->IpChecksumOffset = sizeof(ETH_HEADER) + 10;
+    Context->IpChecksumEnd = (USHORT)(HeaderLength - 1);
+    Context->TcpChecksumStart = (UCHAR)HeaderLength;
+    Context->TcpChecksumOffset = (UCHAR)(HeaderLength + (Protocol == IPV4_PROTOCOL_TCP ? 16 : 6));
+    Context->TcpChecksumEnd = 0; /* Up to the end of the packet */
+    Context->Command = E1000_TCTX_CMD_IP;
+
+    if (Protocol == IPV4_PROTOCOL_TCP)
+        Context->Command |= E1000_TCTX_CMD_TCP;
+
+    *Command = 0;
+    *Options = 0;
+
+    if (ChecksumInfo.Transmit.NdisPacketIpChecksum)
+        *Options |= E1000_TDATA_POPTS_IXSM;
+    if ((ChecksumInfo.Transmit.NdisPacketTcpChecksum && Protocol == IPV4_PROTOCOL_TCP) ||
+        (ChecksumInfo.Transmit.NdisPacketUdpChecksum && Protocol == IPV4_PROTOCOL_UDP))
+    {
+        *Options |= E1000_TDATA_POPTS_TXSM;
+    }
+
+    if (MaximumSegmentSize)
+    {
+        if (Protocol != IPV4_PROTOCOL_TCP || FirstLength < HeaderLength + 20)
+            return NDIS_STATUS_FAILURE;
+
+        TcpHeader = Header + HeaderLength;
+        HeaderLength += (TcpHeader[12] >> 4) * 4;
+
+        if (FirstLength < HeaderLength || TotalLength <= HeaderLength)
+            return NDIS_STATUS_FAILURE;
+
+        Context->Command |= E1000_TCTX_CMD_TSE;
+        Context->PayloadLength = TotalLength - HeaderLength;
+        Context->HeaderLength = (UCHAR)HeaderLength;
+        Context->MaximumSegmentSize = (USHORT)MaximumSegmentSize;
+
+        /* The NIC fills in the length and checksums of every segment it cuts.
+         * It expects the TCP checksum to be seeded with the pseudo header sum without the length. */
+        Sum = *(PUSHORT)(IpHeader + 12) + *(PUSHORT)(IpHeader + 14) +
+              *(PUSHORT)(IpHeader + 16) + *(PUSHORT)(IpHeader + 18) +
+              ((ULONG)IPV4_PROTOCOL_TCP << 8);
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+        *(PUSHORT)(TcpHeader + 16) = (USHORT)Sum;
+
+        *Command |= E1000_TDATA_CMD_TSE;
+        *Options |= E1000_TDATA_POPTS_IXSM | E1000_TDATA_POPTS_TXSM;
+
+        /* Tell the protocol how much payload went out */
+        NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpLargeSendPacketInfo) = UlongToPtr(Context->PayloadLength);
+    }
+
+    return NDIS_STATUS_SUCCESS;
+}
+
 NDIS_STATUS
 NTAPI
 MiniportSend(
@@ -32,35 +134,136 @@ MiniportSend(
 {
     PE1000_ADAPTER Adapter = (PE1000_ADAPTER)MiniportAdapterContext;
     PSCATTER_GATHER_LIST sgList = NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, ScatterGatherListPacketInfo);
-    ULONG TransmitLength;
-    PHYSICAL_ADDRESS TransmitBuffer;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+    ULONG MaximumSegmentSize;
+    E1000_CONTEXT_DESCRIPTOR Context;
+    PE1000_CONTEXT_DESCRIPTOR TransmitContext = NULL;
+    UCHAR Command = 0, Options = 0;
     NDIS_STATUS Status;
 
     ASSERT(sgList != NULL);
-    ASSERT(sgList->NumberOfElements == 1);
-    ASSERT((sgList->Elements[0].Address.LowPart & 3) == 0);
-    ASSERT(sgList->Elements[0].Length <= MAXIMUM_FRAME_SIZE);
+    ASSERT(sgList->NumberOfElements != 0);
+
+    ChecksumInfo.Value = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpIpChecksumPacketInfo));
+    MaximumSegmentSize = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpLargeSendPacketInfo));
+
+    if (!(Adapter->OffloadFlags & E1000_OFFLOAD_LARGE_SEND))
+        MaximumSegmentSize = 0;
 
-    if (Adapter->TxFull)
+    if (MaximumSegmentSize ||
+        (ChecksumInfo.Transmit.NdisPacketChecksumV4 &&
+         (ChecksumInfo.Transmit.NdisPacketIpChecksum ||
+          ChecksumInfo.Transmit.NdisPacketTcpChecksum ||
+          ChecksumInfo.Transmit.NdisPacketUdpChecksum)))
     {
-        NDIS_DbgPrint(MIN_TRACE, ("All TX descriptors are full\n"));
-        return NDIS_STATUS_RESOURCES;
-    }
+        Status = E1000BuildTransmitContext(Packet,
+                                           ChecksumInfo,
+                                           MaximumSegmentSize,
+                                           &Context,
+                                           &Command,
+                                           &Options);
+        if (Status != NDIS_STATUS_SUCCESS)
+        {
+            NDIS_DbgPrint(MIN_TRACE, ("Unable to set up offload for packet (0x%x)\n", Status));
+            return Status;
+        }
 
-    TransmitLength = sgList->Elements[0].Length;
-    TransmitBuffer = sgList->Elements[0].Address;
-    Adapter->TransmitPackets[Adapter->CurrentTxDesc] = Packet;
+        TransmitContext = &Context;
+    }
 
-    Status = NICTransmitPacket(Adapter, TransmitBuffer, TransmitLength);
+    Status = NICTransmitPacket(Adapter, Packet, sgList, TransmitContext, Command, Options);
     if (Status != NDIS_STATUS_SUCCESS)
     {
-        NDIS_DbgPrint(MIN_TRACE, ("Transmit packet failed\n"));
+        if (Status == NDIS_STATUS_RESOURCES)
+            NDIS_DbgPrint(MID_TRACE, ("All TX descriptors are full\n"));
+        else
+            NDIS_DbgPrint(MIN_TRACE, ("Transmit packet failed\n"));
         return Status;
     }
 
     return NDIS_STATUS_PENDING;
 }
 
+static
+ULONG
+E1000ReadConfigurationValue(
+    IN NDIS_HANDLE ConfigurationHandle,
+    IN PCWSTR Name,
+    IN ULONG Default,
+    IN ULONG Minimum,
+    IN ULONG Maximum)
+{
+    PNDIS_CONFIGURATION_PARAMETER ConfigurationParameter;
+    NDIS_STRING Keyword;
+    NDIS_STATUS Status;
+    ULONG Value;
+
+    NdisInitUnicodeString(&Keyword, Name);
+    NdisReadConfiguration(&Status, &ConfigurationParameter, ConfigurationHandle, &Keyword, NdisParameterInteger);
+    if (Status != NDIS_STATUS_SUCCESS)
+        return Default;
+
+    Value = ConfigurationParameter->ParameterData.IntegerData;
+    if (Value < Minimum || Value > Maximum)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("Ignoring out of range %S value %u\n", Name, Value));
+        return Default;
+    }
+
+    return Value;
+}
+
+static
+VOID
+E1000ReadConfiguration(
+    IN PE1000_ADAPTER Adapter,
+    IN NDIS_HANDLE WrapperConfigurationContext)
+{
+    NDIS_HANDLE ConfigurationHandle;
+    NDIS_STATUS Status;
+
+    Adapter->NumTransmitDescriptors = min(DEFAULT_TRANSMIT_DESCRIPTORS, Adapter->MaximumDescriptors);
+    Adapter->NumReceiveDescriptors = min(DEFAULT_RECEIVE_DESCRIPTORS, Adapter->MaximumDescriptors);
+    Adapter->InterruptThrottleRate = ITR_ADAPTIVE;
+
+    NdisOpenConfiguration(&Status, &ConfigurationHandle, WrapperConfigurationContext);
+    if (Status != NDIS_STATUS_SUCCESS)
+    {
+        NDIS_DbgPrint(MIN_TRACE, ("NdisOpenConfiguration failed (0x%x)\n", Status));
+        return;
+    }
+
+    Adapter->NumTransmitDescriptors = E1000ReadConfigurationValue(ConfigurationHandle,
+                                                                  L"*TransmitBuffers",
+                                                                  Adapter->NumTransmitDescriptors,
+                                                                  MIN_DESCRIPTORS,
+                                                                  Adapter->MaximumDescriptors);
+    Adapter->NumReceiveDescriptors = E1000ReadConfigurationValue(ConfigurationHandle,
+                                                                 L"*ReceiveBuffers",
+                                                                 Adapter->NumReceiveDescriptors,
+                                                                 MIN_DESCRIPTORS,
+                                                                 Adapter->MaximumDescriptors);
+
+    /* Round down to what the ring length register can express */
+    Adapter->NumTransmitDescriptors &= ~(DESCRIPTOR_COUNT_ALIGNMENT - 1);
+    Adapter->NumReceiveDescriptors &= ~(DESCRIPTOR_COUNT_ALIGNMENT - 1);
+
+    Adapter->InterruptThrottleRate = E1000ReadConfigurationValue(ConfigurationHandle,
+                                                                 L"InterruptThrottleRate",
+                                                                 ITR_ADAPTIVE,
+                                                                 ITR_DISABLED,
+                                                                 ITR_MAXIMUM_RATE);
+    if (Adapter->InterruptThrottleRate > ITR_ADAPTIVE && Adapter->InterruptThrottleRate < ITR_MINIMUM_RATE)
+        Adapter->InterruptThrottleRate = ITR_MINIMUM_RATE;
+
+    NdisCloseConfiguration(ConfigurationHandle);
+
+    NDIS_DbgPrint(MID_TRACE, ("%u TX descriptors, %u RX descriptors, interrupt throttle rate %u\n",
+                              Adapter->NumTransmitDescriptors,
+                              Adapter->NumReceiveDescriptors,
+                              Adapter->InterruptThrottleRate));
+}
+
 VOID
 NTAPI
 MiniportHalt(
@@ -79,6 +282,8 @@ MiniportHalt(
     /* Finally, free other resources (Ports, IO ranges,...) */
     NICReleaseIoResources(Adapter);
 
+    NdisFreeSpinLock(&Adapter->ReceiveLock);
+
     /* Destroy the adapter context */
     NdisFreeMemory(Adapter, sizeof(*Adapter), 0);
 }
@@ -131,6 +336,7 @@ MiniportInitialize(
 
     RtlZeroMemory(Adapter, sizeof(*Adapter));
     Adapter->AdapterHandle = MiniportAdapterHandle;
+    NdisAllocateSpinLock(&Adapter->ReceiveLock);
 
     /* Notify NDIS of some characteristics of our NIC */
     NdisMSetAttributesEx(MiniportAdapterHandle,
@@ -158,6 +364,9 @@ MiniportInitialize(
         goto Cleanup;
     }
 
+    /* Ring sizes and interrupt moderation */
+    E1000ReadConfiguration(Adapter, WrapperConfigurationContext);
+
     /* Get our resources for IRQ and IO base information */
     NdisMQueryAdapterResources(&Status,
                                WrapperConfigurationContext,
@@ -209,7 +418,7 @@ MiniportInitialize(
     /* Allocate the DMA resources */
     Status = NdisMInitializeScatterGatherDma(MiniportAdapterHandle,
                                              FALSE, // 64bit is supported but can be buggy
-                                             MAXIMUM_FRAME_SIZE);
+                                             MAXIMUM_TRANSMIT_MAPPING);
     if (Status != NDIS_STATUS_SUCCESS)
     {
         NDIS_DbgPrint(MIN_TRACE, ("Unable to configure DMA\n"));
@@ -317,7 +526,7 @@ DriverEntry(
     Characteristics.SendHandler = MiniportSend;
     Characteristics.SetInformationHandler = MiniportSetInformation;
     Characteristics.TransferDataHandler = NULL;
-    Characteristics.ReturnPacketHandler = NULL;
+    Characteristics.ReturnPacketHandler = MiniportReturnPacket;
     Characteristics.SendPacketsHandler = NULL;
     Characteristics.AllocateCompleteHandler = NULL;
 
@@ -19,8 +19,50 @@
 #define MAXIMUM_FRAME_SIZE   1522
 #define RECEIVE_BUFFER_SIZE  2048
 
+/* Largest TCP packet we accept for segmentation, and the matching DMA mapping */
+#define MAXIMUM_LARGE_SEND_SIZE     64000
+#define MAXIMUM_TRANSMIT_MAPPING    (64 * 1024)
+
 #define DRIVER_VERSION 1
 
+/* Ring sizes, can be changed with the *TransmitBuffers and *ReceiveBuffers keywords */
+#define DEFAULT_TRANSMIT_DESCRIPTORS    512
+#define DEFAULT_RECEIVE_DESCRIPTORS     512
+
+/* Most received packets handed to NDIS in one indication */
+#define RECEIVE_INDICATE_BATCH  32
+
+/* Once protocols hold this many receive packets, the rest get copied so the ring can't run dry */
+#define RECEIVE_LOW_WATERMARK(Adapter)  ((Adapter)->NumReceiveDescriptors / 4)
+
+/* InterruptThrottleRate keyword: 0 is off, 1 adapts to the traffic, anything else is fixed */
+#define ITR_DISABLED            0
+#define ITR_ADAPTIVE            1
+#define ITR_MINIMUM_RATE        100
+#define ITR_MAXIMUM_RATE        100000
+
+/* Adaptive moderation picks the interrupt rate from the packet rate seen during the last sample */
+#define ITR_SAMPLE_INTERVAL     100     /* ms */
+#define ITR_LOW_LATENCY_RATE    20000   /* interrupts per second */
+#define ITR_MODERATE_RATE       8000
+#define ITR_BULK_RATE           4000
+#define ITR_LIGHT_TRAFFIC       4000    /* packets per second */
+#define ITR_HEAVY_TRAFFIC       32000
+
+/* Offloads enabled through OID_TCP_TASK_OFFLOAD */
+#define E1000_OFFLOAD_TX_IP_CHECKSUM    0x01
+#define E1000_OFFLOAD_TX_TCP_CHECKSUM   0x02
+#define E1000_OFFLOAD_TX_UDP_CHECKSUM   0x04
+#define E1000_OFFLOAD_RX_IP_CHECKSUM    0x08
+#define E1000_OFFLOAD_RX_TCP_CHECKSUM   0x10
+#define E1000_OFFLOAD_RX_UDP_CHECKSUM   0x20
+#define E1000_OFFLOAD_LARGE_SEND        0x40
+
+#define E1000_OFFLOAD_RX_CHECKSUM       (E1000_OFFLOAD_RX_IP_CHECKSUM | E1000_OFFLOAD_RX_TCP_CHECKSUM | E1000_OFFLOAD_RX_UDP_CHECKSUM)
+
+/* Receive packets remember the descriptor they describe */
+#define RECEIVE_PACKET_INDEX(Packet)    (*(PULONG)(Packet)->MiniportReserved)
+
 #define DEFAULT_INTERRUPT_MASK  (E1000_IMS_LSC | E1000_IMS_TXDW | E1000_IMS_TXQE | E1000_IMS_RXDMT0 | E1000_IMS_RXT0 | E1000_IMS_TXD_LOW)
 
 
@@ -65,27 +107,59 @@ typedef struct _E1000_ADAPTER
     LONG InterruptMask;
     LONG InterruptPending;
 
+    /* Interrupt moderation */
+    BOOLEAN InterruptThrottling;
+    ULONG InterruptThrottleRate;
+    ULONG CurrentInterruptRate;
+    ULONG SamplePackets;
+    ULONG SampleStart;
+
 
     /* Transmit */
     PE1000_TRANSMIT_DESCRIPTOR TransmitDescriptors;
     NDIS_PHYSICAL_ADDRESS TransmitDescriptorsPa;
 
-    PNDIS_PACKET TransmitPackets[NUM_TRANSMIT_DESCRIPTORS];
+    ULONG NumTransmitDescriptors;
+    PNDIS_PACKET *TransmitPackets;
 
     ULONG CurrentTxDesc;
     ULONG LastTxDesc;
-    BOOLEAN TxFull;
+
+    /* Last context loaded into the NIC, so it only gets reloaded when it changes */
+    E1000_CONTEXT_DESCRIPTOR TxContext;
+    BOOLEAN TxContextValid;
 
 
     /* Receive */
     PE1000_RECEIVE_DESCRIPTOR ReceiveDescriptors;
     NDIS_PHYSICAL_ADDRESS ReceiveDescriptorsPa;
+    ULONG NumReceiveDescriptors;
 
     E1000_RCVBUF_SIZE ReceiveBufferType;
     volatile PUCHAR ReceiveBuffer;
     NDIS_PHYSICAL_ADDRESS ReceiveBufferPa;
     ULONG ReceiveBufferEntrySize;
 
+    /* Packets handed to the protocols, one per descriptor */
+    NDIS_HANDLE ReceivePacketPool;
+    NDIS_HANDLE ReceiveBufferPool;
+    PNDIS_PACKET *ReceivePackets;
+    PBOOLEAN ReceivePacketHeld;
+
+    /* Protects the receive ring against packets being returned */
+    NDIS_SPIN_LOCK ReceiveLock;
+    ULONG CurrentRxDesc;
+    ULONG ReceiveTail;
+    ULONG ReceivePacketsHeld;
+
+
+    /* Largest ring the NIC supports */
+    ULONG MaximumDescriptors;
+
+    /* Offload */
+    ULONG OffloadCapabilities;
+    ULONG OffloadFlags;
+
 } E1000_ADAPTER, *PE1000_ADAPTER;
 
 
@@ -177,12 +251,36 @@ NTAPI
 NICUpdateLinkStatus(
     IN PE1000_ADAPTER Adapter);
 
+ULONG
+NTAPI
+NICFreeTransmitDescriptors(
+    IN PE1000_ADAPTER Adapter);
+
 NDIS_STATUS
 NTAPI
 NICTransmitPacket(
     IN PE1000_ADAPTER Adapter,
-    IN PHYSICAL_ADDRESS PhysicalAddress,
-    IN ULONG Length);
+    IN PNDIS_PACKET Packet,
+    IN PSCATTER_GATHER_LIST SgList,
+    IN PE1000_CONTEXT_DESCRIPTOR Context OPTIONAL,
+    IN UCHAR Command,
+    IN UCHAR Options);
+
+NDIS_STATUS
+NTAPI
+NICApplyOffload(
+    IN PE1000_ADAPTER Adapter);
+
+VOID
+NTAPI
+NICReturnReceiveDescriptors(
+    IN PE1000_ADAPTER Adapter);
+
+VOID
+NTAPI
+NICUpdateInterruptThrottling(
+    IN PE1000_ADAPTER Adapter,
+    IN ULONG Packets);
 
 NDIS_STATUS
 NTAPI
@@ -216,6 +314,12 @@ NTAPI
 MiniportHandleInterrupt(
     IN NDIS_HANDLE MiniportAdapterContext);
 
+VOID
+NTAPI
+MiniportReturnPacket(
+    IN NDIS_HANDLE MiniportAdapterContext,
+    IN PNDIS_PACKET Packet);
+
 
 VOID
 NTAPI
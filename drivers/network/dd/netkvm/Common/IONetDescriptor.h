@@ -127,6 +127,35 @@ struct virtio_net_ctrl_mac {
   #define VIRTIO_NET_CTRL_VLAN_ADD             0
   #define VIRTIO_NET_CTRL_VLAN_DEL             1
 
+/*
+ * Control multiqueue and receive-side scaling
+ *
+ * With VIRTIO_NET_F_MQ the driver tells the device how many queue pairs
+ * it uses (VQ_PAIRS_SET, 2 byte count) and the device steers flows by
+ * its own hash. With VIRTIO_NET_F_RSS the driver supplies the Toeplitz
+ * key and the indirection table instead (RSS_CONFIG), so the device and
+ * the driver pick the same queue for a flow.
+ */
+#define VIRTIO_NET_CTRL_MQ                   4
+  #define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET      0
+  #define VIRTIO_NET_CTRL_MQ_RSS_CONFIG        1
+
+#define VIRTIO_NET_RSS_HASH_TYPE_IPv4        (1 << 0)
+#define VIRTIO_NET_RSS_HASH_TYPE_TCPv4       (1 << 1)
+
+#define VIRTIO_NET_RSS_MAX_KEY_SIZE          40
+#define VIRTIO_NET_RSS_MAX_TABLE_LEN         128
+
+typedef struct tag_virtio_net_rss_config {
+    u32 hash_types;
+    u16 indirection_table_mask;
+    u16 unclassified_queue;
+    u16 indirection_table[VIRTIO_NET_RSS_MAX_TABLE_LEN];
+    u16 max_tx_vq;
+    u8  hash_key_length;
+    u8  hash_key_data[VIRTIO_NET_RSS_MAX_KEY_SIZE];
+} virtio_net_rss_config;
+
 
 #pragma pack (pop)
 
@@ -34,6 +34,8 @@
 
 static void ReuseReceiveBufferRegular(PARANDIS_ADAPTER *pContext, pIONetDescriptor pBuffersDescriptor);
 static void ReuseReceiveBufferPowerOff(PARANDIS_ADAPTER *pContext, pIONetDescriptor pBuffersDescriptor);
+static VOID NTAPI ReceiveQueueDpc(PKDPC Dpc, PVOID DeferredContext, PVOID SystemArgument1, PVOID SystemArgument2);
+static void ConfigureQueuePairs(PARANDIS_ADAPTER *pContext);
 
 //#define ROUNDSIZE(sz) ((sz + 15) & ~15)
 #define MAX_VLAN_ID     4095
@@ -128,6 +130,8 @@ typedef struct _tagConfigurationEntries
     tConfigurationEntry MTU;
     tConfigurationEntry NumberOfHandledRXPackersInDPC;
     tConfigurationEntry Indirect;
+    tConfigurationEntry RSSEnabled;
+    tConfigurationEntry NumRSSQueues;
 }tConfigurationEntries;
 
 static const tConfigurationEntries defaultConfiguration =
@@ -166,6 +170,8 @@ static const tConfigurationEntries defaultConfiguration =
     { "MTU", 1500, 500, 65500},
     { "NumberOfHandledRXPackersInDPC", MAX_RX_LOOPS, 1, 10000},
     { "Indirect", 0, 0, 2},
+    { "*RSS", 1, 0, 1},
+    { "*NumRssQueues", PARANDIS_MAX_QUEUE_PAIRS, 1, PARANDIS_MAX_QUEUE_PAIRS},
 };
 
 static void ParaNdis_ResetVirtIONetDevice(PARANDIS_ADAPTER *pContext)
@@ -316,6 +322,8 @@ static void ReadNicConfiguration(PARANDIS_ADAPTER *pContext, PUCHAR *ppNewMACAdd
             GetConfigurationEntry(cfg, &pConfiguration->MTU);
             GetConfigurationEntry(cfg, &pConfiguration->NumberOfHandledRXPackersInDPC);
             GetConfigurationEntry(cfg, &pConfiguration->Indirect);
+            GetConfigurationEntry(cfg, &pConfiguration->RSSEnabled);
+            GetConfigurationEntry(cfg, &pConfiguration->NumRSSQueues);
 
     #if !defined(WPP_EVENT_TRACING)
             bDebugPrint = pConfiguration->isLogEnabled.ulValue;
@@ -370,6 +378,8 @@ static void ReadNicConfiguration(PARANDIS_ADAPTER *pContext, PUCHAR *ppNewMACAdd
             pContext->bUseMergedBuffers = pConfiguration->UseMergeableBuffers.ulValue != 0;
             pContext->MaxPacketSize.nMaxDataSize = pConfiguration->MTU.ulValue;
             pContext->bUseIndirect = pConfiguration->Indirect.ulValue != 0;
+            pContext->bRSSEnabled = pConfiguration->RSSEnabled.ulValue != 0;
+            pContext->nMaxQueuePairs = pConfiguration->NumRSSQueues.ulValue;
             if (!pContext->bDoSupportPriority)
                 pContext->ulPriorityVlanSetting = 0;
             // if Vlan not supported
@@ -537,6 +547,8 @@ static void DumpVirtIOFeatures(PARANDIS_ADAPTER *pContext)
         {VIRTIO_NET_F_CTRL_RX, "VIRTIO_NET_F_CTRL_RX"},
         {VIRTIO_NET_F_CTRL_VLAN, "VIRTIO_NET_F_CTRL_VLAN"},
         {VIRTIO_NET_F_CTRL_RX_EXTRA, "VIRTIO_NET_F_CTRL_RX_EXTRA"},
+        {VIRTIO_NET_F_MQ, "VIRTIO_NET_F_MQ"},
+        {VIRTIO_NET_F_RSS, "VIRTIO_NET_F_RSS"},
         {VIRTIO_RING_F_INDIRECT_DESC, "VIRTIO_RING_F_INDIRECT_DESC"},
         {VIRTIO_F_VERSION_1, "VIRTIO_F_VERSION_1" },
         {VIRTIO_F_ANY_LAYOUT, "VIRTIO_F_ANY_LAYOUT" },
@@ -583,10 +595,19 @@ static void PrintStatistics(PARANDIS_ADAPTER *pContext)
         pContext->Statistics.ifHCInMulticastPkts +
         pContext->Statistics.ifHCInUcastPkts;
 
-    DPrintf(0, ("[Diag!%X] RX buffers at VIRTIO %d of %d",
+    UINT nofReceiveBuffers = 0, maxReceiveBuffers = 0, i;
+
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        nofReceiveBuffers += pContext->QueuePairs[i].NetNofReceiveBuffers;
+        maxReceiveBuffers += pContext->QueuePairs[i].NetMaxReceiveBuffers;
+    }
+
+    DPrintf(0, ("[Diag!%X] RX buffers at VIRTIO %d of %d, %d queue pair(s)",
         pContext->CurrentMacAddress[5],
-        pContext->NetNofReceiveBuffers,
-        pContext->NetMaxReceiveBuffers));
+        nofReceiveBuffers,
+        maxReceiveBuffers,
+        pContext->nQueuePairs));
     DPrintf(0, ("[Diag!] TX desc available %d/%d, buf %d/min. %d",
         pContext->nofFreeTxDescriptors,
         pContext->maxFreeTxDescriptors,
@@ -631,6 +652,70 @@ static NDIS_STATUS NTStatusToNdisStatus(NTSTATUS nt_status) {
     }
 }
 
+/**********************************************************
+Decides how many receive/transmit queue pairs are used.
+One pair per processor is used when the device offers multiqueue
+(and the control queue to switch it on) and RSS is enabled in the
+configuration. With VIRTIO_NET_F_RSS the device also steers the
+flows with our key and indirection table, otherwise it uses
+its own hash for the receive side.
+Parameters:
+    context
+***********************************************************/
+static void InitializeQueuePairs(PARANDIS_ADAPTER *pContext)
+{
+    USHORT nDevicePairs = 0;
+    UINT nPairs;
+
+    pContext->nQueuePairs = 1;
+    pContext->nDeviceQueuePairs = 0;
+    pContext->bHasDeviceRSS = FALSE;
+
+    if (pContext->bHasControlQueue && pContext->bRSSEnabled &&
+        VirtIODeviceGetHostFeature(pContext, VIRTIO_NET_F_MQ))
+    {
+        virtio_get_config(
+            &pContext->IODevice,
+            ETH_LENGTH_OF_ADDRESS + sizeof(USHORT), // + offsetof(struct virtio_net_config, max_virtqueue_pairs)
+            &nDevicePairs,
+            sizeof(nDevicePairs));
+        nPairs = min(nDevicePairs, NdisSystemProcessorCount());
+        nPairs = min(nPairs, pContext->nMaxQueuePairs);
+        nPairs = min(nPairs, PARANDIS_MAX_QUEUE_PAIRS);
+        if (nPairs > 1)
+        {
+            pContext->nQueuePairs = nPairs;
+            pContext->nDeviceQueuePairs = nDevicePairs;
+            VirtIODeviceEnableGuestFeature(pContext, VIRTIO_NET_F_MQ);
+        }
+    }
+
+    if (pContext->nQueuePairs > 1 &&
+        VirtIODeviceGetHostFeature(pContext, VIRTIO_F_VERSION_1) &&
+        VirtIODeviceGetHostFeature(pContext, VIRTIO_NET_F_RSS))
+    {
+        UCHAR maxKeySize = 0;
+        USHORT maxTableLength = 0;
+        ULONG hashTypes = 0;
+        // offsets of rss_max_key_size, rss_max_indirection_table_length
+        // and supported_hash_types in struct virtio_net_config
+        virtio_get_config(&pContext->IODevice, 17, &maxKeySize, sizeof(maxKeySize));
+        virtio_get_config(&pContext->IODevice, 18, &maxTableLength, sizeof(maxTableLength));
+        virtio_get_config(&pContext->IODevice, 20, &hashTypes, sizeof(hashTypes));
+        if (maxKeySize >= PARANDIS_RSS_HASH_KEY_SIZE &&
+            maxTableLength >= PARANDIS_RSS_INDIRECTION_TABLE_SIZE &&
+            (hashTypes & VIRTIO_NET_RSS_HASH_TYPE_TCPv4))
+        {
+            pContext->bHasDeviceRSS = TRUE;
+            VirtIODeviceEnableGuestFeature(pContext, VIRTIO_NET_F_RSS);
+        }
+    }
+
+    ParaNdis_RSSInitialize(pContext);
+    DPrintf(0, ("[%s] %d queue pair(s) of %d, device RSS %d", __FUNCTION__,
+        pContext->nQueuePairs, nDevicePairs, pContext->bHasDeviceRSS));
+}
+
 static NDIS_STATUS FinalizeFeatures(PARANDIS_ADAPTER *pContext)
 {
     NTSTATUS nt_status = virtio_set_features(&pContext->IODevice, pContext->ullGuestFeatures);
@@ -818,6 +903,7 @@ NDIS_STATUS ParaNdis_InitializeContext(
             pContext->bHasControlQueue = TRUE;
             VirtIODeviceEnableGuestFeature(pContext, VIRTIO_NET_F_CTRL_VQ);
         }
+        InitializeQueuePairs(pContext);
     }
     else
     {
@@ -993,14 +1079,20 @@ static pIONetDescriptor AllocatePairOfBuffersOnInit(
 /**********************************************************
 Allocates TX buffers according to startup setting (pContext->maxFreeTxDescriptors as got from registry)
 Buffers are chained in NetFreeSendBuffers
+The descriptors and the hardware buffers are shared by all the send queues,
+so the total never exceeds what the smallest queue can hold
 Parameters:
     context
 ***********************************************************/
 static void PrepareTransmitBuffers(PARANDIS_ADAPTER *pContext)
 {
-    UINT nBuffers, nMaxBuffers;
+    UINT nBuffers, nMaxBuffers, i;
     DEBUG_ENTRY(4);
-    nMaxBuffers = virtio_get_queue_size(pContext->NetSendQueue) / 2;
+    nMaxBuffers = virtio_get_queue_size(pContext->QueuePairs[0].NetSendQueue) / 2;
+    for (i = 1; i < pContext->nQueuePairs; ++i)
+    {
+        nMaxBuffers = min(nMaxBuffers, virtio_get_queue_size(pContext->QueuePairs[i].NetSendQueue) / 2);
+    }
     if (nMaxBuffers > pContext->maxFreeTxDescriptors) nMaxBuffers = pContext->maxFreeTxDescriptors;
 
     for (nBuffers = 0; nBuffers < nMaxBuffers; ++nBuffers)
@@ -1025,7 +1117,7 @@ static void PrepareTransmitBuffers(PARANDIS_ADAPTER *pContext)
         __FUNCTION__, pContext->nofFreeTxDescriptors, pContext->nofFreeHardwareBuffers));
 }
 
-static BOOLEAN AddRxBufferToQueue(PARANDIS_ADAPTER *pContext, pIONetDescriptor pBufferDescriptor)
+static BOOLEAN AddRxBufferToQueue(PARANDIS_ADAPTER *pContext, tNetQueuePair *pQueuePair, pIONetDescriptor pBufferDescriptor)
 {
     UINT nBuffersToSubmit = 2;
     struct VirtIOBufferDescriptor sg[2];
@@ -1043,7 +1135,7 @@ static BOOLEAN AddRxBufferToQueue(PARANDIS_ADAPTER *pContext, pIONetDescriptor p
         nBuffersToSubmit = 1;
     }
     return 0 <= virtqueue_add_buf(
-        pContext->NetReceiveQueue,
+        pQueuePair->NetReceiveQueue,
         sg,
         0,
         nBuffersToSubmit,
@@ -1054,12 +1146,13 @@ static BOOLEAN AddRxBufferToQueue(PARANDIS_ADAPTER *pContext, pIONetDescriptor p
 
 
 /**********************************************************
-Allocates maximum RX buffers for incoming packets
-Buffers are chained in NetReceiveBuffers
+Allocates maximum RX buffers for incoming packets of one queue pair
+Buffers are chained in NetReceiveBuffers of the pair
 Parameters:
     context
+    tNetQueuePair *pQueuePair
 ***********************************************************/
-static int PrepareReceiveBuffers(PARANDIS_ADAPTER *pContext)
+static int PrepareReceiveBuffers(PARANDIS_ADAPTER *pContext, tNetQueuePair *pQueuePair)
 {
     int nRet = 0;
     UINT i;
@@ -1074,45 +1167,73 @@ static int PrepareReceiveBuffers(PARANDIS_ADAPTER *pContext)
             AllocatePairOfBuffersOnInit(pContext, size1, size2, FALSE);
         if (!pBuffersDescriptor) break;
 
-        if (!AddRxBufferToQueue(pContext, pBuffersDescriptor))
+        pBuffersDescriptor->pQueuePair = pQueuePair;
+        if (!AddRxBufferToQueue(pContext, pQueuePair, pBuffersDescriptor))
         {
             VirtIONetFreeBufferDescriptor(pContext, pBuffersDescriptor);
             break;
         }
 
-        InsertTailList(&pContext->NetReceiveBuffers, &pBuffersDescriptor->listEntry);
+        InsertTailList(&pQueuePair->NetReceiveBuffers, &pBuffersDescriptor->listEntry);
 
-        pContext->NetNofReceiveBuffers++;
+        pQueuePair->NetNofReceiveBuffers++;
     }
 
-    pContext->NetMaxReceiveBuffers = pContext->NetNofReceiveBuffers;
-    DPrintf(0, ("[%s] MaxReceiveBuffers %d\n", __FUNCTION__, pContext->NetMaxReceiveBuffers) );
+    pQueuePair->NetMaxReceiveBuffers = pQueuePair->NetNofReceiveBuffers;
+    pQueuePair->nReusedRxBuffers = 0;
+    DPrintf(0, ("[%s] Queue %d MaxReceiveBuffers %d\n", __FUNCTION__,
+        pQueuePair->Index, pQueuePair->NetMaxReceiveBuffers) );
 
-    virtqueue_kick(pContext->NetReceiveQueue);
+    virtqueue_kick(pQueuePair->NetReceiveQueue);
 
     return nRet;
 }
 
 static NDIS_STATUS FindNetQueues(PARANDIS_ADAPTER *pContext)
 {
-    struct virtqueue *queues[3];
-    unsigned nvqs = pContext->bHasControlQueue ? 3 : 2;
+    struct virtqueue *queues[MAX_NUM_OF_QUEUES];
+    unsigned nvqs = pContext->nQueuePairs * 2;
+    unsigned nControlIndex = 2;
     NTSTATUS status;
+    UINT i;
 
-    // We work with two or three virtqueues, 0 - receive, 1 - send, 2 - control
-    status = virtio_find_queues(
-       &pContext->IODevice,
-       nvqs,
-       queues);
+    // Queue pairs come first, 2 * n - receive, 2 * n + 1 - send.
+    // The control queue follows the maximal number of pairs of the device,
+    // even if we use less of them.
+    if (pContext->nDeviceQueuePairs)
+    {
+        nControlIndex = pContext->nDeviceQueuePairs * 2;
+    }
+    status = virtio_reserve_queue_memory(
+        &pContext->IODevice,
+        pContext->bHasControlQueue ? nControlIndex + 1 : nvqs);
+    if (NT_SUCCESS(status))
+    {
+        status = virtio_find_queues(
+           &pContext->IODevice,
+           nvqs,
+           queues);
+    }
+    if (NT_SUCCESS(status) && pContext->bHasControlQueue)
+    {
+        status = virtio_find_queue(
+            &pContext->IODevice,
+            nControlIndex,
+            &pContext->NetControlQueue);
+        if (!NT_SUCCESS(status))
+        {
+            virtio_delete_queues(&pContext->IODevice);
+        }
+    }
     if (!NT_SUCCESS(status)) {
        DPrintf(0, ("[%s] virtio_find_queues failed with %x\n", __FUNCTION__, status));
        return NTStatusToNdisStatus(status);
     }
 
-    pContext->NetReceiveQueue = queues[0];
-    pContext->NetSendQueue = queues[1];
-    if (pContext->bHasControlQueue) {
-       pContext->NetControlQueue = queues[2];
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        pContext->QueuePairs[i].NetReceiveQueue = queues[i * 2];
+        pContext->QueuePairs[i].NetSendQueue = queues[i * 2 + 1];
     }
 
     return NDIS_STATUS_SUCCESS;
@@ -1145,10 +1266,14 @@ static NDIS_STATUS ParaNdis_VirtIONetInit(PARANDIS_ADAPTER *pContext)
         return status;
     }
 
-    if (pContext->NetReceiveQueue && pContext->NetSendQueue)
+    if (pContext->QueuePairs[0].NetReceiveQueue && pContext->QueuePairs[0].NetSendQueue)
     {
+        UINT i;
         PrepareTransmitBuffers(pContext);
-        PrepareReceiveBuffers(pContext);
+        for (i = 0; i < pContext->nQueuePairs; ++i)
+        {
+            PrepareReceiveBuffers(pContext, &pContext->QueuePairs[i]);
+        }
 
         if (pContext->NetControlQueue)
             ParaNdis_InitialAllocatePhysicalMemory(pContext, &pContext->ControlData);
@@ -1158,7 +1283,7 @@ static NDIS_STATUS ParaNdis_VirtIONetInit(PARANDIS_ADAPTER *pContext)
             pContext->bHasHardwareFilters = FALSE;
         }
         if (pContext->nofFreeTxDescriptors &&
-            pContext->NetMaxReceiveBuffers &&
+            pContext->QueuePairs[0].NetMaxReceiveBuffers &&
             pContext->maxFreeHardwareBuffers)
         {
             pContext->sgTxGatherTable = ParaNdis_AllocateMemory(pContext,
@@ -1196,6 +1321,7 @@ Return value:
 NDIS_STATUS ParaNdis_FinishInitialization(PARANDIS_ADAPTER *pContext)
 {
     NDIS_STATUS status = NDIS_STATUS_SUCCESS;
+    UINT i;
     DEBUG_ENTRY(0);
 
     NdisAllocateSpinLock(&pContext->SendLock);
@@ -1203,8 +1329,17 @@ NDIS_STATUS ParaNdis_FinishInitialization(PARANDIS_ADAPTER *pContext)
     NdisAllocateSpinLock(&pContext->ReceiveLock);
 #endif
 
-    InitializeListHead(&pContext->NetReceiveBuffers);
-    InitializeListHead(&pContext->NetReceiveBuffersWaiting);
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        tNetQueuePair *pQueuePair = &pContext->QueuePairs[i];
+        pQueuePair->pContext = pContext;
+        pQueuePair->Index = i;
+        NdisAllocateSpinLock(&pQueuePair->ReceiveLock);
+        InitializeListHead(&pQueuePair->NetReceiveBuffers);
+        InitializeListHead(&pQueuePair->NetReceiveBuffersWaiting);
+        KeInitializeDpc(&pQueuePair->ReceiveDpc, ReceiveQueueDpc, pQueuePair);
+        KeSetTargetProcessorDpc(&pQueuePair->ReceiveDpc, (CCHAR)i);
+    }
     InitializeListHead(&pContext->NetSendBuffersInUse);
     InitializeListHead(&pContext->NetFreeSendBuffers);
 
@@ -1215,8 +1350,6 @@ NDIS_STATUS ParaNdis_FinishInitialization(PARANDIS_ADAPTER *pContext)
         status = ParaNdis_VirtIONetInit(pContext);
     }
 
-    pContext->Limits.nReusedRxBuffers = pContext->NetMaxReceiveBuffers / 4 + 1;
-
     if (status == NDIS_STATUS_SUCCESS)
     {
         JustForCheckClearInterrupt(pContext, "start 3");
@@ -1224,6 +1357,7 @@ NDIS_STATUS ParaNdis_FinishInitialization(PARANDIS_ADAPTER *pContext)
         ParaNdis_SetPowerState(pContext, NdisDeviceStateD0);
         virtio_device_ready(&pContext->IODevice);
         JustForCheckClearInterrupt(pContext, "start 4");
+        ConfigureQueuePairs(pContext);
         ParaNdis_UpdateDeviceFilters(pContext);
     }
     else
@@ -1243,14 +1377,13 @@ Return value:
 static void VirtIONetRelease(PARANDIS_ADAPTER *pContext)
 {
     BOOLEAN b;
+    UINT i;
     DEBUG_ENTRY(0);
 
-    /* list NetReceiveBuffersWaiting must be free */
+    /* lists NetReceiveBuffersWaiting must be free */
     do
     {
-        NdisAcquireSpinLock(&pContext->ReceiveLock);
-        b = !IsListEmpty(&pContext->NetReceiveBuffersWaiting);
-        NdisReleaseSpinLock(&pContext->ReceiveLock);
+        b = InterlockedCompareExchange(&pContext->NetNofReceiveBuffersWaiting, 0, 0) != 0;
         if (b)
         {
             DPrintf(0, ("[%s] There are waiting buffers", __FUNCTION__));
@@ -1266,15 +1399,18 @@ static void VirtIONetRelease(PARANDIS_ADAPTER *pContext)
     /* intentionally commented out
     FreeDescriptorsFromList(
         pContext,
-        &pContext->NetReceiveBuffersWaiting,
-        &pContext->ReceiveLock);
+        &pQueuePair->NetReceiveBuffersWaiting,
+        &pQueuePair->ReceiveLock);
     */
 
     /* this can be freed, queue shut down */
-    FreeDescriptorsFromList(
-        pContext,
-        &pContext->NetReceiveBuffers,
-        &pContext->ReceiveLock);
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        FreeDescriptorsFromList(
+            pContext,
+            &pContext->QueuePairs[i].NetReceiveBuffers,
+            &pContext->QueuePairs[i].ReceiveLock);
+    }
 
     /* this can be freed, queue shut down */
     FreeDescriptorsFromList(
@@ -1312,6 +1448,8 @@ static void PreventDPCServicing(PARANDIS_ADAPTER *pContext)
             NdisMSleep(20000);
         }
     } while (inside > 1);
+    /* receive queue DPCs may still be queued on other processors */
+    KeFlushQueuedDpcs();
 }
 
 /**********************************************************
@@ -1472,12 +1610,38 @@ BOOLEAN ParaNdis_OnQueuedInterrupt(
 }
 
 
+/**********************************************************
+Called when the last Rx buffer waiting for return came back from NDIS.
+Signals end of RX pause operation, if one is in progress.
+The counter is checked again under ReceiveLock, as the pause
+could be started (or new packets indicated) in the meantime
+
+Must be called with &pQueuePair->ReceiveLock acquired
+
+Parameters:
+    context
+***********************************************************/
+static void CompleteReceivePause(PARANDIS_ADAPTER *pContext)
+{
+    NdisDprAcquireSpinLock(&pContext->ReceiveLock);
+    if (InterlockedCompareExchange(&pContext->NetNofReceiveBuffersWaiting, 0, 0) == 0 &&
+        (pContext->ReceiveState == srsPausing || pContext->ReceivePauseCompletionProc))
+    {
+        ONPAUSECOMPLETEPROC callback = pContext->ReceivePauseCompletionProc;
+        pContext->ReceiveState = srsDisabled;
+        pContext->ReceivePauseCompletionProc = NULL;
+        ParaNdis_DebugHistory(pContext, hopInternalReceivePause, NULL, 0, 0, 0);
+        if (callback) callback(pContext);
+    }
+    NdisDprReleaseSpinLock(&pContext->ReceiveLock);
+}
+
 /**********************************************************
 It is called from Rx processing routines in regular mode of operation.
 Returns received buffer back to VirtIO queue, inserting it to NetReceiveBuffers.
 If needed, signals end of RX pause operation
 
-Must be called with &pContext->ReceiveLock acquired
+Must be called with &pQueuePair->ReceiveLock of the buffer acquired
 
 Parameters:
     context
@@ -1485,48 +1649,43 @@ Parameters:
 ***********************************************************/
 void ReuseReceiveBufferRegular(PARANDIS_ADAPTER *pContext, pIONetDescriptor pBuffersDescriptor)
 {
+    tNetQueuePair *pQueuePair;
     DEBUG_ENTRY(4);
 
     if(!pBuffersDescriptor)
         return;
 
+    pQueuePair = pBuffersDescriptor->pQueuePair;
     RemoveEntryList(&pBuffersDescriptor->listEntry);
 
-    if(AddRxBufferToQueue(pContext, pBuffersDescriptor))
+    if(AddRxBufferToQueue(pContext, pQueuePair, pBuffersDescriptor))
     {
-        InsertTailList(&pContext->NetReceiveBuffers, &pBuffersDescriptor->listEntry);
+        InsertTailList(&pQueuePair->NetReceiveBuffers, &pBuffersDescriptor->listEntry);
 
-        pContext->NetNofReceiveBuffers++;
+        pQueuePair->NetNofReceiveBuffers++;
 
-        if (pContext->NetNofReceiveBuffers > pContext->NetMaxReceiveBuffers)
+        if (pQueuePair->NetNofReceiveBuffers > pQueuePair->NetMaxReceiveBuffers)
         {
             DPrintf(0, (" Error: NetNofReceiveBuffers > NetMaxReceiveBuffers(%d>%d)",
-                pContext->NetNofReceiveBuffers, pContext->NetMaxReceiveBuffers));
+                pQueuePair->NetNofReceiveBuffers, pQueuePair->NetMaxReceiveBuffers));
         }
 
-        if (++pContext->Counters.nReusedRxBuffers >= pContext->Limits.nReusedRxBuffers)
+        if (++pQueuePair->nReusedRxBuffers >= pQueuePair->NetMaxReceiveBuffers / 4 + 1)
         {
-            pContext->Counters.nReusedRxBuffers = 0;
-            virtqueue_kick_always(pContext->NetReceiveQueue);
-        }
-
-        if (IsListEmpty(&pContext->NetReceiveBuffersWaiting))
-        {
-            if (pContext->ReceiveState == srsPausing || pContext->ReceivePauseCompletionProc)
-            {
-                ONPAUSECOMPLETEPROC callback = pContext->ReceivePauseCompletionProc;
-                pContext->ReceiveState = srsDisabled;
-                pContext->ReceivePauseCompletionProc = NULL;
-                ParaNdis_DebugHistory(pContext, hopInternalReceivePause, NULL, 0, 0, 0);
-                if (callback) callback(pContext);
-            }
+            pQueuePair->nReusedRxBuffers = 0;
+            virtqueue_kick_always(pQueuePair->NetReceiveQueue);
         }
     }
     else
     {
         DPrintf(0, ("FAILED TO REUSE THE BUFFER!!!!"));
         VirtIONetFreeBufferDescriptor(pContext, pBuffersDescriptor);
-        pContext->NetMaxReceiveBuffers--;
+        pQueuePair->NetMaxReceiveBuffers--;
+    }
+
+    if (InterlockedDecrement(&pContext->NetNofReceiveBuffersWaiting) == 0)
+    {
+        CompleteReceivePause(pContext);
     }
 }
 
@@ -1535,7 +1694,7 @@ It is called from Rx processing routines between power off and power on in non-p
 Returns received buffer to NetReceiveBuffers. 
 All the buffers will be placed into Virtio queue during power-on procedure
 
-Must be called with &pContext->ReceiveLock acquired
+Must be called with &pQueuePair->ReceiveLock of the buffer acquired
 
 Parameters:
     context
@@ -1544,7 +1703,8 @@ Parameters:
 static void ReuseReceiveBufferPowerOff(PARANDIS_ADAPTER *pContext, pIONetDescriptor pBuffersDescriptor)
 {
     RemoveEntryList(&pBuffersDescriptor->listEntry);
-    InsertTailList(&pContext->NetReceiveBuffers, &pBuffersDescriptor->listEntry);
+    InsertTailList(&pBuffersDescriptor->pQueuePair->NetReceiveBuffers, &pBuffersDescriptor->listEntry);
+    InterlockedDecrement(&pContext->NetNofReceiveBuffersWaiting);
 }
 
 /**********************************************************
@@ -1562,13 +1722,19 @@ Return value:
 UINT ParaNdis_VirtIONetReleaseTransmitBuffers(
     PARANDIS_ADAPTER *pContext)
 {
-    UINT len, i = 0;
+    UINT len, i = 0, n = 0;
     pIONetDescriptor pBufferDescriptor;
 
     DEBUG_ENTRY(4);
 
-    while(NULL != (pBufferDescriptor = virtqueue_get_buf(pContext->NetSendQueue, &len)))
+    while (n < pContext->nQueuePairs)
     {
+        pBufferDescriptor = virtqueue_get_buf(pContext->QueuePairs[n].NetSendQueue, &len);
+        if (!pBufferDescriptor)
+        {
+            ++n;
+            continue;
+        }
         RemoveEntryList(&pBufferDescriptor->listEntry);
         pContext->nofFreeTxDescriptors++;
         if (!pBufferDescriptor->nofUsedBuffers)
@@ -1592,6 +1758,35 @@ UINT ParaNdis_VirtIONetReleaseTransmitBuffers(
     return i;
 }
 
+/**********************************************************
+Notifies the host about Tx buffers added to the send queues.
+Only the queues that got new buffers since the last kick are kicked,
+unless bAlways is set
+
+Must be called with &pContext->SendLock acquired
+
+Parameters:
+    context
+    BOOLEAN bAlways - kick all the send queues unconditionally
+***********************************************************/
+VOID ParaNdis_KickTxQueues(PARANDIS_ADAPTER *pContext, BOOLEAN bAlways)
+{
+    UINT i;
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        tNetQueuePair *pQueuePair = &pContext->QueuePairs[i];
+        if (bAlways)
+        {
+            virtqueue_kick_always(pQueuePair->NetSendQueue);
+        }
+        else if (pQueuePair->bTxKickPending)
+        {
+            virtqueue_kick(pQueuePair->NetSendQueue);
+        }
+        pQueuePair->bTxKickPending = FALSE;
+    }
+}
+
 static ULONG FORCEINLINE QueryTcpHeaderOffset(PVOID packetData, ULONG ipHeaderOffset, ULONG ipPacketLength)
 {
     ULONG res;
@@ -1658,7 +1853,12 @@ tCopyPacketResult ParaNdis_DoSubmitPacket(PARANDIS_ADAPTER *pContext, tTxOperati
     }
     else if (pContext->nofFreeHardwareBuffers < nRequiredBuffers || !pContext->nofFreeTxDescriptors)
     {
-        virtqueue_enable_cb_delayed(pContext->NetSendQueue);
+        UINT i;
+        // the buffers are shared, any of the send queues may free them
+        for (i = 0; i < pContext->nQueuePairs; ++i)
+        {
+            virtqueue_enable_cb_delayed(pContext->QueuePairs[i].NetSendQueue);
+        }
         result.error = cpeNoBuffer;
     }
     else if (Params->offloadMss && bUseCopy)
@@ -1763,7 +1963,7 @@ tCopyPacketResult ParaNdis_DoSubmitPacket(PARANDIS_ADAPTER *pContext, tTxOperati
                 }
 
                 if (0 <= virtqueue_add_buf(
-                    pContext->NetSendQueue,
+                    Params->pQueuePair->NetSendQueue,
                     sg,
                     nMappedBuffers,
                     0,
@@ -1771,6 +1971,7 @@ tCopyPacketResult ParaNdis_DoSubmitPacket(PARANDIS_ADAPTER *pContext, tTxOperati
                     vaOfIndirectArea,
                     paOfIndirectArea))
                 {
+                    Params->pQueuePair->bTxKickPending = TRUE;
                     pBuffersDescriptor->nofUsedBuffers = nMappedBuffers;
                     pContext->nofFreeHardwareBuffers -= nMappedBuffers;
                     if (pContext->minFreeHardwareBuffers > pContext->nofFreeHardwareBuffers)
@@ -1832,7 +2033,7 @@ tCopyPacketResult ParaNdis_DoSubmitPacket(PARANDIS_ADAPTER *pContext, tTxOperati
     }
     if (result.error == cpeNoBuffer && pContext->bDoKickOnNoBuffer)
     {
-        virtqueue_kick_always(pContext->NetSendQueue);
+        ParaNdis_KickTxQueues(pContext, TRUE);
         pContext->bDoKickOnNoBuffer = FALSE;
     }
     if (result.error == cpeOK)
@@ -1959,7 +2160,7 @@ tCopyPacketResult ParaNdis_DoCopyPacketData(
             if (pContext->minFreeHardwareBuffers > pContext->nofFreeHardwareBuffers)
                 pContext->minFreeHardwareBuffers = pContext->nofFreeHardwareBuffers;
             if (0 > virtqueue_add_buf(
-                pContext->NetSendQueue,
+                pParams->pQueuePair->NetSendQueue,
                 sg,
                 2,
                 0,
@@ -1976,6 +2177,7 @@ tCopyPacketResult ParaNdis_DoCopyPacketData(
             }
             else
             {
+                pParams->pQueuePair->bTxKickPending = TRUE;
                 DPrintf(2, ("[%s] Submitted %d buffers (%d bytes), avail %d desc, %d bufs",
                     __FUNCTION__, nRequiredHardwareBuffers, result.size,
                     pContext->nofFreeTxDescriptors, pContext->nofFreeHardwareBuffers
@@ -2085,27 +2287,34 @@ ParaNdis_PadPacketReceived(PVOID pDataBuffer, PULONG pLength)
 }
 
 /**********************************************************
-Manages RX path, calling NDIS-specific procedure for packet indication
+Manages RX path of one queue pair, calling NDIS-specific procedure for packet indication
+The statistics are collected locally and added to the common ones
+once, so the pairs serviced on different processors do not contend
+for the common ReceiveLock on every packet
 Parameters:
     context
+    tNetQueuePair *pQueuePair
 ***********************************************************/
-static UINT ParaNdis_ProcessRxPath(PARANDIS_ADAPTER *pContext, ULONG ulMaxPacketsToIndicate)
+static UINT ParaNdis_ProcessRxPath(PARANDIS_ADAPTER *pContext, tNetQueuePair *pQueuePair, ULONG ulMaxPacketsToIndicate)
 {
     pIONetDescriptor pBuffersDescriptor;
     UINT len, headerSize = pContext->nVirtioHeaderSize;
     eInspectedPacketType packetType = iptInvalid;
     UINT nReceived = 0, nRetrieved = 0, nReported = 0;
     tPacketIndicationType   *pBatchOfPackets;
-    UINT                    maxPacketsInBatch = pContext->NetMaxReceiveBuffers;
+    UINT                    maxPacketsInBatch = pQueuePair->NetMaxReceiveBuffers;
+    NDIS_STATISTICS_INFO    stat;
+    NdisZeroMemory(&stat, sizeof(stat));
     pBatchOfPackets = pContext->bBatchReceive ?
         ParaNdis_AllocateMemory(pContext, maxPacketsInBatch * sizeof(tPacketIndicationType)) : NULL;
-    NdisAcquireSpinLock(&pContext->ReceiveLock);
-    while ((nReported < ulMaxPacketsToIndicate) && NULL != (pBuffersDescriptor = virtqueue_get_buf(pContext->NetReceiveQueue, &len)))
+    NdisAcquireSpinLock(&pQueuePair->ReceiveLock);
+    while ((nReported < ulMaxPacketsToIndicate) && NULL != (pBuffersDescriptor = virtqueue_get_buf(pQueuePair->NetReceiveQueue, &len)))
     {
         PVOID pDataBuffer = RtlOffsetToPointer(pBuffersDescriptor->DataInfo.Virtual, pContext->bUseMergedBuffers ? pContext->nVirtioHeaderSize : 0);
         RemoveEntryList(&pBuffersDescriptor->listEntry);
-        InsertTailList(&pContext->NetReceiveBuffersWaiting, &pBuffersDescriptor->listEntry);
-        pContext->NetNofReceiveBuffers--;
+        InsertTailList(&pQueuePair->NetReceiveBuffersWaiting, &pBuffersDescriptor->listEntry);
+        InterlockedIncrement(&pContext->NetNofReceiveBuffersWaiting);
+        pQueuePair->NetNofReceiveBuffers--;
         nRetrieved++;
         DPrintf(2, ("[%s] retrieved header+%d b.", __FUNCTION__, len - headerSize));
         DebugDumpPacket("receive", pDataBuffer, 3);
@@ -2119,14 +2328,14 @@ static UINT ParaNdis_ProcessRxPath(PARANDIS_ADAPTER *pContext, ULONG ulMaxPacket
             ULONG length = len - headerSize;
             if (!pBatchOfPackets)
             {
-                NdisReleaseSpinLock(&pContext->ReceiveLock);
+                NdisReleaseSpinLock(&pQueuePair->ReceiveLock);
                 b = NULL != ParaNdis_IndicateReceivedPacket(
                     pContext,
                     pDataBuffer,
                     &length,
                     FALSE,
                     pBuffersDescriptor);
-                NdisAcquireSpinLock(&pContext->ReceiveLock);
+                NdisAcquireSpinLock(&pQueuePair->ReceiveLock);
             }
             else
             {
@@ -2145,35 +2354,35 @@ static UINT ParaNdis_ProcessRxPath(PARANDIS_ADAPTER *pContext, ULONG ulMaxPacket
                 pContext->ReuseBufferProc(pContext, pBuffersDescriptor);
                 //only possible reason for that is unexpected Vlan tag
                 //shall I count it as error?
-                pContext->Statistics.ifInErrors++;
-                pContext->Statistics.ifInDiscards++;
+                stat.ifInErrors++;
+                stat.ifInDiscards++;
             }
             else
             {
                 nReceived++;
                 nReported++;
-                pContext->Statistics.ifHCInOctets += length;
+                stat.ifHCInOctets += length;
                 switch(packetType)
                 {
                     case iptBroadcast:
-                        pContext->Statistics.ifHCInBroadcastPkts++;
-                        pContext->Statistics.ifHCInBroadcastOctets += length;
+                        stat.ifHCInBroadcastPkts++;
+                        stat.ifHCInBroadcastOctets += length;
                         break;
                     case iptMulticast:
-                        pContext->Statistics.ifHCInMulticastPkts++;
-                        pContext->Statistics.ifHCInMulticastOctets += length;
+                        stat.ifHCInMulticastPkts++;
+                        stat.ifHCInMulticastOctets += length;
                         break;
                     default:
-                        pContext->Statistics.ifHCInUcastPkts++;
-                        pContext->Statistics.ifHCInUcastOctets += length;
+                        stat.ifHCInUcastPkts++;
+                        stat.ifHCInUcastOctets += length;
                         break;
                 }
                 if (pBatchOfPackets && nReceived == maxPacketsInBatch)
                 {
                     DPrintf(1, ("[%s] received %d buffers of max %d", __FUNCTION__, nReceived, ulMaxPacketsToIndicate));
-                    NdisReleaseSpinLock(&pContext->ReceiveLock);
+                    NdisReleaseSpinLock(&pQueuePair->ReceiveLock);
                     ParaNdis_IndicateReceivedBatch(pContext, pBatchOfPackets, nReceived);
-                    NdisAcquireSpinLock(&pContext->ReceiveLock);
+                    NdisAcquireSpinLock(&pQueuePair->ReceiveLock);
                     nReceived = 0;
                 }
             }
@@ -2184,8 +2393,22 @@ static UINT ParaNdis_ProcessRxPath(PARANDIS_ADAPTER *pContext, ULONG ulMaxPacket
             pContext->ReuseBufferProc(pContext, pBuffersDescriptor);
         }
     }
-    ParaNdis_DebugHistory(pContext, hopReceiveStat, NULL, nRetrieved, nReported, pContext->NetNofReceiveBuffers);
-    NdisReleaseSpinLock(&pContext->ReceiveLock);
+    ParaNdis_DebugHistory(pContext, hopReceiveStat, NULL, nRetrieved, nReported, pQueuePair->NetNofReceiveBuffers);
+    NdisReleaseSpinLock(&pQueuePair->ReceiveLock);
+    if (nRetrieved)
+    {
+        NdisAcquireSpinLock(&pContext->ReceiveLock);
+        pContext->Statistics.ifInErrors += stat.ifInErrors;
+        pContext->Statistics.ifInDiscards += stat.ifInDiscards;
+        pContext->Statistics.ifHCInOctets += stat.ifHCInOctets;
+        pContext->Statistics.ifHCInBroadcastPkts += stat.ifHCInBroadcastPkts;
+        pContext->Statistics.ifHCInBroadcastOctets += stat.ifHCInBroadcastOctets;
+        pContext->Statistics.ifHCInMulticastPkts += stat.ifHCInMulticastPkts;
+        pContext->Statistics.ifHCInMulticastOctets += stat.ifHCInMulticastOctets;
+        pContext->Statistics.ifHCInUcastPkts += stat.ifHCInUcastPkts;
+        pContext->Statistics.ifHCInUcastOctets += stat.ifHCInUcastOctets;
+        NdisReleaseSpinLock(&pContext->ReceiveLock);
+    }
     if (nReceived && pBatchOfPackets)
     {
         DPrintf(1, ("[%s]%d: received %d buffers of max %d", __FUNCTION__, KeGetCurrentProcessorNumber(), nReceived, ulMaxPacketsToIndicate));
@@ -2222,6 +2445,97 @@ static BOOLEAN RestartQueueSynchronously(tSynchronizedContext *SyncContext)
     ParaNdis_DebugHistory(SyncContext->pContext, hopDPC, (PVOID)SyncContext->Parameter, 0x20, res, 0);
     return !res;
 }
+/**********************************************************
+Receives the packets of one queue pair and restarts its receive queue
+Parameters:
+    context
+    tNetQueuePair *pQueuePair
+    ULONG ulMaxPacketsToIndicate
+Return value:
+    TRUE if the queue still requires processing
+***********************************************************/
+static BOOLEAN ProcessReceiveQueue(PARANDIS_ADAPTER *pContext, tNetQueuePair *pQueuePair, ULONG numOfPacketsToIndicate)
+{
+    UINT uIndicatedRXPackets = 0;
+    int nRestartResult = 0;
+
+    do
+    {
+        LONG rxActive = InterlockedIncrement(&pQueuePair->dpcReceiveActive);
+        if (rxActive == 1)
+        {
+            uIndicatedRXPackets += ParaNdis_ProcessRxPath(pContext, pQueuePair, numOfPacketsToIndicate - uIndicatedRXPackets);
+            InterlockedDecrement(&pQueuePair->dpcReceiveActive);
+            NdisAcquireSpinLock(&pQueuePair->ReceiveLock);
+            nRestartResult = ParaNdis_SynchronizeWithInterrupt(
+                pContext, pContext->ulRxMessage, RestartQueueSynchronously, pQueuePair->NetReceiveQueue);
+            ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)3, nRestartResult, 0, 0);
+            NdisReleaseSpinLock(&pQueuePair->ReceiveLock);
+            DPrintf(nRestartResult ? 2 : 6, ("[%s] queue %d restarted%s", __FUNCTION__, pQueuePair->Index, nRestartResult ? "(Rerun)" : "(Done)"));
+
+            if (uIndicatedRXPackets < numOfPacketsToIndicate)
+            {
+
+            }
+            else if (uIndicatedRXPackets == numOfPacketsToIndicate)
+            {
+                DPrintf(1, ("[%s] Breaking Rx loop after %d indications", __FUNCTION__, uIndicatedRXPackets));
+                ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)4, nRestartResult, 0, 0);
+                break;
+            }
+            else
+            {
+                DPrintf(0, ("[%s] Glitch found: %d allowed, %d indicated", __FUNCTION__, numOfPacketsToIndicate, uIndicatedRXPackets));
+                ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)6, nRestartResult, 0, 0);
+            }
+        }
+        else
+        {
+            InterlockedDecrement(&pQueuePair->dpcReceiveActive);
+            if (!nRestartResult)
+            {
+                NdisAcquireSpinLock(&pQueuePair->ReceiveLock);
+                nRestartResult = ParaNdis_SynchronizeWithInterrupt(
+                    pContext, pContext->ulRxMessage, RestartQueueSynchronously, pQueuePair->NetReceiveQueue);
+                ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)5, nRestartResult, 0, 0);
+                NdisReleaseSpinLock(&pQueuePair->ReceiveLock);
+            }
+            DPrintf(1, ("[%s] Skip Rx processing no.%d", __FUNCTION__, rxActive));
+            break;
+        }
+    } while (nRestartResult);
+
+    return nRestartResult != 0;
+}
+
+/**********************************************************
+DPC of a receive queue, used when there are several queue pairs.
+It runs on the processor the queue is bound to and requeues
+itself while the queue still has packets to process
+Parameters:
+    tNetQueuePair *pQueuePair (DeferredContext)
+***********************************************************/
+static VOID NTAPI ReceiveQueueDpc(PKDPC Dpc, PVOID DeferredContext, PVOID SystemArgument1, PVOID SystemArgument2)
+{
+    tNetQueuePair *pQueuePair = (tNetQueuePair *)DeferredContext;
+    PARANDIS_ADAPTER *pContext = pQueuePair->pContext;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    InterlockedIncrement(&pContext->counterDPCInside);
+    if (pContext->bEnableInterruptHandlingDPC)
+    {
+        InterlockedExchange(&pContext->bDPCInactive, 0);
+        if (ProcessReceiveQueue(pContext, pQueuePair, pContext->uNumberOfHandledRXPacketsInDPC))
+        {
+            KeInsertQueueDpc(&pQueuePair->ReceiveDpc, NULL, NULL);
+        }
+    }
+    InterlockedDecrement(&pContext->counterDPCInside);
+}
+
 /**********************************************************
 DPC implementation, common for both NDIS
 Parameters:
@@ -2231,7 +2545,6 @@ ULONG ParaNdis_DPCWorkBody(PARANDIS_ADAPTER *pContext, ULONG ulMaxPacketsToIndic
 {
     ULONG stillRequiresProcessing = 0;
     ULONG interruptSources;
-    UINT uIndicatedRXPackets = 0;
     UINT numOfPacketsToIndicate = min(ulMaxPacketsToIndicate, pContext->uNumberOfHandledRXPacketsInDPC);
 
     DEBUG_ENTRY(5);
@@ -2255,68 +2568,37 @@ ULONG ParaNdis_DPCWorkBody(PARANDIS_ADAPTER *pContext, ULONG ulMaxPacketsToIndic
             }
             if (interruptSources & isReceive)
             {
-                int nRestartResult = 0;
-
-                do
+                if (pContext->nQueuePairs == 1)
                 {
-                    LONG rxActive = InterlockedIncrement(&pContext->dpcReceiveActive);
-                    if (rxActive == 1)
-                    {
-                        uIndicatedRXPackets += ParaNdis_ProcessRxPath(pContext, numOfPacketsToIndicate - uIndicatedRXPackets);
-                        InterlockedDecrement(&pContext->dpcReceiveActive);
-                        NdisAcquireSpinLock(&pContext->ReceiveLock);
-                        nRestartResult = ParaNdis_SynchronizeWithInterrupt(
-                            pContext, pContext->ulRxMessage, RestartQueueSynchronously, pContext->NetReceiveQueue);
-                        ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)3, nRestartResult, 0, 0);
-                        NdisReleaseSpinLock(&pContext->ReceiveLock);
-                        DPrintf(nRestartResult ? 2 : 6, ("[%s] queue restarted%s", __FUNCTION__, nRestartResult ? "(Rerun)" : "(Done)"));
-
-                        if (uIndicatedRXPackets < numOfPacketsToIndicate)
-                        {
-
-                        }
-                        else if (uIndicatedRXPackets == numOfPacketsToIndicate)
-                        {
-                            DPrintf(1, ("[%s] Breaking Rx loop after %d indications", __FUNCTION__, uIndicatedRXPackets));
-                            ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)4, nRestartResult, 0, 0);
-                            break;
-                        }
-                        else
-                        {
-                            DPrintf(0, ("[%s] Glitch found: %d allowed, %d indicated", __FUNCTION__, numOfPacketsToIndicate, uIndicatedRXPackets));
-                            ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)6, nRestartResult, 0, 0);
-                        }
-                    }
-                    else
+                    if (ProcessReceiveQueue(pContext, &pContext->QueuePairs[0], numOfPacketsToIndicate))
+                        stillRequiresProcessing |= isReceive;
+                }
+                else
+                {
+                    UINT i;
+                    // each receive queue is serviced on its own processor
+                    for (i = 0; i < pContext->nQueuePairs; ++i)
                     {
-                        InterlockedDecrement(&pContext->dpcReceiveActive);
-                        if (!nRestartResult)
-                        {
-                            NdisAcquireSpinLock(&pContext->ReceiveLock);
-                            nRestartResult = ParaNdis_SynchronizeWithInterrupt(
-                                pContext, pContext->ulRxMessage, RestartQueueSynchronously, pContext->NetReceiveQueue);
-                            ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)5, nRestartResult, 0, 0);
-                            NdisReleaseSpinLock(&pContext->ReceiveLock);
-                        }
-                        DPrintf(1, ("[%s] Skip Rx processing no.%d", __FUNCTION__, rxActive));
-                        break;
+                        KeInsertQueueDpc(&pContext->QueuePairs[i].ReceiveDpc, NULL, NULL);
                     }
-                } while (nRestartResult);
-
-                if (nRestartResult) stillRequiresProcessing |= isReceive;
+                }
             }
 
             if (interruptSources & isTransmit)
             {
+                UINT i;
                 NdisAcquireSpinLock(&pContext->SendLock);
-                if (ParaNdis_SynchronizeWithInterrupt(pContext, pContext->ulTxMessage, RestartQueueSynchronously, pContext->NetSendQueue))
-                    stillRequiresProcessing |= isTransmit;
+                for (i = 0; i < pContext->nQueuePairs; ++i)
+                {
+                    if (ParaNdis_SynchronizeWithInterrupt(pContext, pContext->ulTxMessage, RestartQueueSynchronously, pContext->QueuePairs[i].NetSendQueue))
+                        stillRequiresProcessing |= isTransmit;
+                }
                 if(bDoKick)
                 {
 #ifdef PARANDIS_TEST_TX_KICK_ALWAYS
-                    virtqueue_kick_always(pContext->NetSendQueue);
+                    ParaNdis_KickTxQueues(pContext, TRUE);
 #else
-                    virtqueue_kick(pContext->NetSendQueue);
+                    ParaNdis_KickTxQueues(pContext, FALSE);
 #endif
                 }
                 NdisReleaseSpinLock(&pContext->SendLock);
@@ -2484,19 +2766,27 @@ Parameters:
 ***********************************************************/
 VOID ParaNdis_VirtIOEnableIrqSynchronized(PARANDIS_ADAPTER *pContext, ULONG interruptSource)
 {
-    if (interruptSource & isTransmit)
-        virtqueue_enable_cb(pContext->NetSendQueue);
-    if (interruptSource & isReceive)
-        virtqueue_enable_cb(pContext->NetReceiveQueue);
+    UINT i;
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        if (interruptSource & isTransmit)
+            virtqueue_enable_cb(pContext->QueuePairs[i].NetSendQueue);
+        if (interruptSource & isReceive)
+            virtqueue_enable_cb(pContext->QueuePairs[i].NetReceiveQueue);
+    }
     ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)0x10, interruptSource, TRUE, 0);
 }
 
 VOID ParaNdis_VirtIODisableIrqSynchronized(PARANDIS_ADAPTER *pContext, ULONG interruptSource)
 {
-    if (interruptSource & isTransmit)
-        virtqueue_disable_cb(pContext->NetSendQueue);
-    if (interruptSource & isReceive)
-        virtqueue_disable_cb(pContext->NetReceiveQueue);
+    UINT i;
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        if (interruptSource & isTransmit)
+            virtqueue_disable_cb(pContext->QueuePairs[i].NetSendQueue);
+        if (interruptSource & isReceive)
+            virtqueue_disable_cb(pContext->QueuePairs[i].NetReceiveQueue);
+    }
     ParaNdis_DebugHistory(pContext, hopDPC, (PVOID)0x10, interruptSource, FALSE, 0);
 }
 
@@ -2717,10 +3007,77 @@ VOID ParaNdis_UpdateDeviceFilters(PARANDIS_ADAPTER *pContext)
     }
 }
 
+/**********************************************************
+Switches the device to the number of queue pairs we use.
+With device RSS our hash key and indirection table are sent along,
+otherwise the device steers the flows following the queue
+they are transmitted from.
+If the device refuses, only the first pair is used for transmit
+(and only it gets receive packets)
+Must be called after the device is ready
+Parameters:
+    context
+***********************************************************/
+static void ConfigureQueuePairs(PARANDIS_ADAPTER *pContext)
+{
+    BOOLEAN bOK;
+
+    if (pContext->nQueuePairs == 1)
+        return;
+
+    ParaNdis_RSSSetQueuePairs(pContext, pContext->nQueuePairs);
+    if (pContext->bHasDeviceRSS)
+    {
+        virtio_net_rss_config rss;
+        UINT i;
+        rss.hash_types = VIRTIO_NET_RSS_HASH_TYPE_IPv4 | VIRTIO_NET_RSS_HASH_TYPE_TCPv4;
+        rss.indirection_table_mask = PARANDIS_RSS_INDIRECTION_TABLE_SIZE - 1;
+        rss.unclassified_queue = 0;
+        for (i = 0; i < PARANDIS_RSS_INDIRECTION_TABLE_SIZE; ++i)
+        {
+            rss.indirection_table[i] = pContext->RSSIndirectionTable[i];
+        }
+        rss.max_tx_vq = (u16)pContext->nQueuePairs;
+        rss.hash_key_length = PARANDIS_RSS_HASH_KEY_SIZE;
+        NdisMoveMemory(rss.hash_key_data, pContext->RSSHashKey, PARANDIS_RSS_HASH_KEY_SIZE);
+        bOK = SendControlMessage(pContext, VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_RSS_CONFIG, &rss, sizeof(rss), NULL, 0, 2);
+    }
+    else
+    {
+        u16 nPairs = (u16)pContext->nQueuePairs;
+        bOK = SendControlMessage(pContext, VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &nPairs, sizeof(nPairs), NULL, 0, 2);
+    }
+
+    if (!bOK)
+    {
+        DPrintf(0, ("[%s] ERROR: device refused %d queue pairs", __FUNCTION__, pContext->nQueuePairs));
+        ParaNdis_RSSSetQueuePairs(pContext, 1);
+    }
+}
+
+static void AcquireReceiveLocks(PARANDIS_ADAPTER *pContext)
+{
+    UINT i;
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        NdisAcquireSpinLock(&pContext->QueuePairs[i].ReceiveLock);
+    }
+}
+
+static void ReleaseReceiveLocks(PARANDIS_ADAPTER *pContext)
+{
+    UINT i = pContext->nQueuePairs;
+    while (i--)
+    {
+        NdisReleaseSpinLock(&pContext->QueuePairs[i].ReceiveLock);
+    }
+}
+
 NDIS_STATUS ParaNdis_PowerOn(PARANDIS_ADAPTER *pContext)
 {
     LIST_ENTRY TempList;
     NDIS_STATUS status;
+    UINT i;
     DEBUG_ENTRY(0);
     ParaNdis_DebugHistory(pContext, hopPowerOn, NULL, 1, 0, 0);
     ParaNdis_ResetVirtIONetDevice(pContext);
@@ -2739,6 +3096,12 @@ NDIS_STATUS ParaNdis_PowerOn(PARANDIS_ADAPTER *pContext)
         VirtIODeviceEnableGuestFeature(pContext, VIRTIO_F_VERSION_1);
     if (VirtIODeviceGetHostFeature(pContext, VIRTIO_F_ANY_LAYOUT))
         VirtIODeviceEnableGuestFeature(pContext, VIRTIO_F_ANY_LAYOUT);
+    if (pContext->bHasControlQueue)
+        VirtIODeviceEnableGuestFeature(pContext, VIRTIO_NET_F_CTRL_VQ);
+    if (pContext->nDeviceQueuePairs)
+        VirtIODeviceEnableGuestFeature(pContext, VIRTIO_NET_F_MQ);
+    if (pContext->bHasDeviceRSS)
+        VirtIODeviceEnableGuestFeature(pContext, VIRTIO_NET_F_RSS);
 
     status = FinalizeFeatures(pContext);
     if (status == NDIS_STATUS_SUCCESS) {
@@ -2756,39 +3119,45 @@ NDIS_STATUS ParaNdis_PowerOn(PARANDIS_ADAPTER *pContext)
     InitializeListHead(&TempList);
     
     /* submit all the receive buffers */
-    NdisAcquireSpinLock(&pContext->ReceiveLock);
-    
+    AcquireReceiveLocks(pContext);
+
     pContext->ReuseBufferProc = (tReuseReceiveBufferProc)ReuseReceiveBufferRegular;
     
-    while (!IsListEmpty(&pContext->NetReceiveBuffers))
-    {
-        pIONetDescriptor pBufferDescriptor =
-            (pIONetDescriptor)RemoveHeadList(&pContext->NetReceiveBuffers);
-        InsertTailList(&TempList, &pBufferDescriptor->listEntry);
-    }
-    pContext->NetNofReceiveBuffers = 0;
-    while (!IsListEmpty(&TempList))
+    for (i = 0; i < pContext->nQueuePairs; ++i)
     {
-        pIONetDescriptor pBufferDescriptor =
-            (pIONetDescriptor)RemoveHeadList(&TempList);
-        if (AddRxBufferToQueue(pContext, pBufferDescriptor))
+        tNetQueuePair *pQueuePair = &pContext->QueuePairs[i];
+        while (!IsListEmpty(&pQueuePair->NetReceiveBuffers))
         {
-            InsertTailList(&pContext->NetReceiveBuffers, &pBufferDescriptor->listEntry);
-            pContext->NetNofReceiveBuffers++;
+            pIONetDescriptor pBufferDescriptor =
+                (pIONetDescriptor)RemoveHeadList(&pQueuePair->NetReceiveBuffers);
+            InsertTailList(&TempList, &pBufferDescriptor->listEntry);
         }
-        else
+        pQueuePair->NetNofReceiveBuffers = 0;
+        while (!IsListEmpty(&TempList))
         {
-            DPrintf(0, ("FAILED TO REUSE THE BUFFER!!!!"));
-            VirtIONetFreeBufferDescriptor(pContext, pBufferDescriptor);
-            pContext->NetMaxReceiveBuffers--;
+            pIONetDescriptor pBufferDescriptor =
+                (pIONetDescriptor)RemoveHeadList(&TempList);
+            if (AddRxBufferToQueue(pContext, pQueuePair, pBufferDescriptor))
+            {
+                InsertTailList(&pQueuePair->NetReceiveBuffers, &pBufferDescriptor->listEntry);
+                pQueuePair->NetNofReceiveBuffers++;
+            }
+            else
+            {
+                DPrintf(0, ("FAILED TO REUSE THE BUFFER!!!!"));
+                VirtIONetFreeBufferDescriptor(pContext, pBufferDescriptor);
+                pQueuePair->NetMaxReceiveBuffers--;
+            }
         }
+        virtqueue_kick(pQueuePair->NetReceiveQueue);
     }
-    virtqueue_kick(pContext->NetReceiveQueue);
     ParaNdis_SetPowerState(pContext, NdisDeviceStateD0);
     pContext->bEnableInterruptHandlingDPC = TRUE;
     virtio_device_ready(&pContext->IODevice);
     
-    NdisReleaseSpinLock(&pContext->ReceiveLock);
+    ReleaseReceiveLocks(pContext);
+
+    ConfigureQueuePairs(pContext);
 
     // if bFastSuspendInProcess is set by Win8 power-off procedure,
     // the ParaNdis_Resume enables Tx and RX
@@ -2804,6 +3173,7 @@ NDIS_STATUS ParaNdis_PowerOn(PARANDIS_ADAPTER *pContext)
 
 VOID ParaNdis_PowerOff(PARANDIS_ADAPTER *pContext)
 {
+    UINT i;
     DEBUG_ENTRY(0);
     ParaNdis_DebugHistory(pContext, hopPowerOff, NULL, 1, 0, 0);
 
@@ -2821,9 +3191,9 @@ VOID ParaNdis_PowerOff(PARANDIS_ADAPTER *pContext)
     
     if (pContext->bFastSuspendInProcess)
     {
-        NdisAcquireSpinLock(&pContext->ReceiveLock);
+        AcquireReceiveLocks(pContext);
         pContext->ReuseBufferProc = (tReuseReceiveBufferProc)ReuseReceiveBufferPowerOff;
-        NdisReleaseSpinLock(&pContext->ReceiveLock);
+        ReleaseReceiveLocks(pContext);
     }
     
     ParaNdis_SetPowerState(pContext, NdisDeviceStateD3);
@@ -2836,7 +3206,11 @@ VOID ParaNdis_PowerOff(PARANDIS_ADAPTER *pContext)
     ********************************************************************/
 
     NdisAcquireSpinLock(&pContext->SendLock);
-    virtqueue_shutdown(pContext->NetSendQueue);
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        virtqueue_shutdown(pContext->QueuePairs[i].NetSendQueue);
+        pContext->QueuePairs[i].bTxKickPending = FALSE;
+    }
     while (!IsListEmpty(&pContext->NetSendBuffersInUse))
     {
         pIONetDescriptor pBufferDescriptor =
@@ -2847,17 +3221,23 @@ VOID ParaNdis_PowerOff(PARANDIS_ADAPTER *pContext)
     }
     NdisReleaseSpinLock(&pContext->SendLock);
 
-    NdisAcquireSpinLock(&pContext->ReceiveLock);
-    virtqueue_shutdown(pContext->NetReceiveQueue);
-    NdisReleaseSpinLock(&pContext->ReceiveLock);
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        NdisAcquireSpinLock(&pContext->QueuePairs[i].ReceiveLock);
+        virtqueue_shutdown(pContext->QueuePairs[i].NetReceiveQueue);
+        NdisReleaseSpinLock(&pContext->QueuePairs[i].ReceiveLock);
+    }
     if (pContext->NetControlQueue) {
         virtqueue_shutdown(pContext->NetControlQueue);
     }
 
     DPrintf(0, ("WARNING: deleting queues!!!!!!!!!"));
     DeleteNetQueues(pContext);
-    pContext->NetSendQueue = NULL;
-    pContext->NetReceiveQueue = NULL;
+    for (i = 0; i < pContext->nQueuePairs; ++i)
+    {
+        pContext->QueuePairs[i].NetSendQueue = NULL;
+        pContext->QueuePairs[i].NetReceiveQueue = NULL;
+    }
     pContext->NetControlQueue = NULL;
 
     ParaNdis_ResetVirtIONetDevice(pContext);
@@ -265,7 +265,7 @@ NDIS_STATUS ParaNdis_OidQueryCommon(PARANDIS_ADAPTER *pContext, tOidDesc *pOid)
         SETINFO(ul, pContext->MaxPacketSize.nMaxFullSizeOS * pContext->nofFreeTxDescriptors);
         break;
     case OID_GEN_RECEIVE_BUFFER_SPACE:
-        SETINFO(ul, pContext->MaxPacketSize.nMaxFullSizeOS * pContext->NetMaxReceiveBuffers);
+        SETINFO(ul, pContext->MaxPacketSize.nMaxFullSizeOS * pContext->NetMaxReceiveBuffers * pContext->nQueuePairs);
         break;
     case OID_GEN_RECEIVE_BLOCK_SIZE:
         __fallthrough;
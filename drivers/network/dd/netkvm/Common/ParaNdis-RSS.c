@@ -0,0 +1,143 @@
+/*
+ * This file contains receive side scaling support: the Toeplitz hash,
+ * the indirection table and transmit queue selection
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met :
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and / or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of their contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "ndis56common.h"
+
+#ifdef WPP_EVENT_TRACING
+#include "ParaNdis-RSS.tmh"
+#endif
+
+#define ETH_TYPE_IPV4           0x0800
+#define IP_PROTOCOL_TCP         6
+#define IP_FRAGMENT_MASK        0x3FFF
+
+/* the default key from the Microsoft RSS specification */
+static const UCHAR DefaultRSSHashKey[PARANDIS_RSS_HASH_KEY_SIZE] =
+{
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+    0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+    0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+    0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+/**********************************************************
+Toeplitz hash of the input, the key must be at least 4 bytes
+longer than the input
+***********************************************************/
+static ULONG ToeplitzHash(const UCHAR *pKey, const UCHAR *pInput, ULONG ulLength)
+{
+    ULONG hash = 0;
+    ULONG window = ((ULONG)pKey[0] << 24) | ((ULONG)pKey[1] << 16) |
+                   ((ULONG)pKey[2] << 8) | pKey[3];
+    ULONG i, bit;
+
+    for (i = 0; i < ulLength; ++i)
+    {
+        UCHAR nextKeyByte = pKey[i + 4];
+        for (bit = 0; bit < 8; ++bit)
+        {
+            if (pInput[i] & (0x80 >> bit))
+                hash ^= window;
+            window = (window << 1) | ((nextKeyByte >> (7 - bit)) & 1);
+        }
+    }
+    return hash;
+}
+
+/**********************************************************
+Loads the hash key and spreads the indirection table over
+the active queue pairs
+***********************************************************/
+VOID ParaNdis_RSSInitialize(PARANDIS_ADAPTER *pContext)
+{
+    NdisMoveMemory(pContext->RSSHashKey, DefaultRSSHashKey, sizeof(pContext->RSSHashKey));
+    ParaNdis_RSSSetQueuePairs(pContext, pContext->nQueuePairs);
+}
+
+/**********************************************************
+Rebuilds the indirection table for given number of queue pairs.
+The same table is programmed into the device (if it does RSS)
+so receive and transmit of one flow land on the same pair.
+***********************************************************/
+VOID ParaNdis_RSSSetQueuePairs(PARANDIS_ADAPTER *pContext, UINT nQueuePairs)
+{
+    UINT i;
+
+    if (nQueuePairs == 0 || nQueuePairs > pContext->nQueuePairs)
+        nQueuePairs = 1;
+
+    for (i = 0; i < PARANDIS_RSS_INDIRECTION_TABLE_SIZE; ++i)
+    {
+        pContext->RSSIndirectionTable[i] = (UCHAR)(i % nQueuePairs);
+    }
+    DPrintf(1, ("[%s] %d queue pair(s) in use", __FUNCTION__, nQueuePairs));
+}
+
+/**********************************************************
+Calculates the hash of an outgoing packet, as the peer's receive
+side would see it: addresses and ports are taken in reverse order.
+Non-IPv4 packets hash to 0, i.e. go to the first queue pair.
+Parameters:
+    pEthHeader - start of the frame
+    ulLength - number of contiguous bytes available at pEthHeader
+***********************************************************/
+ULONG ParaNdis_RSSCalculateTxHash(PARANDIS_ADAPTER *pContext, PVOID pEthHeader, ULONG ulLength)
+{
+    ETH_HEADER *pEth = (ETH_HEADER *)pEthHeader;
+    IPv4Header *pIp;
+    ULONG ipHeaderSize;
+    UCHAR input[12];
+    ULONG inputLength = 8;
+
+    if (!pContext->bRSSEnabled || pContext->nQueuePairs < 2)
+        return 0;
+    if (ulLength < ETH_HEADER_SIZE + sizeof(IPv4Header))
+        return 0;
+    if (pEth->EthType != swap_short(ETH_TYPE_IPV4))
+        return 0;
+
+    pIp = (IPv4Header *)((PUCHAR)pEthHeader + ETH_HEADER_SIZE);
+    ipHeaderSize = (pIp->ip_verlen & 0x0F) << 2;
+    if ((pIp->ip_verlen & 0xF0) != 0x40 || ipHeaderSize < sizeof(IPv4Header))
+        return 0;
+
+    NdisMoveMemory(input, &pIp->ip_dest, sizeof(ULONG));
+    NdisMoveMemory(input + 4, &pIp->ip_src, sizeof(ULONG));
+
+    if (pIp->ip_protocol == IP_PROTOCOL_TCP &&
+        !(pIp->ip_offset & swap_short(IP_FRAGMENT_MASK)) &&
+        ulLength >= ETH_HEADER_SIZE + ipHeaderSize + 2 * sizeof(USHORT))
+    {
+        TCPHeader *pTcp = (TCPHeader *)((PUCHAR)pIp + ipHeaderSize);
+        NdisMoveMemory(input + 8, &pTcp->tcp_dest, sizeof(USHORT));
+        NdisMoveMemory(input + 10, &pTcp->tcp_src, sizeof(USHORT));
+        inputLength = 12;
+    }
+
+    return ToeplitzHash(pContext->RSSHashKey, input, inputLength);
+}
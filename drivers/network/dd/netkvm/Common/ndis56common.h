@@ -89,8 +89,17 @@
 // to be set to real limit later
 #define MAX_RX_LOOPS    1000
 
+// maximum number of receive/transmit queue pairs used by the driver
+#define PARANDIS_MAX_QUEUE_PAIRS    8
+
 // maximum number of virtio queues used by the driver
-#define MAX_NUM_OF_QUEUES 3
+#define MAX_NUM_OF_QUEUES (PARANDIS_MAX_QUEUE_PAIRS * 2 + 1)
+
+// receive-side scaling hash key and indirection table sizes
+#define PARANDIS_RSS_HASH_KEY_SIZE          40
+#define PARANDIS_RSS_INDIRECTION_TABLE_SIZE 128
+// Ethernet, IPv4 header with options and TCP/UDP ports
+#define PARANDIS_RSS_TX_HEADERS_SIZE        (ETH_HEADER_SIZE + MAX_IPV4_HEADER_SIZE + 4)
 
 /* The feature bitmap for virtio net */
 #define VIRTIO_NET_F_CSUM   0   /* Host handles pkts w/ partial csum */
@@ -111,6 +120,8 @@
 #define VIRTIO_NET_F_CTRL_RX    18      /* Control channel RX mode support */
 #define VIRTIO_NET_F_CTRL_VLAN  19      /* Control channel VLAN filtering */
 #define VIRTIO_NET_F_CTRL_RX_EXTRA 20   /* Extra RX mode control support */
+#define VIRTIO_NET_F_MQ         22      /* Device supports multiple Rx/Tx queue pairs */
+#define VIRTIO_NET_F_RSS        60      /* Device supports RSS (Toeplitz hash steering) */
 
 #define VIRTIO_NET_S_LINK_UP    1       /* Link is up */
 
@@ -303,7 +314,6 @@ typedef struct _tagNdisOffloadParams
 
 typedef struct _tagOurCounters
 {
-    UINT nReusedRxBuffers;
     UINT nPrintDiagnostic;
     ULONG64 prevIn;
     UINT nRxInactivity;
@@ -339,10 +349,40 @@ typedef struct _tagIONetDescriptor {
     tPacketHolderType pHolder;
     PVOID ReferenceValue;
     UINT  nofUsedBuffers;
+    /* queue pair the Rx buffer belongs to */
+    struct _tagNetQueuePair *pQueuePair;
 } IONetDescriptor, * pIONetDescriptor;
 
 typedef void (*tReuseReceiveBufferProc)(void *pContext, pIONetDescriptor pDescriptor);
 
+/*
+One receive/transmit virtqueue pair. With VIRTIO_NET_F_MQ there is one pair
+per processor, each receive queue is serviced by its own DPC targeted to that
+processor, so the packets of a flow are always indicated on the same CPU.
+Tx descriptors and hardware buffer accounting stay common for all the pairs.
+*/
+typedef struct _tagNetQueuePair
+{
+    struct _tagPARANDIS_ADAPTER *pContext;
+    UINT                    Index;
+    struct virtqueue *      NetReceiveQueue;
+    struct virtqueue *      NetSendQueue;
+    /* protects the receive queue and the Rx lists of the pair */
+    NDIS_SPIN_LOCK          ReceiveLock;
+    /* list of Rx buffers available for data (under VIRTIO management) */
+    LIST_ENTRY              NetReceiveBuffers;
+    UINT                    NetNofReceiveBuffers;
+    /* list of Rx buffers waiting for return (under NDIS management) */
+    LIST_ENTRY              NetReceiveBuffersWaiting;
+    /* total of Rx buffer in turnaround */
+    UINT                    NetMaxReceiveBuffers;
+    UINT                    nReusedRxBuffers;
+    LONG                    dpcReceiveActive;
+    /* Tx buffers were added since the last kick (under SendLock) */
+    BOOLEAN                 bTxKickPending;
+    KDPC                    ReceiveDpc;
+} tNetQueuePair;
+
 typedef struct _tagPARANDIS_ADAPTER
 {
     NDIS_HANDLE             DriverHandle;
@@ -387,7 +427,6 @@ typedef struct _tagPARANDIS_ADAPTER
     tMulticastData          MulticastData;
     UINT                    uNumberOfHandledRXPacketsInDPC;
     NDIS_DEVICE_POWER_STATE powerState;
-    LONG                    dpcReceiveActive;
     LONG                    counterDPCInside;
     LONG                    bDPCInactive;
     LONG                    InterruptStatus;
@@ -406,6 +445,14 @@ typedef struct _tagPARANDIS_ADAPTER
     ULONG                   nDetectedStoppedTx;
     ULONG                   nDetectedInactivity;
     ULONG                   nVirtioHeaderSize;
+    /* multiqueue and receive-side scaling */
+    BOOLEAN                 bRSSEnabled;
+    BOOLEAN                 bHasDeviceRSS;
+    UINT                    nMaxQueuePairs;
+    UINT                    nQueuePairs;
+    UINT                    nDeviceQueuePairs;
+    UCHAR                   RSSHashKey[PARANDIS_RSS_HASH_KEY_SIZE];
+    UCHAR                   RSSIndirectionTable[PARANDIS_RSS_INDIRECTION_TABLE_SIZE];
     /* send part */
 #if !defined(UNIFY_LOCKS)
     NDIS_SPIN_LOCK          SendLock;
@@ -439,13 +486,9 @@ typedef struct _tagPARANDIS_ADAPTER
     /* Net part - management of buffers and queues of QEMU */
     struct virtqueue *      NetControlQueue;
     tCompletePhysicalAddress ControlData;
-    struct virtqueue *      NetReceiveQueue;
-    struct virtqueue *      NetSendQueue;
-    /* list of Rx buffers available for data (under VIRTIO management) */
-    LIST_ENTRY              NetReceiveBuffers;
-    UINT                    NetNofReceiveBuffers;
-    /* list of Rx buffers waiting for return (under NDIS management) */
-    LIST_ENTRY              NetReceiveBuffersWaiting;
+    tNetQueuePair           QueuePairs[PARANDIS_MAX_QUEUE_PAIRS];
+    /* number of Rx buffers of all the pairs waiting for return (under NDIS management) */
+    LONG                    NetNofReceiveBuffersWaiting;
     /* list of Tx buffers in process (under VIRTIO management) */
     LIST_ENTRY              NetSendBuffersInUse;
     /* list of Tx buffers ready for data (under MINIPORT management) */
@@ -462,7 +505,7 @@ typedef struct _tagPARANDIS_ADAPTER
     UINT                    minFreeHardwareBuffers;
     /* current number of Tx packets (or lists) to return */
     LONG                    NetTxPacketsToReturn;
-    /* total of Rx buffer in turnaround */
+    /* Rx buffers per queue pair (from cfg) */
     UINT                    NetMaxReceiveBuffers;
     struct VirtIOBufferDescriptor *sgTxGatherTable;
     UINT                    nPnpEventIndex;
@@ -590,9 +633,9 @@ static __inline struct virtqueue *
 ParaNdis_GetQueueForInterrupt(PARANDIS_ADAPTER *pContext, ULONG interruptSource)
 {
     if (interruptSource & isTransmit)
-        return pContext->NetSendQueue;
+        return pContext->QueuePairs[0].NetSendQueue;
     if (interruptSource & isReceive)
-        return pContext->NetReceiveQueue;
+        return pContext->QueuePairs[0].NetReceiveQueue;
 
     return NULL;
 }
@@ -669,6 +712,7 @@ void ParaNdis_DebugHistory(
 
 typedef struct _tagTxOperationParameters
 {
+    tNetQueuePair   *pQueuePair;
     tPacketType     packet;
     PVOID           ReferenceValue;
     UINT            nofSGFragments;
@@ -698,6 +742,24 @@ tChecksumCheckResult ParaNdis_CheckRxChecksum(PARANDIS_ADAPTER *pContext, ULONG
 
 void ParaNdis_CallOnBugCheck(PARANDIS_ADAPTER *pContext);
 
+VOID ParaNdis_KickTxQueues(PARANDIS_ADAPTER *pContext, BOOLEAN bAlways);
+
+/* receive-side scaling */
+VOID ParaNdis_RSSInitialize(PARANDIS_ADAPTER *pContext);
+
+VOID ParaNdis_RSSSetQueuePairs(PARANDIS_ADAPTER *pContext, UINT nQueuePairs);
+
+ULONG ParaNdis_RSSCalculateTxHash(PARANDIS_ADAPTER *pContext, PVOID pEthHeader, ULONG ulLength);
+
+static __inline tNetQueuePair *
+ParaNdis_RSSGetTxQueuePair(PARANDIS_ADAPTER *pContext, ULONG ulHash)
+{
+    UINT index = pContext->RSSIndirectionTable[ulHash % PARANDIS_RSS_INDIRECTION_TABLE_SIZE];
+    if (index >= pContext->nQueuePairs)
+        index = 0;
+    return &pContext->QueuePairs[index];
+}
+
 /*****************************************************
 Procedures to implement for NDIS specific implementation
 ******************************************************/
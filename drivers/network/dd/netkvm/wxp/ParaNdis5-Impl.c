@@ -52,6 +52,7 @@ typedef struct _tagSendEntry
     PNDIS_PACKET    packet;
     ULONG           flags;
     ULONG           ipTransferUnit;
+    ULONG           ulFlowHash;
     union
     {
         ULONG PriorityDataLong;
@@ -276,7 +277,7 @@ NDIS_STATUS NTAPI ParaNdis_FinishSpecificInitialization(
     PARANDIS_ADAPTER *pContext)
 {
     NDIS_STATUS     status;
-    UINT            nPackets = pContext->NetMaxReceiveBuffers * 2;
+    UINT            nPackets = pContext->NetMaxReceiveBuffers * pContext->nQueuePairs * 2;
     DEBUG_ENTRY(2);
     NdisInitializeEvent(&pContext->HaltEvent);
     InitializeListHead(&pContext->SendQueue);
@@ -968,6 +969,7 @@ BOOLEAN ParaNdis_ProcessTx(
             tTxOperationParameters Params;
             pEntry = (tSendEntry *)RemoveHeadList(&pContext->SendQueue);
             InitializeTransferParameters(&Params, pEntry);
+            Params.pQueuePair = ParaNdis_RSSGetTxQueuePair(pContext, pEntry->ulFlowHash);
             bDataAvailable = TRUE;
             result = ParaNdis_DoSubmitPacket(pContext, &Params);
             if (result.error == cpeNoBuffer)
@@ -1019,9 +1021,9 @@ BOOLEAN ParaNdis_ProcessTx(
         else
         {
 #ifdef PARANDIS_TEST_TX_KICK_ALWAYS
-            virtqueue_kick_always(pContext->NetSendQueue);
+            ParaNdis_KickTxQueues(pContext, TRUE);
 #else
-            virtqueue_kick(pContext->NetSendQueue);
+            ParaNdis_KickTxQueues(pContext, FALSE);
 #endif
         }
         DPrintf(2, ("[%s] sent down %d p.(%d b.)", __FUNCTION__, nBuffersSent, nBytesSent));
@@ -1081,9 +1083,9 @@ VOID NTAPI ParaNdis5_ReturnPacket(IN NDIS_HANDLE  MiniportAdapterContext,IN PNDI
     pBufferDescriptor = (pIONetDescriptor) *REF_MINIPORT(Packet);
     DPrintf(4, ("[%s] buffer %p", __FUNCTION__, pBufferDescriptor));
 
-    NdisAcquireSpinLock(&pContext->ReceiveLock);
+    NdisAcquireSpinLock(&pBufferDescriptor->pQueuePair->ReceiveLock);
     pContext->ReuseBufferProc(pContext, pBufferDescriptor);
-    NdisReleaseSpinLock(&pContext->ReceiveLock);
+    NdisReleaseSpinLock(&pBufferDescriptor->pQueuePair->ReceiveLock);
 }
 
 static __inline tSendEntry * PrepareSendEntry(PARANDIS_ADAPTER *pContext, PNDIS_PACKET Packet, ULONG len)
@@ -1100,6 +1102,7 @@ static __inline tSendEntry * PrepareSendEntry(PARANDIS_ADAPTER *pContext, PNDIS_
         pse->flags  = 0;
         pse->PriorityDataLong = 0;
         pse->ipTransferUnit = len;
+        pse->ulFlowHash = 0;
         //pse->fullTCPCheckSum = 0;
         qInfo.Value = pContext->ulPriorityVlanSetting ?
             NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, Ieee8021QInfo) : NULL;
@@ -1206,6 +1209,13 @@ static __inline tSendEntry * PrepareSendEntry(PARANDIS_ADAPTER *pContext, PNDIS_
     {
         NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpLargeSendPacketInfo) = (PVOID)(ULONG_PTR)0;
         DPrintf(1, ("[%s] Sending packet of %d with %s", __FUNCTION__, len, offloadName));
+        if (pContext->nQueuePairs > 1)
+        {
+            // the flow is sent from the queue pair its replies are received on
+            UCHAR headers[PARANDIS_RSS_TX_HEADERS_SIZE];
+            tCopyPacketResult res = ParaNdis_PacketCopier(pse->packet, headers, sizeof(headers), pse, TRUE);
+            pse->ulFlowHash = ParaNdis_RSSCalculateTxHash(pContext, headers, res.size);
+        }
         if (pContext->bDoIPCheckTx)
         {
             tTcpIpPacketParsingResult res;
@@ -1418,7 +1428,7 @@ NDIS_STATUS ParaNdis5_StopReceive(
     {
         ParaNdis_DebugHistory(pContext, hopInternalReceivePause, NULL, 1, 0, 0);
         NdisAcquireSpinLock(&pContext->ReceiveLock);
-        if (IsListEmpty(&pContext->NetReceiveBuffersWaiting))
+        if (InterlockedCompareExchange(&pContext->NetNofReceiveBuffersWaiting, 0, 0) == 0)
         {
             pContext->ReceiveState = srsDisabled;
             ParaNdis_DebugHistory(pContext, hopInternalReceivePause, NULL, 0, 0, 0);
@@ -27,6 +27,7 @@ typedef struct _ADAPTER_BINDING {
     KSPIN_LOCK        Lock;                     /* Protecting spin lock */
     PPROTOCOL_BINDING ProtocolBinding;          /* Protocol that opened adapter */
     PLOGICAL_ADAPTER  Adapter;                  /* Adapter opened by protocol */
+    EX_RUNDOWN_REF    IndicationRundown;        /* Packet indications in progress */
 } ADAPTER_BINDING, *PADAPTER_BINDING;
 
 typedef struct _NDIS_REQUEST_MAC_BLOCK {
@@ -309,14 +309,27 @@ MiniIndicateReceivePacket(
     KIRQL OldIrql;
     UINT i;
 
+    /* Deserialized miniports with several receive queues indicate from
+     * several processors at once, so the miniport lock is only held while
+     * moving along the binding list. The binding we call into is protected
+     * by its rundown reference instead, which also keeps NdisCloseAdapter
+     * from unlinking it before we got its successor. */
     KeAcquireSpinLock(&Adapter->NdisMiniportBlock.Lock, &OldIrql);
 
     CurrentEntry = Adapter->ProtocolListHead.Flink;
-
     while (CurrentEntry != &Adapter->ProtocolListHead)
     {
         AdapterBinding = CONTAINING_RECORD(CurrentEntry, ADAPTER_BINDING, AdapterListEntry);
 
+        /* Skip bindings that are being closed */
+        if (!ExAcquireRundownProtection(&AdapterBinding->IndicationRundown))
+        {
+            CurrentEntry = CurrentEntry->Flink;
+            continue;
+        }
+
+        KeReleaseSpinLockFromDpcLevel(&Adapter->NdisMiniportBlock.Lock);
+
         for (i = 0; i < NumberOfPackets; i++)
         {
             /* Store the indicating miniport in the packet */
@@ -351,7 +364,8 @@ MiniIndicateReceivePacket(
                 if (!LookAheadBuffer)
                 {
                     NDIS_DbgPrint(MIN_TRACE, ("Failed to allocate lookahead buffer!\n"));
-                    KeReleaseSpinLock(&Adapter->NdisMiniportBlock.Lock, OldIrql);
+                    ExReleaseRundownProtection(&AdapterBinding->IndicationRundown);
+                    KeLowerIrql(OldIrql);
                     return;
                 }
 
@@ -374,9 +388,13 @@ MiniIndicateReceivePacket(
             }
         }
 
+        KeAcquireSpinLockAtDpcLevel(&Adapter->NdisMiniportBlock.Lock);
         CurrentEntry = CurrentEntry->Flink;
+        ExReleaseRundownProtection(&AdapterBinding->IndicationRundown);
     }
 
+    KeReleaseSpinLockFromDpcLevel(&Adapter->NdisMiniportBlock.Lock);
+
     /* Loop the packet array to get everything
      * set up for return the packets to the miniport */
     for (i = 0; i < NumberOfPackets; i++)
@@ -428,7 +446,7 @@ MiniIndicateReceivePacket(
         }
     }
 
-    KeReleaseSpinLock(&Adapter->NdisMiniportBlock.Lock, OldIrql);
+    KeLowerIrql(OldIrql);
 }
 
 VOID NTAPI
@@ -711,14 +711,20 @@ NdisCloseAdapter(
  */
 {
     PADAPTER_BINDING AdapterBinding = GET_ADAPTER_BINDING(NdisBindingHandle);
+    PLOGICAL_ADAPTER Adapter = AdapterBinding->Adapter;
 
     NDIS_DbgPrint(MAX_TRACE, ("Called.\n"));
 
     /* Remove from protocol's bound adapters list */
     ExInterlockedRemoveEntryList(&AdapterBinding->ProtocolListEntry, &AdapterBinding->ProtocolBinding->Lock);
 
+    /* Packet indications call into the binding without holding the adapter lock.
+     * Wait for the ones in progress and keep new ones from starting; the binding
+     * stays on the adapter's list until then so that they can move past it. */
+    ExWaitForRundownProtectionRelease(&AdapterBinding->IndicationRundown);
+
     /* Remove protocol from adapter's bound protocols list */
-    ExInterlockedRemoveEntryList(&AdapterBinding->AdapterListEntry, &AdapterBinding->Adapter->NdisMiniportBlock.Lock);
+    ExInterlockedRemoveEntryList(&AdapterBinding->AdapterListEntry, &Adapter->NdisMiniportBlock.Lock);
 
     ExFreePool(AdapterBinding);
 
@@ -846,6 +852,7 @@ NdisOpenAdapter(
   AdapterBinding->ProtocolBinding        = Protocol;
   AdapterBinding->Adapter                = Adapter;
   AdapterBinding->NdisOpenBlock.ProtocolBindingContext = ProtocolBindingContext;
+  ExInitializeRundownProtection(&AdapterBinding->IndicationRundown);
 
   /* Set fields required by some NDIS macros */
   AdapterBinding->NdisOpenBlock.BindingHandle = (NDIS_HANDLE)AdapterBinding;
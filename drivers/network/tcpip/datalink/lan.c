@@ -313,6 +313,7 @@ VOID LanReceiveWorker( PVOID Context ) {
     IP_PACKET IPPacket;
     BOOLEAN LegacyReceive;
     PIP_INTERFACE Interface;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
 
     TI_DbgPrint(DEBUG_DATALINK, ("Called.\n"));
 
@@ -358,6 +359,24 @@ VOID LanReceiveWorker( PVOID Context ) {
 
         /* Calculate packet size (excluding media header) */
         NdisQueryPacketLength(IPPacket.NdisPacket, &IPPacket.TotalSize);
+
+        /* Take note of the checksums the adapter already verified */
+        if (Interface->OffloadFlags & (IP_OFFLOAD_RX_IP_CHECKSUM |
+                                       IP_OFFLOAD_RX_TCP_CHECKSUM |
+                                       IP_OFFLOAD_RX_UDP_CHECKSUM))
+        {
+            ChecksumInfo.Value = PtrToUlong(NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket.NdisPacket,
+                                                                             TcpIpChecksumPacketInfo));
+            if (ChecksumInfo.Receive.NdisPacketIpChecksumSucceeded &&
+                (Interface->OffloadFlags & IP_OFFLOAD_RX_IP_CHECKSUM))
+                IPPacket.Flags |= IP_PACKET_FLAG_RX_IP_OK;
+            if (ChecksumInfo.Receive.NdisPacketTcpChecksumSucceeded &&
+                (Interface->OffloadFlags & IP_OFFLOAD_RX_TCP_CHECKSUM))
+                IPPacket.Flags |= IP_PACKET_FLAG_RX_TCP_OK;
+            if (ChecksumInfo.Receive.NdisPacketUdpChecksumSucceeded &&
+                (Interface->OffloadFlags & IP_OFFLOAD_RX_UDP_CHECKSUM))
+                IPPacket.Flags |= IP_PACKET_FLAG_RX_UDP_OK;
+        }
     }
 
     TI_DbgPrint
@@ -1006,6 +1025,12 @@ VOID LANTransmit(
 
     RtlCopyMemory(Data + Adapter->HeaderSize, OldData, OldSize);
 
+    /* Carry the offload requests over before the original packet is gone */
+    NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpIpChecksumPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpIpChecksumPacketInfo);
+    NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpLargeSendPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpLargeSendPacketInfo);
+
     (*PC(NdisPacket)->DLComplete)(PC(NdisPacket)->Context, NdisPacket, NDIS_STATUS_SUCCESS);
 
     switch (Adapter->Media) {
@@ -1056,12 +1081,6 @@ VOID LANTransmit(
 		   ((PCHAR)LinkAddress)[5] & 0xff));
 	}
 
-    if (Adapter->MTU < Size) {
-        /* This is NOT a pointer. MSDN explicitly says so. */
-        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket,
-                                         TcpLargeSendPacketInfo) = (PVOID)((ULONG_PTR)Adapter->MTU);
-    }
-
     /* Update interface stats */
     Interface->Stats.OutBytes += Size;
 
@@ -1309,6 +1328,113 @@ VOID GetName( PUNICODE_STRING RegistryKey,
     AppendUnicodeString( OutName, &PartialRegistryKey, FALSE );
 }
 
+static VOID LANNegotiateOffload(
+    PLAN_ADAPTER Adapter,
+    PIP_INTERFACE IF)
+/*
+ * FUNCTION: Queries and enables the task offloads of an adapter
+ * ARGUMENTS:
+ *     Adapter = Pointer to LAN_ADAPTER structure
+ *     IF      = Pointer to the IP interface of the adapter
+ * NOTES:
+ *     Only checksum offload is enabled. The large send size is only
+ *     recorded since lwIP segments at the MSS itself.
+ */
+{
+    UCHAR Buffer[256];
+    PNDIS_TASK_OFFLOAD_HEADER Header = (PNDIS_TASK_OFFLOAD_HEADER)Buffer;
+    PNDIS_TASK_OFFLOAD Task, ChecksumTask = NULL;
+    PNDIS_TASK_TCP_IP_CHECKSUM Checksum;
+    PNDIS_TASK_TCP_LARGE_SEND LargeSend;
+    NDIS_STATUS NdisStatus;
+    ULONG Offset;
+
+    IF->OffloadFlags = 0;
+    IF->LargeSendSize = 0;
+
+    if (Adapter->Media != NdisMedium802_3)
+        return;
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+    Header->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Header->Size = sizeof(*Header);
+    Header->EncapsulationFormat.Encapsulation = IEEE_802_3_Encapsulation;
+    Header->EncapsulationFormat.Flags.FixedHeaderSize = 1;
+    Header->EncapsulationFormat.EncapsulationHeaderSize = Adapter->HeaderSize;
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestQueryInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          sizeof(Buffer));
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(DEBUG_DATALINK, ("No task offload support (0x%X).\n", NdisStatus));
+        return;
+    }
+
+    for (Offset = Header->OffsetFirstTask; Offset != 0; Offset += Task->OffsetNextTask) {
+        if (Offset > sizeof(Buffer) - FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer))
+            break;
+
+        Task = (PNDIS_TASK_OFFLOAD)(Buffer + Offset);
+        if (Task->TaskBufferLength > sizeof(Buffer) - Offset - FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer))
+            break;
+
+        if (Task->Task == TcpIpChecksumNdisTask &&
+            Task->TaskBufferLength >= sizeof(*Checksum)) {
+            Checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+            if (Checksum->V4Transmit.IpChecksum && Checksum->V4Transmit.IpOptionsSupported)
+                IF->OffloadFlags |= IP_OFFLOAD_TX_IP_CHECKSUM;
+            if (Checksum->V4Transmit.TcpChecksum && Checksum->V4Transmit.TcpOptionsSupported)
+                IF->OffloadFlags |= IP_OFFLOAD_TX_TCP_CHECKSUM;
+            if (Checksum->V4Transmit.UdpChecksum)
+                IF->OffloadFlags |= IP_OFFLOAD_TX_UDP_CHECKSUM;
+            if (Checksum->V4Receive.IpChecksum)
+                IF->OffloadFlags |= IP_OFFLOAD_RX_IP_CHECKSUM;
+            if (Checksum->V4Receive.TcpChecksum)
+                IF->OffloadFlags |= IP_OFFLOAD_RX_TCP_CHECKSUM;
+            if (Checksum->V4Receive.UdpChecksum)
+                IF->OffloadFlags |= IP_OFFLOAD_RX_UDP_CHECKSUM;
+            ChecksumTask = Task;
+        } else if (Task->Task == TcpLargeSendNdisTask &&
+                   Task->TaskBufferLength >= sizeof(*LargeSend)) {
+            LargeSend = (PNDIS_TASK_TCP_LARGE_SEND)Task->TaskBuffer;
+            if (LargeSend->Version == NDIS_TASK_TCP_LARGE_SEND_V0)
+                IF->LargeSendSize = LargeSend->MaxOffLoadSize;
+        }
+
+        if (Task->OffsetNextTask == 0)
+            break;
+    }
+
+    if (!ChecksumTask || IF->OffloadFlags == 0)
+        return;
+
+    /* Enable only the checksum task, with just the offloads we use */
+    Checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)ChecksumTask->TaskBuffer;
+    Checksum->V4Transmit.IpChecksum = !!(IF->OffloadFlags & IP_OFFLOAD_TX_IP_CHECKSUM);
+    Checksum->V4Transmit.TcpChecksum = !!(IF->OffloadFlags & IP_OFFLOAD_TX_TCP_CHECKSUM);
+    RtlZeroMemory(&Checksum->V6Transmit, sizeof(Checksum->V6Transmit));
+    RtlZeroMemory(&Checksum->V6Receive, sizeof(Checksum->V6Receive));
+    ChecksumTask->OffsetNextTask = 0;
+    Header->OffsetFirstTask = (ULONG)((PUCHAR)ChecksumTask - Buffer);
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestSetInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Buffer,
+                          Header->OffsetFirstTask + FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) +
+                          ChecksumTask->TaskBufferLength);
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(MIN_TRACE, ("Could not enable checksum offload (0x%X).\n", NdisStatus));
+        IF->OffloadFlags = 0;
+        return;
+    }
+
+    TI_DbgPrint(MIN_TRACE, ("Checksum offloads 0x%x, large send size %u\n",
+                            IF->OffloadFlags, IF->LargeSendSize));
+}
+
 BOOLEAN BindAdapter(
     PLAN_ADAPTER Adapter,
     PNDIS_STRING RegistryPath)
@@ -1410,6 +1536,9 @@ BOOLEAN BindAdapter(
     if (NdisStatus != NDIS_STATUS_SUCCESS)
         return FALSE;
 
+    /* Find out which checksums the adapter can do for us */
+    LANNegotiateOffload(Adapter, IF);
+
     /* Register interface with IP layer */
     IPRegisterInterface(IF);
 
@@ -15,12 +15,29 @@ ULONG ChecksumCompute(
     UINT Count,
     ULONG Seed);
 
+ULONG ChecksumCopy(
+    PVOID Destination,
+    PVOID Source,
+    UINT Count,
+    ULONG Seed);
+
+ULONG ChecksumCombine(
+    ULONG Sum,
+    ULONG Partial,
+    UINT Offset);
+
 unsigned int
 csum_partial(
   const unsigned char * buff,
   int len,
   unsigned int sum);
 
+ULONG
+IPv4PseudoHeaderChecksum(
+  PIPv4_HEADER IPHeader,
+  UCHAR Protocol,
+  USHORT Length);
+
 ULONG
 UDPv4ChecksumCalculate(
   PIPv4_HEADER IPHeader,
@@ -88,9 +88,15 @@ typedef struct _IP_PACKET {
     PNDIS_PACKET NdisPacket;            /* Pointer to NDIS packet */
     IP_ADDRESS SrcAddr;                 /* Source address */
     IP_ADDRESS DstAddr;                 /* Destination address */
+    ULONG DataChecksum;                 /* Unfolded checksum of the data (see IP_PACKET_FLAG_DATA_CHECKSUM) */
 } IP_PACKET, *PIP_PACKET;
 
-#define IP_PACKET_FLAG_RAW      0x01    /* Raw IP packet */
+#define IP_PACKET_FLAG_RAW          0x01    /* Raw IP packet */
+#define IP_PACKET_FLAG_TX_CHECKSUM  0x02    /* Transport checksum is left to the adapter */
+#define IP_PACKET_FLAG_RX_IP_OK     0x04    /* Adapter validated the IP header checksum */
+#define IP_PACKET_FLAG_RX_TCP_OK    0x08    /* Adapter validated the TCP checksum */
+#define IP_PACKET_FLAG_RX_UDP_OK    0x10    /* Adapter validated the UDP checksum */
+#define IP_PACKET_FLAG_DATA_CHECKSUM 0x20   /* DataChecksum was computed while copying the data */
 
 
 /* Packet context */
@@ -168,8 +174,18 @@ typedef struct _IP_INTERFACE {
     LL_TRANSMIT_ROUTINE Transmit; /* Pointer to transmit function */
     PVOID TCPContext;             /* TCP Content for this interface */
     SEND_RECV_STATS Stats;        /* Send/Receive statistics */
+    ULONG OffloadFlags;           /* Offloads enabled on the adapter (see IP_OFFLOAD_xx below) */
+    UINT  LargeSendSize;          /* Largest TCP packet the adapter can segment */
 } IP_INTERFACE, *PIP_INTERFACE;
 
+#define IP_OFFLOAD_TX_IP_CHECKSUM   0x01    /* Adapter computes IPv4 header checksums */
+#define IP_OFFLOAD_TX_TCP_CHECKSUM  0x02    /* Adapter computes TCP checksums */
+#define IP_OFFLOAD_TX_UDP_CHECKSUM  0x04    /* Adapter computes UDP checksums */
+#define IP_OFFLOAD_RX_IP_CHECKSUM   0x08    /* Adapter validates IPv4 header checksums */
+#define IP_OFFLOAD_RX_TCP_CHECKSUM  0x10    /* Adapter validates TCP checksums */
+#define IP_OFFLOAD_RX_UDP_CHECKSUM  0x20    /* Adapter validates UDP checksums */
+#define IP_OFFLOAD_LARGE_SEND       0x40    /* Adapter can segment large TCP packets */
+
 typedef struct _IP_SET_ADDRESS {
     ULONG NteIndex;
     IPv4_RAW_ADDRESS Address;
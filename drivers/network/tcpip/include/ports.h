@@ -10,12 +10,19 @@
 
 #pragma once
 
+/* Number of per-processor search hints for ephemeral ports */
+#define PORT_SET_HINTS 32
+
 typedef struct _PORT_SET {
     RTL_BITMAP ProtoBitmap;
     PVOID ProtoBitBuffer;
     UINT StartingPort;
     UINT PortsToOversee;
     KSPIN_LOCK Lock;
+    /* Bit index where each processor resumes searching for a free port.
+     * Seeded randomly so ephemeral ports are not predictable and the
+     * processors do not all scan the same busy part of the bitmap. */
+    ULONG NextPort[PORT_SET_HINTS];
 } PORT_SET, *PPORT_SET;
 
 NTSTATUS PortsStartup( PPORT_SET PortSet,
@@ -27,6 +27,13 @@ UINT CopyPacketToBuffer(
     UINT SrcOffset,
     UINT Length);
 
+UINT CopyPacketToBufferChecksum(
+    PCHAR DstData,
+    PNDIS_PACKET SrcPacket,
+    UINT SrcOffset,
+    UINT Length,
+    PULONG Checksum);
+
 UINT CopyPacketToBufferChain(
     PNDIS_BUFFER DstBuffer,
     UINT DstOffset,
@@ -33,6 +33,10 @@ typedef struct TCPv4_HEADER {
 /* Data offset; 32-bit words (leftmost 4 bits); convert to bytes */
 #define TCP_DATA_OFFSET(DataOffset)(((DataOffset) & 0xF0) >> (4-2))
 
+/* Ephemeral port range (IANA dynamic ports), the top port is not managed by TCPPorts */
+#define TCP_STARTING_PORT 0xC000
+#define TCP_ENDING_PORT   0xFFFE
+
 
 /* TCPv4 pseudo header */
 typedef struct TCPv4_PSEUDO_HEADER {
@@ -188,6 +192,8 @@ BOOLEAN TCPRemoveIRP( PCONNECTION_ENDPOINT Connection, PIRP Irp );
 
 NTSTATUS TCPSetNoDelay(PCONNECTION_ENDPOINT Connection, BOOLEAN Set);
 
+NTSTATUS TCPSetBufferSize(PCONNECTION_ENDPOINT Connection, ULONG Size, BOOLEAN Receive);
+
 VOID
 TCPUpdateInterfaceLinkStatus(PIP_INTERFACE IF);
 
@@ -232,6 +232,11 @@ typedef struct _TDI_BUCKET {
     TDI_REQUEST Request;
     NTSTATUS Status;
     ULONG Information;
+
+    /* Send requests */
+    PCHAR SendData;             /* Locked client buffer */
+    ULONG SendLength;           /* Size of the request */
+    ULONG SendQueued;           /* Bytes already copied into lwIP */
 } TDI_BUCKET, *PTDI_BUCKET;
 
 /* Transport connection context structure A.K.A. Transmission Control Block
@@ -266,6 +271,12 @@ typedef struct _CONNECTION_ENDPOINT {
     NTSTATUS ReceiveShutdownStatus;
     BOOLEAN Closing;
 
+    /* Receive window bookkeeping */
+    ULONG ReceiveConsumed;          /* Bytes handed to the client but not yet returned to the window */
+    BOOLEAN ReceiveUpdatePending;   /* A window update is queued to the lwIP thread */
+
+    BOOLEAN SendPumpPending;        /* TCPSendEventHandler is queued to the lwIP thread */
+
     struct _CONNECTION_ENDPOINT *Next; /* Next connection in address file list */
 } CONNECTION_ENDPOINT, *PCONNECTION_ENDPOINT;
 
@@ -24,6 +24,15 @@ TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
             Set = *(BOOLEAN*)Buffer;
             return TCPSetNoDelay(Connection, Set);
         }
+        case TCP_SOCKET_WINDOW:
+        case TCP_SOCKET_SNDBUF:
+        {
+            ULONG Size;
+            if (BufferSize < sizeof(ULONG))
+                return TDI_INVALID_PARAMETER;
+            Size = *(ULONG*)Buffer;
+            return TCPSetBufferSize(Connection, Size, ID->toi_id == TCP_SOCKET_WINDOW);
+        }
         default:
             DbgPrint("TCPIP: Unknown connection info ID: %u.\n", ID->toi_id);
     }
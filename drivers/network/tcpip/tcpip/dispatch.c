@@ -1531,6 +1531,15 @@ NTSTATUS DispTdiSetInformationEx(
         return Irp->IoStatus.Status;
     }
 
+    /* Connection options sent straight to a connection object don't need an entity lookup */
+    if ((ULONG_PTR)IrpSp->FileObject->FsContext2 == TDI_CONNECTION_FILE &&
+        Info->ID.toi_class == INFO_CLASS_PROTOCOL &&
+        Info->ID.toi_type == INFO_TYPE_CONNECTION)
+    {
+        return SetConnectionInfo(&Info->ID, Request.Handle.ConnectionContext,
+                                 &Info->Buffer, Info->BufferSize);
+    }
+
     Request.RequestNotifyObject = NULL;
     Request.RequestContext      = NULL;
 
@@ -384,6 +384,63 @@ AfdSendTo(
     return Status;
 }
 
+NTSTATUS
+AfdRecv(
+    _In_ HANDLE SocketHandle,
+    _Out_writes_bytes_(BufferLength) void *Buffer,
+    _In_ ULONG BufferLength,
+    _Out_opt_ PULONG BytesReceived)
+{
+    NTSTATUS Status;
+    IO_STATUS_BLOCK IoStatus;
+    AFD_RECV_INFO RecvInfo;
+    HANDLE Event;
+    AFD_WSABUF AfdBuffer;
+
+    Status = NtCreateEvent(&Event,
+                           EVENT_ALL_ACCESS,
+                           NULL,
+                           NotificationEvent,
+                           FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        return Status;
+    }
+
+    AfdBuffer.buf = Buffer;
+    AfdBuffer.len = BufferLength;
+    RecvInfo.BufferArray = &AfdBuffer;
+    RecvInfo.BufferCount = 1;
+    RecvInfo.AfdFlags = 0;
+    RecvInfo.TdiFlags = TDI_RECEIVE_NORMAL;
+
+    IoStatus.Information = 0;
+    Status = NtDeviceIoControlFile(SocketHandle,
+                                   Event,
+                                   NULL,
+                                   NULL,
+                                   &IoStatus,
+                                   IOCTL_AFD_RECV,
+                                   &RecvInfo,
+                                   sizeof(RecvInfo),
+                                   NULL,
+                                   0);
+    if (Status == STATUS_PENDING)
+    {
+        NtWaitForSingleObject(Event, FALSE, NULL);
+        Status = IoStatus.Status;
+    }
+
+    if (BytesReceived != NULL)
+    {
+        *BytesReceived = NT_SUCCESS(Status) ? (ULONG)IoStatus.Information : 0;
+    }
+
+    NtClose(Event);
+
+    return Status;
+}
+
 NTSTATUS
 AfdSetInformation(
     _In_ HANDLE SocketHandle,
@@ -41,6 +41,13 @@ AfdSendTo(
     _In_ const struct sockaddr *Address,
     _In_ ULONG AddressLength);
 
+NTSTATUS
+AfdRecv(
+    _In_ HANDLE SocketHandle,
+    _Out_writes_bytes_(BufferLength) void *Buffer,
+    _In_ ULONG BufferLength,
+    _Out_opt_ PULONG BytesReceived);
+
 NTSTATUS
 AfdSetInformation(
     _In_ HANDLE SocketHandle,
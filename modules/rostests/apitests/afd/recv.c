@@ -0,0 +1,285 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1+ (https://spdx.org/licenses/LGPL-2.1+)
+ * PURPOSE:     Test for IOCTL_AFD_RECV on stream sockets
+ */
+
+#include "precomp.h"
+
+#define TRANSFER_SIZE   (16 * 1024 * 1024)
+#define SEND_CHUNK_SIZE (64 * 1024)
+
+static
+UCHAR
+PatternByte(
+    _In_ ULONG Offset)
+{
+    /* 251 is prime so the pattern never lines up with buffer boundaries */
+    return (UCHAR)(Offset % 251);
+}
+
+static
+BOOLEAN
+CreateConnectedPair(
+    _Out_ SOCKET *Client,
+    _Out_ SOCKET *Server)
+{
+    SOCKET listener;
+    struct sockaddr_in addr;
+    int addrlen;
+    int err;
+
+    *Client = INVALID_SOCKET;
+    *Server = INVALID_SOCKET;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+    {
+        skip("socket failed %d\n", WSAGetLastError());
+        return FALSE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(0);
+
+    err = bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+    ok(err == 0, "bind err = %d %d\n", err, WSAGetLastError());
+    addrlen = sizeof(addr);
+    err = getsockname(listener, (struct sockaddr *)&addr, &addrlen);
+    ok(err == 0, "getsockname err = %d %d\n", err, WSAGetLastError());
+    err = listen(listener, 1);
+    ok(err == 0, "listen err = %d %d\n", err, WSAGetLastError());
+
+    *Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (*Client == INVALID_SOCKET)
+    {
+        skip("socket failed %d\n", WSAGetLastError());
+        closesocket(listener);
+        return FALSE;
+    }
+
+    err = connect(*Client, (struct sockaddr *)&addr, sizeof(addr));
+    ok(err == 0, "connect err = %d %d\n", err, WSAGetLastError());
+
+    *Server = accept(listener, NULL, NULL);
+    ok(*Server != INVALID_SOCKET, "accept failed %d\n", WSAGetLastError());
+    closesocket(listener);
+
+    if (err != 0 || *Server == INVALID_SOCKET)
+    {
+        closesocket(*Client);
+        if (*Server != INVALID_SOCKET)
+            closesocket(*Server);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+DWORD
+WINAPI
+SenderThread(
+    _In_ PVOID Parameter)
+{
+    SOCKET sock = (SOCKET)Parameter;
+    PUCHAR Buffer;
+    ULONG Sent = 0;
+    ULONG Length;
+    ULONG i;
+    int err;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, SEND_CHUNK_SIZE);
+    if (!Buffer)
+    {
+        shutdown(sock, SD_SEND);
+        return 0;
+    }
+
+    while (Sent < TRANSFER_SIZE)
+    {
+        Length = min(SEND_CHUNK_SIZE, TRANSFER_SIZE - Sent);
+        for (i = 0; i < Length; i++)
+            Buffer[i] = PatternByte(Sent + i);
+
+        err = send(sock, (char *)Buffer, Length, 0);
+        if (err <= 0)
+            break;
+        Sent += err;
+
+        /* Partial sends would leave the pattern misaligned */
+        if ((ULONG)err != Length)
+            break;
+    }
+
+    shutdown(sock, SD_SEND);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    return Sent;
+}
+
+static
+void
+TestRecvThroughput(
+    _In_ ULONG BufferSize)
+{
+    NTSTATUS Status;
+    SOCKET client, server;
+    HANDLE hthread;
+    DWORD Sent;
+    PUCHAR Buffer;
+    ULONG Received = 0, Length, i;
+    ULONG Mismatch = 0;
+
+    if (!CreateConnectedPair(&client, &server))
+        return;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, BufferSize);
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        closesocket(server);
+        closesocket(client);
+        return;
+    }
+
+    hthread = CreateThread(NULL, 0, SenderThread, (PVOID)client, 0, NULL);
+    ok(hthread != NULL, "CreateThread %lu\n", GetLastError());
+    if (!hthread)
+    {
+        HeapFree(GetProcessHeap(), 0, Buffer);
+        closesocket(server);
+        closesocket(client);
+        return;
+    }
+
+    for (;;)
+    {
+        Status = AfdRecv((HANDLE)server, Buffer, BufferSize, &Length);
+        if (!NT_SUCCESS(Status) || Length == 0)
+            break;
+
+        for (i = 0; i < Length && !Mismatch; i++)
+        {
+            if (Buffer[i] != PatternByte(Received + i))
+                Mismatch = Received + i + 1;
+        }
+        Received += Length;
+    }
+    ok(Status == STATUS_SUCCESS, "AfdRecv failed with %lx\n", Status);
+
+    WaitForSingleObject(hthread, INFINITE);
+    GetExitCodeThread(hthread, &Sent);
+    CloseHandle(hthread);
+
+    ok(Sent == TRANSFER_SIZE, "Sent %lu bytes\n", Sent);
+    ok(Received == TRANSFER_SIZE, "Received %lu bytes\n", Received);
+    ok(Mismatch == 0, "Data mismatch at offset %lu\n", Mismatch - 1);
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    closesocket(server);
+    closesocket(client);
+}
+
+static
+void
+TestRecvCancel(void)
+{
+    NTSTATUS Status;
+    SOCKET client, server;
+    IO_STATUS_BLOCK IoStatus, CancelIoStatus;
+    AFD_RECV_INFO RecvInfo;
+    AFD_WSABUF AfdBuffer;
+    HANDLE Event;
+    PUCHAR Buffer;
+    ULONG Length;
+    LARGE_INTEGER Timeout;
+    int err;
+
+    if (!CreateConnectedPair(&client, &server))
+        return;
+
+    /* Larger than the receive window so the transport gets to fill it directly */
+    Buffer = HeapAlloc(GetProcessHeap(), 0, SEND_CHUNK_SIZE);
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        closesocket(server);
+        closesocket(client);
+        return;
+    }
+
+    Status = NtCreateEvent(&Event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE);
+    ok(Status == STATUS_SUCCESS, "NtCreateEvent failed with %lx\n", Status);
+
+    AfdBuffer.buf = (PCHAR)Buffer;
+    AfdBuffer.len = SEND_CHUNK_SIZE;
+    RecvInfo.BufferArray = &AfdBuffer;
+    RecvInfo.BufferCount = 1;
+    RecvInfo.AfdFlags = AFD_OVERLAPPED;
+    RecvInfo.TdiFlags = TDI_RECEIVE_NORMAL;
+
+    IoStatus.Status = 0xdeadbeef;
+    Status = NtDeviceIoControlFile((HANDLE)server,
+                                   Event,
+                                   NULL,
+                                   NULL,
+                                   &IoStatus,
+                                   IOCTL_AFD_RECV,
+                                   &RecvInfo,
+                                   sizeof(RecvInfo),
+                                   NULL,
+                                   0);
+    ok(Status == STATUS_PENDING, "IOCTL_AFD_RECV returned %lx\n", Status);
+
+    if (Status == STATUS_PENDING)
+    {
+        /* Nothing was sent, so the read must still be waiting */
+        Timeout.QuadPart = -100 * 10000LL;
+        Status = NtWaitForSingleObject(Event, FALSE, &Timeout);
+        ok(Status == STATUS_TIMEOUT, "NtWaitForSingleObject returned %lx\n", Status);
+
+        Status = NtCancelIoFile((HANDLE)server, &CancelIoStatus);
+        ok(Status == STATUS_SUCCESS, "NtCancelIoFile failed with %lx\n", Status);
+
+        Timeout.QuadPart = -5000 * 10000LL;
+        Status = NtWaitForSingleObject(Event, FALSE, &Timeout);
+        ok(Status == STATUS_SUCCESS, "NtWaitForSingleObject returned %lx\n", Status);
+        ok(IoStatus.Status == STATUS_CANCELLED, "Status = %lx\n", IoStatus.Status);
+        ok(IoStatus.Information == 0, "Information = %Iu\n", IoStatus.Information);
+    }
+
+    /* The connection must be unaffected by the cancelled read */
+    err = send(client, "ReactOS", 7, 0);
+    ok(err == 7, "send returned %d %d\n", err, WSAGetLastError());
+
+    Status = AfdRecv((HANDLE)server, Buffer, SEND_CHUNK_SIZE, &Length);
+    ok(Status == STATUS_SUCCESS, "AfdRecv failed with %lx\n", Status);
+    ok(Length == 7, "Received %lu bytes\n", Length);
+    ok(Length == 7 && !memcmp(Buffer, "ReactOS", 7), "Wrong data received\n");
+
+    NtClose(Event);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    closesocket(server);
+    closesocket(client);
+}
+
+START_TEST(recv)
+{
+    int ret;
+    WSADATA wsad;
+
+    ret = WSAStartup(MAKEWORD(2, 2), &wsad);
+    ok(ret == 0, "WSAStartup failed with %d\n", ret);
+    if (ret != 0)
+        return;
+
+    TestRecvCancel();
+    TestRecvThroughput(512);
+    TestRecvThroughput(4096);
+    TestRecvThroughput(SEND_CHUNK_SIZE);
+    TestRecvThroughput(1024 * 1024);
+
+    WSACleanup();
+}
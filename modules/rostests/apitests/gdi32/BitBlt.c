@@ -0,0 +1,435 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for BitBlt rops between DIB sections of the same format,
+ *                  and for large blits that win32k may split into bands
+ */
+
+#include "precomp.h"
+
+#define BMP_WIDTH   128
+#define BMP_HEIGHT  4
+#define BLT_ROWS    3
+
+/* Large enough to be split into bands when tiling is enabled, while a
+   strip is always drawn in one piece */
+#define BANDED_WIDTH    1024
+#define BANDED_HEIGHT   512
+#define STRIP_HEIGHT    32
+
+typedef struct _TEST_ROP
+{
+    DWORD dwRop;
+    const char *pszName;
+} TEST_ROP;
+
+static const TEST_ROP TestRops[] =
+{
+    { SRCCOPY, "SRCCOPY" },
+    { SRCINVERT, "SRCINVERT" },
+    { SRCAND, "SRCAND" },
+    { SRCPAINT, "SRCPAINT" },
+    { NOTSRCCOPY, "NOTSRCCOPY" },
+    { DSTINVERT, "DSTINVERT" },
+    { PATINVERT, "PATINVERT" },
+    { PATCOPY, "PATCOPY" },
+};
+
+/* Odd widths leave pixels on both sides of the dword aligned part */
+static const INT TestWidths[] = { 1, 3, 8, 37, 69, 100 };
+
+static ULONG gulSeed;
+
+static
+ULONG
+NextRandom(void)
+{
+    gulSeed = gulSeed * 1103515245 + 12345;
+    return gulSeed >> 8;
+}
+
+static
+ULONG
+GetRawPixel(
+    _In_ PBYTE pjBits,
+    _In_ ULONG cBpp,
+    _In_ INT x,
+    _In_ INT y)
+{
+    PBYTE pj = pjBits + y * BMP_WIDTH * cBpp / 8 + x * cBpp / 8;
+
+    switch (cBpp)
+    {
+        case 8: return pj[0];
+        case 16: return *(PUSHORT)pj;
+        default: return *(PULONG)pj;
+    }
+}
+
+static
+void
+SetRawPixel(
+    _In_ PBYTE pjBits,
+    _In_ ULONG cBpp,
+    _In_ INT x,
+    _In_ INT y,
+    _In_ ULONG ulColor)
+{
+    PBYTE pj = pjBits + y * BMP_WIDTH * cBpp / 8 + x * cBpp / 8;
+
+    switch (cBpp)
+    {
+        case 8: pj[0] = (BYTE)ulColor; break;
+        case 16: *(PUSHORT)pj = (USHORT)ulColor; break;
+        default: *(PULONG)pj = ulColor; break;
+    }
+}
+
+static
+ULONG
+DoRop(
+    _In_ DWORD dwRop,
+    _In_ ULONG D,
+    _In_ ULONG S,
+    _In_ ULONG P)
+{
+    switch (dwRop)
+    {
+        case SRCCOPY: return S;
+        case SRCINVERT: return D ^ S;
+        case SRCAND: return D & S;
+        case SRCPAINT: return D | S;
+        case NOTSRCCOPY: return ~S;
+        case DSTINVERT: return ~D;
+        case PATINVERT: return D ^ P;
+        case PATCOPY: return P;
+    }
+    return D;
+}
+
+static
+HBITMAP
+CreateTestDIB(
+    _In_ HDC hdc,
+    _In_ ULONG cBpp,
+    _Out_ PVOID *ppvBits)
+{
+    struct
+    {
+        BITMAPINFOHEADER bmiHeader;
+        RGBQUAD bmiColors[256];
+    } bmi;
+    ULONG i;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = BMP_WIDTH;
+    bmi.bmiHeader.biHeight = -BMP_HEIGHT;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = (WORD)cBpp;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    /* Every index is its own gray, so index and color match in both DIBs */
+    for (i = 0; i < 256; i++)
+    {
+        bmi.bmiColors[i].rgbRed = (BYTE)i;
+        bmi.bmiColors[i].rgbGreen = (BYTE)i;
+        bmi.bmiColors[i].rgbBlue = (BYTE)i;
+    }
+
+    return CreateDIBSection(hdc, (BITMAPINFO*)&bmi, DIB_RGB_COLORS, ppvBits, NULL, 0);
+}
+
+static
+ULONG
+Test_BitBlt_Rop(
+    _In_ HDC hdcSrc,
+    _In_ PBYTE pjSrc,
+    _In_ HDC hdcDst,
+    _In_ PBYTE pjDst,
+    _In_ PBYTE pjExpected,
+    _In_ ULONG cBpp,
+    _In_ DWORD dwRop)
+{
+    SIZE_T cjBits = BMP_WIDTH * BMP_HEIGHT * cBpp / 8;
+    ULONG cFailures = 0, ulMask, ulPattern, i;
+    INT xSrc, xDst, iWidth, x, y;
+    COLORREF crBrush;
+    HBRUSH hbr, hbrOld;
+    BYTE jGray;
+
+    ulMask = (cBpp == 32) ? 0xFFFFFFFF : (1 << cBpp) - 1;
+
+    /* A solid brush that maps to a single pixel value in each format */
+    jGray = (BYTE)(NextRandom() & 0xF8);
+    crBrush = RGB(jGray, jGray, jGray);
+    switch (cBpp)
+    {
+        case 8: ulPattern = jGray; break;
+        case 16: ulPattern = ((jGray >> 3) << 10) | ((jGray >> 3) << 5) | (jGray >> 3); break;
+        default: ulPattern = (jGray << 16) | (jGray << 8) | jGray; break;
+    }
+    hbr = CreateSolidBrush(crBrush);
+    hbrOld = SelectObject(hdcDst, hbr);
+
+    for (xSrc = 0; xSrc < 4; xSrc++)
+    {
+        for (xDst = 0; xDst < 4; xDst++)
+        {
+            for (i = 0; i < sizeof(TestWidths) / sizeof(TestWidths[0]); i++)
+            {
+                iWidth = TestWidths[i];
+
+                for (x = 0; x < (INT)cjBits; x++)
+                {
+                    pjSrc[x] = (BYTE)NextRandom();
+                    pjDst[x] = (BYTE)NextRandom();
+                }
+
+                /* 32bpp DIBs keep whatever is in the high byte, 16bpp 555 ignores bit 15 */
+                if (cBpp == 16)
+                {
+                    for (x = 0; x < (INT)cjBits; x += 2)
+                    {
+                        pjSrc[x + 1] &= 0x7F;
+                        pjDst[x + 1] &= 0x7F;
+                    }
+                }
+
+                CopyMemory(pjExpected, pjDst, cjBits);
+                for (y = 0; y < BLT_ROWS; y++)
+                {
+                    for (x = 0; x < iWidth; x++)
+                    {
+                        ULONG D = GetRawPixel(pjDst, cBpp, xDst + x, y + 1);
+                        ULONG S = GetRawPixel(pjSrc, cBpp, xSrc + x, y);
+                        ULONG ulResult = DoRop(dwRop, D, S, ulPattern) & ulMask;
+
+                        if (cBpp == 16)
+                            ulResult &= 0x7FFF;
+                        SetRawPixel(pjExpected, cBpp, xDst + x, y + 1, ulResult);
+                    }
+                }
+
+                BitBlt(hdcDst, xDst, 1, iWidth, BLT_ROWS, hdcSrc, xSrc, 0, dwRop);
+                GdiFlush();
+
+                if (cBpp == 16)
+                {
+                    for (x = 0; x < (INT)cjBits; x += 2)
+                        pjDst[x + 1] &= 0x7F;
+                }
+
+                if (memcmp(pjDst, pjExpected, cjBits) != 0)
+                    cFailures++;
+            }
+        }
+    }
+
+    SelectObject(hdcDst, hbrOld);
+    DeleteObject(hbr);
+    return cFailures;
+}
+
+void Test_BitBlt_Rops(void)
+{
+    static const ULONG aBpp[] = { 8, 16, 32 };
+    HDC hdcSrc, hdcDst;
+    HBITMAP hbmSrc, hbmDst, hbmOldSrc, hbmOldDst;
+    PVOID pvSrc, pvDst;
+    PBYTE pjExpected;
+    ULONG i, j, cFailures;
+
+    hdcSrc = CreateCompatibleDC(NULL);
+    hdcDst = CreateCompatibleDC(NULL);
+    ok(hdcSrc != NULL && hdcDst != NULL, "CreateCompatibleDC failed\n");
+    pjExpected = HeapAlloc(GetProcessHeap(), 0, BMP_WIDTH * BMP_HEIGHT * 4);
+    if (!hdcSrc || !hdcDst || !pjExpected)
+    {
+        skip("No DCs\n");
+        if (hdcSrc)
+            DeleteDC(hdcSrc);
+        if (hdcDst)
+            DeleteDC(hdcDst);
+        HeapFree(GetProcessHeap(), 0, pjExpected);
+        return;
+    }
+
+    gulSeed = 0x1234;
+
+    for (i = 0; i < sizeof(aBpp) / sizeof(aBpp[0]); i++)
+    {
+        hbmSrc = CreateTestDIB(hdcSrc, aBpp[i], &pvSrc);
+        hbmDst = CreateTestDIB(hdcDst, aBpp[i], &pvDst);
+        ok(hbmSrc != NULL && hbmDst != NULL, "CreateDIBSection failed for %lu bpp\n", aBpp[i]);
+        if (!hbmSrc || !hbmDst)
+        {
+            if (hbmSrc)
+                DeleteObject(hbmSrc);
+            if (hbmDst)
+                DeleteObject(hbmDst);
+            continue;
+        }
+
+        hbmOldSrc = SelectObject(hdcSrc, hbmSrc);
+        hbmOldDst = SelectObject(hdcDst, hbmDst);
+
+        for (j = 0; j < sizeof(TestRops) / sizeof(TestRops[0]); j++)
+        {
+            cFailures = Test_BitBlt_Rop(hdcSrc, pvSrc, hdcDst, pvDst, pjExpected,
+                                        aBpp[i], TestRops[j].dwRop);
+            ok(cFailures == 0, "%s at %lu bpp: %lu blits differ from the reference\n",
+               TestRops[j].pszName, aBpp[i], cFailures);
+        }
+
+        SelectObject(hdcSrc, hbmOldSrc);
+        SelectObject(hdcDst, hbmOldDst);
+        DeleteObject(hbmSrc);
+        DeleteObject(hbmDst);
+    }
+
+    HeapFree(GetProcessHeap(), 0, pjExpected);
+    DeleteDC(hdcSrc);
+    DeleteDC(hdcDst);
+}
+
+typedef enum _BANDED_OP
+{
+    BANDED_PATTERN,
+    BANDED_SOURCE_PATTERN,
+    BANDED_STRETCH,
+    BANDED_OP_COUNT
+} BANDED_OP;
+
+static
+void
+DoBandedOp(
+    _In_ HDC hdcDst,
+    _In_ HDC hdcSrc,
+    _In_ BANDED_OP Op)
+{
+    switch (Op)
+    {
+        case BANDED_PATTERN:
+            PatBlt(hdcDst, 0, 0, BANDED_WIDTH, BANDED_HEIGHT, PATINVERT);
+            break;
+        case BANDED_SOURCE_PATTERN:
+            BitBlt(hdcDst, 0, 0, BANDED_WIDTH, BANDED_HEIGHT, hdcSrc, 0, 0, MERGECOPY);
+            break;
+        case BANDED_STRETCH:
+            /* An exact ratio maps every strip to the same source rows */
+            StretchBlt(hdcDst, 0, 0, BANDED_WIDTH, BANDED_HEIGHT,
+                       hdcSrc, 0, 0, BANDED_WIDTH / 2, BANDED_HEIGHT / 2, SRCCOPY);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Draws the same operation onto two compatible bitmaps, whose bits are in
+ * system space, once in one call and once strip by strip through clip
+ * regions. The strips are too small to be split, so they give the serial
+ * result, which the whole operation must match bit for bit whether win32k
+ * splits it into bands or not.
+ */
+void Test_BitBlt_Banded(void)
+{
+    BITMAPINFO bmi;
+    HDC hdcScreen, hdcSrc, hdcWhole, hdcStrips;
+    HBITMAP hbmSrc, hbmWhole, hbmStrips;
+    HBRUSH hbr;
+    HRGN hrgn;
+    PULONG pulBits, pulWhole, pulStrips;
+    ULONG cPixels = BANDED_WIDTH * BANDED_HEIGHT, cMismatches, i;
+    INT Op, y;
+
+    hdcScreen = GetDC(NULL);
+    hdcSrc = CreateCompatibleDC(hdcScreen);
+    hdcWhole = CreateCompatibleDC(hdcScreen);
+    hdcStrips = CreateCompatibleDC(hdcScreen);
+    hbmSrc = CreateCompatibleBitmap(hdcScreen, BANDED_WIDTH, BANDED_HEIGHT);
+    hbmWhole = CreateCompatibleBitmap(hdcScreen, BANDED_WIDTH, BANDED_HEIGHT);
+    hbmStrips = CreateCompatibleBitmap(hdcScreen, BANDED_WIDTH, BANDED_HEIGHT);
+    hbr = CreateHatchBrush(HS_DIAGCROSS, RGB(0x12, 0x9a, 0xf0));
+    pulBits = HeapAlloc(GetProcessHeap(), 0, cPixels * sizeof(ULONG));
+    pulWhole = HeapAlloc(GetProcessHeap(), 0, cPixels * sizeof(ULONG));
+    pulStrips = HeapAlloc(GetProcessHeap(), 0, cPixels * sizeof(ULONG));
+    if (!hdcSrc || !hdcWhole || !hdcStrips || !hbmSrc || !hbmWhole || !hbmStrips ||
+        !hbr || !pulBits || !pulWhole || !pulStrips)
+    {
+        skip("No resources\n");
+        goto Cleanup;
+    }
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = BANDED_WIDTH;
+    bmi.bmiHeader.biHeight = -BANDED_HEIGHT;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    SelectObject(hdcSrc, hbmSrc);
+    SelectObject(hdcWhole, hbmWhole);
+    SelectObject(hdcStrips, hbmStrips);
+    SelectObject(hdcWhole, hbr);
+    SelectObject(hdcStrips, hbr);
+    SetBrushOrgEx(hdcWhole, 3, 5, NULL);
+    SetBrushOrgEx(hdcStrips, 3, 5, NULL);
+
+    gulSeed = 0x4321;
+    for (i = 0; i < cPixels; i++)
+        pulBits[i] = NextRandom() & 0xffffff;
+    SetDIBits(hdcSrc, hbmSrc, 0, BANDED_HEIGHT, pulBits, &bmi, DIB_RGB_COLORS);
+
+    for (Op = 0; Op < BANDED_OP_COUNT; Op++)
+    {
+        for (i = 0; i < cPixels; i++)
+            pulBits[i] = NextRandom() & 0xffffff;
+        SetDIBits(hdcWhole, hbmWhole, 0, BANDED_HEIGHT, pulBits, &bmi, DIB_RGB_COLORS);
+        SetDIBits(hdcStrips, hbmStrips, 0, BANDED_HEIGHT, pulBits, &bmi, DIB_RGB_COLORS);
+
+        DoBandedOp(hdcWhole, hdcSrc, Op);
+
+        for (y = 0; y < BANDED_HEIGHT; y += STRIP_HEIGHT)
+        {
+            hrgn = CreateRectRgn(0, y, BANDED_WIDTH, y + STRIP_HEIGHT);
+            SelectClipRgn(hdcStrips, hrgn);
+            DeleteObject(hrgn);
+            DoBandedOp(hdcStrips, hdcSrc, Op);
+        }
+        SelectClipRgn(hdcStrips, NULL);
+
+        ok(GetDIBits(hdcWhole, hbmWhole, 0, BANDED_HEIGHT, pulWhole, &bmi, DIB_RGB_COLORS) == BANDED_HEIGHT,
+           "GetDIBits failed\n");
+        ok(GetDIBits(hdcStrips, hbmStrips, 0, BANDED_HEIGHT, pulStrips, &bmi, DIB_RGB_COLORS) == BANDED_HEIGHT,
+           "GetDIBits failed\n");
+
+        for (i = 0, cMismatches = 0; i < cPixels; i++)
+        {
+            if (pulWhole[i] != pulStrips[i])
+                cMismatches++;
+        }
+        ok(cMismatches == 0, "Operation %d: %lu pixels differ from the serial result\n", Op, cMismatches);
+    }
+
+Cleanup:
+    if (hdcSrc) DeleteDC(hdcSrc);
+    if (hdcWhole) DeleteDC(hdcWhole);
+    if (hdcStrips) DeleteDC(hdcStrips);
+    if (hbmSrc) DeleteObject(hbmSrc);
+    if (hbmWhole) DeleteObject(hbmWhole);
+    if (hbmStrips) DeleteObject(hbmStrips);
+    if (hbr) DeleteObject(hbr);
+    HeapFree(GetProcessHeap(), 0, pulBits);
+    HeapFree(GetProcessHeap(), 0, pulWhole);
+    HeapFree(GetProcessHeap(), 0, pulStrips);
+    ReleaseDC(NULL, hdcScreen);
+}
+
+START_TEST(BitBlt)
+{
+    Test_BitBlt_Rops();
+    Test_BitBlt_Banded();
+}
@@ -333,6 +333,53 @@ void Test_CombineRgn_XOR()
 
 }
 
+/* A region shaped like a stack of rounded windows */
+static
+HRGN
+CreateWindowsRegion(INT xOffset, INT yOffset)
+{
+    HRGN hrgn, hrgnPart;
+    INT x, y;
+
+    hrgn = CreateRectRgn(0, 0, 0, 0);
+    for (y = 0; y < 6; y++)
+    {
+        for (x = 0; x < 6; x++)
+        {
+            hrgnPart = CreateRoundRectRgn(xOffset + x * 80 + y * 7, yOffset + y * 60 + x * 5,
+                                          xOffset + x * 80 + y * 7 + 110, yOffset + y * 60 + x * 5 + 70,
+                                          12, 12);
+            CombineRgn(hrgn, hrgn, hrgnPart, RGN_OR);
+            DeleteObject(hrgnPart);
+        }
+    }
+
+    return hrgn;
+}
+
+void Test_CombineRgn_Complex()
+{
+    HRGN hrgn1, hrgn2, hrgnAnd, hrgnDiff, hrgnDst;
+
+    hrgn1 = CreateWindowsRegion(0, 0);
+    hrgn2 = CreateWindowsRegion(33, 21);
+    hrgnAnd = CreateRectRgn(0, 0, 0, 0);
+    hrgnDiff = CreateRectRgn(0, 0, 0, 0);
+    hrgnDst = CreateRectRgn(0, 0, 0, 0);
+
+    /* The intersection and the difference put together again make the original */
+    ok_long(CombineRgn(hrgnAnd, hrgn1, hrgn2, RGN_AND), COMPLEXREGION);
+    ok_long(CombineRgn(hrgnDiff, hrgn1, hrgn2, RGN_DIFF), COMPLEXREGION);
+    ok_long(CombineRgn(hrgnDst, hrgnAnd, hrgnDiff, RGN_OR), COMPLEXREGION);
+    ok(EqualRgn(hrgnDst, hrgn1), "Region is not correct\n");
+
+    DeleteObject(hrgn1);
+    DeleteObject(hrgn2);
+    DeleteObject(hrgnAnd);
+    DeleteObject(hrgnDiff);
+    DeleteObject(hrgnDst);
+}
+
 START_TEST(CombineRgn)
 {
     Test_CombineRgn_Params();
@@ -342,5 +389,6 @@ START_TEST(CombineRgn)
     Test_CombineRgn_DIFF();
     Test_CombineRgn_XOR();
     Test_RectRegions();
+    Test_CombineRgn_Complex();
 }
 
@@ -0,0 +1,211 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for CreateSolidBrush handles
+ */
+
+#include "precomp.h"
+
+#define BRUSH_COUNT         500
+#define THREAD_COUNT        4
+#define THREAD_BRUSH_COUNT  200
+#define THREAD_ROUNDS       5
+
+typedef struct _BRUSH_THREAD
+{
+    ULONG iThread;
+    HBRUSH ahbr[THREAD_BRUSH_COUNT];
+    HANDLE hCreated;
+    HANDLE hChecked;
+    ULONG cFailed;
+    ULONG cBad;
+    ULONG cNotDeleted;
+} BRUSH_THREAD, *PBRUSH_THREAD;
+
+static
+void
+Test_CreateSolidBrush_Handles(void)
+{
+    HBRUSH ahbr[BRUSH_COUNT];
+    LOGBRUSH lb;
+    ULONG cBad = 0, cDuplicates = 0, i, j;
+
+    for (i = 0; i < BRUSH_COUNT; i++)
+    {
+        ahbr[i] = CreateSolidBrush(RGB(i & 0xff, i >> 8, 0x55));
+        ok(ahbr[i] != NULL, "CreateSolidBrush failed for brush %lu\n", i);
+    }
+
+    for (i = 0; i < BRUSH_COUNT; i++)
+    {
+        if (!ahbr[i])
+            continue;
+
+        for (j = i + 1; j < BRUSH_COUNT; j++)
+        {
+            if (ahbr[i] == ahbr[j])
+                cDuplicates++;
+        }
+
+        ZeroMemory(&lb, sizeof(lb));
+        if (GetObjectW(ahbr[i], sizeof(lb), &lb) != sizeof(lb) ||
+            lb.lbStyle != BS_SOLID ||
+            lb.lbColor != RGB(i & 0xff, i >> 8, 0x55))
+        {
+            cBad++;
+        }
+    }
+    ok(cDuplicates == 0, "%lu duplicate handles\n", cDuplicates);
+    ok(cBad == 0, "%lu brushes have the wrong color\n", cBad);
+
+    for (i = 0; i < BRUSH_COUNT; i++)
+    {
+        if (ahbr[i])
+            ok(DeleteObject(ahbr[i]), "DeleteObject failed for brush %lu\n", i);
+    }
+}
+
+static
+DWORD
+WINAPI
+BrushThread(
+    _In_ LPVOID Parameter)
+{
+    PBRUSH_THREAD pThread = Parameter;
+    LOGBRUSH lb;
+    COLORREF Color;
+    ULONG i;
+
+    for (i = 0; i < THREAD_BRUSH_COUNT; i++)
+    {
+        pThread->ahbr[i] = CreateSolidBrush(RGB(pThread->iThread, i & 0xff, i >> 8));
+        if (!pThread->ahbr[i])
+            pThread->cFailed++;
+    }
+
+    /* Keep the brushes alive until the main thread has compared them */
+    SetEvent(pThread->hCreated);
+    WaitForSingleObject(pThread->hChecked, INFINITE);
+
+    for (i = 0; i < THREAD_BRUSH_COUNT; i++)
+    {
+        if (!pThread->ahbr[i])
+            continue;
+
+        Color = RGB(pThread->iThread, i & 0xff, i >> 8);
+        ZeroMemory(&lb, sizeof(lb));
+        if (GetObjectW(pThread->ahbr[i], sizeof(lb), &lb) != sizeof(lb) ||
+            lb.lbStyle != BS_SOLID ||
+            lb.lbColor != Color)
+        {
+            pThread->cBad++;
+        }
+
+        if (!DeleteObject(pThread->ahbr[i]))
+            pThread->cNotDeleted++;
+    }
+
+    return 0;
+}
+
+static
+void
+Test_CreateSolidBrush_Threads(void)
+{
+    static BRUSH_THREAD aThreads[THREAD_COUNT];
+    HANDLE ahThreads[THREAD_COUNT];
+    HANDLE ahCreated[THREAD_COUNT];
+    HANDLE hChecked;
+    ULONG cDuplicates, cStarted, iRound, i, j, k, l;
+
+    hChecked = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(hChecked != NULL, "CreateEventW failed with %lu\n", GetLastError());
+    if (!hChecked)
+        return;
+
+    for (iRound = 0; iRound < THREAD_ROUNDS; iRound++)
+    {
+        ResetEvent(hChecked);
+
+        for (cStarted = 0; cStarted < THREAD_COUNT; cStarted++)
+        {
+            i = cStarted;
+            ZeroMemory(&aThreads[i], sizeof(aThreads[i]));
+            aThreads[i].iThread = i;
+            aThreads[i].hChecked = hChecked;
+            aThreads[i].hCreated = CreateEventW(NULL, TRUE, FALSE, NULL);
+            ahCreated[i] = aThreads[i].hCreated;
+            if (!ahCreated[i])
+                break;
+
+            ahThreads[i] = CreateThread(NULL, 0, BrushThread, &aThreads[i], 0, NULL);
+            if (!ahThreads[i])
+            {
+                CloseHandle(ahCreated[i]);
+                break;
+            }
+        }
+
+        if (cStarted < THREAD_COUNT)
+        {
+            skip("Could not start thread %lu: %lu\n", cStarted, GetLastError());
+            SetEvent(hChecked);
+            goto Cleanup;
+        }
+
+        WaitForMultipleObjects(THREAD_COUNT, ahCreated, TRUE, INFINITE);
+
+        /* All brushes of all threads are alive at this point */
+        cDuplicates = 0;
+        for (i = 0; i < THREAD_COUNT; i++)
+        {
+            for (j = 0; j < THREAD_BRUSH_COUNT; j++)
+            {
+                if (!aThreads[i].ahbr[j])
+                    continue;
+
+                for (k = i; k < THREAD_COUNT; k++)
+                {
+                    for (l = (k == i) ? j + 1 : 0; l < THREAD_BRUSH_COUNT; l++)
+                    {
+                        if (aThreads[i].ahbr[j] == aThreads[k].ahbr[l])
+                            cDuplicates++;
+                    }
+                }
+            }
+        }
+        ok(cDuplicates == 0, "Round %lu: %lu duplicate handles\n", iRound, cDuplicates);
+
+        SetEvent(hChecked);
+        WaitForMultipleObjects(THREAD_COUNT, ahThreads, TRUE, INFINITE);
+
+        for (i = 0; i < THREAD_COUNT; i++)
+        {
+            ok(aThreads[i].cFailed == 0, "Round %lu, thread %lu: %lu brushes not created\n",
+               iRound, i, aThreads[i].cFailed);
+            ok(aThreads[i].cBad == 0, "Round %lu, thread %lu: %lu brushes have the wrong color\n",
+               iRound, i, aThreads[i].cBad);
+            ok(aThreads[i].cNotDeleted == 0, "Round %lu, thread %lu: %lu brushes not deleted\n",
+               iRound, i, aThreads[i].cNotDeleted);
+        }
+
+Cleanup:
+        for (i = 0; i < cStarted; i++)
+        {
+            WaitForSingleObject(ahThreads[i], INFINITE);
+            CloseHandle(ahThreads[i]);
+            CloseHandle(ahCreated[i]);
+        }
+
+        if (cStarted < THREAD_COUNT)
+            break;
+    }
+
+    CloseHandle(hChecked);
+}
+
+START_TEST(CreateSolidBrush)
+{
+    Test_CreateSolidBrush_Handles();
+    Test_CreateSolidBrush_Threads();
+}
@@ -0,0 +1,109 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for ExtTextOut and the glyph cache behind it
+ */
+
+#include "precomp.h"
+
+#define BMP_WIDTH       512
+#define BMP_HEIGHT      128
+
+static const WCHAR TestText[] = L"The quick brown fox jumps over the lazy dog 0123456789";
+
+static
+HFONT
+CreateTestFont(
+    _In_ INT Height)
+{
+    LOGFONTW lf;
+
+    ZeroMemory(&lf, sizeof(lf));
+    lf.lfHeight = -Height;
+    lf.lfCharSet = DEFAULT_CHARSET;
+    lf.lfQuality = ANTIALIASED_QUALITY;
+    lstrcpyW(lf.lfFaceName, L"Tahoma");
+    return CreateFontIndirectW(&lf);
+}
+
+static
+void
+DrawTestText(
+    _In_ HDC hdc,
+    _In_ INT Height)
+{
+    RECT rc = { 0, 0, BMP_WIDTH, BMP_HEIGHT };
+    HFONT hFont, hOldFont;
+
+    hFont = CreateTestFont(Height);
+    hOldFont = SelectObject(hdc, hFont);
+    ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc, TestText, lstrlenW(TestText), NULL);
+    SelectObject(hdc, hOldFont);
+    DeleteObject(hFont);
+}
+
+void Test_ExtTextOut_GlyphCache(void)
+{
+    BITMAPINFO bmi;
+    HBITMAP hbmp, hOldBmp;
+    PVOID pvBits;
+    PBYTE pFirst;
+    HDC hdc;
+    SIZE_T cjBits = BMP_WIDTH * BMP_HEIGHT * 4;
+    INT Height;
+
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != NULL, "CreateCompatibleDC failed\n");
+    if (!hdc)
+        return;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = BMP_WIDTH;
+    bmi.bmiHeader.biHeight = -BMP_HEIGHT;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    hbmp = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, &pvBits, NULL, 0);
+    ok(hbmp != NULL, "CreateDIBSection failed\n");
+    pFirst = HeapAlloc(GetProcessHeap(), 0, cjBits);
+    if (!hbmp || !pFirst)
+    {
+        skip("No bitmap\n");
+        if (hbmp)
+            DeleteObject(hbmp);
+        HeapFree(GetProcessHeap(), 0, pFirst);
+        DeleteDC(hdc);
+        return;
+    }
+    hOldBmp = SelectObject(hdc, hbmp);
+    SetBkColor(hdc, RGB(255, 255, 255));
+    SetTextColor(hdc, RGB(0, 0, 0));
+
+    /* Rendered the first time, then served from the cache */
+    DrawTestText(hdc, 24);
+    GdiFlush();
+    CopyMemory(pFirst, pvBits, cjBits);
+
+    DrawTestText(hdc, 24);
+    GdiFlush();
+    ok(memcmp(pFirst, pvBits, cjBits) == 0, "Cached glyphs differ from the rendered ones\n");
+
+    /* Enough sizes to push the first glyphs out of the cache */
+    for (Height = 8; Height <= 96; Height++)
+        DrawTestText(hdc, Height);
+
+    DrawTestText(hdc, 24);
+    GdiFlush();
+    ok(memcmp(pFirst, pvBits, cjBits) == 0, "Glyphs differ after cache eviction\n");
+
+    SelectObject(hdc, hOldBmp);
+    DeleteObject(hbmp);
+    HeapFree(GetProcessHeap(), 0, pFirst);
+    DeleteDC(hdc);
+}
+
+START_TEST(ExtTextOut)
+{
+    Test_ExtTextOut_GlyphCache();
+}
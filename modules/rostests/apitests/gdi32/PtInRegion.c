@@ -0,0 +1,146 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for PtInRegion and RectInRegion on complex regions
+ */
+
+#include "precomp.h"
+
+/* Overlapping rounded windows, which gives many bands with several rects each */
+static
+HRGN
+CreateComplexRegion(void)
+{
+    HRGN hrgn, hrgnPart;
+    INT x, y;
+
+    hrgn = CreateRectRgn(0, 0, 0, 0);
+    for (y = 0; y < 8; y++)
+    {
+        for (x = 0; x < 8; x++)
+        {
+            hrgnPart = CreateRoundRectRgn(x * 70 + y * 5, y * 50 + x * 3,
+                                          x * 70 + y * 5 + 90, y * 50 + x * 3 + 40,
+                                          16, 16);
+            CombineRgn(hrgn, hrgn, hrgnPart, RGN_OR);
+            DeleteObject(hrgnPart);
+        }
+    }
+
+    return hrgn;
+}
+
+static
+PRGNDATA
+GetRects(
+    _In_ HRGN hrgn)
+{
+    PRGNDATA pData;
+    DWORD cjSize;
+
+    cjSize = GetRegionData(hrgn, 0, NULL);
+    pData = HeapAlloc(GetProcessHeap(), 0, cjSize);
+    if (pData && !GetRegionData(hrgn, cjSize, pData))
+    {
+        HeapFree(GetProcessHeap(), 0, pData);
+        return NULL;
+    }
+    return pData;
+}
+
+void Test_PtInRegion(void)
+{
+    HRGN hrgn;
+    PRGNDATA pData;
+    PRECT prc;
+    POINT pt;
+    ULONG cMismatches = 0, i;
+    BOOL bExpected;
+
+    hrgn = CreateComplexRegion();
+    pData = GetRects(hrgn);
+    ok(pData != NULL, "GetRegionData failed\n");
+    if (!pData)
+    {
+        DeleteObject(hrgn);
+        return;
+    }
+    prc = (PRECT)pData->Buffer;
+    ok(pData->rdh.nCount > 100, "Only %lu rects\n", pData->rdh.nCount);
+
+    for (pt.y = -2; pt.y < 460; pt.y++)
+    {
+        for (pt.x = -2; pt.x < 600; pt.x += 3)
+        {
+            bExpected = FALSE;
+            for (i = 0; i < pData->rdh.nCount; i++)
+            {
+                if (PtInRect(&prc[i], pt))
+                {
+                    bExpected = TRUE;
+                    break;
+                }
+            }
+            if (PtInRegion(hrgn, pt.x, pt.y) != bExpected)
+                cMismatches++;
+        }
+    }
+    ok(cMismatches == 0, "PtInRegion was wrong for %lu points\n", cMismatches);
+
+    HeapFree(GetProcessHeap(), 0, pData);
+    DeleteObject(hrgn);
+}
+
+void Test_RectInRegion(void)
+{
+    HRGN hrgn;
+    PRGNDATA pData;
+    PRECT prc;
+    RECT rc, rcTmp;
+    ULONG cMismatches = 0, i;
+    BOOL bExpected;
+    INT x, y;
+
+    hrgn = CreateComplexRegion();
+    pData = GetRects(hrgn);
+    ok(pData != NULL, "GetRegionData failed\n");
+    if (!pData)
+    {
+        DeleteObject(hrgn);
+        return;
+    }
+    prc = (PRECT)pData->Buffer;
+
+    for (y = -4; y < 460; y += 2)
+    {
+        for (x = -4; x < 600; x += 5)
+        {
+            SetRect(&rc, x, y, x + 1 + (x & 7), y + 1 + (y & 3));
+            bExpected = FALSE;
+            for (i = 0; i < pData->rdh.nCount; i++)
+            {
+                if (IntersectRect(&rcTmp, &prc[i], &rc))
+                {
+                    bExpected = TRUE;
+                    break;
+                }
+            }
+            if (RectInRegion(hrgn, &rc) != bExpected)
+                cMismatches++;
+        }
+    }
+    ok(cMismatches == 0, "RectInRegion was wrong for %lu rects\n", cMismatches);
+
+    /* Swapped coordinates are the same rectangle */
+    SetRect(&rc, 40, 20, 10, 5);
+    ok(RectInRegion(hrgn, &rc) == TRUE, "Swapped rect not found\n");
+
+    HeapFree(GetProcessHeap(), 0, pData);
+    DeleteObject(hrgn);
+}
+
+START_TEST(PtInRegion)
+{
+    Test_PtInRegion();
+    Test_RectInRegion();
+}
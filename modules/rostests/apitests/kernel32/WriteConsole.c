@@ -0,0 +1,310 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for WriteConsole
+ */
+
+#include "precomp.h"
+
+#include <stdio.h>
+
+#define SB_WIDTH        80
+#define SB_HEIGHT       500
+#define LARGE_LINES     4000
+#define LONG_RUN        (SB_WIDTH + 5)
+
+static
+HANDLE
+CreateTestScreenBuffer(void)
+{
+    HANDLE hConOut;
+    COORD Size = { SB_WIDTH, SB_HEIGHT };
+
+    /* An inactive screen buffer, so that nothing gets painted */
+    hConOut = CreateConsoleScreenBuffer(GENERIC_READ | GENERIC_WRITE,
+                                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                        NULL,
+                                        CONSOLE_TEXTMODE_BUFFER,
+                                        NULL);
+    if (hConOut == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (!SetConsoleScreenBufferSize(hConOut, Size))
+    {
+        CloseHandle(hConOut);
+        return NULL;
+    }
+
+    return hConOut;
+}
+
+/* Every line fills a whole row, which wraps to the next one */
+static
+void
+FillLine(
+    _Out_writes_(SB_WIDTH) PCHAR pLine,
+    _In_ ULONG Line)
+{
+    ULONG i;
+
+    sprintf(pLine, "%06lu", Line);
+    for (i = 6; i < SB_WIDTH; i++)
+        pLine[i] = 'a' + (CHAR)((Line + i) % 26);
+}
+
+static
+void
+Test_WriteConsole_Large(void)
+{
+    HANDLE hConOut;
+    PCHAR pszText;
+    PWCHAR pszTextW;
+    CHAR Row[SB_WIDTH + 1], Expected[SB_WIDTH + 1];
+    DWORD cchText = LARGE_LINES * SB_WIDTH, cchWritten, cchRead, i;
+    COORD Coord;
+    BOOL Success;
+    ULONG cMismatches = 0;
+    SHORT y;
+
+    hConOut = CreateTestScreenBuffer();
+    if (!hConOut)
+    {
+        skip("No console screen buffer, error %lu\n", GetLastError());
+        return;
+    }
+
+    pszText = HeapAlloc(GetProcessHeap(), 0, cchText + 1);
+    pszTextW = HeapAlloc(GetProcessHeap(), 0, cchText * sizeof(WCHAR));
+    if (!pszText || !pszTextW)
+    {
+        skip("No memory\n");
+        HeapFree(GetProcessHeap(), 0, pszText);
+        HeapFree(GetProcessHeap(), 0, pszTextW);
+        CloseHandle(hConOut);
+        return;
+    }
+
+    for (i = 0; i < LARGE_LINES; i++)
+        FillLine(pszText + i * SB_WIDTH, i);
+    for (i = 0; i < cchText; i++)
+        pszTextW[i] = (WCHAR)(UCHAR)pszText[i];
+
+    /* Larger than both the CSR port heap and the shared output buffer */
+    cchWritten = 0;
+    Success = WriteConsoleA(hConOut, pszText, cchText, &cchWritten, NULL);
+    ok(Success, "WriteConsoleA failed, error %lu\n", GetLastError());
+    ok(cchWritten == cchText, "Wrote %lu chars instead of %lu\n", cchWritten, cchText);
+
+    cchWritten = 0;
+    Success = WriteConsoleW(hConOut, pszTextW, cchText, &cchWritten, NULL);
+    ok(Success, "WriteConsoleW failed, error %lu\n", GetLastError());
+    ok(cchWritten == cchText, "Wrote %lu chars instead of %lu\n", cchWritten, cchText);
+
+    /* The last row is the empty one after the last line, the ones above hold the last lines */
+    for (y = 0; y < SB_HEIGHT - 1; y++)
+    {
+        Coord.X = 0;
+        Coord.Y = y;
+        cchRead = 0;
+        ReadConsoleOutputCharacterA(hConOut, Row, SB_WIDTH, Coord, &cchRead);
+        FillLine(Expected, LARGE_LINES - (SB_HEIGHT - 1) + y);
+        if (cchRead != SB_WIDTH || memcmp(Row, Expected, SB_WIDTH) != 0)
+            cMismatches++;
+    }
+    ok(cMismatches == 0, "%lu rows differ from what was written\n", cMismatches);
+
+    HeapFree(GetProcessHeap(), 0, pszText);
+    HeapFree(GetProcessHeap(), 0, pszTextW);
+    CloseHandle(hConOut);
+}
+
+static
+BOOL
+ReadRow(
+    _In_ HANDLE hConOut,
+    _In_ SHORT y,
+    _Out_writes_(SB_WIDTH) PCHAR_INFO pRow)
+{
+    COORD BufferSize = { SB_WIDTH, 1 };
+    COORD BufferCoord = { 0, 0 };
+    SMALL_RECT Region = { 0, y, SB_WIDTH - 1, y };
+
+    return ReadConsoleOutputW(hConOut, pRow, BufferSize, BufferCoord, &Region);
+}
+
+static
+void
+WriteAt(
+    _In_ HANDLE hConOut,
+    _In_ SHORT x,
+    _In_ SHORT y,
+    _In_ PCWSTR pszText)
+{
+    COORD Coord = { x, y };
+    DWORD cchWritten = 0;
+    BOOL Success;
+
+    ok(SetConsoleCursorPosition(hConOut, Coord), "SetConsoleCursorPosition failed, error %lu\n", GetLastError());
+    Success = WriteConsoleW(hConOut, pszText, lstrlenW(pszText), &cchWritten, NULL);
+    ok(Success, "WriteConsoleW failed, error %lu\n", GetLastError());
+    ok(cchWritten == (DWORD)lstrlenW(pszText), "Wrote %lu chars instead of %d\n", cchWritten, lstrlenW(pszText));
+}
+
+#define ok_cursor(hConOut, x, y) \
+do { \
+    CONSOLE_SCREEN_BUFFER_INFO __csbi; \
+    BOOL __ok = GetConsoleScreenBufferInfo((hConOut), &__csbi); \
+    ok(__ok && __csbi.dwCursorPosition.X == (x) && __csbi.dwCursorPosition.Y == (y), \
+       "Expected cursor at (%d,%d), got (%d,%d)\n", (x), (y), \
+       __csbi.dwCursorPosition.X, __csbi.dwCursorPosition.Y); \
+} while (0)
+
+#define ok_cell(Row, x, ch, dbcs) \
+    ok((Row)[x].Char.UnicodeChar == (ch) && \
+       ((Row)[x].Attributes & COMMON_LVB_SBCSDBCS) == (dbcs), \
+       "Cell %d: got 0x%04x/0x%04x, expected 0x%04x/0x%04x\n", (x), \
+       (Row)[x].Char.UnicodeChar, (Row)[x].Attributes & COMMON_LVB_SBCSDBCS, \
+       (ch), (dbcs))
+
+/* Runs of plain characters that reach the end of the line */
+static
+void
+Test_WriteConsole_Wrap(void)
+{
+    HANDLE hConOut;
+    CHAR_INFO Row[SB_WIDTH];
+    WCHAR szLong[LONG_RUN + 1];
+    DWORD Mode;
+    int i;
+
+    hConOut = CreateTestScreenBuffer();
+    if (!hConOut)
+    {
+        skip("No console screen buffer, error %lu\n", GetLastError());
+        return;
+    }
+
+    ok(GetConsoleMode(hConOut, &Mode), "GetConsoleMode failed, error %lu\n", GetLastError());
+
+    /* Wrapping on: the run continues at the start of the next line */
+    ok(SetConsoleMode(hConOut, ENABLE_PROCESSED_OUTPUT | ENABLE_WRAP_AT_EOL_OUTPUT),
+       "SetConsoleMode failed, error %lu\n", GetLastError());
+    WriteAt(hConOut, SB_WIDTH - 5, 0, L"ABCDEFGHIJ");
+    ok_cursor(hConOut, 5, 1);
+
+    ok(ReadRow(hConOut, 0, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    for (i = 0; i < 5; i++)
+        ok_cell(Row, SB_WIDTH - 5 + i, L'A' + i, 0);
+    ok(ReadRow(hConOut, 1, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    for (i = 0; i < 5; i++)
+        ok_cell(Row, i, L'F' + i, 0);
+    ok_cell(Row, 5, L' ', 0);
+
+    /* Wrapping off: the cursor goes back to where the write started */
+    ok(SetConsoleMode(hConOut, ENABLE_PROCESSED_OUTPUT),
+       "SetConsoleMode failed, error %lu\n", GetLastError());
+    WriteAt(hConOut, SB_WIDTH - 5, 2, L"ABCDEFGHIJ");
+    ok_cursor(hConOut, SB_WIDTH - 5, 2);
+
+    ok(ReadRow(hConOut, 2, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    for (i = 0; i < 5; i++)
+        ok_cell(Row, SB_WIDTH - 5 + i, L'F' + i, 0);
+    ok(ReadRow(hConOut, 3, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    ok_cell(Row, 0, L' ', 0);
+
+    /* A run longer than the line overwrites its own start */
+    for (i = 0; i < LONG_RUN; i++)
+        szLong[i] = L'a' + (i % 26);
+    szLong[i] = UNICODE_NULL;
+    WriteAt(hConOut, 0, 4, szLong);
+    ok_cursor(hConOut, LONG_RUN - SB_WIDTH, 4);
+
+    ok(ReadRow(hConOut, 4, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    for (i = 0; i < SB_WIDTH; i++)
+    {
+        if (i < LONG_RUN - SB_WIDTH)
+            ok_cell(Row, i, szLong[SB_WIDTH + i], 0);
+        else
+            ok_cell(Row, i, szLong[i], 0);
+    }
+
+    SetConsoleMode(hConOut, Mode);
+    CloseHandle(hConOut);
+}
+
+/* Runs of plain characters next to full-width characters */
+static
+void
+Test_WriteConsole_FullWidth(void)
+{
+    static const WCHAR u9580[] = { 0x9580, 0 }; /* full-width in Japanese */
+    HANDLE hConOut;
+    CHAR_INFO Row[SB_WIDTH];
+    UINT OldCP;
+
+    if (!IsValidCodePage(932))
+    {
+        skip("Codepage 932 not available\n");
+        return;
+    }
+
+    hConOut = CreateTestScreenBuffer();
+    if (!hConOut)
+    {
+        skip("No console screen buffer, error %lu\n", GetLastError());
+        return;
+    }
+
+    OldCP = GetConsoleOutputCP();
+    if (!SetConsoleOutputCP(932))
+    {
+        skip("SetConsoleOutputCP failed, error %lu\n", GetLastError());
+        CloseHandle(hConOut);
+        return;
+    }
+
+    /* A run starting on the trailing half kills the leading half */
+    WriteAt(hConOut, 10, 0, u9580);
+    ok(ReadRow(hConOut, 0, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    ok_cell(Row, 10, 0x9580, COMMON_LVB_LEADING_BYTE);
+    ok(Row[11].Attributes & COMMON_LVB_TRAILING_BYTE, "Cell 11: attributes 0x%04x\n", Row[11].Attributes);
+
+    WriteAt(hConOut, 11, 0, L"xyz");
+    ok_cursor(hConOut, 14, 0);
+    ok(ReadRow(hConOut, 0, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    ok_cell(Row, 9, L' ', 0);
+    ok_cell(Row, 10, L' ', 0);
+    ok_cell(Row, 11, L'x', 0);
+    ok_cell(Row, 12, L'y', 0);
+    ok_cell(Row, 13, L'z', 0);
+    ok_cell(Row, 14, L' ', 0);
+
+    /* A run ending just before a full-width character leaves it alone */
+    WriteAt(hConOut, 20, 1, u9580);
+    WriteAt(hConOut, 17, 1, L"abc");
+    ok_cursor(hConOut, 20, 1);
+    ok(ReadRow(hConOut, 1, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    ok_cell(Row, 17, L'a', 0);
+    ok_cell(Row, 18, L'b', 0);
+    ok_cell(Row, 19, L'c', 0);
+    ok_cell(Row, 20, 0x9580, COMMON_LVB_LEADING_BYTE);
+    ok(Row[21].Attributes & COMMON_LVB_TRAILING_BYTE, "Cell 21: attributes 0x%04x\n", Row[21].Attributes);
+
+    /* One more and it ends on the leading half, which kills the trailing one */
+    WriteAt(hConOut, 17, 1, L"abcd");
+    ok_cursor(hConOut, 21, 1);
+    ok(ReadRow(hConOut, 1, Row), "ReadConsoleOutputW failed, error %lu\n", GetLastError());
+    ok_cell(Row, 20, L'd', 0);
+    ok_cell(Row, 21, L' ', 0);
+    ok_cell(Row, 22, L' ', 0);
+
+    SetConsoleOutputCP(OldCP);
+    CloseHandle(hConOut);
+}
+
+START_TEST(WriteConsole)
+{
+    Test_WriteConsole_Large();
+    Test_WriteConsole_Wrap();
+    Test_WriteConsole_FullWidth();
+}
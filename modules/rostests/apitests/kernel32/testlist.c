@@ -34,6 +34,7 @@ extern void func_SystemFirmware(void);
 extern void func_TerminateProcess(void);
 extern void func_TunnelCache(void);
 extern void func_WideCharToMultiByte(void);
+extern void func_WriteConsole(void);
 
 const struct test winetest_testlist[] =
 {
@@ -68,5 +69,6 @@ const struct test winetest_testlist[] =
     { "TerminateProcess",            func_TerminateProcess },
     { "TunnelCache",                 func_TunnelCache },
     { "WideCharToMultiByte",         func_WideCharToMultiByte },
+    { "WriteConsole",                func_WriteConsole },
     { 0, 0 }
 };
@@ -0,0 +1,208 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for InvalidateRect on windows with many children
+ */
+
+#include "precomp.h"
+
+#define GRID_COLUMNS        20
+#define GRID_ROWS           20
+#define CHILD_COUNT         (GRID_COLUMNS * GRID_ROWS)
+#define CHILD_WIDTH         20
+#define CHILD_HEIGHT        16
+
+static ULONG gacPaints[CHILD_COUNT];
+static ULONG gcParentPaints;
+
+static
+LRESULT
+CALLBACK
+ChildWndProc(
+    _In_ HWND hWnd,
+    _In_ UINT message,
+    _In_ WPARAM wParam,
+    _In_ LPARAM lParam)
+{
+    PAINTSTRUCT ps;
+    INT iChild;
+
+    if (message == WM_PAINT)
+    {
+        iChild = GetDlgCtrlID(hWnd);
+        if (iChild >= 0 && iChild < CHILD_COUNT)
+            gacPaints[iChild]++;
+        BeginPaint(hWnd, &ps);
+        EndPaint(hWnd, &ps);
+        return 0;
+    }
+    return DefWindowProcW(hWnd, message, wParam, lParam);
+}
+
+static
+LRESULT
+CALLBACK
+ParentWndProc(
+    _In_ HWND hWnd,
+    _In_ UINT message,
+    _In_ WPARAM wParam,
+    _In_ LPARAM lParam)
+{
+    if (message == WM_PAINT)
+        gcParentPaints++;
+    return DefWindowProcW(hWnd, message, wParam, lParam);
+}
+
+static
+void
+FlushMessages(void)
+{
+    MSG msg;
+
+    while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))
+        DispatchMessageW(&msg);
+}
+
+static
+void
+ResetPaintCounts(void)
+{
+    ZeroMemory(gacPaints, sizeof(gacPaints));
+    gcParentPaints = 0;
+}
+
+/* Returns the number of painted children, and checks that only the ones in prc were */
+static
+ULONG
+CountPaintedChildren(
+    _In_ const RECT *prc)
+{
+    RECT rcChild, rcTmp;
+    ULONG cPainted = 0, i;
+
+    for (i = 0; i < CHILD_COUNT; i++)
+    {
+        SetRect(&rcChild,
+                (i % GRID_COLUMNS) * CHILD_WIDTH,
+                (i / GRID_COLUMNS) * CHILD_HEIGHT,
+                (i % GRID_COLUMNS + 1) * CHILD_WIDTH,
+                (i / GRID_COLUMNS + 1) * CHILD_HEIGHT);
+
+        if (gacPaints[i])
+            cPainted++;
+
+        ok(!gacPaints[i] == !IntersectRect(&rcTmp, &rcChild, prc),
+           "Child %lu was painted %lu times\n", i, gacPaints[i]);
+    }
+
+    return cPainted;
+}
+
+/*
+ * A dialog-like window with a grid of children. An invalidation only
+ * reaches the children in the invalid rectangle, and only they get a
+ * WM_PAINT, also when the same child is invalidated over and over.
+ */
+START_TEST(InvalidateRect)
+{
+    HWND hParent, ahChildren[CHILD_COUNT];
+    RECT rc;
+    ULONG cPainted, i;
+
+    RegisterSimpleClass(ParentWndProc, L"InvalidateRectParent");
+    RegisterSimpleClass(ChildWndProc, L"InvalidateRectChild");
+
+    SetRect(&rc, 0, 0, GRID_COLUMNS * CHILD_WIDTH, GRID_ROWS * CHILD_HEIGHT);
+    AdjustWindowRect(&rc, WS_OVERLAPPEDWINDOW, FALSE);
+    hParent = CreateWindowExW(0, L"InvalidateRectParent", NULL, WS_OVERLAPPEDWINDOW,
+                              10, 10, rc.right - rc.left, rc.bottom - rc.top,
+                              NULL, NULL, NULL, NULL);
+    ok(hParent != NULL, "CreateWindow failed\n");
+    if (!hParent)
+        return;
+
+    for (i = 0; i < CHILD_COUNT; i++)
+    {
+        ahChildren[i] = CreateWindowExW(0, L"InvalidateRectChild", NULL, WS_CHILD | WS_VISIBLE,
+                                        (i % GRID_COLUMNS) * CHILD_WIDTH,
+                                        (i / GRID_COLUMNS) * CHILD_HEIGHT,
+                                        CHILD_WIDTH, CHILD_HEIGHT,
+                                        hParent, (HMENU)(ULONG_PTR)i, NULL, NULL);
+        if (!ahChildren[i])
+            break;
+    }
+    ok(i == CHILD_COUNT, "Only %lu children created\n", i);
+    if (i < CHILD_COUNT)
+    {
+        DestroyWindow(hParent);
+        return;
+    }
+
+    ShowWindow(hParent, SW_SHOW);
+    UpdateWindow(hParent);
+    FlushMessages();
+
+    /* Inside of a single child */
+    ResetPaintCounts();
+    SetRect(&rc, 3 * CHILD_WIDTH + 2, 2 * CHILD_HEIGHT + 2, 3 * CHILD_WIDTH + 8, 2 * CHILD_HEIGHT + 8);
+    InvalidateRect(hParent, &rc, TRUE);
+    UpdateWindow(hParent);
+    FlushMessages();
+    cPainted = CountPaintedChildren(&rc);
+    ok(cPainted == 1, "%lu children painted instead of 1\n", cPainted);
+    ok(gcParentPaints == 1, "Parent painted %lu times\n", gcParentPaints);
+
+    /* Across the corners of four children */
+    ResetPaintCounts();
+    SetRect(&rc, 8 * CHILD_WIDTH - 3, 5 * CHILD_HEIGHT - 3, 8 * CHILD_WIDTH + 3, 5 * CHILD_HEIGHT + 3);
+    InvalidateRect(hParent, &rc, TRUE);
+    UpdateWindow(hParent);
+    FlushMessages();
+    cPainted = CountPaintedChildren(&rc);
+    ok(cPainted == 4, "%lu children painted instead of 4\n", cPainted);
+
+    /* Two invalidations before the paint are painted once */
+    ResetPaintCounts();
+    SetRect(&rc, 0, 0, CHILD_WIDTH, CHILD_HEIGHT);
+    InvalidateRect(hParent, &rc, TRUE);
+    InvalidateRect(ahChildren[0], NULL, TRUE);
+    FlushMessages();
+    ok(gacPaints[0] == 1, "Child 0 painted %lu times\n", gacPaints[0]);
+    cPainted = CountPaintedChildren(&rc);
+    ok(cPainted == 1, "%lu children painted instead of 1\n", cPainted);
+
+    /* Everything */
+    ResetPaintCounts();
+    RedrawWindow(hParent, NULL, NULL, RDW_INVALIDATE | RDW_ERASE | RDW_ALLCHILDREN | RDW_UPDATENOW);
+    FlushMessages();
+    SetRect(&rc, 0, 0, GRID_COLUMNS * CHILD_WIDTH, GRID_ROWS * CHILD_HEIGHT);
+    cPainted = CountPaintedChildren(&rc);
+    ok(cPainted == CHILD_COUNT, "%lu children painted instead of %d\n", cPainted, CHILD_COUNT);
+
+    /* Validating the parent and all children leaves nothing to paint */
+    RedrawWindow(hParent, NULL, NULL, RDW_INVALIDATE | RDW_ALLCHILDREN);
+    RedrawWindow(hParent, NULL, NULL, RDW_VALIDATE | RDW_ALLCHILDREN);
+    ResetPaintCounts();
+    FlushMessages();
+    SetRectEmpty(&rc);
+    cPainted = CountPaintedChildren(&rc);
+    ok(cPainted == 0, "%lu children painted after validation\n", cPainted);
+
+    /* Every update paints the child once more */
+    ResetPaintCounts();
+    SetRect(&rc, 10 * CHILD_WIDTH + 4, 10 * CHILD_HEIGHT + 4, 10 * CHILD_WIDTH + 9, 10 * CHILD_HEIGHT + 9);
+    for (i = 0; i < 10; i++)
+    {
+        InvalidateRect(hParent, &rc, TRUE);
+        UpdateWindow(hParent);
+    }
+    FlushMessages();
+    ok(gacPaints[10 * GRID_COLUMNS + 10] == 10,
+       "Child painted %lu times instead of 10\n", gacPaints[10 * GRID_COLUMNS + 10]);
+    cPainted = CountPaintedChildren(&rc);
+    ok(cPainted == 1, "%lu children painted instead of 1\n", cPainted);
+
+    DestroyWindow(hParent);
+    UnregisterClassW(L"InvalidateRectParent", NULL);
+    UnregisterClassW(L"InvalidateRectChild", NULL);
+}
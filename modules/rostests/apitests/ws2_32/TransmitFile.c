@@ -0,0 +1,347 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for TransmitFile and TransmitPackets
+ */
+
+#include "ws2_32.h"
+#include <mswsock.h>
+
+#define FILE_SIZE       (8 * 1024 * 1024 + 123)
+#define CHUNK_SIZE      (64 * 1024)
+
+static LPFN_TRANSMITFILE pTransmitFile;
+static LPFN_TRANSMITPACKETS pTransmitPackets;
+
+static
+UCHAR
+PatternByte(
+    _In_ ULONG Offset)
+{
+    /* 251 is prime so the pattern never lines up with buffer boundaries */
+    return (UCHAR)(Offset % 251);
+}
+
+static
+BOOLEAN
+CreateConnectedPair(
+    _Out_ SOCKET *Client,
+    _Out_ SOCKET *Server)
+{
+    SOCKET listener;
+    struct sockaddr_in addr;
+    int addrlen;
+    int err;
+
+    *Client = INVALID_SOCKET;
+    *Server = INVALID_SOCKET;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+    {
+        skip("socket failed %d\n", WSAGetLastError());
+        return FALSE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = 0;
+
+    err = bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+    ok(err == 0, "bind err = %d %d\n", err, WSAGetLastError());
+    addrlen = sizeof(addr);
+    err = getsockname(listener, (struct sockaddr *)&addr, &addrlen);
+    ok(err == 0, "getsockname err = %d %d\n", err, WSAGetLastError());
+    err = listen(listener, 1);
+    ok(err == 0, "listen err = %d %d\n", err, WSAGetLastError());
+
+    *Client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (*Client == INVALID_SOCKET)
+    {
+        skip("socket failed %d\n", WSAGetLastError());
+        closesocket(listener);
+        return FALSE;
+    }
+
+    err = connect(*Client, (struct sockaddr *)&addr, sizeof(addr));
+    ok(err == 0, "connect err = %d %d\n", err, WSAGetLastError());
+
+    *Server = accept(listener, NULL, NULL);
+    ok(*Server != INVALID_SOCKET, "accept failed %d\n", WSAGetLastError());
+    closesocket(listener);
+
+    if (err != 0 || *Server == INVALID_SOCKET)
+    {
+        closesocket(*Client);
+        if (*Server != INVALID_SOCKET)
+            closesocket(*Server);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+HANDLE
+CreatePatternFile(
+    _Out_writes_(MAX_PATH) PCHAR FileName)
+{
+    CHAR TempPath[MAX_PATH];
+    HANDLE hFile;
+    PUCHAR Buffer;
+    ULONG Written = 0, Length, i;
+    DWORD Bytes;
+
+    GetTempPathA(MAX_PATH, TempPath);
+    GetTempFileNameA(TempPath, "tf", 0, FileName);
+
+    hFile = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                        NULL, CREATE_ALWAYS, FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return hFile;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+    {
+        CloseHandle(hFile);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    while (Written < FILE_SIZE)
+    {
+        Length = min(CHUNK_SIZE, FILE_SIZE - Written);
+        for (i = 0; i < Length; i++)
+            Buffer[i] = PatternByte(Written + i);
+
+        if (!WriteFile(hFile, Buffer, Length, &Bytes, NULL) || Bytes != Length)
+            break;
+        Written += Length;
+    }
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+
+    if (Written != FILE_SIZE)
+    {
+        CloseHandle(hFile);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    SetFilePointer(hFile, 0, NULL, FILE_BEGIN);
+    return hFile;
+}
+
+typedef struct _TRANSMIT_PARAMS {
+    SOCKET Socket;
+    HANDLE File;
+    BOOL Ret;
+    DWORD Error;
+} TRANSMIT_PARAMS, *PTRANSMIT_PARAMS;
+
+static
+DWORD
+WINAPI
+TransmitThread(
+    _In_ PVOID Parameter)
+{
+    PTRANSMIT_PARAMS Params = Parameter;
+
+    Params->Ret = pTransmitFile(Params->Socket, Params->File, 0, 0, NULL, NULL, TF_DISCONNECT);
+    Params->Error = GetLastError();
+    return 0;
+}
+
+/* Receives everything up to the disconnect and checks it against the pattern */
+static
+ULONG
+ReceiveAndVerify(
+    _In_ SOCKET Socket,
+    _Out_ PULONG Mismatch)
+{
+    PUCHAR Buffer;
+    ULONG Received = 0, i;
+    int err;
+
+    *Mismatch = 0;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+        return 0;
+
+    for (;;)
+    {
+        err = recv(Socket, (char *)Buffer, CHUNK_SIZE, 0);
+        if (err <= 0)
+            break;
+
+        for (i = 0; i < (ULONG)err && !*Mismatch; i++)
+        {
+            if (Buffer[i] != PatternByte(Received + i))
+                *Mismatch = Received + i + 1;
+        }
+        Received += err;
+    }
+    ok(err == 0, "recv err = %d %d\n", err, WSAGetLastError());
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    return Received;
+}
+
+static
+void
+Test_TransmitFile(void)
+{
+    CHAR FileName[MAX_PATH];
+    TRANSMIT_PARAMS Params;
+    SOCKET client, server;
+    HANDLE hthread;
+    ULONG Received, Mismatch;
+
+    Params.File = CreatePatternFile(FileName);
+    if (Params.File == INVALID_HANDLE_VALUE)
+    {
+        skip("Could not create the test file %lu\n", GetLastError());
+        return;
+    }
+
+    if (!CreateConnectedPair(&client, &server))
+    {
+        CloseHandle(Params.File);
+        return;
+    }
+
+    Params.Socket = client;
+
+    hthread = CreateThread(NULL, 0, TransmitThread, &Params, 0, NULL);
+    ok(hthread != NULL, "CreateThread %lu\n", GetLastError());
+    if (!hthread)
+    {
+        closesocket(server);
+        closesocket(client);
+        CloseHandle(Params.File);
+        return;
+    }
+
+    Received = ReceiveAndVerify(server, &Mismatch);
+
+    WaitForSingleObject(hthread, INFINITE);
+    CloseHandle(hthread);
+
+    ok(Params.Ret, "TransmitFile failed with %lu\n", Params.Error);
+    ok(Received == FILE_SIZE, "Received %lu bytes\n", Received);
+    ok(Mismatch == 0, "Data mismatch at offset %lu\n", Mismatch - 1);
+
+    closesocket(server);
+    closesocket(client);
+    CloseHandle(Params.File);
+}
+
+static
+void
+Test_TransmitPackets(void)
+{
+    TRANSMIT_PACKETS_ELEMENT Packets[3];
+    UCHAR Head[100], Tail[51];
+    CHAR FileName[MAX_PATH];
+    SOCKET client, server;
+    HANDLE hFile;
+    ULONG Received, Mismatch, i;
+    BOOL Ret;
+
+    hFile = CreatePatternFile(FileName);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        skip("Could not create the test file %lu\n", GetLastError());
+        return;
+    }
+
+    if (!CreateConnectedPair(&client, &server))
+    {
+        CloseHandle(hFile);
+        return;
+    }
+
+    /* Memory, a piece of the file, then memory again, all in pattern order */
+    for (i = 0; i < sizeof(Head); i++)
+        Head[i] = PatternByte(i);
+    for (i = 0; i < sizeof(Tail); i++)
+        Tail[i] = PatternByte(sizeof(Head) + CHUNK_SIZE + i);
+
+    memset(Packets, 0, sizeof(Packets));
+    Packets[0].dwElFlags = TP_ELEMENT_MEMORY;
+    Packets[0].cLength = sizeof(Head);
+    Packets[0].pBuffer = Head;
+    Packets[1].dwElFlags = TP_ELEMENT_FILE;
+    Packets[1].cLength = CHUNK_SIZE;
+    Packets[1].nFileOffset.QuadPart = sizeof(Head);
+    Packets[1].hFile = hFile;
+    Packets[2].dwElFlags = TP_ELEMENT_MEMORY | TP_ELEMENT_EOP;
+    Packets[2].cLength = sizeof(Tail);
+    Packets[2].pBuffer = Tail;
+
+    Ret = pTransmitPackets(client, Packets, 3, 0, NULL, TF_DISCONNECT);
+    ok(Ret, "TransmitPackets failed with %lu\n", GetLastError());
+
+    Received = ReceiveAndVerify(server, &Mismatch);
+    ok(Received == sizeof(Head) + CHUNK_SIZE + sizeof(Tail), "Received %lu bytes\n", Received);
+    ok(Mismatch == 0, "Data mismatch at offset %lu\n", Mismatch - 1);
+
+    /* The socket is closed for sending now */
+    Ret = pTransmitPackets(client, Packets, 1, 0, NULL, 0);
+    ok(!Ret, "TransmitPackets succeeded\n");
+
+    closesocket(server);
+    closesocket(client);
+    CloseHandle(hFile);
+}
+
+static
+BOOLEAN
+GetExtensionFunctions(void)
+{
+    GUID TransmitFileGUID = WSAID_TRANSMITFILE;
+    GUID TransmitPacketsGUID = WSAID_TRANSMITPACKETS;
+    SOCKET sock;
+    DWORD Bytes;
+    int err;
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET)
+        return FALSE;
+
+    err = WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                   &TransmitFileGUID, sizeof(TransmitFileGUID),
+                   &pTransmitFile, sizeof(pTransmitFile), &Bytes, NULL, NULL);
+    ok(err == 0, "WSAIoctl(TransmitFile) err = %d %d\n", err, WSAGetLastError());
+
+    err = WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                   &TransmitPacketsGUID, sizeof(TransmitPacketsGUID),
+                   &pTransmitPackets, sizeof(pTransmitPackets), &Bytes, NULL, NULL);
+    ok(err == 0, "WSAIoctl(TransmitPackets) err = %d %d\n", err, WSAGetLastError());
+
+    closesocket(sock);
+    return pTransmitFile && pTransmitPackets;
+}
+
+START_TEST(TransmitFile)
+{
+    int ret;
+    WSADATA wsad;
+
+    ret = WSAStartup(MAKEWORD(2, 2), &wsad);
+    ok(ret == 0, "WSAStartup failed with %d\n", ret);
+    if (ret != 0)
+        return;
+
+    if (!GetExtensionFunctions())
+    {
+        skip("TransmitFile is not available\n");
+        WSACleanup();
+        return;
+    }
+
+    Test_TransmitFile();
+    Test_TransmitPackets();
+
+    WSACleanup();
+}
@@ -0,0 +1,179 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for WSAPoll with many sockets
+ */
+
+#include "ws2_32.h"
+
+#define MANY_SOCKETS    10000
+
+static int (WINAPI *pWSAPoll)(WSAPOLLFD *, ULONG, INT);
+
+static
+SOCKET
+CreateBoundUdpSocket(
+    _Out_ struct sockaddr_in *addr)
+{
+    SOCKET sock;
+    int addrlen;
+    int err;
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr->sin_port = 0;
+
+    err = bind(sock, (struct sockaddr *)addr, sizeof(*addr));
+    ok(err == 0, "bind err = %d %d\n", err, WSAGetLastError());
+    addrlen = sizeof(*addr);
+    err = getsockname(sock, (struct sockaddr *)addr, &addrlen);
+    ok(err == 0, "getsockname err = %d %d\n", err, WSAGetLastError());
+
+    return sock;
+}
+
+static
+void
+Test_Basic(void)
+{
+    WSAPOLLFD fds[3];
+    struct sockaddr_in addr;
+    SOCKET sock;
+    char buffer[16];
+    int ret;
+
+    WSASetLastError(0xdeadbeef);
+    ret = pWSAPoll(NULL, 0, 0);
+    ok(ret == SOCKET_ERROR, "WSAPoll returned %d\n", ret);
+    ok(WSAGetLastError() == WSAEINVAL, "Error = %d\n", WSAGetLastError());
+
+    WSASetLastError(0xdeadbeef);
+    ret = pWSAPoll(NULL, 1, 0);
+    ok(ret == SOCKET_ERROR, "WSAPoll returned %d\n", ret);
+    ok(WSAGetLastError() == WSAEFAULT, "Error = %d\n", WSAGetLastError());
+
+    sock = CreateBoundUdpSocket(&addr);
+    if (sock == INVALID_SOCKET)
+    {
+        skip("socket failed %d. Aborting test.\n", WSAGetLastError());
+        return;
+    }
+
+    /* Nothing was received yet */
+    fds[0].fd = sock;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0xdead;
+    ret = pWSAPoll(fds, 1, 0);
+    ok(ret == 0, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents == 0, "revents = %x\n", fds[0].revents);
+
+    fds[0].events = POLLIN | POLLOUT;
+    ret = pWSAPoll(fds, 1, 0);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents == POLLWRNORM, "revents = %x\n", fds[0].revents);
+
+    ret = sendto(sock, "ReactOS", 7, 0, (struct sockaddr *)&addr, sizeof(addr));
+    ok(ret == 7, "sendto returned %d %d\n", ret, WSAGetLastError());
+
+    fds[0].events = POLLIN;
+    ret = pWSAPoll(fds, 1, 1000);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents == POLLRDNORM, "revents = %x\n", fds[0].revents);
+
+    /* Negative descriptors are skipped, closed ones are reported */
+    fds[0].fd = INVALID_SOCKET;
+    fds[0].events = POLLIN;
+    fds[1].fd = sock;
+    fds[1].events = POLLIN;
+    fds[2].fd = 0xdeadbeef;
+    fds[2].events = POLLIN;
+    fds[0].revents = fds[1].revents = fds[2].revents = 0xdead;
+    ret = pWSAPoll(fds, 3, 1000);
+    ok(ret == 2, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents == 0, "revents = %x\n", fds[0].revents);
+    ok(fds[1].revents == POLLRDNORM, "revents = %x\n", fds[1].revents);
+    ok(fds[2].revents == POLLNVAL, "revents = %x\n", fds[2].revents);
+
+    ret = recv(sock, buffer, sizeof(buffer), 0);
+    ok(ret == 7, "recv returned %d %d\n", ret, WSAGetLastError());
+
+    closesocket(sock);
+}
+
+static
+void
+Test_ManySockets(void)
+{
+    WSAPOLLFD *fds;
+    struct sockaddr_in addr;
+    ULONG Count, i;
+    int ret;
+
+    fds = HeapAlloc(GetProcessHeap(), 0, MANY_SOCKETS * sizeof(*fds));
+    if (!fds)
+    {
+        skip("No memory\n");
+        return;
+    }
+
+    for (Count = 0; Count < MANY_SOCKETS; Count++)
+    {
+        fds[Count].fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (fds[Count].fd == INVALID_SOCKET)
+            break;
+        fds[Count].events = POLLIN;
+    }
+
+    if (Count < MANY_SOCKETS)
+    {
+        skip("Only created %lu sockets, %d\n", Count, WSAGetLastError());
+        goto Cleanup;
+    }
+
+    /* Only the last socket of the set gets ready */
+    closesocket(fds[Count - 1].fd);
+    fds[Count - 1].fd = CreateBoundUdpSocket(&addr);
+    if (fds[Count - 1].fd == INVALID_SOCKET)
+    {
+        skip("socket failed %d\n", WSAGetLastError());
+        Count--;
+        goto Cleanup;
+    }
+
+    ret = sendto(fds[Count - 1].fd, "ReactOS", 7, 0, (struct sockaddr *)&addr, sizeof(addr));
+    ok(ret == 7, "sendto returned %d %d\n", ret, WSAGetLastError());
+
+    ret = pWSAPoll(fds, Count, 1000);
+    ok(ret == 1, "WSAPoll returned %d %d\n", ret, WSAGetLastError());
+    ok(fds[Count - 1].revents == POLLRDNORM, "revents = %x\n", fds[Count - 1].revents);
+    ok(fds[0].revents == 0, "revents = %x\n", fds[0].revents);
+
+Cleanup:
+    for (i = 0; i < Count; i++)
+        closesocket(fds[i].fd);
+    HeapFree(GetProcessHeap(), 0, fds);
+}
+
+START_TEST(WSAPoll)
+{
+    int ret;
+    WSADATA wsad;
+
+    pWSAPoll = (void *)GetProcAddress(GetModuleHandleA("ws2_32.dll"), "WSAPoll");
+    if (!pWSAPoll)
+    {
+        skip("WSAPoll is not available\n");
+        return;
+    }
+
+    ret = WSAStartup(MAKEWORD(2, 2), &wsad);
+    ok(ret == 0, "WSAStartup failed with %d\n", ret);
+    Test_Basic();
+    Test_ManySockets();
+    WSACleanup();
+}
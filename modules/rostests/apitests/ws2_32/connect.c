@@ -0,0 +1,190 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for connect/accept over loopback
+ */
+
+#include "ws2_32.h"
+
+#define OPEN_CONNECTIONS    500
+#define CHURN_CONNECTIONS   2000
+
+static
+SOCKET
+CreateListener(
+    _Out_ struct sockaddr_in *addr)
+{
+    SOCKET listener;
+    int addrlen;
+    int err;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr->sin_port = 0;
+
+    err = bind(listener, (struct sockaddr *)addr, sizeof(*addr));
+    ok(err == 0, "bind err = %d %d\n", err, WSAGetLastError());
+    addrlen = sizeof(*addr);
+    err = getsockname(listener, (struct sockaddr *)addr, &addrlen);
+    ok(err == 0, "getsockname err = %d %d\n", err, WSAGetLastError());
+    err = listen(listener, SOMAXCONN);
+    ok(err == 0, "listen err = %d %d\n", err, WSAGetLastError());
+
+    return listener;
+}
+
+/* Keeps many connections open and checks that every segment reaches its own one */
+static
+void
+Test_ManyConnections(void)
+{
+    SOCKET listener, *clients, *servers;
+    struct sockaddr_in addr, local;
+    ULONG Count, i, BadPort = 0, BadData = 0;
+    int addrlen;
+    int err;
+    char c;
+
+    listener = CreateListener(&addr);
+    if (listener == INVALID_SOCKET)
+    {
+        skip("socket failed %d\n", WSAGetLastError());
+        return;
+    }
+
+    clients = HeapAlloc(GetProcessHeap(), 0, OPEN_CONNECTIONS * sizeof(SOCKET));
+    servers = HeapAlloc(GetProcessHeap(), 0, OPEN_CONNECTIONS * sizeof(SOCKET));
+    if (!clients || !servers)
+    {
+        skip("No memory\n");
+        HeapFree(GetProcessHeap(), 0, clients);
+        HeapFree(GetProcessHeap(), 0, servers);
+        closesocket(listener);
+        return;
+    }
+
+    for (Count = 0; Count < OPEN_CONNECTIONS; Count++)
+    {
+        clients[Count] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (clients[Count] == INVALID_SOCKET)
+            break;
+
+        err = connect(clients[Count], (struct sockaddr *)&addr, sizeof(addr));
+        if (err != 0)
+        {
+            closesocket(clients[Count]);
+            break;
+        }
+
+        servers[Count] = accept(listener, NULL, NULL);
+        if (servers[Count] == INVALID_SOCKET)
+        {
+            closesocket(clients[Count]);
+            break;
+        }
+
+        /* Ephemeral ports come from the dynamic range */
+        addrlen = sizeof(local);
+        err = getsockname(clients[Count], (struct sockaddr *)&local, &addrlen);
+        if (err != 0 || ntohs(local.sin_port) < 49152)
+            BadPort++;
+    }
+    ok(Count == OPEN_CONNECTIONS, "Only made %lu connections, %d\n", Count, WSAGetLastError());
+    ok(BadPort == 0, "%lu ephemeral ports out of range\n", BadPort);
+
+    for (i = 0; i < Count; i++)
+    {
+        c = (char)i;
+        err = send(clients[i], &c, 1, 0);
+        ok(err == 1, "send err = %d %d\n", err, WSAGetLastError());
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        c = (char)~i;
+        err = recv(servers[i], &c, 1, 0);
+        if (err != 1 || c != (char)i)
+            BadData++;
+    }
+    ok(BadData == 0, "%lu connections received wrong data\n", BadData);
+
+    for (i = 0; i < Count; i++)
+    {
+        closesocket(clients[i]);
+        closesocket(servers[i]);
+    }
+
+    HeapFree(GetProcessHeap(), 0, clients);
+    HeapFree(GetProcessHeap(), 0, servers);
+    closesocket(listener);
+}
+
+/* Opens and closes connections back to back, with more and more of them in TIME-WAIT */
+static
+void
+Test_ConnectionChurn(void)
+{
+    SOCKET listener, client, server;
+    struct sockaddr_in addr;
+    ULONG i;
+    int err = 0;
+
+    listener = CreateListener(&addr);
+    if (listener == INVALID_SOCKET)
+    {
+        skip("socket failed %d\n", WSAGetLastError());
+        return;
+    }
+
+    for (i = 0; i < CHURN_CONNECTIONS; i++)
+    {
+        client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (client == INVALID_SOCKET)
+            break;
+
+        err = connect(client, (struct sockaddr *)&addr, sizeof(addr));
+        if (err != 0)
+        {
+            closesocket(client);
+            break;
+        }
+
+        server = accept(listener, NULL, NULL);
+        if (server == INVALID_SOCKET)
+        {
+            err = SOCKET_ERROR;
+            closesocket(client);
+            break;
+        }
+
+        /* The client closes first, so TIME-WAIT piles up on its side */
+        closesocket(client);
+        closesocket(server);
+    }
+
+    ok(i == CHURN_CONNECTIONS, "Failed after %lu connections, err = %d %d\n",
+       i, err, WSAGetLastError());
+
+    closesocket(listener);
+}
+
+START_TEST(connect)
+{
+    int ret;
+    WSADATA wsad;
+
+    ret = WSAStartup(MAKEWORD(2, 2), &wsad);
+    ok(ret == 0, "WSAStartup failed with %d\n", ret);
+    if (ret != 0)
+        return;
+
+    Test_ManyConnections();
+    Test_ConnectionChurn();
+
+    WSACleanup();
+}
@@ -0,0 +1,232 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for SO_RCVBUF/SO_SNDBUF and bulk TCP transfers
+ */
+
+#include "ws2_32.h"
+
+#define LARGE_BUFFER_SIZE   (1024 * 1024)
+#define CHUNK_SIZE          (64 * 1024)
+#define TRANSFER_SIZE       (32 * 1024 * 1024)
+
+static
+void
+Test_BufferSizes(void)
+{
+    SOCKET sock;
+    int err;
+    int size;
+    int len;
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET)
+    {
+        skip("socket failed %d. Aborting test.\n", WSAGetLastError());
+        return;
+    }
+
+    /* Sizes beyond 64 KB must be kept as is, not clamped */
+    size = LARGE_BUFFER_SIZE;
+    err = setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&size, sizeof(size));
+    ok(err == 0, "setsockopt SO_RCVBUF err = %d %d\n", err, WSAGetLastError());
+    ok(size == LARGE_BUFFER_SIZE, "optval was modified to %d\n", size);
+
+    size = 0;
+    len = sizeof(size);
+    err = getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&size, &len);
+    ok(err == 0, "getsockopt SO_RCVBUF err = %d %d\n", err, WSAGetLastError());
+    ok(size == LARGE_BUFFER_SIZE, "SO_RCVBUF = %d\n", size);
+
+    size = LARGE_BUFFER_SIZE;
+    err = setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *)&size, sizeof(size));
+    ok(err == 0, "setsockopt SO_SNDBUF err = %d %d\n", err, WSAGetLastError());
+
+    size = 0;
+    len = sizeof(size);
+    err = getsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *)&size, &len);
+    ok(err == 0, "getsockopt SO_SNDBUF err = %d %d\n", err, WSAGetLastError());
+    ok(size == LARGE_BUFFER_SIZE, "SO_SNDBUF = %d\n", size);
+
+    closesocket(sock);
+}
+
+static int SendChunkSize;
+
+/* Every byte of the stream depends on its offset, so reordered, lost or
+ * stale data shows up on the receiving side */
+#define PATTERN_BYTE(Offset)    ((char)((Offset) % 251))
+
+static
+void
+FillPattern(
+    _Out_writes_(Length) char *Buffer,
+    _In_ int Offset,
+    _In_ int Length)
+{
+    int i;
+
+    for (i = 0; i < Length; i++)
+        Buffer[i] = PATTERN_BYTE(Offset + i);
+}
+
+static
+DWORD
+WINAPI
+SenderThread(
+    _In_ PVOID Parameter)
+{
+    SOCKET sock = (SOCKET)Parameter;
+    char *Buffer;
+    int Sent = 0;
+    int Length;
+    int err;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, SendChunkSize);
+    if (!Buffer)
+    {
+        shutdown(sock, SD_SEND);
+        return 0;
+    }
+
+    /* The buffer is refilled as soon as send() returns, which must not
+     * change what the transport already accepted */
+    while (Sent < TRANSFER_SIZE)
+    {
+        Length = min(SendChunkSize, TRANSFER_SIZE - Sent);
+        FillPattern(Buffer, Sent, Length);
+        err = send(sock, Buffer, Length, 0);
+        if (err <= 0)
+            break;
+        Sent += err;
+    }
+
+    shutdown(sock, SD_SEND);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    return Sent;
+}
+
+static
+void
+Test_LoopbackTransfer(
+    _In_ int ChunkSize)
+{
+    SOCKET listener, client, server;
+    struct sockaddr_in addr;
+    int addrlen;
+    int size;
+    int err;
+    HANDLE hthread;
+    DWORD Sent;
+    char *Buffer;
+    ULONGLONG Received = 0;
+    ULONG cMismatches = 0;
+    int i;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET || client == INVALID_SOCKET)
+    {
+        skip("socket failed %d. Aborting test.\n", WSAGetLastError());
+        if (listener != INVALID_SOCKET) closesocket(listener);
+        if (client != INVALID_SOCKET) closesocket(client);
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = 0;
+
+    err = bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+    ok(err == 0, "bind err = %d %d\n", err, WSAGetLastError());
+    addrlen = sizeof(addr);
+    err = getsockname(listener, (struct sockaddr *)&addr, &addrlen);
+    ok(err == 0, "getsockname err = %d %d\n", err, WSAGetLastError());
+    err = listen(listener, 1);
+    ok(err == 0, "listen err = %d %d\n", err, WSAGetLastError());
+
+    /* Window scaling is always offered on the SYN with a fixed shift, so
+     * buffers well beyond the unscaled 64 KB limit can be asked for either
+     * before connecting (they are applied once connected) or after accept */
+    size = LARGE_BUFFER_SIZE;
+    err = setsockopt(client, SOL_SOCKET, SO_SNDBUF, (char *)&size, sizeof(size));
+    ok(err == 0, "setsockopt SO_SNDBUF err = %d %d\n", err, WSAGetLastError());
+
+    err = connect(client, (struct sockaddr *)&addr, sizeof(addr));
+    ok(err == 0, "connect err = %d %d\n", err, WSAGetLastError());
+
+    server = accept(listener, NULL, NULL);
+    ok(server != INVALID_SOCKET, "accept failed %d\n", WSAGetLastError());
+    closesocket(listener);
+    if (server == INVALID_SOCKET)
+    {
+        closesocket(client);
+        return;
+    }
+
+    size = LARGE_BUFFER_SIZE;
+    err = setsockopt(server, SOL_SOCKET, SO_RCVBUF, (char *)&size, sizeof(size));
+    ok(err == 0, "setsockopt SO_RCVBUF err = %d %d\n", err, WSAGetLastError());
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!Buffer)
+    {
+        skip("No memory\n");
+        closesocket(server);
+        closesocket(client);
+        return;
+    }
+
+    SendChunkSize = ChunkSize;
+
+    hthread = CreateThread(NULL, 0, SenderThread, (PVOID)client, 0, NULL);
+    ok(hthread != NULL, "CreateThread %ld\n", GetLastError());
+    if (!hthread)
+    {
+        HeapFree(GetProcessHeap(), 0, Buffer);
+        closesocket(server);
+        closesocket(client);
+        return;
+    }
+
+    for (;;)
+    {
+        err = recv(server, Buffer, CHUNK_SIZE, 0);
+        if (err <= 0)
+            break;
+        for (i = 0; i < err; i++)
+        {
+            if (Buffer[i] != PATTERN_BYTE(Received + i))
+                cMismatches++;
+        }
+        Received += err;
+    }
+    ok(err == 0, "recv err = %d %d\n", err, WSAGetLastError());
+
+    WaitForSingleObject(hthread, INFINITE);
+    GetExitCodeThread(hthread, &Sent);
+    CloseHandle(hthread);
+
+    ok(Sent == TRANSFER_SIZE, "Sent %lu bytes\n", Sent);
+    ok(Received == TRANSFER_SIZE, "Received %I64u bytes\n", Received);
+    ok(cMismatches == 0, "%lu bytes received with %d byte sends are wrong\n", cMismatches, ChunkSize);
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    closesocket(server);
+    closesocket(client);
+}
+
+START_TEST(sockbuf)
+{
+    int ret;
+    WSADATA wsad;
+
+    ret = WSAStartup(MAKEWORD(2, 2), &wsad);
+    ok(ret == 0, "WSAStartup failed with %d\n", ret);
+    Test_BufferSizes();
+    Test_LoopbackTransfer(4096);
+    Test_LoopbackTransfer(CHUNK_SIZE);
+    Test_LoopbackTransfer(LARGE_BUFFER_SIZE);
+    WSACleanup();
+}
@@ -5,6 +5,7 @@
 
 extern void func_bind(void);
 extern void func_close(void);
+extern void func_connect(void);
 extern void func_getaddrinfo(void);
 extern void func_gethostname(void);
 extern void func_getnameinfo(void);
@@ -16,8 +17,11 @@ extern void func_nostartup(void);
 extern void func_open_osfhandle(void);
 extern void func_recv(void);
 extern void func_send(void);
+extern void func_sockbuf(void);
+extern void func_TransmitFile(void);
 extern void func_WSAAsync(void);
 extern void func_WSAIoctl(void);
+extern void func_WSAPoll(void);
 extern void func_WSARecv(void);
 extern void func_WSAStartup(void);
 
@@ -25,6 +29,7 @@ const struct test winetest_testlist[] =
 {
     { "bind", func_bind },
     { "close", func_close },
+    { "connect", func_connect },
     { "getaddrinfo", func_getaddrinfo },
     { "gethostname", func_gethostname },
     { "getnameinfo", func_getnameinfo },
@@ -36,8 +41,11 @@ const struct test winetest_testlist[] =
     { "open_osfhandle", func_open_osfhandle },
     { "recv", func_recv },
     { "send", func_send },
+    { "sockbuf", func_sockbuf },
+    { "TransmitFile", func_TransmitFile },
     { "WSAAsync", func_WSAAsync },
     { "WSAIoctl", func_WSAIoctl },
+    { "WSAPoll", func_WSAPoll },
     { "WSARecv", func_WSARecv },
     { "WSAStartup", func_WSAStartup },
     { 0, 0 }
@@ -1,9 +1,17 @@
 #include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 BOOL WINAPI GdiAlphaBlend(HDC hdcDst, int xDst, int yDst, int widthDst, int heightDst,
                           HDC hdcSrc, int xSrc, int ySrc, int widthSrc, int heightSrc,
                            BLENDFUNCTION blendFunction);
+BOOL WINAPI GdiTransparentBlt(HDC hdcDst, int xDst, int yDst, int widthDst, int heightDst,
+                              HDC hdcSrc, int xSrc, int ySrc, int widthSrc, int heightSrc,
+                              UINT crTransparent);
+
+#define BENCH_SIZE        256
+#define BENCH_ITERATIONS  200
 
 #ifndef AC_SRC_ALPHA
 #define AC_SRC_ALPHA	(0x1)
@@ -117,11 +125,147 @@ BOOL ConvertBitmapTo32Bpp(HDC hDC, BITMAP *bmp)
   return FALSE;
 }
 
+/* What AlphaBlend must produce for one 32bpp pixel */
+static DWORD RefBlend(DWORD Dst, DWORD Src, BLENDFUNCTION BlendFunc)
+{
+  DWORD Result = 0, Alpha, s, d;
+  int i;
+
+  Alpha = (BlendFunc.AlphaFormat & AC_SRC_ALPHA) ?
+          ((Src >> 24) * BlendFunc.SourceConstantAlpha) / 255 :
+          BlendFunc.SourceConstantAlpha;
+
+  for (i = 0; i < 32; i += 8)
+  {
+    s = (((Src >> i) & 0xFF) * BlendFunc.SourceConstantAlpha) / 255;
+    d = (((Dst >> i) & 0xFF) * (255 - Alpha)) / 255 + s;
+    Result |= min(d, 255) << i;
+  }
+  return Result;
+}
+
+static HBITMAP CreateBench32(HDC hdc, DWORD **Bits)
+{
+  BITMAPINFO bmi;
+
+  ZeroMemory(&bmi, sizeof(bmi));
+  bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+  bmi.bmiHeader.biWidth = BENCH_SIZE;
+  bmi.bmiHeader.biHeight = -BENCH_SIZE;
+  bmi.bmiHeader.biPlanes = 1;
+  bmi.bmiHeader.biBitCount = 32;
+  bmi.bmiHeader.biCompression = BI_RGB;
+  return CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, (PVOID*)Bits, NULL, 0);
+}
+
+/* Checks unstretched 32bpp AlphaBlend/TransparentBlt against the reference
+   and times them. Click into the window to run it. */
+static void RunBenchmark(HWND HWnd)
+{
+  static const BLENDFUNCTION Modes[] =
+  {
+    { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA },
+    { AC_SRC_OVER, 0, 128, AC_SRC_ALPHA },
+    { AC_SRC_OVER, 0, 128, 0 },
+  };
+  HDC hdcSrc, hdcDst;
+  HBITMAP hbmSrc, hbmDst;
+  DWORD *SrcBits, *DstBits, *Expected;
+  DWORD Start, Time[4], i, n, Errors = 0;
+  char Text[256];
+
+  hdcSrc = CreateCompatibleDC(NULL);
+  hdcDst = CreateCompatibleDC(NULL);
+  hbmSrc = CreateBench32(hdcSrc, &SrcBits);
+  hbmDst = CreateBench32(hdcDst, &DstBits);
+  Expected = HeapAlloc(GetProcessHeap(), 0, BENCH_SIZE * BENCH_SIZE * sizeof(DWORD));
+  if (!hdcSrc || !hdcDst || !hbmSrc || !hbmDst || !Expected)
+    goto Cleanup;
+
+  SelectObject(hdcSrc, hbmSrc);
+  SelectObject(hdcDst, hbmDst);
+
+  for (n = 0; n < sizeof(Modes) / sizeof(Modes[0]); n++)
+  {
+    srand(n);
+    for (i = 0; i < BENCH_SIZE * BENCH_SIZE; i++)
+    {
+      SrcBits[i] = (rand() << 17) ^ (rand() << 2) ^ rand();
+      DstBits[i] = (rand() << 17) ^ (rand() << 2) ^ rand();
+      Expected[i] = RefBlend(DstBits[i], SrcBits[i], Modes[n]);
+    }
+
+    GdiAlphaBlend(hdcDst, 0, 0, BENCH_SIZE, BENCH_SIZE,
+                  hdcSrc, 0, 0, BENCH_SIZE, BENCH_SIZE, Modes[n]);
+    GdiFlush();
+    for (i = 0; i < BENCH_SIZE * BENCH_SIZE; i++)
+    {
+      if (DstBits[i] != Expected[i])
+        Errors++;
+    }
+
+    Start = GetTickCount();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+    {
+      GdiAlphaBlend(hdcDst, 0, 0, BENCH_SIZE, BENCH_SIZE,
+                    hdcSrc, 0, 0, BENCH_SIZE, BENCH_SIZE, Modes[n]);
+    }
+    GdiFlush();
+    Time[n] = GetTickCount() - Start;
+  }
+
+  /* Every other pixel is the color key */
+  for (i = 0; i < BENCH_SIZE * BENCH_SIZE; i++)
+  {
+    SrcBits[i] = (i & 1) ? 0x00FF00FF : i;
+    DstBits[i] = 0x12345678;
+  }
+  GdiTransparentBlt(hdcDst, 0, 0, BENCH_SIZE, BENCH_SIZE,
+                    hdcSrc, 0, 0, BENCH_SIZE, BENCH_SIZE, RGB(0xFF, 0, 0xFF));
+  GdiFlush();
+  for (i = 0; i < BENCH_SIZE * BENCH_SIZE; i++)
+  {
+    if (DstBits[i] != ((i & 1) ? 0x12345678 : i))
+      Errors++;
+  }
+
+  Start = GetTickCount();
+  for (i = 0; i < BENCH_ITERATIONS; i++)
+  {
+    GdiTransparentBlt(hdcDst, 0, 0, BENCH_SIZE, BENCH_SIZE,
+                      hdcSrc, 0, 0, BENCH_SIZE, BENCH_SIZE, RGB(0xFF, 0, 0xFF));
+  }
+  GdiFlush();
+  Time[3] = GetTickCount() - Start;
+
+  sprintf(Text, "%d iterations of %dx%d:\n"
+                "per-pixel alpha: %lu ms\n"
+                "per-pixel and constant alpha: %lu ms\n"
+                "constant alpha: %lu ms\n"
+                "TransparentBlt: %lu ms\n\n"
+                "%lu wrong pixels",
+          BENCH_ITERATIONS, BENCH_SIZE, BENCH_SIZE,
+          Time[0], Time[1], Time[2], Time[3], Errors);
+  MessageBoxA(HWnd, Text, "AlphaBlend benchmark", Errors ? MB_ICONERROR : MB_ICONINFORMATION);
+
+Cleanup:
+  HeapFree(GetProcessHeap(), 0, Expected);
+  if (hdcSrc) DeleteDC(hdcSrc);
+  if (hdcDst) DeleteDC(hdcDst);
+  if (hbmSrc) DeleteObject(hbmSrc);
+  if (hbmDst) DeleteObject(hbmDst);
+}
+
 LRESULT CALLBACK MainWndProc(HWND HWnd, UINT Msg, WPARAM WParam,
    LPARAM LParam)
 {
    switch (Msg)
    {
+      case WM_LBUTTONDOWN:
+      {
+         RunBenchmark(HWnd);
+         return 0;
+      }
       case WM_CREATE:
       {
          /* create a memory DC */
@@ -569,6 +569,93 @@ TestReadWrite(
     FinishWorkerThread(&ConnectContext);
 }
 
+#define LARGE_MESSAGE_BUFFER_SIZE   (64 * 1024)
+#define LARGE_MESSAGE_ITERATIONS    16
+
+static KSTART_ROUTINE TestLargeMessages;
+static
+VOID
+NTAPI
+TestLargeMessages(
+    IN PVOID Context)
+{
+    static const ULONG MessageSizes[] = { 64, 512, 4096, 16384, 65536 };
+    PREAD_WRITE_TEST_CONTEXT TestContext = Context;
+    PCWSTR PipePath = TestContext->PipePath;
+    NTSTATUS Status;
+    HANDLE ServerHandle;
+    HANDLE ClientHandle;
+    THREAD_CONTEXT ConnectContext;
+    THREAD_CONTEXT ClientWriteContext;
+    BOOLEAN Okay;
+    PUCHAR ReadBuffer;
+    PUCHAR WriteBuffer;
+    ULONG_PTR BytesRead;
+    ULONG Size;
+    ULONG i, j;
+
+    ReadBuffer = ExAllocatePoolWithTag(NonPagedPool, LARGE_MESSAGE_BUFFER_SIZE, 'RNmK');
+    WriteBuffer = ExAllocatePoolWithTag(NonPagedPool, LARGE_MESSAGE_BUFFER_SIZE, 'WNmK');
+    if (skip(ReadBuffer != NULL && WriteBuffer != NULL, "Out of memory\n"))
+    {
+        if (ReadBuffer) ExFreePoolWithTag(ReadBuffer, 'RNmK');
+        if (WriteBuffer) ExFreePoolWithTag(WriteBuffer, 'WNmK');
+        return;
+    }
+
+    StartWorkerThread(&ConnectContext);
+    StartWorkerThread(&ClientWriteContext);
+
+    Status = MakeServer(&ServerHandle, PipePath, TRUE);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Okay = CheckConnectPipe(&ConnectContext, PipePath, TRUE, 100);
+    ok_bool_true(Okay, "CheckConnectPipe returned");
+    ok_eq_hex(ConnectContext.Connect.Status, STATUS_SUCCESS);
+    ClientHandle = ConnectContext.Connect.ClientHandle;
+
+    if (!skip(NT_SUCCESS(ConnectContext.Connect.Status), "Client not connected\n"))
+    {
+        for (i = 0; i < RTL_NUMBER_OF(MessageSizes); i++)
+        {
+            /* The writer is triggered first, but usually only gets to run once
+             * we block in the read. Messages of two pages or more then take the
+             * direct path into the pending read's locked buffer */
+            Size = MessageSizes[i];
+            for (j = 0; j < LARGE_MESSAGE_ITERATIONS; j++)
+            {
+                WriteBuffer[0] = (UCHAR)j;
+                WriteBuffer[Size - 1] = (UCHAR)~j;
+                ReadBuffer[0] = (UCHAR)~j;
+                CheckWritePipe(&ClientWriteContext, ClientHandle, WriteBuffer, Size, 0);
+                Status = NpReadPipe(ServerHandle, ReadBuffer, Size, &BytesRead);
+                Okay = WaitForWork(&ClientWriteContext, 1000);
+                if (!NT_SUCCESS(Status) || !Okay ||
+                    BytesRead != Size ||
+                    ClientWriteContext.ReadWrite.BytesTransferred != Size ||
+                    ReadBuffer[0] != (UCHAR)j ||
+                    ReadBuffer[Size - 1] != (UCHAR)~j)
+                {
+                    ok(0, "Size %lu, iteration %lu: Status %lx, read %lu, wrote %lu\n",
+                       Size, j, Status, (ULONG)BytesRead, (ULONG)ClientWriteContext.ReadWrite.BytesTransferred);
+                    break;
+                }
+            }
+        }
+
+        Status = ObCloseHandle(ClientHandle, KernelMode);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+    }
+
+    Status = ObCloseHandle(ServerHandle, KernelMode);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    FinishWorkerThread(&ClientWriteContext);
+    FinishWorkerThread(&ConnectContext);
+
+    ExFreePoolWithTag(WriteBuffer, 'WNmK');
+    ExFreePoolWithTag(ReadBuffer, 'RNmK');
+}
+
 START_TEST(NpfsReadWrite)
 {
     PKTHREAD Thread;
@@ -595,4 +682,7 @@ START_TEST(NpfsReadWrite)
     TestContext.ClientSynchronous = FALSE;
     Thread = KmtStartThread(TestReadWrite, &TestContext);
     KmtFinishThread(Thread, NULL);
+
+    Thread = KmtStartThread(TestLargeMessages, &TestContext);
+    KmtFinishThread(Thread, NULL);
 }
@@ -715,10 +715,184 @@ static VOID FsRtlLargeMcbTestsFastFat()
     FsRtlUninitializeLargeMcb(&FirstMcb);
 }
 
+static VOID FsRtlLargeMcbTestsManyRuns()
+{
+    LARGE_MCB LargeMcb;
+    LONGLONG Vbn, Lbn, SectorCount, StartingLbn, CountFromStartingLbn;
+    ULONG i, Index, NbRuns, Errors;
+    BOOLEAN Result;
+    const ULONG RunCount = 4096;
+    const ULONG LookupCount = 100000;
+
+    FsRtlInitializeLargeMcb(&LargeMcb, PagedPool);
+
+    /* Extend sequentially, with a hole after each run:
+     * [0,100,8][8,-1,8][16,132,8][24,-1,8]...
+     */
+    Errors = 0;
+    for (i = 0; i < RunCount; i++)
+    {
+        if (!FsRtlAddLargeMcbEntry(&LargeMcb, i * 16LL, i * 32LL + 100, 8))
+            Errors++;
+    }
+    ok_eq_ulong(Errors, 0);
+
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 2 * RunCount - 1);
+
+    Result = FsRtlLookupLastLargeMcbEntryAndIndex(&LargeMcb, &Vbn, &Lbn, &Index);
+    ok_bool_true(Result, "FsRtlLookupLastLargeMcbEntryAndIndex returned");
+    ok_eq_longlong(Vbn, (RunCount - 1) * 16LL + 7);
+    ok_eq_longlong(Lbn, (RunCount - 1) * 32LL + 107);
+    ok_eq_ulong(Index, 2 * RunCount - 2);
+
+    /* Check every run and every hole */
+    Errors = 0;
+    for (i = 0; i < RunCount; i++)
+    {
+        Result = FsRtlLookupLargeMcbEntry(&LargeMcb, i * 16LL + 3, &Lbn, &SectorCount, &StartingLbn, &CountFromStartingLbn, &Index);
+        if (!Result || Lbn != i * 32LL + 103 || SectorCount != 5 || StartingLbn != i * 32LL + 100 ||
+            CountFromStartingLbn != 8 || Index != 2 * i)
+        {
+            Errors++;
+        }
+
+        if (i == RunCount - 1)
+            break;
+
+        Result = FsRtlLookupLargeMcbEntry(&LargeMcb, i * 16LL + 9, &Lbn, &SectorCount, &StartingLbn, &CountFromStartingLbn, &Index);
+        if (!Result || Lbn != -1 || SectorCount != 7 || StartingLbn != -1 ||
+            CountFromStartingLbn != 8 || Index != 2 * i + 1)
+        {
+            Errors++;
+        }
+
+        Result = FsRtlGetNextLargeMcbEntry(&LargeMcb, 2 * i + 1, &Vbn, &Lbn, &SectorCount);
+        if (!Result || Vbn != i * 16LL + 8 || Lbn != -1 || SectorCount != 8)
+            Errors++;
+    }
+    ok_eq_ulong(Errors, 0);
+
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, RunCount * 16LL, &Lbn, NULL, NULL, NULL, NULL);
+    ok_bool_false(Result, "FsRtlLookupLargeMcbEntry returned");
+
+    /* Punch a hole in the middle of a run: it gets split in two */
+    FsRtlRemoveLargeMcbEntry(&LargeMcb, 1000 * 16LL + 2, 4);
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 2 * RunCount + 1);
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 1000 * 16LL + 6, &Lbn, &SectorCount, &StartingLbn, &CountFromStartingLbn, &Index);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 1000 * 32LL + 106);
+    ok_eq_longlong(SectorCount, 2);
+    ok_eq_longlong(StartingLbn, 1000 * 32LL + 106);
+    ok_eq_longlong(CountFromStartingLbn, 2);
+    ok_eq_ulong(Index, 2002);
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 2000 * 16LL, &Lbn, NULL, NULL, NULL, &Index);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 2000 * 32LL + 100);
+    ok_eq_ulong(Index, 4002);
+
+    /* Fill it back: the three pieces are merged again */
+    Result = FsRtlAddLargeMcbEntry(&LargeMcb, 1000 * 16LL + 2, 1000 * 32LL + 102, 4);
+    ok_bool_true(Result, "FsRtlAddLargeMcbEntry returned");
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 2 * RunCount - 1);
+
+    /* Shift the upper half of the mapping */
+    Result = FsRtlSplitLargeMcb(&LargeMcb, 2048 * 16LL + 4, 16);
+    ok_bool_true(Result, "FsRtlSplitLargeMcb returned");
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 2 * RunCount + 1);
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 2048 * 16LL + 20, &Lbn, &SectorCount, NULL, NULL, &Index);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 2048 * 32LL + 104);
+    ok_eq_longlong(SectorCount, 4);
+    ok_eq_ulong(Index, 4098);
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 3000 * 16LL + 16, &Lbn, NULL, NULL, NULL, NULL);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 3000 * 32LL + 100);
+
+    FsRtlTruncateLargeMcb(&LargeMcb, 2048 * 16LL + 2);
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 4097);
+    Result = FsRtlLookupLastLargeMcbEntry(&LargeMcb, &Vbn, &Lbn);
+    ok_bool_true(Result, "FsRtlLookupLastLargeMcbEntry returned");
+    ok_eq_longlong(Vbn, 2048 * 16LL + 1);
+    ok_eq_longlong(Lbn, 2048 * 32LL + 101);
+
+    /* Random lookups on the remaining mapping */
+    Errors = 0;
+    for (i = 0; i < LookupCount; i++)
+    {
+        Vbn = ((i * 7919) % 2048) * 16LL + 3;
+        Result = FsRtlLookupLargeMcbEntry(&LargeMcb, Vbn, &Lbn, NULL, NULL, NULL, NULL);
+        if (!Result || Lbn == -1)
+            Errors++;
+    }
+    ok_eq_ulong(Errors, 0);
+
+    FsRtlUninitializeLargeMcb(&LargeMcb);
+}
+
+/* A run added right before another one is only merged with it when the
+ * Lbns are contiguous too */
+static VOID FsRtlLargeMcbTestsAdjacentRuns()
+{
+    LARGE_MCB LargeMcb;
+    LONGLONG Vbn, Lbn, SectorCount;
+    ULONG NbRuns;
+    BOOLEAN Result;
+
+    FsRtlInitializeLargeMcb(&LargeMcb, PagedPool);
+
+    Result = FsRtlAddLargeMcbEntry(&LargeMcb, 16, 500, 8);
+    ok_bool_true(Result, "FsRtlAddLargeMcbEntry returned");
+
+    /* [8,100,8] ends where [16,500,8] starts, but its Lbns end at 108 */
+    Result = FsRtlAddLargeMcbEntry(&LargeMcb, 8, 100, 8);
+    ok_bool_true(Result, "FsRtlAddLargeMcbEntry returned");
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 3);
+
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 10, &Lbn, &SectorCount, NULL, NULL, NULL);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 102);
+    ok_eq_longlong(SectorCount, 6);
+
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 18, &Lbn, &SectorCount, NULL, NULL, NULL);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 502);
+    ok_eq_longlong(SectorCount, 6);
+
+    Result = FsRtlLookupLastLargeMcbEntry(&LargeMcb, &Vbn, &Lbn);
+    ok_bool_true(Result, "FsRtlLookupLastLargeMcbEntry returned");
+    ok_eq_longlong(Vbn, 23);
+    ok_eq_longlong(Lbn, 507);
+
+    /* [0,92,8] continues [8,100,8] on disk as well, so they become one run */
+    Result = FsRtlAddLargeMcbEntry(&LargeMcb, 0, 92, 8);
+    ok_bool_true(Result, "FsRtlAddLargeMcbEntry returned");
+    NbRuns = FsRtlNumberOfRunsInLargeMcb(&LargeMcb);
+    ok_eq_ulong(NbRuns, 2);
+
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 2, &Lbn, &SectorCount, NULL, NULL, NULL);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 94);
+    ok_eq_longlong(SectorCount, 14);
+
+    Result = FsRtlLookupLargeMcbEntry(&LargeMcb, 16, &Lbn, NULL, NULL, NULL, NULL);
+    ok_bool_true(Result, "FsRtlLookupLargeMcbEntry returned");
+    ok_eq_longlong(Lbn, 500);
+
+    FsRtlUninitializeLargeMcb(&LargeMcb);
+}
+
 START_TEST(FsRtlMcb)
 {
     FsRtlMcbTest();
     FsRtlLargeMcbTest();
     FsRtlLargeMcbTestsExt2();
     FsRtlLargeMcbTestsFastFat();
+    FsRtlLargeMcbTestsManyRuns();
+    FsRtlLargeMcbTestsAdjacentRuns();
 }
@@ -15,6 +15,44 @@
 
 /* FUNCTIONS *****************************************************************/
 
+/* Finds the view a CcMdlRead MDL was built over. The caller owns the
+ * reference CcMdlRead kept on it, so the view can't go away meanwhile */
+static
+PROS_VACB
+CcpFindMdlVacb (
+    IN PROS_SHARED_CACHE_MAP SharedCacheMap,
+    IN PMDL Mdl)
+{
+    PLIST_ENTRY current_entry;
+    PROS_VACB current, Found = NULL;
+    ULONG_PTR Address;
+    KIRQL oldIrql;
+
+    Address = (ULONG_PTR)MmGetMdlVirtualAddress(Mdl);
+
+    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+
+    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
+    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    {
+        current = CONTAINING_RECORD(current_entry,
+                                    ROS_VACB,
+                                    CacheMapVacbListEntry);
+        if (Address - (ULONG_PTR)current->BaseAddress < VACB_MAPPING_GRANULARITY)
+        {
+            Found = current;
+            break;
+        }
+        current_entry = current_entry->Flink;
+    }
+
+    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+
+    return Found;
+}
+
 /*
  * @implemented
  */
@@ -28,10 +66,96 @@ CcMdlRead (
     OUT PIO_STATUS_BLOCK IoStatus
     )
 {
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    LONGLONG CurrentOffset;
+    ULONG PartialLength, VacbOffset, BytesMapped;
+    PROS_VACB Vacb;
+    PVOID BaseAddress;
+    BOOLEAN Valid;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PMDL Mdl, *LastMdl;
+
     CCTRACE(CC_API_DEBUG, "FileObject=%p FileOffset=%I64d Length=%lu\n",
         FileObject, FileOffset->QuadPart, Length);
 
-    UNIMPLEMENTED;
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+    CurrentOffset = FileOffset->QuadPart;
+    BytesMapped = 0;
+    *MdlChain = NULL;
+    LastMdl = MdlChain;
+
+    /* Describe the cached data with one locked MDL per view. Each view
+     * stays referenced, so it is neither unmapped nor reused for another
+     * part of the file, until the caller hands the chain back with
+     * CcMdlReadComplete */
+    while (Length > 0)
+    {
+        VacbOffset = CurrentOffset % VACB_MAPPING_GRANULARITY;
+        PartialLength = min(Length, VACB_MAPPING_GRANULARITY - VacbOffset);
+
+        Status = CcRosRequestVacb(SharedCacheMap,
+                                  CurrentOffset - VacbOffset,
+                                  &BaseAddress,
+                                  &Valid,
+                                  &Vacb);
+        if (!NT_SUCCESS(Status))
+            break;
+        if (!Valid)
+        {
+            Status = CcReadVirtualAddress(Vacb);
+            if (!NT_SUCCESS(Status))
+            {
+                CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE, FALSE);
+                break;
+            }
+        }
+
+        Mdl = IoAllocateMdl((PUCHAR)BaseAddress + VacbOffset, PartialLength, FALSE, FALSE, NULL);
+        if (Mdl)
+        {
+            _SEH2_TRY
+            {
+                MmProbeAndLockPages(Mdl, KernelMode, IoReadAccess);
+            }
+            _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+            {
+                Status = _SEH2_GetExceptionCode();
+            }
+            _SEH2_END;
+        }
+        else
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        if (!NT_SUCCESS(Status))
+        {
+            CcRosReleaseVacb(SharedCacheMap, Vacb, TRUE, FALSE, FALSE);
+            if (Mdl)
+                IoFreeMdl(Mdl);
+            break;
+        }
+
+        /* Released in CcMdlReadComplete2 */
+        Vacb->Valid = TRUE;
+
+        *LastMdl = Mdl;
+        LastMdl = &Mdl->Next;
+
+        Length -= PartialLength;
+        CurrentOffset += PartialLength;
+        BytesMapped += PartialLength;
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        CcMdlReadComplete2(FileObject, *MdlChain);
+        *MdlChain = NULL;
+        ExRaiseStatus(Status);
+    }
+
+    IoStatus->Status = STATUS_SUCCESS;
+    IoStatus->Information = BytesMapped;
 }
 
 /*
@@ -58,14 +182,23 @@ CcMdlReadComplete2 (
     IN PMDL MemoryDescriptorList
 )
 {
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    PROS_VACB Vacb;
     PMDL Mdl;
 
-    /* Free MDLs */
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+
+    /* Free MDLs and drop the references CcMdlRead kept on their views */
     while ((Mdl = MemoryDescriptorList))
     {
         MemoryDescriptorList = Mdl->Next;
+        Vacb = CcpFindMdlVacb(SharedCacheMap, Mdl);
         MmUnlockPages(Mdl);
         IoFreeMdl(Mdl);
+
+        ASSERT(Vacb);
+        if (Vacb)
+            CcRosReleaseVacb(SharedCacheMap, Vacb, TRUE, FALSE, FALSE);
     }
 }
 
@@ -101,10 +234,13 @@ CcMdlReadComplete (
     /* Check if we support Fast Calls, and check this one */
     if (FastDispatch && FastDispatch->MdlReadComplete)
     {
-         /* Use the fast path */
-        FastDispatch->MdlReadComplete(FileObject,
-                                      MdlChain,
-                                      DeviceObject);
+        /* Use the fast path, it releases the chain if it succeeds */
+        if (FastDispatch->MdlReadComplete(FileObject,
+                                          MdlChain,
+                                          DeviceObject))
+        {
+            return;
+        }
     }
 
     /* Use slow path */
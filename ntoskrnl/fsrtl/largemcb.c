@@ -22,97 +22,170 @@
 PAGED_LOOKASIDE_LIST FsRtlFirstMappingLookasideList;
 NPAGED_LOOKASIDE_LIST FsRtlFastMutexLookasideList;
 
-/* We use only real 'mapping' runs; we do not store 'holes' to our GTree. */
+/*
+ * We use only real 'mapping' runs; we do not store 'holes' to our array.
+ *
+ * The runs are kept in a single array sorted by Vbn (Mcb->Mapping), with
+ * Mcb->PairCount used entries out of Mcb->MaximumPairCount allocated ones.
+ * Lookups are done with a binary search and never modify the array, so
+ * callers may look up a base MCB concurrently under a shared lock.
+ * Extending a file sequentially only appends at the end of the array.
+ */
 typedef struct _LARGE_MCB_MAPPING_ENTRY // run
 {
     LARGE_INTEGER RunStartVbn;
     LARGE_INTEGER RunEndVbn;   /* RunStartVbn+SectorCount; that means +1 after the last sector */
     LARGE_INTEGER StartingLbn; /* Lbn of 'RunStartVbn' */
+    ULONG RunIndex;            /* Index of this run as returned to callers, that is including emulated 'hole' runs */
 } LARGE_MCB_MAPPING_ENTRY, *PLARGE_MCB_MAPPING_ENTRY;
 
-typedef struct _LARGE_MCB_MAPPING // mcb_priv
-{
-    RTL_GENERIC_TABLE Table;
-} LARGE_MCB_MAPPING, *PLARGE_MCB_MAPPING;
-
 typedef struct _BASE_MCB_INTERNAL {
     ULONG MaximumPairCount;
     ULONG PairCount;
     USHORT PoolType;
     USHORT Flags;
-    PLARGE_MCB_MAPPING Mapping;
+    PLARGE_MCB_MAPPING_ENTRY Mapping;
 } BASE_MCB_INTERNAL, *PBASE_MCB_INTERNAL;
 
-/*
-static LARGE_MCB_MAPPING_ENTRY StaticRunBelow0 = {
-    {{-1}}, // ignored
-    {{0}},
-    {{-1}}, // ignored
-};
-*/
-
-static PVOID NTAPI McbMappingAllocate(PRTL_GENERIC_TABLE Table, CLONG Bytes)
+static
+VOID
+McbFreeMapping(IN PBASE_MCB_INTERNAL Mcb,
+               IN PLARGE_MCB_MAPPING_ENTRY Mapping,
+               IN ULONG MaximumPairCount)
 {
-    PVOID Result;
-    PBASE_MCB Mcb = (PBASE_MCB)Table->TableContext;
-    Result = ExAllocatePoolWithTag(Mcb->PoolType, Bytes, 'BCML');
-    DPRINT("McbMappingAllocate(%lu) => %p\n", Bytes, Result);
-    return Result;
+    /* The initial array comes from the lookaside list for paged MCBs */
+    if (Mcb->PoolType == PagedPool && MaximumPairCount == MAXIMUM_PAIR_COUNT)
+    {
+        ExFreeToPagedLookasideList(&FsRtlFirstMappingLookasideList, Mapping);
+    }
+    else
+    {
+        ExFreePoolWithTag(Mapping, 'CBSF');
+    }
 }
 
-static VOID NTAPI McbMappingFree(PRTL_GENERIC_TABLE Table, PVOID Buffer)
+static
+BOOLEAN
+McbEnsureCapacity(IN PBASE_MCB_INTERNAL Mcb,
+                  IN ULONG PairCount)
 {
-    DPRINT("McbMappingFree(%p)\n", Buffer);
-    ExFreePoolWithTag(Buffer, 'BCML');
+    PLARGE_MCB_MAPPING_ENTRY NewMapping;
+    ULONG NewMaximumPairCount;
+
+    if (PairCount <= Mcb->MaximumPairCount)
+        return TRUE;
+
+    /* Grow geometrically, so that appending runs stays amortized O(1) */
+    NewMaximumPairCount = Mcb->MaximumPairCount * 2;
+    if (NewMaximumPairCount < PairCount)
+        NewMaximumPairCount = PairCount;
+    if (NewMaximumPairCount > MAXULONG / sizeof(LARGE_MCB_MAPPING_ENTRY))
+        return FALSE;
+
+    NewMapping = ExAllocatePoolWithTag(Mcb->PoolType,
+                                       NewMaximumPairCount * sizeof(LARGE_MCB_MAPPING_ENTRY),
+                                       'CBSF');
+    if (NewMapping == NULL)
+    {
+        DPRINT1("Failed to grow MCB %p to %lu runs\n", Mcb, NewMaximumPairCount);
+        return FALSE;
+    }
+
+    RtlCopyMemory(NewMapping, Mcb->Mapping, Mcb->PairCount * sizeof(LARGE_MCB_MAPPING_ENTRY));
+    McbFreeMapping(Mcb, Mcb->Mapping, Mcb->MaximumPairCount);
+
+    Mcb->Mapping = NewMapping;
+    Mcb->MaximumPairCount = NewMaximumPairCount;
+    return TRUE;
 }
 
+/* Returns the position of the first run ending after Vbn, or PairCount if there is none */
 static
-RTL_GENERIC_COMPARE_RESULTS
-NTAPI
-McbMappingCompare(PRTL_GENERIC_TABLE Table,
-                  PVOID PtrA,
-                  PVOID PtrB)
+ULONG
+McbFindRun(IN PBASE_MCB_INTERNAL Mcb,
+           IN LONGLONG Vbn)
 {
-    PLARGE_MCB_MAPPING_ENTRY A = PtrA, B = PtrB;
-    RTL_GENERIC_COMPARE_RESULTS Res;
-
-    ASSERT(A);
-    ASSERT(B);
-
-    if (A->RunStartVbn.QuadPart == B->RunStartVbn.QuadPart && A->RunEndVbn.QuadPart == B->RunEndVbn.QuadPart)
-        Res = GenericEqual;
-    else if (A->RunEndVbn.QuadPart <= B->RunStartVbn.QuadPart)
-        Res = GenericLessThan;
-    else if (A->RunEndVbn.QuadPart >= B->RunStartVbn.QuadPart)
-        Res = GenericGreaterThan;
-    else
+    ULONG Low = 0, High = Mcb->PairCount, Middle;
+
+    while (Low < High)
     {
-        ASSERT(FALSE);
-        Res = GenericEqual;
+        Middle = Low + (High - Low) / 2;
+        if (Mcb->Mapping[Middle].RunEndVbn.QuadPart <= Vbn)
+            Low = Middle + 1;
+        else
+            High = Middle;
     }
 
-    return Res;
+    return Low;
 }
 
-static RTL_GENERIC_COMPARE_RESULTS NTAPI McbMappingIntersectCompare(PRTL_GENERIC_TABLE Table, PVOID PtrA, PVOID PtrB)
+/* Recomputes the public run indexes from the given position up to the end of the array */
+static
+VOID
+McbRenumberRuns(IN PBASE_MCB_INTERNAL Mcb,
+                IN ULONG Position)
 {
-    PLARGE_MCB_MAPPING_ENTRY A = PtrA, B = PtrB;
-    RTL_GENERIC_COMPARE_RESULTS Res;
-
-    if (A->RunStartVbn.QuadPart <= B->RunStartVbn.QuadPart && A->RunEndVbn.QuadPart > B->RunStartVbn.QuadPart)
-        Res = GenericEqual;
-    else if (A->RunStartVbn.QuadPart >= B->RunStartVbn.QuadPart && B->RunEndVbn.QuadPart > A->RunStartVbn.QuadPart)
-        Res = GenericEqual;
-    else if (A->RunStartVbn.QuadPart < B->RunStartVbn.QuadPart)
-        Res = GenericLessThan;
-    else if (A->RunStartVbn.QuadPart > B->RunStartVbn.QuadPart)
-        Res = GenericGreaterThan;
+    ULONG i, RunIndex;
+    LONGLONG LastVbn;
+
+    if (Position == 0)
+    {
+        RunIndex = 0;
+        LastVbn = 0;
+    }
     else
-        Res = GenericEqual;
+    {
+        RunIndex = Mcb->Mapping[Position - 1].RunIndex + 1;
+        LastVbn = Mcb->Mapping[Position - 1].RunEndVbn.QuadPart;
+    }
+
+    for (i = Position; i < Mcb->PairCount; i++)
+    {
+        /* Take care when we must emulate missing 'hole' runs. */
+        if (Mcb->Mapping[i].RunStartVbn.QuadPart > LastVbn)
+            RunIndex++;
 
-    return Res;
+        Mcb->Mapping[i].RunIndex = RunIndex++;
+        LastVbn = Mcb->Mapping[i].RunEndVbn.QuadPart;
+    }
 }
 
+static
+BOOLEAN
+McbInsertRun(IN PBASE_MCB_INTERNAL Mcb,
+             IN ULONG Position,
+             IN LONGLONG RunStartVbn,
+             IN LONGLONG RunEndVbn,
+             IN LONGLONG StartingLbn)
+{
+    PLARGE_MCB_MAPPING_ENTRY Run;
+
+    if (!McbEnsureCapacity(Mcb, Mcb->PairCount + 1))
+        return FALSE;
+
+    Run = &Mcb->Mapping[Position];
+    RtlMoveMemory(Run + 1, Run, (Mcb->PairCount - Position) * sizeof(LARGE_MCB_MAPPING_ENTRY));
+    ++Mcb->PairCount;
+
+    Run->RunStartVbn.QuadPart = RunStartVbn;
+    Run->RunEndVbn.QuadPart = RunEndVbn;
+    Run->StartingLbn.QuadPart = StartingLbn;
+    return TRUE;
+}
+
+static
+VOID
+McbDeleteRuns(IN PBASE_MCB_INTERNAL Mcb,
+              IN ULONG Position,
+              IN ULONG Count)
+{
+    ASSERT(Position + Count <= Mcb->PairCount);
+
+    RtlMoveMemory(&Mcb->Mapping[Position],
+                  &Mcb->Mapping[Position + Count],
+                  (Mcb->PairCount - Position - Count) * sizeof(LARGE_MCB_MAPPING_ENTRY));
+    Mcb->PairCount -= Count;
+}
 
 /* PUBLIC FUNCTIONS **********************************************************/
 
@@ -140,9 +213,9 @@ FsRtlAddBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     BOOLEAN Result = TRUE;
     BOOLEAN IntResult;
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    LARGE_MCB_MAPPING_ENTRY Node, NeedleRun;
+    LARGE_MCB_MAPPING_ENTRY Node;
     PLARGE_MCB_MAPPING_ENTRY LowerRun, HigherRun;
-    BOOLEAN NewElement;
+    ULONG Position;
     LONGLONG IntLbn;
 
     DPRINT("FsRtlAddBaseMcbEntry(%p, %I64d, %I64d, %I64d)\n", OpaqueMcb, Vbn, Lbn, SectorCount);
@@ -153,28 +226,51 @@ FsRtlAddBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
         goto quit;
     }
 
-    if (SectorCount <= 0)
+    if (SectorCount <= 0 || Vbn + SectorCount <= Vbn)
+    {
+        Result = FALSE;
+        goto quit;
+    }
+
+    /* Make sure neither splitting an existing run nor inserting ours can fail halfway */
+    if (!McbEnsureCapacity(Mcb, Mcb->PairCount + 2))
     {
         Result = FALSE;
         goto quit;
     }
 
-    IntResult = FsRtlLookupBaseMcbEntry(OpaqueMcb, Vbn, &IntLbn, NULL, NULL, NULL, NULL);
-    if (IntResult)
+    /* Fast path: appending past the last run cannot overlap any existing mapping */
+    if (Mcb->PairCount == 0 ||
+        Vbn >= Mcb->Mapping[Mcb->PairCount - 1].RunEndVbn.QuadPart)
+    {
+        Position = Mcb->PairCount;
+    }
+    else
     {
-        if (IntLbn != -1 && IntLbn != Lbn)
+        IntResult = FsRtlLookupBaseMcbEntry(OpaqueMcb, Vbn, &IntLbn, NULL, NULL, NULL, NULL);
+        if (IntResult)
+        {
+            if (IntLbn != -1 && IntLbn != Lbn)
+            {
+                Result = FALSE;
+                goto quit;
+            }
+        }
+
+        /* clean any possible previous entries in our range */
+        if (!FsRtlRemoveBaseMcbEntry(OpaqueMcb, Vbn, SectorCount))
         {
             Result = FALSE;
             goto quit;
         }
-    }
 
-    /* clean any possible previous entries in our range */
-    FsRtlRemoveBaseMcbEntry(OpaqueMcb, Vbn, SectorCount);
+        /* Nothing is left in our range, so we go right before the first run ending after it */
+        Position = McbFindRun(Mcb, Vbn);
+    }
 
     // We need to map [Vbn, Vbn+SectorCount) to [Lbn, Lbn+SectorCount),
     // taking in account the fact that we need to merge these runs if
-    // they are adjacent or overlap, but fail if new run fully fits into another run
+    // they are adjacent and their LBNs are contiguous
 
     /* initially we think we will be inserted as a separate run */
     Node.RunStartVbn.QuadPart = Vbn;
@@ -182,42 +278,61 @@ FsRtlAddBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     Node.StartingLbn.QuadPart = Lbn;
 
     /* optionally merge with lower run */
-    NeedleRun.RunStartVbn.QuadPart = Node.RunStartVbn.QuadPart - 1;
-    NeedleRun.RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart + 1;
-    NeedleRun.StartingLbn.QuadPart = ~0ULL;
-    Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    if ((LowerRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)) &&
-        (LowerRun->StartingLbn.QuadPart + (LowerRun->RunEndVbn.QuadPart - LowerRun->RunStartVbn.QuadPart) == Node.StartingLbn.QuadPart))
+    LowerRun = NULL;
+    if (Position > 0)
     {
-        ASSERT(LowerRun->RunEndVbn.QuadPart == Node.RunStartVbn.QuadPart);
-        Node.RunStartVbn.QuadPart = LowerRun->RunStartVbn.QuadPart;
-        Node.StartingLbn.QuadPart = LowerRun->StartingLbn.QuadPart;
-        Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, LowerRun);
-        --Mcb->PairCount;
-        DPRINT("Intersecting lower run found (%I64d,%I64d) Lbn: %I64d\n", LowerRun->RunStartVbn.QuadPart, LowerRun->RunEndVbn.QuadPart, LowerRun->StartingLbn.QuadPart);
+        LowerRun = &Mcb->Mapping[Position - 1];
+        if (LowerRun->RunEndVbn.QuadPart == Node.RunStartVbn.QuadPart &&
+            LowerRun->StartingLbn.QuadPart + (LowerRun->RunEndVbn.QuadPart - LowerRun->RunStartVbn.QuadPart) == Node.StartingLbn.QuadPart)
+        {
+            DPRINT("Intersecting lower run found (%I64d,%I64d) Lbn: %I64d\n", LowerRun->RunStartVbn.QuadPart, LowerRun->RunEndVbn.QuadPart, LowerRun->StartingLbn.QuadPart);
+            Node.RunStartVbn.QuadPart = LowerRun->RunStartVbn.QuadPart;
+            Node.StartingLbn.QuadPart = LowerRun->StartingLbn.QuadPart;
+        }
+        else
+        {
+            LowerRun = NULL;
+        }
     }
 
     /* optionally merge with higher run */
-    NeedleRun.RunStartVbn.QuadPart = Node.RunEndVbn.QuadPart;
-    NeedleRun.RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart + 1;
-    Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    if ((HigherRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)) &&
-        (Node.StartingLbn.QuadPart <= HigherRun->StartingLbn.QuadPart))
+    HigherRun = NULL;
+    if (Position < Mcb->PairCount)
     {
-        ASSERT(HigherRun->RunStartVbn.QuadPart == Node.RunEndVbn.QuadPart);
-        Node.RunEndVbn.QuadPart = HigherRun->RunEndVbn.QuadPart;
-        Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, HigherRun);
-        --Mcb->PairCount;
-        DPRINT("Intersecting higher run found (%I64d,%I64d) Lbn: %I64d\n", HigherRun->RunStartVbn.QuadPart, HigherRun->RunEndVbn.QuadPart, HigherRun->StartingLbn.QuadPart);
+        HigherRun = &Mcb->Mapping[Position];
+        ASSERT(HigherRun->RunStartVbn.QuadPart >= Node.RunEndVbn.QuadPart);
+        if (HigherRun->RunStartVbn.QuadPart == Node.RunEndVbn.QuadPart &&
+            Node.StartingLbn.QuadPart + (Node.RunEndVbn.QuadPart - Node.RunStartVbn.QuadPart) == HigherRun->StartingLbn.QuadPart)
+        {
+            DPRINT("Intersecting higher run found (%I64d,%I64d) Lbn: %I64d\n", HigherRun->RunStartVbn.QuadPart, HigherRun->RunEndVbn.QuadPart, HigherRun->StartingLbn.QuadPart);
+            Node.RunEndVbn.QuadPart = HigherRun->RunEndVbn.QuadPart;
+        }
+        else
+        {
+            HigherRun = NULL;
+        }
     }
-    Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
 
-    /* finally insert the resulting run */
-    RtlInsertElementGenericTable(&Mcb->Mapping->Table, &Node, sizeof(Node), &NewElement);
-    ++Mcb->PairCount;
-    ASSERT(NewElement);
+    /* finally store the resulting run */
+    if (LowerRun)
+    {
+        LowerRun->RunEndVbn.QuadPart = Node.RunEndVbn.QuadPart;
+        if (HigherRun)
+            McbDeleteRuns(Mcb, Position, 1);
+        Position--;
+    }
+    else if (HigherRun)
+    {
+        HigherRun->RunStartVbn.QuadPart = Node.RunStartVbn.QuadPart;
+        HigherRun->StartingLbn.QuadPart = Node.StartingLbn.QuadPart;
+    }
+    else if (!McbInsertRun(Mcb, Position, Node.RunStartVbn.QuadPart, Node.RunEndVbn.QuadPart, Node.StartingLbn.QuadPart))
+    {
+        Result = FALSE;
+        goto quit;
+    }
+
+    McbRenumberRuns(Mcb, Position);
 
     // NB: Two consecutive runs can only be merged, if actual LBNs also match!
 
@@ -331,46 +446,41 @@ FsRtlGetNextBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
 {
     BOOLEAN Result = FALSE;
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    PLARGE_MCB_MAPPING_ENTRY Run = NULL;
-    ULONG CurrentIndex = 0;
-    ULONGLONG LastVbn = 0;
-    ULONGLONG LastSectorCount = 0;
-
-    // Traverse the tree 
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
-    Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
+    PLARGE_MCB_MAPPING_ENTRY Run;
+    ULONG Low = 0, High = Mcb->PairCount, Middle;
+
+    // Find the first run whose index is not below the requested one
+    while (Low < High)
     {
-        // is the current index a hole?
-        if (Run->RunStartVbn.QuadPart > (LastVbn + LastSectorCount))
-        {
-            // Is this the index we're looking for?
-            if (RunIndex == CurrentIndex)
-            {
-                *Vbn = LastVbn + LastSectorCount;
-                *Lbn = -1;
-                *SectorCount = Run->RunStartVbn.QuadPart - *Vbn;
+        Middle = Low + (High - Low) / 2;
+        if (Mcb->Mapping[Middle].RunIndex < RunIndex)
+            Low = Middle + 1;
+        else
+            High = Middle;
+    }
 
-                Result = TRUE;
-                goto quit;
-            }
+    if (Low < Mcb->PairCount)
+    {
+        Run = &Mcb->Mapping[Low];
 
-            CurrentIndex++;
-        }
+        // is the requested index the hole right before this run?
+        if (Run->RunIndex != RunIndex)
+        {
+            ASSERT(Run->RunIndex == RunIndex + 1);
 
-        if (RunIndex == CurrentIndex)
+            *Vbn = (Low == 0) ? 0 : Mcb->Mapping[Low - 1].RunEndVbn.QuadPart;
+            *Lbn = -1;
+            *SectorCount = Run->RunStartVbn.QuadPart - *Vbn;
+        }
+        else
         {
             *Vbn = Run->RunStartVbn.QuadPart;
             *Lbn = Run->StartingLbn.QuadPart;
             *SectorCount = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
-
-            Result = TRUE;
-            goto quit;
         }
 
-        CurrentIndex++;
-        LastVbn = Run->RunStartVbn.QuadPart;
-        LastSectorCount = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
+        Result = TRUE;
+        goto quit;
     }
 
     // these values are meaningless when returning false (but setting them can be helpful for debugging purposes)
@@ -428,18 +538,13 @@ FsRtlInitializeBaseMcb(IN PBASE_MCB OpaqueMcb,
     else
     {
         Mcb->Mapping = ExAllocatePoolWithTag(PoolType | POOL_RAISE_IF_ALLOCATION_FAILURE,
-                                             sizeof(LARGE_MCB_MAPPING),
+                                             MAXIMUM_PAIR_COUNT * sizeof(LARGE_MCB_MAPPING_ENTRY),
                                              'CBSF');
     }
 
     Mcb->PoolType = PoolType;
     Mcb->PairCount = 0;
     Mcb->MaximumPairCount = MAXIMUM_PAIR_COUNT;
-    RtlInitializeGenericTable(&Mcb->Mapping->Table,
-                              McbMappingCompare,
-                              McbMappingAllocate,
-                              McbMappingFree,
-                              Mcb);
 }
 
 /*
@@ -482,7 +587,7 @@ FsRtlInitializeLargeMcbs(VOID)
                                    NULL,
                                    NULL,
                                    POOL_RAISE_IF_ALLOCATION_FAILURE,
-                                   sizeof(LARGE_MCB_MAPPING),
+                                   MAXIMUM_PAIR_COUNT * sizeof(LARGE_MCB_MAPPING_ENTRY),
                                    IFS_POOL_TAG,
                                    0); /* FIXME: Should be 4 */
 
@@ -510,36 +615,53 @@ FsRtlLookupBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
     OUT PULONG Index OPTIONAL)
 {
     BOOLEAN Result = FALSE;
-    ULONG i;
-    LONGLONG LastVbn = 0, LastLbn = 0, Count = 0;   // the last values we've found during traversal
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
+    PLARGE_MCB_MAPPING_ENTRY Run;
+    ULONG Position, i;
+    LONGLONG LastVbn, LastLbn, Count;   // the mapping (or hole) containing Vbn
 
     DPRINT("FsRtlLookupBaseMcbEntry(%p, %I64d, %p, %p, %p, %p, %p)\n", OpaqueMcb, Vbn, Lbn, SectorCountFromLbn, StartingLbn, SectorCountFromStartingLbn, Index);
 
-    for (i = 0; FsRtlGetNextBaseMcbEntry(OpaqueMcb, i, &LastVbn, &LastLbn, &Count); i++)
+    Position = McbFindRun(Mcb, Vbn);
+    if (Position < Mcb->PairCount)
     {
-        // have we reached the target mapping?
-        if (Vbn < LastVbn + Count)
-        {
-            if (Lbn)
-            {
-                if (LastLbn == -1)
-                    *Lbn = -1;
-                else
-                    *Lbn = LastLbn + (Vbn - LastVbn);
-            }
+        Run = &Mcb->Mapping[Position];
 
-            if (SectorCountFromLbn)
-                *SectorCountFromLbn = LastVbn + Count - Vbn;
-            if (StartingLbn)
-                *StartingLbn = LastLbn;
-            if (SectorCountFromStartingLbn)
-                *SectorCountFromStartingLbn = LastVbn + Count - LastVbn;
-            if (Index)
-                *Index = i;
+        // are we in the hole right before this run?
+        if (Vbn < Run->RunStartVbn.QuadPart)
+        {
+            LastVbn = (Position == 0) ? 0 : Mcb->Mapping[Position - 1].RunEndVbn.QuadPart;
+            LastLbn = -1;
+            Count = Run->RunStartVbn.QuadPart - LastVbn;
+            i = Run->RunIndex - 1;
+        }
+        else
+        {
+            LastVbn = Run->RunStartVbn.QuadPart;
+            LastLbn = Run->StartingLbn.QuadPart;
+            Count = Run->RunEndVbn.QuadPart - Run->RunStartVbn.QuadPart;
+            i = Run->RunIndex;
+        }
 
-            Result = TRUE;
-            goto quit;
+        if (Lbn)
+        {
+            if (LastLbn == -1)
+                *Lbn = -1;
+            else
+                *Lbn = LastLbn + (Vbn - LastVbn);
         }
+
+        if (SectorCountFromLbn)
+            *SectorCountFromLbn = LastVbn + Count - Vbn;
+        if (StartingLbn)
+            *StartingLbn = LastLbn;
+        if (SectorCountFromStartingLbn)
+            *SectorCountFromStartingLbn = LastVbn + Count - LastVbn;
+        if (Index)
+            *Index = i;
+
+        Result = TRUE;
+        goto quit;
     }
 
     if (Lbn)
@@ -598,47 +720,27 @@ FsRtlLookupLastLargeMcbEntryAndIndex_internal(IN PBASE_MCB_INTERNAL Mcb,
                                               OUT PLONGLONG Lbn,
                                               OUT PULONG Index OPTIONAL)
 {
-    ULONG RunIndex = 0;
-    PLARGE_MCB_MAPPING_ENTRY Run, RunFound = NULL;
-    LONGLONG LastVbn = 0;
-
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
-        Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
-    {
-        /* Take care when we must emulate missing 'hole' runs. */
-        if (Run->RunStartVbn.QuadPart > LastVbn)
-        {
-            RunIndex++;
-        }
-        LastVbn = Run->RunEndVbn.QuadPart;
-        RunIndex++;
-        RunFound = Run;
-    }
+    PLARGE_MCB_MAPPING_ENTRY RunFound;
 
-    if (!RunFound)
+    /* Last run is always a 'real' run */
+    if (Mcb->PairCount == 0)
     {
         return FALSE;
     }
 
+    RunFound = &Mcb->Mapping[Mcb->PairCount - 1];
+
     if (Vbn)
     {
         *Vbn = RunFound->RunEndVbn.QuadPart - 1;
     }
     if (Lbn)
     {
-        if (1)
-        {
-            *Lbn = RunFound->StartingLbn.QuadPart + (RunFound->RunEndVbn.QuadPart - RunFound->RunStartVbn.QuadPart) - 1;
-        }
-        else
-        {
-            *Lbn = ~0ULL;
-        }
+        *Lbn = RunFound->StartingLbn.QuadPart + (RunFound->RunEndVbn.QuadPart - RunFound->RunStartVbn.QuadPart) - 1;
     }
     if (Index)
     {
-        *Index = RunIndex - 1;
+        *Index = RunFound->RunIndex;
     }
 
     return TRUE;
@@ -694,7 +796,7 @@ FsRtlLookupLastLargeMcbEntryAndIndex(IN PLARGE_MCB OpaqueMcb,
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 BOOLEAN
 NTAPI
@@ -745,16 +847,15 @@ ULONG
 NTAPI
 FsRtlNumberOfRunsInBaseMcb(IN PBASE_MCB OpaqueMcb)
 {
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
     ULONG NumberOfRuns = 0;
-    LONGLONG Vbn, Lbn, Count;
-    int i;
 
     DPRINT("FsRtlNumberOfRunsInBaseMcb(%p)\n", OpaqueMcb);
 
-    // Count how many Mcb entries there are
-    for (i = 0; FsRtlGetNextBaseMcbEntry(OpaqueMcb, i, &Vbn, &Lbn, &Count); i++)
+    // The last run index accounts for all the emulated 'hole' runs before it
+    if (Mcb->PairCount != 0)
     {
-        NumberOfRuns++;
+        NumberOfRuns = Mcb->Mapping[Mcb->PairCount - 1].RunIndex + 1;
     }
 
     DPRINT("FsRtlNumberOfRunsInBaseMcb(%p) = %d\n", OpaqueMcb, NumberOfRuns);
@@ -801,8 +902,9 @@ FsRtlRemoveBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
                         IN LONGLONG SectorCount)
 {
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    LARGE_MCB_MAPPING_ENTRY NeedleRun;
     PLARGE_MCB_MAPPING_ENTRY HaystackRun;
+    ULONG First, Last;
+    LONGLONG EndVbn;
     BOOLEAN Result = TRUE;
 
     DPRINT("FsRtlRemoveBaseMcbEntry(%p, %I64d, %I64d)\n", OpaqueMcb, Vbn, SectorCount);
@@ -819,35 +921,57 @@ FsRtlRemoveBaseMcbEntry(IN PBASE_MCB OpaqueMcb,
         goto quit;
     }
 
-    NeedleRun.RunStartVbn.QuadPart = Vbn;
-    NeedleRun.RunEndVbn.QuadPart = Vbn + SectorCount;
-    NeedleRun.StartingLbn.QuadPart = ~0ULL;
+    EndVbn = Vbn + SectorCount;
 
     /* adjust/destroy all intersecting ranges */
-    Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
-    while ((HaystackRun = RtlLookupElementGenericTable(&Mcb->Mapping->Table, &NeedleRun)))
+    First = McbFindRun(Mcb, Vbn);
+    if (First == Mcb->PairCount || Mcb->Mapping[First].RunStartVbn.QuadPart >= EndVbn)
     {
-        if (HaystackRun->RunStartVbn.QuadPart < NeedleRun.RunStartVbn.QuadPart)
-        {
-            ASSERT(HaystackRun->RunEndVbn.QuadPart > NeedleRun.RunStartVbn.QuadPart);
-            HaystackRun->RunEndVbn.QuadPart = NeedleRun.RunStartVbn.QuadPart;
-        }
-        else if (HaystackRun->RunEndVbn.QuadPart > NeedleRun.RunEndVbn.QuadPart)
-        {
-            ASSERT(HaystackRun->RunStartVbn.QuadPart < NeedleRun.RunEndVbn.QuadPart);
-            HaystackRun->RunStartVbn.QuadPart = NeedleRun.RunEndVbn.QuadPart;
-        }
-        else
+        /* nothing is mapped in our range */
+        goto quit;
+    }
+
+    HaystackRun = &Mcb->Mapping[First];
+    if (HaystackRun->RunStartVbn.QuadPart < Vbn)
+    {
+        ASSERT(HaystackRun->RunEndVbn.QuadPart > Vbn);
+
+        /* we punch a hole in the middle of the run: keep its upper part as a new run */
+        if (HaystackRun->RunEndVbn.QuadPart > EndVbn)
         {
-            //ASSERT(NeedleRun.RunStartVbn.QuadPart >= HaystackRun->RunStartVbn.QuadPart);
-            //ASSERT(NeedleRun.RunEndVbn.QuadPart <= HaystackRun->RunEndVbn.QuadPart);
-            Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
-            RtlDeleteElementGenericTable(&Mcb->Mapping->Table, HaystackRun);
-            --Mcb->PairCount;
-            Mcb->Mapping->Table.CompareRoutine = McbMappingIntersectCompare;
+            if (!McbInsertRun(Mcb, First + 1, EndVbn, HaystackRun->RunEndVbn.QuadPart,
+                              HaystackRun->StartingLbn.QuadPart + (EndVbn - HaystackRun->RunStartVbn.QuadPart)))
+            {
+                Result = FALSE;
+                goto quit;
+            }
+
+            /* the array may have been reallocated */
+            HaystackRun = &Mcb->Mapping[First];
         }
+
+        HaystackRun->RunEndVbn.QuadPart = Vbn;
+        First++;
+    }
+
+    /* delete all the runs fully covered by our range */
+    for (Last = First; Last < Mcb->PairCount; Last++)
+    {
+        if (Mcb->Mapping[Last].RunEndVbn.QuadPart > EndVbn)
+            break;
+    }
+    McbDeleteRuns(Mcb, First, Last - First);
+
+    /* and cut the beginning of the run crossing the end of our range */
+    if (First < Mcb->PairCount && Mcb->Mapping[First].RunStartVbn.QuadPart < EndVbn)
+    {
+        HaystackRun = &Mcb->Mapping[First];
+        ASSERT(HaystackRun->RunEndVbn.QuadPart > EndVbn);
+        HaystackRun->StartingLbn.QuadPart += EndVbn - HaystackRun->RunStartVbn.QuadPart;
+        HaystackRun->RunStartVbn.QuadPart = EndVbn;
     }
-    Mcb->Mapping->Table.CompareRoutine = McbMappingCompare;
+
+    McbRenumberRuns(Mcb, (First > 0) ? First - 1 : 0);
 
 quit:
     DPRINT("FsRtlRemoveBaseMcbEntry(%p, %I64d, %I64d) = %d\n", OpaqueMcb, Vbn, SectorCount, Result);
@@ -878,18 +1002,11 @@ NTAPI
 FsRtlResetBaseMcb(IN PBASE_MCB OpaqueMcb)
 {
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    PLARGE_MCB_MAPPING_ENTRY Element;
 
     DPRINT("FsRtlResetBaseMcb(%p)\n", OpaqueMcb);
 
-    while (RtlNumberGenericTableElements(&Mcb->Mapping->Table) &&
-           (Element = (PLARGE_MCB_MAPPING_ENTRY)RtlGetElementGenericTable(&Mcb->Mapping->Table, 0)))
-    {
-        RtlDeleteElementGenericTable(&Mcb->Mapping->Table, Element);
-    }
-
+    /* Keep the array we already have, it will likely be filled again */
     Mcb->PairCount = 0;
-    Mcb->MaximumPairCount = 0;
 }
 
 /*
@@ -912,7 +1029,7 @@ FsRtlResetLargeMcb(IN PLARGE_MCB Mcb,
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 BOOLEAN
 NTAPI
@@ -921,50 +1038,42 @@ FsRtlSplitBaseMcb(IN PBASE_MCB OpaqueMcb,
                   IN LONGLONG Amount)
 {
     PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
-    PLARGE_MCB_MAPPING_ENTRY Run, InsertLowerRun = NULL, ExistingRun = NULL;
-    BOOLEAN NewElement;
+    PLARGE_MCB_MAPPING_ENTRY Run;
+    ULONG Position, i;
 
     DPRINT("FsRtlSplitBaseMcb(%p, %I64d, %I64d)\n", OpaqueMcb, Vbn, Amount);
 
-    /* Traverse the tree */
-    for (Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, TRUE);
-        Run;
-        Run = (PLARGE_MCB_MAPPING_ENTRY)RtlEnumerateGenericTable(&Mcb->Mapping->Table, FALSE))
+    /* Effectively skip all 'lower' runs */
+    Position = McbFindRun(Mcb, Vbn);
+
+    /* crossing run to be split?
+     * 'lower_run' is kept on the original place; just shortened.
+     * the upper part is inserted right after it and shifted up below
+     */
+    if (Position < Mcb->PairCount && Mcb->Mapping[Position].RunStartVbn.QuadPart < Vbn)
     {
-        /* unaffected run? */
-        /* FIXME: performance: effective skip of all 'lower' runs without traversing them */
-        if (Vbn >= Run->RunEndVbn.QuadPart) { DPRINT("Skipping it\n"); continue; }
-
-        /* crossing run to be split?
-        * 'lower_run' is created on the original place; just shortened.
-        * current 'run' is shifted up later
-        */
-        if (Vbn < Run->RunEndVbn.QuadPart)
+        Run = &Mcb->Mapping[Position];
+        if (!McbInsertRun(Mcb, Position + 1, Vbn, Run->RunEndVbn.QuadPart,
+                          Run->StartingLbn.QuadPart + (Vbn - Run->RunStartVbn.QuadPart)))
         {
-            /* FIXME: shift 'run->Lbn_start' ? */
-            Run->RunStartVbn.QuadPart = Vbn;
-
-            InsertLowerRun = NULL;
+            DPRINT("FsRtlSplitBaseMcb(%p, %I64d, %I64d) = %d\n", OpaqueMcb, Vbn, Amount, FALSE);
+            return FALSE;
         }
 
-        /* Shift the current 'run'.
-        * Ordering is not changed in Generic Tree so I hope I do not need to reinsert it.
-        */
-        Run->RunStartVbn.QuadPart += Amount;
-        ASSERT(Run->RunEndVbn.QuadPart + Amount > Run->RunEndVbn.QuadPart); /* overflow? */
-        Run->RunEndVbn.QuadPart += Amount;
-        /* FIXME: shift 'run->Lbn_start' ? */
-
-        /* continue the traversal */
+        Mcb->Mapping[Position].RunEndVbn.QuadPart = Vbn;
+        Position++;
     }
 
-    if (InsertLowerRun)
+    /* Shift all the runs from there; their ordering does not change */
+    for (i = Position; i < Mcb->PairCount; i++)
     {
-        ExistingRun = RtlInsertElementGenericTable(&Mcb->Mapping->Table, InsertLowerRun, sizeof(*InsertLowerRun), &NewElement);
-        ++Mcb->PairCount;
+        Run = &Mcb->Mapping[i];
+        Run->RunStartVbn.QuadPart += Amount;
+        ASSERT(Run->RunEndVbn.QuadPart + Amount > Run->RunEndVbn.QuadPart); /* overflow? */
+        Run->RunEndVbn.QuadPart += Amount;
     }
 
-    ASSERT(ExistingRun == NULL);
+    McbRenumberRuns(Mcb, (Position > 0) ? Position - 1 : 0);
 
     DPRINT("FsRtlSplitBaseMcb(%p, %I64d, %I64d) = %d\n", OpaqueMcb, Vbn, Amount, TRUE);
 
@@ -996,16 +1105,30 @@ FsRtlSplitLargeMcb(IN PLARGE_MCB Mcb,
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 VOID
 NTAPI
 FsRtlTruncateBaseMcb(IN PBASE_MCB OpaqueMcb,
                      IN LONGLONG Vbn)
 {
+    PBASE_MCB_INTERNAL Mcb = (PBASE_MCB_INTERNAL)OpaqueMcb;
+    ULONG Position;
+
     DPRINT("FsRtlTruncateBaseMcb(%p, %I64d)\n", OpaqueMcb, Vbn);
 
-    FsRtlRemoveBaseMcbEntry(OpaqueMcb, Vbn, MAXLONG - Vbn + 1);
+    if (Vbn < 0)
+        return;
+
+    /* Shorten the run crossing Vbn and drop everything above it */
+    Position = McbFindRun(Mcb, Vbn);
+    if (Position < Mcb->PairCount && Mcb->Mapping[Position].RunStartVbn.QuadPart < Vbn)
+    {
+        Mcb->Mapping[Position].RunEndVbn.QuadPart = Vbn;
+        Position++;
+    }
+
+    Mcb->PairCount = Position;
 }
 
 /*
@@ -1030,19 +1153,15 @@ VOID
 NTAPI
 FsRtlUninitializeBaseMcb(IN PBASE_MCB Mcb)
 {
+    PBASE_MCB_INTERNAL InternalMcb = (PBASE_MCB_INTERNAL)Mcb;
+
     DPRINT("FsRtlUninitializeBaseMcb(%p)\n", Mcb);
 
     FsRtlResetBaseMcb(Mcb);
 
-    if ((Mcb->PoolType == PagedPool)/* && (Mcb->MaximumPairCount == MAXIMUM_PAIR_COUNT)*/)
-    {
-        ExFreeToPagedLookasideList(&FsRtlFirstMappingLookasideList,
-                                   Mcb->Mapping);
-    }
-    else
-    {
-        ExFreePoolWithTag(Mcb->Mapping, 'CBSF');
-    }
+    McbFreeMapping(InternalMcb, InternalMcb->Mapping, InternalMcb->MaximumPairCount);
+    InternalMcb->Mapping = NULL;
+    InternalMcb->MaximumPairCount = 0;
 }
 
 /*
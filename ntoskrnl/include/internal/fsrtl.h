@@ -45,7 +45,7 @@
 #define FSRTL_MAX_RESOURCES 16
 
 //
-// Number of maximum pair count per MCB
+// Initial number of pairs allocated per MCB
 //
 #define MAXIMUM_PAIR_COUNT  15
 
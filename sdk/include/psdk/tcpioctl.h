@@ -102,6 +102,10 @@
 
 /* TCP connection options */
 #define TCP_SOCKET_NODELAY 1
+#define TCP_SOCKET_WINDOW  6
+#ifdef __REACTOS__
+#define TCP_SOCKET_SNDBUF  0x100
+#endif
 
 typedef struct IFEntry
 {
@@ -137,6 +137,22 @@ typedef struct _AFD_DISCONNECT_INFO {
     LARGE_INTEGER			Timeout;
 } AFD_DISCONNECT_INFO, *PAFD_DISCONNECT_INFO;
 
+typedef struct _AFD_TRANSMIT_ELEMENT {
+    ULONG				Flags;
+    ULONG				Length;
+    PVOID				Buffer;
+    HANDLE				FileHandle;
+    LARGE_INTEGER			FileOffset;
+} AFD_TRANSMIT_ELEMENT, *PAFD_TRANSMIT_ELEMENT;
+
+typedef struct _AFD_TRANSMIT_FILE_INFO {
+    PAFD_TRANSMIT_ELEMENT		ElementArray;
+    ULONG				ElementCount;
+    ULONG				SendSize;
+    ULONG				Flags;
+    ULONG				AfdFlags;
+} AFD_TRANSMIT_FILE_INFO, *PAFD_TRANSMIT_FILE_INFO;
+
 typedef struct _AFD_VALIDATE_GROUP_DATA
 {
     LONG GroupId;
@@ -219,6 +235,14 @@ typedef struct _AFD_TDI_HANDLE_DATA
 #define AFD_OVERLAPPED			0x2L
 #define AFD_IMMEDIATE                   0x4L
 
+/* AFD Transmit Element Flags */
+#define AFD_TRANSMIT_ELEMENT_MEMORY	0x01L
+#define AFD_TRANSMIT_ELEMENT_FILE	0x02L
+
+/* AFD Transmit Flags */
+#define AFD_TF_DISCONNECT		0x01L
+#define AFD_TF_REUSE_SOCKET		0x02L
+
 /* IOCTL Generation */
 #define FSCTL_AFD_BASE                  FILE_DEVICE_NETWORK
 #define _AFD_CONTROL_CODE(Operation,Method) \
@@ -261,6 +285,7 @@ typedef struct _AFD_TDI_HANDLE_DATA
 #define AFD_DEFER_ACCEPT		35
 #define AFD_GET_PENDING_CONNECT_DATA	41
 #define AFD_VALIDATE_GROUP		42
+#define AFD_TRANSMIT_FILE		43
 
 /* AFD IOCTLs */
 
@@ -336,6 +361,8 @@ typedef struct _AFD_TDI_HANDLE_DATA
   _AFD_CONTROL_CODE(AFD_ENUM_NETWORK_EVENTS, METHOD_NEITHER)
 #define IOCTL_AFD_VALIDATE_GROUP \
   _AFD_CONTROL_CODE(AFD_VALIDATE_GROUP, METHOD_NEITHER)
+#define IOCTL_AFD_TRANSMIT_FILE \
+  _AFD_CONTROL_CODE(AFD_TRANSMIT_FILE, METHOD_NEITHER)
 
 typedef struct _AFD_SOCKET_INFORMATION {
     BOOL CommandChannel;
@@ -111,6 +111,8 @@ typedef enum _CONSRV_API_NUMBER
     // ConsolepSetScreenBufferInfo,            // Added in Vista+
     // ConsolepClientConnect,                  // Added in Win7
 
+    ConsolepMapOutputBuffer,                // ReactOS-specific
+
     ConsolepMaxApiNumber
 } CONSRV_API_NUMBER, *PCONSRV_API_NUMBER;
 
@@ -250,6 +252,20 @@ typedef struct _CONSOLE_WRITECONSOLE
     CHAR Reserved2[6];
 } CONSOLE_WRITECONSOLE, *PCONSOLE_WRITECONSOLE;
 
+/*
+ * Output buffer shared between a client process and the console server
+ * (ReactOS-specific). WriteConsole copies the writes that do not fit in
+ * the static buffer there, instead of allocating capture buffers.
+ */
+#define CONSOLE_OUTPUT_BUFFER_SIZE  (256 * 1024)
+
+typedef struct _CONSOLE_MAPOUTPUTBUFFER
+{
+    HANDLE ConsoleHandle;
+    PVOID  Buffer;  // Client view of the shared buffer
+    ULONG  Size;
+} CONSOLE_MAPOUTPUTBUFFER, *PCONSOLE_MAPOUTPUTBUFFER;
+
 typedef struct _CONSOLE_READCONSOLE
 {
     HANDLE ConsoleHandle;
@@ -966,6 +982,7 @@ typedef struct _CONSOLE_API_MESSAGE
 
         /* Write */
         CONSOLE_WRITECONSOLE WriteConsoleRequest;       // SrvWriteConsole / WriteConsole
+        CONSOLE_MAPOUTPUTBUFFER MapOutputBufferRequest; // SrvMapConsoleOutputBuffer / WriteConsole
         CONSOLE_WRITEINPUT WriteInputRequest;
         CONSOLE_WRITEOUTPUT WriteOutputRequest;
         CONSOLE_WRITEOUTPUTCODE WriteOutputCodeRequest;
@@ -1696,6 +1696,18 @@ FsRtlAllocatePoolWithTag (
     _In_ ULONG        Tag
 );
 
+NTKERNELAPI
+BOOLEAN
+NTAPI
+FsRtlMdlRead (
+    _In_ PFILE_OBJECT       FileObject,
+    _In_ PLARGE_INTEGER     FileOffset,
+    _In_ ULONG              Length,
+    _In_ ULONG              LockKey,
+    _Outptr_ PMDL           *MdlChain,
+    _Out_ PIO_STATUS_BLOCK  IoStatus
+);
+
 NTKERNELAPI
 BOOLEAN
 NTAPI
@@ -24,6 +24,28 @@ ULONG ChecksumFold(
   return Sum;
 }
 
+/*
+ * The sum is accumulated a native word at a time. Carries out of the top
+ * of the word are counted and added back in at the end, which yields the
+ * same folded result as adding 16-bit words since 2^16 = 1 (mod 0xFFFF).
+ */
+#define CHECKSUM_ADD(Sum, Carry, Value) \
+  { (Sum) += (Value); (Carry) += ((Sum) < (Value)); }
+
+static __inline ULONG ChecksumFoldWord(
+  ULONG_PTR Sum,
+  ULONG_PTR Carry)
+{
+  ULONGLONG Total = Sum;
+
+  /* Reduce to 32 bits, wrapping carries around like ChecksumFold does */
+  Total = (Total & 0xFFFFFFFF) + (Total >> 32) + Carry;
+  Total = (Total & 0xFFFFFFFF) + (Total >> 32);
+  Total = (Total & 0xFFFFFFFF) + (Total >> 32);
+
+  return (ULONG)Total;
+}
+
 ULONG ChecksumCompute(
   PVOID Data,
   UINT Count,
@@ -38,21 +60,191 @@ ULONG ChecksumCompute(
  *     Checksum of buffer
  */
 {
-  register ULONG Sum = Seed;
+  ULONG_PTR UNALIGNED *Words = Data;
+  PUCHAR Bytes;
+  ULONG_PTR Sum = Seed;
+  ULONG_PTR Carry = 0;
+
+  while (Count >= 4 * sizeof(ULONG_PTR))
+    {
+      CHECKSUM_ADD(Sum, Carry, Words[0]);
+      CHECKSUM_ADD(Sum, Carry, Words[1]);
+      CHECKSUM_ADD(Sum, Carry, Words[2]);
+      CHECKSUM_ADD(Sum, Carry, Words[3]);
+      Words += 4;
+      Count -= 4 * sizeof(ULONG_PTR);
+    }
+
+  while (Count >= sizeof(ULONG_PTR))
+    {
+      CHECKSUM_ADD(Sum, Carry, *Words);
+      Words++;
+      Count -= sizeof(ULONG_PTR);
+    }
+
+  Bytes = (PUCHAR)Words;
+
+#ifdef _WIN64
+  if (Count >= sizeof(ULONG))
+    {
+      CHECKSUM_ADD(Sum, Carry, *(ULONG UNALIGNED *)Bytes);
+      Bytes += sizeof(ULONG);
+      Count -= sizeof(ULONG);
+    }
+#endif
 
-  while (Count > 1)
+  if (Count >= sizeof(USHORT))
     {
-      Sum += *(PUSHORT)Data;
-      Count -= 2;
-      Data = (PVOID)((ULONG_PTR) Data + 2);
+      CHECKSUM_ADD(Sum, Carry, *(USHORT UNALIGNED *)Bytes);
+      Bytes += sizeof(USHORT);
+      Count -= sizeof(USHORT);
     }
 
   /* Add left-over byte, if any */
   if (Count > 0)
     {
-      Sum += *(PUCHAR)Data;
+      CHECKSUM_ADD(Sum, Carry, *Bytes);
+    }
+
+  return ChecksumFoldWord(Sum, Carry);
+}
+
+ULONG ChecksumCopy(
+  PVOID Destination,
+  PVOID Source,
+  UINT Count,
+  ULONG Seed)
+/*
+ * FUNCTION: Copy a buffer and calculate its checksum in the same pass
+ * ARGUMENTS:
+ *     Destination = Pointer to destination buffer
+ *     Source      = Pointer to source buffer
+ *     Count       = Number of bytes to copy
+ *     Seed        = Previously calculated checksum (if any)
+ * RETURNS:
+ *     Checksum of buffer, as ChecksumCompute would return it
+ * NOTES:
+ *     The buffers must not overlap
+ */
+{
+  ULONG_PTR UNALIGNED *Dst = Destination;
+  ULONG_PTR UNALIGNED *Src = Source;
+  PUCHAR DstBytes, SrcBytes;
+  ULONG_PTR Sum = Seed;
+  ULONG_PTR Carry = 0;
+  ULONG_PTR Value;
+
+  while (Count >= 4 * sizeof(ULONG_PTR))
+    {
+      Value = Src[0]; Dst[0] = Value; CHECKSUM_ADD(Sum, Carry, Value);
+      Value = Src[1]; Dst[1] = Value; CHECKSUM_ADD(Sum, Carry, Value);
+      Value = Src[2]; Dst[2] = Value; CHECKSUM_ADD(Sum, Carry, Value);
+      Value = Src[3]; Dst[3] = Value; CHECKSUM_ADD(Sum, Carry, Value);
+      Src += 4;
+      Dst += 4;
+      Count -= 4 * sizeof(ULONG_PTR);
+    }
+
+  while (Count >= sizeof(ULONG_PTR))
+    {
+      Value = *Src++;
+      *Dst++ = Value;
+      CHECKSUM_ADD(Sum, Carry, Value);
+      Count -= sizeof(ULONG_PTR);
+    }
+
+  DstBytes = (PUCHAR)Dst;
+  SrcBytes = (PUCHAR)Src;
+
+#ifdef _WIN64
+  if (Count >= sizeof(ULONG))
+    {
+      Value = *(ULONG UNALIGNED *)SrcBytes;
+      *(ULONG UNALIGNED *)DstBytes = (ULONG)Value;
+      CHECKSUM_ADD(Sum, Carry, Value);
+      SrcBytes += sizeof(ULONG);
+      DstBytes += sizeof(ULONG);
+      Count -= sizeof(ULONG);
+    }
+#endif
+
+  if (Count >= sizeof(USHORT))
+    {
+      Value = *(USHORT UNALIGNED *)SrcBytes;
+      *(USHORT UNALIGNED *)DstBytes = (USHORT)Value;
+      CHECKSUM_ADD(Sum, Carry, Value);
+      SrcBytes += sizeof(USHORT);
+      DstBytes += sizeof(USHORT);
+      Count -= sizeof(USHORT);
+    }
+
+  /* Copy and add left-over byte, if any */
+  if (Count > 0)
+    {
+      Value = *SrcBytes;
+      *DstBytes = (UCHAR)Value;
+      CHECKSUM_ADD(Sum, Carry, Value);
     }
 
+  return ChecksumFoldWord(Sum, Carry);
+}
+
+ULONG ChecksumCombine(
+  ULONG Sum,
+  ULONG Partial,
+  UINT Offset)
+/*
+ * FUNCTION: Add the checksum of a block to a running checksum
+ * ARGUMENTS:
+ *     Sum     = Running checksum
+ *     Partial = Checksum of the block, computed from its own start
+ *     Offset  = Offset of the block from the start of the running checksum
+ * RETURNS:
+ *     Unfolded checksum of both
+ * NOTES:
+ *     A block starting at an odd offset has its bytes in the opposite
+ *     halves of each 16-bit word, so its folded sum is byte swapped
+ */
+{
+  if (Offset & 1)
+    {
+      Partial = ChecksumFold(Partial);
+      Partial = ((Partial & 0xFF) << 8) | (Partial >> 8);
+    }
+
+  Sum += Partial;
+
+  /* Wrap the carry around */
+  if (Sum < Partial)
+      Sum++;
+
+  return Sum;
+}
+
+ULONG
+IPv4PseudoHeaderChecksum(
+  PIPv4_HEADER IPHeader,
+  UCHAR Protocol,
+  USHORT Length)
+/*
+ * FUNCTION: Calculate checksum of a TCP/UDP pseudo header
+ * ARGUMENTS:
+ *     IPHeader = Pointer to IPv4 header with the addresses
+ *     Protocol = Transport protocol number
+ *     Length   = Length of transport header and data
+ * RETURNS:
+ *     Unfolded checksum in memory order, usable as seed for ChecksumCompute
+ */
+{
+  ULONG Sum;
+
+  Sum = ChecksumCompute(&IPHeader->SrcAddr, sizeof(IPv4_RAW_ADDRESS), 0);
+  Sum = ChecksumCompute(&IPHeader->DstAddr, sizeof(IPv4_RAW_ADDRESS), Sum);
+
+  /* Zero byte, protocol and length are in network order */
+  Sum += WH2N((USHORT)Protocol);
+  Sum += WH2N(Length);
+
   return Sum;
 }
 
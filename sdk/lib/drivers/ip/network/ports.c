@@ -13,6 +13,9 @@
 NTSTATUS PortsStartup( PPORT_SET PortSet,
 		   UINT StartingPort,
 		   UINT PortsToManage ) {
+    LARGE_INTEGER Counter;
+    ULONG Seed, i;
+
     PortSet->StartingPort = StartingPort;
     PortSet->PortsToOversee = PortsToManage;
 
@@ -25,6 +28,12 @@ NTSTATUS PortsStartup( PPORT_SET PortSet,
 			 PortSet->PortsToOversee );
     RtlClearAllBits( &PortSet->ProtoBitmap );
     KeInitializeSpinLock( &PortSet->Lock );
+
+    Counter = KeQueryPerformanceCounter( NULL );
+    Seed = Counter.LowPart ^ Counter.HighPart;
+    for( i = 0; i < PORT_SET_HINTS; i++ )
+        PortSet->NextPort[i] = RtlRandomEx( &Seed );
+
     return STATUS_SUCCESS;
 }
 
@@ -83,8 +92,19 @@ ULONG AllocateAnyPort( PPORT_SET PortSet ) {
     return -1;
 }
 
+/* Finds the first clear bit in [From, To], or returns -1 */
+static ULONG FindClearPort( PPORT_SET PortSet, ULONG From, ULONG To ) {
+    ULONG Index;
+
+    if( RtlFindNextForwardRunClear( &PortSet->ProtoBitmap, From, &Index ) &&
+        Index <= To )
+        return Index;
+    return -1;
+}
+
 ULONG AllocatePortFromRange( PPORT_SET PortSet, ULONG Lowest, ULONG Highest ) {
-    ULONG AllocatedPort;
+    ULONG AllocatedPort, Start;
+    PULONG NextPort;
     KIRQL OldIrql;
 
     if ((Lowest < PortSet->StartingPort) ||
@@ -97,9 +117,17 @@ ULONG AllocatePortFromRange( PPORT_SET PortSet, ULONG Lowest, ULONG Highest ) {
     Highest -= PortSet->StartingPort;
 
     KeAcquireSpinLock( &PortSet->Lock, &OldIrql );
-    AllocatedPort = RtlFindClearBits( &PortSet->ProtoBitmap, 1, Lowest );
-    if( AllocatedPort != (ULONG)-1 && AllocatedPort <= Highest) {
+
+    /* Start where this processor left off and wrap around once */
+    NextPort = &PortSet->NextPort[KeGetCurrentProcessorNumber() % PORT_SET_HINTS];
+    Start = Lowest + *NextPort % (Highest - Lowest + 1);
+    AllocatedPort = FindClearPort( PortSet, Start, Highest );
+    if( AllocatedPort == (ULONG)-1 && Start > Lowest )
+        AllocatedPort = FindClearPort( PortSet, Lowest, Start - 1 );
+
+    if( AllocatedPort != (ULONG)-1 ) {
 	RtlSetBit( &PortSet->ProtoBitmap, AllocatedPort );
+	*NextPort = AllocatedPort + 1 - Lowest;
 	AllocatedPort += PortSet->StartingPort;
 	KeReleaseSpinLock( &PortSet->Lock, OldIrql );
 	return htons(AllocatedPort);
@@ -201,6 +201,9 @@ ReassembleDatagram(
   PLIST_ENTRY CurrentEntry;
   PIP_FRAGMENT Fragment;
   PCHAR Data;
+  BOOLEAN Checksum;
+  ULONG Sum, FragmentSum;
+  UINT DataCopied;
 
   PAGED_CODE();
 
@@ -229,20 +232,41 @@ ReassembleDatagram(
   Data = (PVOID)((ULONG_PTR)IPPacket->Header + IPDR->HeaderSize);
   IPPacket->Data = Data;
 
+  /* Unless the adapter verified the transport checksum, sum the data while
+     copying it so the transport doesn't need another pass over it */
+  Checksum = !(IPPacket->Flags & (IP_PACKET_FLAG_RX_TCP_OK | IP_PACKET_FLAG_RX_UDP_OK));
+  Sum = 0;
+  DataCopied = 0;
+
   /* Copy data from all fragments into buffer */
   CurrentEntry = IPDR->FragmentListHead.Flink;
   while (CurrentEntry != &IPDR->FragmentListHead) {
     Fragment = CONTAINING_RECORD(CurrentEntry, IP_FRAGMENT, ListEntry);
 
     /* Copy fragment data into datagram buffer */
-    CopyPacketToBuffer(Data + Fragment->Offset,
-                       Fragment->Packet,
-                       Fragment->PacketOffset,
-                       Fragment->Size);
+    if (Checksum) {
+      DataCopied += CopyPacketToBufferChecksum(Data + Fragment->Offset,
+                                               Fragment->Packet,
+                                               Fragment->PacketOffset,
+                                               Fragment->Size,
+                                               &FragmentSum);
+      Sum = ChecksumCombine(Sum, FragmentSum, Fragment->Offset);
+    } else {
+      CopyPacketToBuffer(Data + Fragment->Offset,
+                         Fragment->Packet,
+                         Fragment->PacketOffset,
+                         Fragment->Size);
+    }
 
     CurrentEntry = CurrentEntry->Flink;
   }
 
+  /* Overlapping fragments would have been summed more than once */
+  if (Checksum && DataCopied == IPDR->DataSize) {
+    IPPacket->DataChecksum = Sum;
+    IPPacket->Flags |= IP_PACKET_FLAG_DATA_CHECKSUM;
+  }
+
   return TRUE;
 }
 
@@ -461,6 +485,10 @@ VOID ProcessFragment(
     /* FIXME: Assumes IPv4 */
     IPInitializePacket(&Datagram, IP_ADDRESS_V4);
 
+    /* The adapter's transport checksum verdict only holds for unfragmented datagrams */
+    if (FragFirst == 0 && !MoreFragments)
+      Datagram.Flags = IPPacket->Flags & (IP_PACKET_FLAG_RX_TCP_OK | IP_PACKET_FLAG_RX_UDP_OK);
+
     Success = ReassembleDatagram(&Datagram, IPDR);
 
     FreeIPDR(IPDR);
@@ -611,8 +639,9 @@ VOID IPv4Receive(PIP_INTERFACE IF, PIP_PACKET IPPacket)
         return;
     }
 
-    /* Checksum IPv4 header */
-    if (!IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
+    /* Checksum IPv4 header, unless the adapter already did */
+    if (!(IPPacket->Flags & IP_PACKET_FLAG_RX_IP_OK) &&
+        !IPv4CorrectChecksum(IPPacket->Header, IPPacket->HeaderSize)) {
         TI_DbgPrint(MIN_TRACE, ("Datagram received with bad checksum. Checksum field (0x%X)\n",
 	      WN2H(((PIPv4_HEADER)IPPacket->Header)->Checksum)));
         /* Discard packet */
@@ -11,6 +11,7 @@
 #include "precomp.h"
 
 BOOLEAN PrepareNextFragment(PIPFRAGMENT_CONTEXT IFC);
+VOID SetChecksumOffload(PIPFRAGMENT_CONTEXT IFC, PIP_PACKET IPPacket);
 NTSTATUS IPSendFragment(PNDIS_PACKET NdisPacket,
 			PNEIGHBOR_CACHE_ENTRY NCE,
 			PIPFRAGMENT_CONTEXT IFC);
@@ -112,9 +113,10 @@ BOOLEAN PrepareNextFragment(
 
         /* FIXME: Handle options */
 
-        /* Calculate checksum of IP header */
+        /* Calculate checksum of IP header, unless the adapter does it */
         Header->Checksum = 0;
-        Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
+        if (!IFC->OffloadIpChecksum)
+            Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
 	TI_DbgPrint(MID_TRACE,("IP Check: %x\n", Header->Checksum));
 
         /* Update pointers */
@@ -129,6 +131,44 @@ BOOLEAN PrepareNextFragment(
     }
 }
 
+VOID SetChecksumOffload(
+    PIPFRAGMENT_CONTEXT IFC,
+    PIP_PACKET IPPacket)
+/*
+ * FUNCTION: Tells the adapter which checksums of the fragments it has to fill in
+ * ARGUMENTS:
+ *     IFC      = Pointer to IP fragment context
+ *     IPPacket = Pointer to the IP packet being sent
+ */
+{
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+    PIP_INTERFACE Interface = IFC->NCE->Interface;
+
+    ChecksumInfo.Value = 0;
+
+    IFC->OffloadIpChecksum = (Interface->OffloadFlags & IP_OFFLOAD_TX_IP_CHECKSUM) != 0;
+    if (IFC->OffloadIpChecksum)
+    {
+        ChecksumInfo.Transmit.NdisPacketChecksumV4 = 1;
+        ChecksumInfo.Transmit.NdisPacketIpChecksum = 1;
+    }
+
+    /* The transport only leaves its checksum to the adapter if the datagram isn't fragmented */
+    if (IPPacket->Flags & IP_PACKET_FLAG_TX_CHECKSUM)
+    {
+        ASSERT(IPPacket->TotalSize <= IFC->PathMTU);
+
+        ChecksumInfo.Transmit.NdisPacketChecksumV4 = 1;
+        if (((PIPv4_HEADER)IPPacket->Header)->Protocol == IPPROTO_TCP)
+            ChecksumInfo.Transmit.NdisPacketTcpChecksum = 1;
+        else
+            ChecksumInfo.Transmit.NdisPacketUdpChecksum = 1;
+    }
+
+    NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket, TcpIpChecksumPacketInfo) =
+        UlongToPtr(ChecksumInfo.Value);
+}
+
 NTSTATUS SendFragments(
     PIP_PACKET IPPacket,
     PNEIGHBOR_CACHE_ENTRY NCE,
@@ -190,6 +230,8 @@ NTSTATUS SendFragments(
     IFC->Data         = (PVOID)((ULONG_PTR)IFC->Header + IPPacket->HeaderSize);
     KeInitializeEvent(&IFC->Event, NotificationEvent, FALSE);
 
+    SetChecksumOffload(IFC, IPPacket);
+
     TI_DbgPrint(MID_TRACE,("Copying header from %x to %x (%d)\n",
 			   IPPacket->Header, IFC->Header,
 			   IPPacket->HeaderSize));
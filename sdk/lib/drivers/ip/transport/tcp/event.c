@@ -295,68 +295,58 @@ TCPSendEventHandler(void *arg, const u16_t space)
 {
     PCONNECTION_ENDPOINT Connection = (PCONNECTION_ENDPOINT)arg;
     PTDI_BUCKET Bucket;
-    PLIST_ENTRY Entry;
-    PIRP Irp;
     NTSTATUS Status;
-    PMDL Mdl;
     ULONG BytesSent;
 
     ReferenceObject(Connection);
     LockObject(Connection);
 
+    /* Sends queued from now on need another trip to this thread */
+    Connection->SendPumpPending = FALSE;
+
+    /* Hand lwIP as much of the queued data as it takes. lwIP copies it, so a request
+     * completes as soon as all of its data was taken. The lock is held throughout
+     * so that nobody completes a request while lwIP copies from its buffer. */
     while (!IsListEmpty(&Connection->SendRequest))
     {
-        UINT SendLen = 0;
-        PVOID SendBuffer = 0;
-
-        Entry = RemoveHeadList(&Connection->SendRequest);
-
-        UnlockObject(Connection);
-
-        Bucket = CONTAINING_RECORD( Entry, TDI_BUCKET, Entry );
-
-        Irp = Bucket->Request.RequestContext;
-        Mdl = Irp->MdlAddress;
+        Bucket = CONTAINING_RECORD(Connection->SendRequest.Flink, TDI_BUCKET, Entry);
 
         TI_DbgPrint(DEBUG_TCP,
-                    ("Getting the user buffer from %x\n", Mdl));
-
-        NdisQueryBuffer( Mdl, &SendBuffer, &SendLen );
-
-        TI_DbgPrint(DEBUG_TCP,
-                    ("Writing %d bytes to %x\n", SendLen, SendBuffer));
-
-        TI_DbgPrint(DEBUG_TCP, ("Connection: %x\n", Connection));
-        TI_DbgPrint
-        (DEBUG_TCP,
-         ("Connection->SocketContext: %x\n",
-          Connection->SocketContext));
+                    ("Writing %d bytes to %x\n",
+                     Bucket->SendLength - Bucket->SendQueued,
+                     Bucket->SendData + Bucket->SendQueued));
 
         Status = TCPTranslateError(LibTCPSend(Connection,
-                                              SendBuffer,
-                                              SendLen, &BytesSent, TRUE));
+                                              Bucket->SendData + Bucket->SendQueued,
+                                              Bucket->SendLength - Bucket->SendQueued,
+                                              Bucket->Entry.Flink != &Connection->SendRequest,
+                                              &BytesSent));
 
         TI_DbgPrint(DEBUG_TCP,("TCP Bytes: %d\n", BytesSent));
 
-        if( Status == STATUS_PENDING )
+        if (Status == STATUS_PENDING)
         {
-            LockObject(Connection);
-            InsertHeadList(&Connection->SendRequest, &Bucket->Entry);
+            /* Out of send buffer, the next acknowledgement brings us back */
             break;
         }
-        else
+
+        if (NT_SUCCESS(Status))
         {
-            TI_DbgPrint(DEBUG_TCP,
-                        ("Completing Send request: %x %x\n",
-                         Bucket->Request, Status));
+            Bucket->SendQueued += BytesSent;
+            if (Bucket->SendQueued < Bucket->SendLength)
+                continue;
+        }
 
-            Bucket->Status = Status;
-            Bucket->Information = (Bucket->Status == STATUS_SUCCESS) ? BytesSent : 0;
+        RemoveEntryList(&Bucket->Entry);
 
-            CompleteBucket(Connection, Bucket, FALSE);
-        }
+        TI_DbgPrint(DEBUG_TCP,
+                    ("Completing Send request: %x %x\n",
+                     Bucket->Request, Status));
 
-        LockObject(Connection);
+        Bucket->Status = Status;
+        Bucket->Information = (Bucket->Status == STATUS_SUCCESS) ? Bucket->SendQueued : 0;
+
+        CompleteBucket(Connection, Bucket, FALSE);
     }
 
     //  If we completed all outstanding send requests then finish all pending shutdown requests,
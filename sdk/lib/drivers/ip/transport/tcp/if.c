@@ -15,8 +15,12 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     IP_PACKET Packet;
     IP_ADDRESS RemoteAddress, LocalAddress;
     PIPv4_HEADER Header;
+    PUSHORT Checksum;
+    ULONG HeaderLength;
     ULONG Length;
     ULONG TotalLength;
+    ULONG Sum;
+    BOOLEAN Offload;
 
     /* The caller frees the pbuf struct */
 
@@ -53,18 +57,52 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
 
     ASSERT(Packet.TotalSize == p->tot_len);
 
+    /* lwIP leaves the TCP checksum to us so that it can be offloaded */
     TotalLength = p->tot_len;
+    Offload = (NCE->Interface->OffloadFlags & IP_OFFLOAD_TX_TCP_CHECKSUM) &&
+              TotalLength <= NCE->Interface->MTU;
+
     Length = 0;
+    Sum = 0;
     while (Length < TotalLength)
     {
         ASSERT(p->len <= TotalLength - Length);
         ASSERT(p->tot_len == TotalLength - Length);
-        RtlCopyMemory((PCHAR)Packet.Header + Length, p->payload, p->len);
+        if (Offload)
+        {
+            RtlCopyMemory((PCHAR)Packet.Header + Length, p->payload, p->len);
+        }
+        else
+        {
+            /* Sum the whole datagram while copying it, the IP header is taken out below */
+            Sum = ChecksumCombine(Sum,
+                                  ChecksumCopy((PCHAR)Packet.Header + Length, p->payload, p->len, 0),
+                                  Length);
+        }
         Length += p->len;
         p = p->next;
     }
     ASSERT(Length == TotalLength);
 
+    Header = Packet.Header;
+    HeaderLength = (Header->VerIHL & 0x0F) << 2;
+    Length = TotalLength - HeaderLength;
+    Checksum = (PUSHORT)((PUCHAR)Header + HeaderLength + 16);
+
+    if (Offload)
+    {
+        *Checksum = (USHORT)ChecksumFold(IPv4PseudoHeaderChecksum(Header, IPPROTO_TCP, (USHORT)Length));
+        Packet.Flags |= IP_PACKET_FLAG_TX_CHECKSUM;
+    }
+    else
+    {
+        /* Subtract the IP header and whatever lwIP left in the checksum field */
+        Sum = ChecksumFold(Sum) +
+              (USHORT)~ChecksumFold(ChecksumCompute(Header, HeaderLength, *Checksum));
+        Sum = ChecksumCombine(Sum, IPv4PseudoHeaderChecksum(Header, IPPROTO_TCP, (USHORT)Length), 0);
+        *Checksum = (USHORT)~ChecksumFold(Sum);
+    }
+
     Packet.HeaderSize = sizeof(IPv4_HEADER);
     Packet.TotalSize = TotalLength;
     Packet.SrcAddr = LocalAddress;
@@ -202,6 +202,25 @@ VOID TCPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
  *     This is the low level interface for receiving TCP data
  */
 {
+    ULONG Sum;
+    USHORT Length;
+
+    /* lwIP does not check TCP checksums, unless the adapter did we must */
+    if (!(IPPacket->Flags & IP_PACKET_FLAG_RX_TCP_OK))
+    {
+        Length = (USHORT)(IPPacket->TotalSize - IPPacket->HeaderSize);
+        Sum = IPv4PseudoHeaderChecksum(IPPacket->Header, IPPROTO_TCP, Length);
+        if (IPPacket->Flags & IP_PACKET_FLAG_DATA_CHECKSUM)
+            Sum = ChecksumCombine(Sum, IPPacket->DataChecksum, 0);
+        else
+            Sum = ChecksumCompute((PUCHAR)IPPacket->Header + IPPacket->HeaderSize, Length, Sum);
+        if (ChecksumFold(Sum) != 0xFFFF)
+        {
+            TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
+            return;
+        }
+    }
+
     TI_DbgPrint(DEBUG_TCP,("Sending packet %d (%d) to lwIP\n",
                            IPPacket->TotalSize,
                            IPPacket->HeaderSize));
@@ -576,10 +595,8 @@ NTSTATUS TCPSendData
   PTCP_COMPLETION_ROUTINE Complete,
   PVOID Context )
 {
-    NTSTATUS Status;
     PTDI_BUCKET Bucket;
-
-    ReferenceObject(Connection);
+    BOOLEAN QueueSend;
 
     TI_DbgPrint(DEBUG_TCP,("[IP, TCPSendData] Called for %d bytes (on socket %x)\n",
                            SendLength, Connection->SocketContext));
@@ -588,40 +605,43 @@ NTSTATUS TCPSendData
     TI_DbgPrint(DEBUG_TCP,("[IP, TCPSendData] Connection->SocketContext = %x\n",
                            Connection->SocketContext));
 
-    Status = TCPTranslateError(LibTCPSend(Connection,
-                                          BufferData,
-                                          SendLength,
-                                          BytesSent,
-                                          FALSE));
+    *BytesSent = 0;
 
-    TI_DbgPrint(DEBUG_TCP,("[IP, TCPSendData] Send: %x, %d\n", Status, SendLength));
+    if (!Connection->SocketContext || Connection->SendShutdown)
+        return TCPTranslateError(ERR_CLSD);
 
-    /* Keep this request around ... there was no data yet */
-    if (Status == STATUS_PENDING)
+    if (SendLength == 0)
+        return STATUS_SUCCESS;
+
+    /* The request stays queued until lwIP took all of its data. Freed in TCPSendEventHandler */
+    Bucket = ExAllocateFromNPagedLookasideList(&TdiBucketLookasideList);
+    if (!Bucket)
     {
-        /* Freed in TCPSocketState */
-        Bucket = ExAllocateFromNPagedLookasideList(&TdiBucketLookasideList);
-        if (!Bucket)
-        {
-            DereferenceObject(Connection);
-            TI_DbgPrint(DEBUG_TCP,("[IP, TCPSendData] Failed to allocate bucket\n"));
-            return STATUS_NO_MEMORY;
-        }
+        TI_DbgPrint(DEBUG_TCP,("[IP, TCPSendData] Failed to allocate bucket\n"));
+        return STATUS_NO_MEMORY;
+    }
 
-        Bucket->Request.RequestNotifyObject = Complete;
-        Bucket->Request.RequestContext = Context;
+    Bucket->Request.RequestNotifyObject = Complete;
+    Bucket->Request.RequestContext = Context;
+    Bucket->SendData = BufferData;
+    Bucket->SendLength = SendLength;
+    Bucket->SendQueued = 0;
 
-        LockObject(Connection);
-        InsertTailList( &Connection->SendRequest, &Bucket->Entry );
-        TI_DbgPrint(DEBUG_TCP,("[IP, TCPSendData] Queued write irp\n"));
-        UnlockObject(Connection);
-    }
+    LockObject(Connection);
+    InsertTailList(&Connection->SendRequest, &Bucket->Entry);
+    TI_DbgPrint(DEBUG_TCP,("[IP, TCPSendData] Queued write irp\n"));
 
+    /* Sends queued while the lwIP thread is busy go out with the same wakeup */
+    QueueSend = !Connection->SendPumpPending;
+    Connection->SendPumpPending = TRUE;
+    UnlockObject(Connection);
 
-    TI_DbgPrint(DEBUG_TCP, ("[IP, TCPSendData] Leaving. Status = %x\n", Status));
-    DereferenceObject(Connection);
+    if (QueueSend)
+        LibTCPQueueSend(Connection);
 
-    return Status;
+    TI_DbgPrint(DEBUG_TCP, ("[IP, TCPSendData] Leaving. Status = STATUS_PENDING\n"));
+
+    return STATUS_PENDING;
 }
 
 UINT TCPAllocatePort(const UINT HintPort)
@@ -637,7 +657,7 @@ UINT TCPAllocatePort(const UINT HintPort)
         }
     }
     else
-        return AllocatePortFromRange( &TCPPorts, 1024, 5000 );
+        return AllocatePortFromRange( &TCPPorts, TCP_STARTING_PORT, TCP_ENDING_PORT );
 }
 
 VOID TCPFreePort(const UINT Port)
@@ -708,6 +728,11 @@ BOOLEAN TCPRemoveIRP( PCONNECTION_ENDPOINT Endpoint, PIRP Irp )
             Bucket = CONTAINING_RECORD( Entry, TDI_BUCKET, Entry );
             if( Bucket->Request.RequestContext == Irp )
             {
+                /* Part of this send is already in lwIP and goes out anyway,
+                 * so it can't be cancelled. It completes once the rest was taken. */
+                if (i == 0 && Bucket->SendQueued != 0)
+                    break;
+
                 RemoveEntryList( &Bucket->Entry );
                 ExFreeToNPagedLookasideList(&TdiBucketLookasideList, Bucket);
                 Found = TRUE;
@@ -736,6 +761,21 @@ TCPSetNoDelay(
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+TCPSetBufferSize(
+    PCONNECTION_ENDPOINT Connection,
+    ULONG Size,
+    BOOLEAN Receive)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    if (Connection->SocketContext == NULL)
+        return STATUS_UNSUCCESSFUL;
+
+    return TCPTranslateError(LibTCPSetBufferSize(Connection, Size, Receive));
+}
+
 NTSTATUS
 TCPGetSocketStatus(
     PCONNECTION_ENDPOINT Connection,
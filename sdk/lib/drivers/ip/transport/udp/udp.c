@@ -21,7 +21,8 @@ NTSTATUS AddUDPHeaderIPv4(
     USHORT LocalPort,
     PIP_PACKET IPPacket,
     PVOID Data,
-    UINT DataLength)
+    UINT DataLength,
+    PIP_INTERFACE Interface)
 /*
  * FUNCTION: Adds an IPv4 and UDP header to an IP packet
  * ARGUMENTS:
@@ -29,12 +30,14 @@ NTSTATUS AddUDPHeaderIPv4(
  *     LocalAddress = Pointer to our local address
  *     LocalPort    = The port we send this datagram from
  *     IPPacket     = Pointer to IP packet
+ *     Interface    = Pointer to the interface the packet is sent on
  * RETURNS:
  *     Status of operation
  */
 {
     PUDP_HEADER UDPHeader;
     NTSTATUS Status;
+    ULONG Sum;
 
     TI_DbgPrint(MID_TRACE, ("Packet: %x NdisPacket %x\n",
 			    IPPacket, IPPacket->NdisPacket));
@@ -59,12 +62,34 @@ NTSTATUS AddUDPHeaderIPv4(
 			    IPPacket->Header, IPPacket->Data,
 			    (PCHAR)IPPacket->Data - (PCHAR)IPPacket->Header));
 
-    RtlCopyMemory(IPPacket->Data, Data, DataLength);
-
-    UDPHeader->Checksum = UDPv4ChecksumCalculate((PIPv4_HEADER)IPPacket->Header,
-                                                 (PUCHAR)UDPHeader,
-                                                 DataLength + sizeof(UDP_HEADER));
-    UDPHeader->Checksum = WH2N(UDPHeader->Checksum);
+    if ((Interface->OffloadFlags & IP_OFFLOAD_TX_UDP_CHECKSUM) &&
+        IPPacket->TotalSize <= Interface->MTU)
+    {
+        RtlCopyMemory(IPPacket->Data, Data, DataLength);
+
+        /* The adapter completes the checksum, it only needs the pseudo header sum */
+        UDPHeader->Checksum = (USHORT)ChecksumFold(
+            IPv4PseudoHeaderChecksum((PIPv4_HEADER)IPPacket->Header,
+                                     IPPROTO_UDP,
+                                     (USHORT)(DataLength + sizeof(UDP_HEADER))));
+        IPPacket->Flags |= IP_PACKET_FLAG_TX_CHECKSUM;
+    }
+    else
+    {
+        /* Sum the payload while copying it, then add the header and pseudo header */
+        Sum = ChecksumCopy(IPPacket->Data, Data, DataLength, 0);
+        Sum = ChecksumCompute(UDPHeader, sizeof(UDP_HEADER), Sum);
+        Sum = ChecksumCombine(Sum,
+                              IPv4PseudoHeaderChecksum((PIPv4_HEADER)IPPacket->Header,
+                                                       IPPROTO_UDP,
+                                                       (USHORT)(DataLength + sizeof(UDP_HEADER))),
+                              0);
+        UDPHeader->Checksum = (USHORT)~ChecksumFold(Sum);
+
+        /* A zero checksum means none was computed, send all ones instead */
+        if (UDPHeader->Checksum == 0)
+            UDPHeader->Checksum = 0xFFFF;
+    }
 
     TI_DbgPrint(MID_TRACE, ("Packet: %d ip %d udp %d payload\n",
 			    (PCHAR)UDPHeader - (PCHAR)IPPacket->Header,
@@ -83,7 +108,8 @@ NTSTATUS BuildUDPPacket(
     PIP_ADDRESS LocalAddress,
     USHORT LocalPort,
     PCHAR DataBuffer,
-    UINT DataLen )
+    UINT DataLen,
+    PIP_INTERFACE Interface )
 /*
  * FUNCTION: Builds an UDP packet
  * ARGUMENTS:
@@ -91,6 +117,7 @@ NTSTATUS BuildUDPPacket(
  *     LocalAddress = Pointer to our local address
  *     LocalPort    = The port we send this datagram from
  *     IPPacket     = Address of pointer to IP packet
+ *     Interface    = Pointer to the interface the packet is sent on
  * RETURNS:
  *     Status of operation
  */
@@ -122,7 +149,8 @@ NTSTATUS BuildUDPPacket(
     switch (RemoteAddress->Type) {
         case IP_ADDRESS_V4:
             Status = AddUDPHeaderIPv4(AddrFile, RemoteAddress, RemotePort,
-                                      LocalAddress, LocalPort, Packet, DataBuffer, DataLen);
+                                      LocalAddress, LocalPort, Packet, DataBuffer, DataLen,
+                                      Interface);
             break;
         case IP_ADDRESS_V6:
             /* FIXME: Support IPv6 */
@@ -220,7 +248,8 @@ NTSTATUS UDPSendDatagram(
 							 &LocalAddress,
 							 AddrFile->Port,
 							 BufferData,
-							 DataSize );
+							 DataSize,
+							 NCE->Interface );
 
     UnlockObject(AddrFile);
 
@@ -254,6 +283,7 @@ VOID UDPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
   PUDP_HEADER UDPHeader;
   PIP_ADDRESS DstAddress, SrcAddress;
   UINT DataSize, i;
+  ULONG Sum;
 
   TI_DbgPrint(MAX_TRACE, ("Called.\n"));
 
@@ -278,14 +308,29 @@ VOID UDPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
 
   UDPHeader = (PUDP_HEADER)IPPacket->Data;
 
-  /* Calculate and validate UDP checksum */
-  i = UDPv4ChecksumCalculate(IPv4Header,
-                             (PUCHAR)UDPHeader,
-                             WH2N(UDPHeader->Length));
-  if (i != DH2N(0x0000FFFF) && UDPHeader->Checksum != 0)
+  /* Calculate and validate UDP checksum, unless the adapter already did */
+  if ((IPPacket->Flags & IP_PACKET_FLAG_DATA_CHECKSUM) &&
+      WN2H(UDPHeader->Length) == IPPacket->TotalSize - IPPacket->HeaderSize)
+  {
+      /* The data was summed while the datagram was reassembled */
+      Sum = IPv4PseudoHeaderChecksum(IPv4Header, IPPROTO_UDP, WN2H(UDPHeader->Length));
+      Sum = ChecksumCombine(Sum, IPPacket->DataChecksum, 0);
+      if (ChecksumFold(Sum) != 0xFFFF && UDPHeader->Checksum != 0)
+      {
+          TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
+          return;
+      }
+  }
+  else if (!(IPPacket->Flags & IP_PACKET_FLAG_RX_UDP_OK))
   {
-      TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
-      return;
+      i = UDPv4ChecksumCalculate(IPv4Header,
+                                 (PUCHAR)UDPHeader,
+                                 WH2N(UDPHeader->Length));
+      if (i != DH2N(0x0000FFFF) && UDPHeader->Checksum != 0)
+      {
+          TI_DbgPrint(MIN_TRACE, ("Bad checksum on packet received.\n"));
+          return;
+      }
   }
 
   /* Sanity checks */
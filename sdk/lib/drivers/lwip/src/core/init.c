@@ -109,8 +109,23 @@
   #error "MEMP_NUM_REASSDATA > IP_REASS_MAX_PBUFS doesn't make sense since each struct ip_reassdata must hold 2 pbufs at least!"
 #endif
 #endif /* !MEMP_MEM_MALLOC */
-#if (LWIP_TCP && (TCP_WND > 0xffff))
-  #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
+#if (LWIP_TCP && !LWIP_WND_SCALE && (TCP_WND > 0xffff))
+  #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h (or enable window scaling)"
+#endif
+#if (LWIP_TCP && LWIP_WND_SCALE && ((TCP_RCV_SCALE < 0) || (TCP_RCV_SCALE > 14)))
+  #error "TCP_RCV_SCALE must be in the range of [0..14]"
+#endif
+#if (LWIP_TCP && (TCP_RCV_BUF_MAX < TCP_WND))
+  #error "TCP_RCV_BUF_MAX must be at least TCP_WND"
+#endif
+#if (LWIP_TCP && (TCP_RCV_BUF_MAX > (0xFFFFUL << TCP_RCV_SCALE)))
+  #error "TCP_RCV_BUF_MAX must fit in the scaled window field, increase TCP_RCV_SCALE in your lwipopts.h"
+#endif
+#if (LWIP_TCP && (TCP_SND_BUF_MAX < TCP_SND_BUF))
+  #error "TCP_SND_BUF_MAX must be at least TCP_SND_BUF"
+#endif
+#if (LWIP_TCP && !LWIP_WND_SCALE && (TCP_SND_BUF_MAX > 0xffff))
+  #error "TCP_SND_BUF_MAX must fit in an u16_t without window scaling"
 #endif
 #if (LWIP_TCP && (TCP_SND_QUEUELEN > 0xffff))
   #error "If you want to use TCP, TCP_SND_QUEUELEN must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
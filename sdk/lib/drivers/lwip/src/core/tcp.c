@@ -51,6 +51,7 @@
 #include "lwip/tcp.h"
 #include "lwip/tcp_impl.h"
 #include "lwip/debug.h"
+#include "lwip/sys.h"
 #include "lwip/stats.h"
 
 #include <string.h>
@@ -116,12 +117,21 @@ struct tcp_pcb ** const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcb
 /** Only used for temporary storage. */
 struct tcp_pcb *tcp_tmp_pcb;
 
+/** Active and TIME-WAIT PCBs hashed by their 4-tuple, chained through
+ * hash_next. This is what tcp_input uses to demultiplex segments. */
+static struct tcp_pcb *tcp_conn_hash[TCP_CONN_HASH_SIZE];
+
+#define TCP_CONN_HASH(lip, lport, rip, rport) \
+  ((((ip4_addr_get_u32(lip) ^ ip4_addr_get_u32(rip) ^ \
+      (((u32_t)(lport) << 16) | (rport))) * 0x9E3779B1UL) >> 16) & (TCP_CONN_HASH_SIZE - 1))
+
 u8_t tcp_active_pcbs_changed;
 
 /** Timer counter to handle calling slow-timer from tcp_tmr() */ 
 static u8_t tcp_timer;
 static u8_t tcp_timer_ctr;
 static u16_t tcp_new_port(void);
+static void tcp_rcv_buf_autotune(struct tcp_pcb *pcb, u16_t len);
 
 /**
  * Initialize this module.
@@ -172,7 +182,7 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
   err_t err;
 
   if (rst_on_unacked_data && ((pcb->state == ESTABLISHED) || (pcb->state == CLOSE_WAIT))) {
-    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != TCP_WND)) {
+    if ((pcb->refused_data != NULL) || (pcb->rcv_wnd != TCP_WND_MAX(pcb))) {
       /* Not all data received by application, send RST to tell the remote
          side about this. */
       LWIP_ASSERT("pcb->flags & TF_RXCLOSED", pcb->flags & TF_RXCLOSED);
@@ -187,7 +197,7 @@ tcp_close_shutdown(struct tcp_pcb *pcb, u8_t rst_on_unacked_data)
       if (pcb->state == ESTABLISHED) {
         /* move to TIME_WAIT since we close actively */
         pcb->state = TIME_WAIT;
-        TCP_REG(&tcp_tw_pcbs, pcb);
+        TCP_REG_TW(pcb);
       } else {
         /* CLOSE_WAIT: deallocate the pcb since we already sent a RST for it */
         memp_free(MEMP_TCP_PCB, pcb);
@@ -580,7 +590,7 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
 {
   u32_t new_right_edge = pcb->rcv_nxt + pcb->rcv_wnd;
 
-  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND / 2), pcb->mss))) {
+  if (TCP_SEQ_GEQ(new_right_edge, pcb->rcv_ann_right_edge + LWIP_MIN((TCP_WND_MAX(pcb) / 2), pcb->mss))) {
     /* we can advertise more window */
     pcb->rcv_ann_wnd = pcb->rcv_wnd;
     return new_right_edge - pcb->rcv_ann_right_edge;
@@ -592,8 +602,10 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
     } else {
       /* keep the right edge of window constant */
       u32_t new_rcv_ann_wnd = pcb->rcv_ann_right_edge - pcb->rcv_nxt;
+#if !LWIP_WND_SCALE
       LWIP_ASSERT("new_rcv_ann_wnd <= 0xffff", new_rcv_ann_wnd <= 0xffff);
-      pcb->rcv_ann_wnd = (u16_t)new_rcv_ann_wnd;
+#endif /* !LWIP_WND_SCALE */
+      pcb->rcv_ann_wnd = (tcpwnd_size_t)new_rcv_ann_wnd;
     }
     return 0;
   }
@@ -610,19 +622,23 @@ u32_t tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb)
 void
 tcp_recved(struct tcp_pcb *pcb, u16_t len)
 {
-  int wnd_inflation;
+  u32_t wnd_inflation;
+  tcpwnd_size_t rcv_wnd;
 
   /* pcb->state LISTEN not allowed here */
   LWIP_ASSERT("don't call tcp_recved for listen-pcbs",
     pcb->state != LISTEN);
-  LWIP_ASSERT("tcp_recved: len would wrap rcv_wnd\n",
-              len <= 0xffff - pcb->rcv_wnd );
 
-  pcb->rcv_wnd += len;
-  if (pcb->rcv_wnd > TCP_WND) {
-    pcb->rcv_wnd = TCP_WND;
+  rcv_wnd = (tcpwnd_size_t)(pcb->rcv_wnd + len);
+  if ((rcv_wnd > TCP_WND_MAX(pcb)) || (rcv_wnd < pcb->rcv_wnd)) {
+    /* window got too big or tcpwnd_size_t overflow */
+    pcb->rcv_wnd = TCP_WND_MAX(pcb);
+  } else {
+    pcb->rcv_wnd = rcv_wnd;
   }
 
+  tcp_rcv_buf_autotune(pcb, len);
+
   wnd_inflation = tcp_update_rcv_ann_wnd(pcb);
 
   /* If the change in the right edge of window is significant (default
@@ -634,8 +650,173 @@ tcp_recved(struct tcp_pcb *pcb, u16_t len)
     tcp_output(pcb);
   }
 
-  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"U16_F" (%"U16_F").\n",
-         len, pcb->rcv_wnd, TCP_WND - pcb->rcv_wnd));
+  LWIP_DEBUGF(TCP_DEBUG, ("tcp_recved: recveived %"U16_F" bytes, wnd %"TCPWNDSIZE_F" (%"TCPWNDSIZE_F").\n",
+         len, pcb->rcv_wnd, (tcpwnd_size_t)(TCP_WND_MAX(pcb) - pcb->rcv_wnd)));
+}
+
+/**
+ * Recompute the receive window limit after the receive buffer size or the
+ * window scaling state of a pcb changed, and open or close the available
+ * receive window by the difference.
+ *
+ * @param pcb the tcp_pcb to update
+ */
+void
+tcp_update_rcv_wnd_max(struct tcp_pcb *pcb)
+{
+  tcpwnd_size_t wnd_max = pcb->rcv_buf;
+
+#if LWIP_WND_SCALE
+  if (!(pcb->flags & TF_WND_SCALE)) {
+    /* The peer can't see more than an unscaled window */
+    wnd_max = TCPWND16(wnd_max);
+  }
+#endif /* LWIP_WND_SCALE */
+
+  if (wnd_max >= pcb->rcv_wnd_max) {
+    pcb->rcv_wnd += wnd_max - pcb->rcv_wnd_max;
+  } else if (pcb->rcv_wnd > pcb->rcv_wnd_max - wnd_max) {
+    pcb->rcv_wnd -= pcb->rcv_wnd_max - wnd_max;
+  } else {
+    /* The application holds more than the new limit, tcp_recved() will
+       reopen the window once it has caught up */
+    pcb->rcv_wnd = 0;
+  }
+  pcb->rcv_wnd_max = wnd_max;
+}
+
+/**
+ * Take a receiver side RTT sample for receive buffer auto-tuning. The sample
+ * is the time it took the sender to fill the window that was open when the
+ * previous sample ended. This approximates the RTT as long as the sender is
+ * limited by our window, which is exactly when auto-tuning matters.
+ * Called by tcp_receive() whenever rcv_nxt advances.
+ *
+ * @param pcb the tcp_pcb that received in-sequence data
+ */
+void
+tcp_rcv_rtt_measure(struct tcp_pcb *pcb)
+{
+  u32_t now, sample;
+
+  if (pcb->rcv_buf >= pcb->rcv_buf_max) {
+    /* auto-tuning is done or disabled */
+    return;
+  }
+  if ((pcb->rcv_rtt_time != 0) && TCP_SEQ_LT(pcb->rcv_nxt, pcb->rcv_rtt_seq)) {
+    return;
+  }
+
+  now = sys_now();
+  if (pcb->rcv_rtt_time != 0) {
+    sample = LWIP_MAX(now - pcb->rcv_rtt_time, 1);
+    if ((pcb->rcv_rtt == 0) || (sample < pcb->rcv_rtt)) {
+      pcb->rcv_rtt = sample;
+    } else {
+      /* Grow slowly, a sample only gets too large when the sender was
+         not window limited */
+      pcb->rcv_rtt += (sample - pcb->rcv_rtt) >> 3;
+    }
+  }
+  pcb->rcv_rtt_seq = pcb->rcv_nxt + pcb->rcv_wnd;
+  pcb->rcv_rtt_time = LWIP_MAX(now, 1);
+}
+
+/**
+ * Receive buffer auto-tuning: if the application consumed more than half
+ * of the receive buffer within one receiver side RTT, the sender is likely
+ * limited by our window, so grow the buffer to twice the amount consumed
+ * (up to rcv_buf_max).
+ *
+ * @param pcb the tcp_pcb for which data is read
+ * @param len the amount of bytes that have been read by the application
+ */
+static void
+tcp_rcv_buf_autotune(struct tcp_pcb *pcb, u16_t len)
+{
+  u32_t now, copied;
+  tcpwnd_size_t rcv_buf;
+
+  if ((pcb->rcv_buf >= pcb->rcv_buf_max) || (pcb->rcv_rtt == 0)) {
+    return;
+  }
+
+  pcb->rcv_copied += len;
+  now = sys_now();
+  if ((u32_t)(now - pcb->rcv_copied_time) < pcb->rcv_rtt) {
+    return;
+  }
+
+  copied = pcb->rcv_copied;
+  pcb->rcv_copied = 0;
+  pcb->rcv_copied_time = now;
+
+  if (copied > pcb->rcv_buf / 2) {
+    rcv_buf = (tcpwnd_size_t)LWIP_MIN(2 * copied, pcb->rcv_buf_max);
+    if (rcv_buf > pcb->rcv_buf) {
+      LWIP_DEBUGF(TCP_WND_DEBUG, ("tcp_rcv_buf_autotune: rcv_buf %"TCPWNDSIZE_F" -> %"TCPWNDSIZE_F", rtt %"U32_F" ms\n",
+                                  pcb->rcv_buf, rcv_buf, pcb->rcv_rtt));
+      pcb->rcv_buf = rcv_buf;
+      tcp_update_rcv_wnd_max(pcb);
+    }
+  }
+}
+
+/**
+ * Set the receive buffer size of a pcb. This bounds the receive window
+ * advertised to the remote host and turns off receive buffer auto-tuning.
+ *
+ * @param pcb the tcp_pcb to change
+ * @param size new receive buffer size in bytes, limited to
+ *        [TCP_MSS, TCP_RCV_BUF_MAX]
+ */
+void
+tcp_setrcvbuf(struct tcp_pcb *pcb, u32_t size)
+{
+  LWIP_ASSERT("don't call tcp_setrcvbuf for listen-pcbs",
+    pcb->state != LISTEN);
+
+  size = LWIP_MIN(LWIP_MAX(size, TCP_MSS), TCP_RCV_BUF_MAX);
+  pcb->rcv_buf = (tcpwnd_size_t)size;
+  pcb->rcv_buf_max = (tcpwnd_size_t)size;
+  tcp_update_rcv_wnd_max(pcb);
+
+  if (pcb->state == CLOSED) {
+    /* Nothing announced yet, tcp_connect() starts with the full window */
+    return;
+  }
+
+  if (tcp_update_rcv_ann_wnd(pcb) >= TCP_WND_UPDATE_THRESHOLD) {
+    tcp_ack_now(pcb);
+    tcp_output(pcb);
+  }
+}
+
+/**
+ * Set the send buffer size of a pcb, i.e. how much unacknowledged data
+ * tcp_write() accepts. The buffer never shrinks below the data already
+ * queued.
+ *
+ * @param pcb the tcp_pcb to change
+ * @param size new send buffer size in bytes, limited to
+ *        [2 * TCP_MSS, TCP_SND_BUF_MAX]
+ */
+void
+tcp_setsndbuf(struct tcp_pcb *pcb, u32_t size)
+{
+  tcpwnd_size_t used;
+
+  LWIP_ASSERT("don't call tcp_setsndbuf for listen-pcbs",
+    pcb->state != LISTEN);
+
+  used = (pcb->snd_buf_max > pcb->snd_buf) ? (pcb->snd_buf_max - pcb->snd_buf) : 0;
+  size = LWIP_MIN(LWIP_MAX(size, 2 * TCP_MSS), TCP_SND_BUF_MAX);
+  if (size < used) {
+    size = used;
+  }
+
+  pcb->snd_buf = (tcpwnd_size_t)(size - used);
+  pcb->snd_buf_max = (tcpwnd_size_t)size;
 }
 
 /**
@@ -722,19 +903,10 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
   if (ip_get_option(pcb, SOF_REUSEADDR)) {
     /* Since SOF_REUSEADDR allows reusing a local address, we have to make sure
        now that the 5-tuple is unique. */
-    struct tcp_pcb *cpcb;
-    int i;
     /* Don't check listen- and bound-PCBs, check active- and TIME-WAIT PCBs. */
-    for (i = 2; i < NUM_TCP_PCB_LISTS; i++) {
-      for(cpcb = *tcp_pcb_lists[i]; cpcb != NULL; cpcb = cpcb->next) {
-        if ((cpcb->local_port == pcb->local_port) &&
-            (cpcb->remote_port == port) &&
-            ip_addr_cmp(&cpcb->local_ip, &pcb->local_ip) &&
-            ip_addr_cmp(&cpcb->remote_ip, ipaddr)) {
-          /* linux returns EISCONN here, but ERR_USE should be OK for us */
-          return ERR_USE;
-        }
-      }
+    if (tcp_conn_lookup(&pcb->local_ip, pcb->local_port, ipaddr, port) != NULL) {
+      /* linux returns EISCONN here, but ERR_USE should be OK for us */
+      return ERR_USE;
     }
   }
 #endif /* SO_REUSE */
@@ -743,8 +915,8 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
   pcb->snd_nxt = iss;
   pcb->lastack = iss - 1;
   pcb->snd_lbb = iss - 1;
-  pcb->rcv_wnd = TCP_WND;
-  pcb->rcv_ann_wnd = TCP_WND;
+  pcb->rcv_wnd = TCP_WND_MAX(pcb);
+  pcb->rcv_ann_wnd = TCP_WND_MAX(pcb);
   pcb->rcv_ann_right_edge = pcb->rcv_nxt;
   pcb->snd_wnd = TCP_WND;
   /* As initial send MSS, we use TCP_MSS but limit it to 536.
@@ -788,7 +960,7 @@ void
 tcp_slowtmr(void)
 {
   struct tcp_pcb *pcb, *prev;
-  u16_t eff_wnd;
+  tcpwnd_size_t eff_wnd;
   u8_t pcb_remove;      /* flag if a PCB should be removed */
   u8_t pcb_reset;       /* flag if a RST should be sent when removing */
   err_t err;
@@ -867,8 +1039,8 @@ tcp_slowtmr_start:
             pcb->ssthresh = (pcb->mss << 1);
           }
           pcb->cwnd = pcb->mss;
-          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"U16_F
-                                       " ssthresh %"U16_F"\n",
+          LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_slowtmr: cwnd %"TCPWNDSIZE_F
+                                       " ssthresh %"TCPWNDSIZE_F"\n",
                                        pcb->cwnd, pcb->ssthresh));
  
           /* The following needs to be called AFTER cwnd is set to one
@@ -949,6 +1121,7 @@ tcp_slowtmr_start:
       tcp_err_fn err_fn;
       void *err_arg;
       tcp_pcb_purge(pcb);
+      tcp_conn_hash_del(pcb);
       /* Remove PCB from tcp_active_pcbs list. */
       if (prev != NULL) {
         LWIP_ASSERT("tcp_slowtmr: middle tcp != tcp_active_pcbs", pcb != tcp_active_pcbs);
@@ -1017,6 +1190,7 @@ tcp_slowtmr_start:
     if (pcb_remove) {
       struct tcp_pcb *pcb2;
       tcp_pcb_purge(pcb);
+      tcp_conn_hash_del(pcb);
       /* Remove PCB from tcp_tw_pcbs list. */
       if (prev != NULL) {
         LWIP_ASSERT("tcp_slowtmr: middle tcp != tcp_tw_pcbs", pcb != tcp_tw_pcbs);
@@ -1098,7 +1272,7 @@ tcp_process_refused_data(struct tcp_pcb *pcb)
     if (refused_flags & PBUF_FLAG_TCP_FIN) {
       /* correct rcv_wnd as the application won't call tcp_recved()
          for the FIN's seqno */
-      if (pcb->rcv_wnd != TCP_WND) {
+      if (pcb->rcv_wnd != TCP_WND_MAX(pcb)) {
         pcb->rcv_wnd++;
       }
       TCP_EVENT_CLOSED(pcb, err);
@@ -1307,9 +1481,14 @@ tcp_alloc(u8_t prio)
     memset(pcb, 0, sizeof(struct tcp_pcb));
     pcb->prio = prio;
     pcb->snd_buf = TCP_SND_BUF;
+    pcb->snd_buf_max = TCP_SND_BUF;
     pcb->snd_queuelen = 0;
-    pcb->rcv_wnd = TCP_WND;
-    pcb->rcv_ann_wnd = TCP_WND;
+    /* Until window scaling is negotiated, the SYN window limits us to 64k */
+    pcb->rcv_buf = TCP_WND;
+    pcb->rcv_buf_max = TCP_RCV_BUF_MAX;
+    pcb->rcv_wnd_max = TCPWND16(TCP_WND);
+    pcb->rcv_wnd = pcb->rcv_wnd_max;
+    pcb->rcv_ann_wnd = pcb->rcv_wnd_max;
     pcb->tos = 0;
     pcb->ttl = TCP_TTL;
     /* As initial send MSS, we use TCP_MSS but limit it to 536.
@@ -1538,6 +1717,9 @@ void
 tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
 {
   TCP_RMV(pcblist, pcb);
+  if (pcblist == &tcp_active_pcbs || pcblist == &tcp_tw_pcbs) {
+    tcp_conn_hash_del(pcb);
+  }
 
   tcp_pcb_purge(pcb);
   
@@ -1562,6 +1744,67 @@ tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb)
   LWIP_ASSERT("tcp_pcb_remove: tcp_pcbs_sane()", tcp_pcbs_sane());
 }
 
+/**
+ * Adds an active or TIME-WAIT PCB to the connection hash. Its addresses and
+ * ports must not change until it is removed again.
+ *
+ * @param pcb tcp_pcb to add
+ */
+void
+tcp_conn_hash_add(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **bucket;
+
+  bucket = &tcp_conn_hash[TCP_CONN_HASH(&pcb->local_ip, pcb->local_port,
+                                        &pcb->remote_ip, pcb->remote_port)];
+  pcb->hash_next = *bucket;
+  *bucket = pcb;
+}
+
+/**
+ * Removes a PCB from the connection hash. Does nothing if it is not there.
+ *
+ * @param pcb tcp_pcb to remove
+ */
+void
+tcp_conn_hash_del(struct tcp_pcb *pcb)
+{
+  struct tcp_pcb **link;
+
+  link = &tcp_conn_hash[TCP_CONN_HASH(&pcb->local_ip, pcb->local_port,
+                                      &pcb->remote_ip, pcb->remote_port)];
+  for (; *link != NULL; link = &(*link)->hash_next) {
+    if (*link == pcb) {
+      *link = pcb->hash_next;
+      break;
+    }
+  }
+  pcb->hash_next = NULL;
+}
+
+/**
+ * Finds the active or TIME-WAIT PCB of a connection.
+ *
+ * @return the matching tcp_pcb or NULL
+ */
+struct tcp_pcb *
+tcp_conn_lookup(ip_addr_t *local_ip, u16_t local_port,
+                ip_addr_t *remote_ip, u16_t remote_port)
+{
+  struct tcp_pcb *pcb;
+
+  pcb = tcp_conn_hash[TCP_CONN_HASH(local_ip, local_port, remote_ip, remote_port)];
+  for (; pcb != NULL; pcb = pcb->hash_next) {
+    if (pcb->remote_port == remote_port &&
+        pcb->local_port == local_port &&
+        ip_addr_cmp(&pcb->remote_ip, remote_ip) &&
+        ip_addr_cmp(&pcb->local_ip, local_ip)) {
+      break;
+    }
+  }
+  return pcb;
+}
+
 /**
  * Calculates a new initial sequence number for new connections.
  *
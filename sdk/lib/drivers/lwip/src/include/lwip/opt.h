@@ -923,6 +923,29 @@
 #define TCP_WND                         (4 * TCP_MSS)
 #endif 
 
+/**
+ * LWIP_WND_SCALE and TCP_RCV_SCALE:
+ * Set LWIP_WND_SCALE to 1 to enable window scaling (RFC 7323).
+ * Set TCP_RCV_SCALE to the desired scaling factor (shift count in the
+ * range of [0..14]).
+ * When LWIP_WND_SCALE is enabled but TCP_RCV_SCALE is 0, we can use a large
+ * send window while having a small receive window only.
+ */
+#ifndef LWIP_WND_SCALE
+#define LWIP_WND_SCALE                  0
+#define TCP_RCV_SCALE                   0
+#endif
+
+/**
+ * TCP_RCV_BUF_MAX: Largest receive buffer a pcb may use, either set by
+ * tcp_setrcvbuf() or reached by receive buffer auto-tuning. TCP_WND is
+ * only the initial size. With the default of TCP_WND, auto-tuning is off.
+ * Must fit in (0xFFFF << TCP_RCV_SCALE).
+ */
+#ifndef TCP_RCV_BUF_MAX
+#define TCP_RCV_BUF_MAX                 TCP_WND
+#endif
+
 /**
  * TCP_MAXRTX: Maximum number of retransmissions of data segments.
  */
@@ -977,12 +1000,20 @@
 #define TCP_SND_BUF                     (2 * TCP_MSS)
 #endif
 
+/**
+ * TCP_SND_BUF_MAX: Largest sender buffer space (bytes) that may be set on a
+ * pcb with tcp_setsndbuf(). TCP_SND_BUF is the default.
+ */
+#ifndef TCP_SND_BUF_MAX
+#define TCP_SND_BUF_MAX                 TCP_SND_BUF
+#endif
+
 /**
  * TCP_SND_QUEUELEN: TCP sender buffer space (pbufs). This must be at least
- * as much as (2 * TCP_SND_BUF/TCP_MSS) for things to work.
+ * as much as (2 * TCP_SND_BUF_MAX/TCP_MSS) for things to work.
  */
 #ifndef TCP_SND_QUEUELEN
-#define TCP_SND_QUEUELEN                ((4 * (TCP_SND_BUF) + (TCP_MSS - 1))/(TCP_MSS))
+#define TCP_SND_QUEUELEN                ((4 * (TCP_SND_BUF_MAX) + (TCP_MSS - 1))/(TCP_MSS))
 #endif
 
 /**
@@ -1035,6 +1066,14 @@
 #define TCP_DEFAULT_LISTEN_BACKLOG      0xff
 #endif
 
+/**
+ * TCP_CONN_HASH_SIZE: Number of buckets of the hash table that maps the
+ * 4-tuple of active and TIME-WAIT pcbs to the pcb. Must be a power of two.
+ */
+#ifndef TCP_CONN_HASH_SIZE
+#define TCP_CONN_HASH_SIZE              64
+#endif
+
 /**
  * TCP_OVERSIZE: The maximum number of bytes that tcp_write may
  * allocate ahead of time in an attempt to create shorter pbuf chains
@@ -70,6 +70,8 @@ void             tcp_rexmit  (struct tcp_pcb *pcb);
 void             tcp_rexmit_rto  (struct tcp_pcb *pcb);
 void             tcp_rexmit_fast (struct tcp_pcb *pcb);
 u32_t            tcp_update_rcv_ann_wnd(struct tcp_pcb *pcb);
+void             tcp_update_rcv_wnd_max(struct tcp_pcb *pcb);
+void             tcp_rcv_rtt_measure(struct tcp_pcb *pcb);
 err_t            tcp_process_refused_data(struct tcp_pcb *pcb);
 
 /**
@@ -292,16 +294,26 @@ struct tcp_seg {
 #define TF_SEG_OPTS_TS          (u8_t)0x02U /* Include timestamp option. */
 #define TF_SEG_DATA_CHECKSUMMED (u8_t)0x04U /* ALL data (not the header) is
                                                checksummed into 'chksum' */
+#define TF_SEG_OPTS_WND_SCALE   (u8_t)0x08U /* Include WND SCALE option */
   struct tcp_hdr *tcphdr;  /* the TCP header */
 };
 
 #define LWIP_TCP_OPT_LENGTH(flags)              \
   (flags & TF_SEG_OPTS_MSS ? 4  : 0) +          \
-  (flags & TF_SEG_OPTS_TS  ? 12 : 0)
+  (flags & TF_SEG_OPTS_TS  ? 12 : 0) +          \
+  (flags & TF_SEG_OPTS_WND_SCALE ? 4 : 0)
 
 /** This returns a TCP header option for MSS in an u32_t */
 #define TCP_BUILD_MSS_OPTION(mss) htonl(0x02040000 | ((mss) & 0xFFFF))
 
+/** This returns a NOP followed by a TCP window scale option in an u32_t */
+#define TCP_BUILD_WND_SCALE_OPTION(shift) htonl(0x01030300 | ((shift) & 0xFF))
+
+/** Initial slow start threshold: as large as the peer could ever announce
+ * (RFC 5681), so that slow start is only ended by loss or the window. Only
+ * meaningful once the SYN options have been parsed. */
+#define TCP_INITIAL_SSTHRESH(pcb) ((tcpwnd_size_t)SND_WND_SCALE(pcb, (tcpwnd_size_t)0xFFFF))
+
 /* Global variables: */
 extern struct tcp_pcb *tcp_input_pcb;
 extern u32_t tcp_ticks;
@@ -392,18 +404,28 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
 
 #endif /* LWIP_DEBUG */
 
+/* Active and TIME-WAIT pcbs are also kept in tcp_conn_hash, so incoming
+   segments do not have to walk the whole lists. */
 #define TCP_REG_ACTIVE(npcb)                       \
   do {                                             \
     TCP_REG(&tcp_active_pcbs, npcb);               \
+    tcp_conn_hash_add(npcb);                       \
     tcp_active_pcbs_changed = 1;                   \
   } while (0)
 
 #define TCP_RMV_ACTIVE(npcb)                       \
   do {                                             \
     TCP_RMV(&tcp_active_pcbs, npcb);               \
+    tcp_conn_hash_del(npcb);                       \
     tcp_active_pcbs_changed = 1;                   \
   } while (0)
 
+#define TCP_REG_TW(npcb)                           \
+  do {                                             \
+    TCP_REG(&tcp_tw_pcbs, npcb);                   \
+    tcp_conn_hash_add(npcb);                       \
+  } while (0)
+
 #define TCP_PCB_REMOVE_ACTIVE(pcb)                 \
   do {                                             \
     tcp_pcb_remove(&tcp_active_pcbs, pcb);         \
@@ -412,6 +434,11 @@ extern struct tcp_pcb *tcp_tmp_pcb;      /* Only used for temporary storage. */
 
 
 /* Internal functions: */
+void tcp_conn_hash_add(struct tcp_pcb *pcb);
+void tcp_conn_hash_del(struct tcp_pcb *pcb);
+struct tcp_pcb *tcp_conn_lookup(ip_addr_t *local_ip, u16_t local_port,
+       ip_addr_t *remote_ip, u16_t remote_port);
+
 struct tcp_pcb *tcp_pcb_copy(struct tcp_pcb *pcb);
 void tcp_pcb_purge(struct tcp_pcb *pcb);
 void tcp_pcb_remove(struct tcp_pcb **pcblist, struct tcp_pcb *pcb);
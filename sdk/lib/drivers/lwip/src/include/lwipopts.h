@@ -64,9 +64,21 @@
  * add support for other transport mediums */
 #define TCP_MSS                         1460
 
-#define TCP_WND                         0xFFFF
+/* Window scaling lets a single connection keep more than 64 KB in flight.
+ * Receive buffers start at TCP_WND and are auto-tuned up to TCP_RCV_BUF_MAX,
+ * which is also the upper bound for SO_RCVBUF. A shift of 7 makes the
+ * advertised window cover 8 MB with a granularity of 128 bytes. */
+#define LWIP_WND_SCALE                  1
 
-#define TCP_SND_BUF                     TCP_WND
+#define TCP_RCV_SCALE                   7
+
+#define TCP_WND                         (64 * 1024)
+
+#define TCP_RCV_BUF_MAX                 (4 * 1024 * 1024)
+
+#define TCP_SND_BUF                     (128 * 1024)
+
+#define TCP_SND_BUF_MAX                 (4 * 1024 * 1024)
 
 #define TCP_MAXRTX                      8
 
@@ -74,6 +86,8 @@
 
 #define TCP_LISTEN_BACKLOG              1
 
+#define TCP_CONN_HASH_SIZE              1024
+
 #define LWIP_TCP_TIMESTAMPS             1
 
 #define LWIP_CALLBACK_API               1
@@ -96,6 +110,15 @@
 
 #define PPPOS_SUPPORT                   0
 
+/* The IP header checksum is rebuilt by our IP layer for every fragment and
+ * the TCP checksum is filled in by TCPSendDataCallback and checked by
+ * TCPReceive, so both can be offloaded to the NIC when it supports it */
+#define CHECKSUM_GEN_IP                 0
+
+#define CHECKSUM_GEN_TCP                0
+
+#define CHECKSUM_CHECK_TCP              0
+
 /*
    ---------------------------------------
    ---------- Debugging options ----------
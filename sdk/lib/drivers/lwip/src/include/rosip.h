@@ -43,11 +43,6 @@ struct lwip_callback_msg
             PCONNECTION_ENDPOINT Connection;
             u8_t Backlog;
         } Listen;
-        struct {
-            PCONNECTION_ENDPOINT Connection;
-            void *Data;
-            u16_t DataLength;
-        } Send;
         struct {
             PCONNECTION_ENDPOINT Connection;
             struct ip_addr *IpAddress;
@@ -62,6 +57,11 @@ struct lwip_callback_msg
             PCONNECTION_ENDPOINT Connection;
             int Callback;
         } Close;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            u32_t Size;
+            int Receive;
+        } SetBuffer;
     } Input;
 
     /* Output */
@@ -75,10 +75,6 @@ struct lwip_callback_msg
         struct {
             struct tcp_pcb *NewPcb;
         } Listen;
-        struct {
-            err_t Error;
-            u32_t Information;
-        } Send;
         struct {
             err_t Error;
         } Connect;
@@ -88,6 +84,9 @@ struct lwip_callback_msg
         struct {
             err_t Error;
         } Close;
+        struct {
+            err_t Error;
+        } SetBuffer;
     } Output;
 };
 
@@ -105,7 +104,8 @@ PTCP_PCB    LibTCPSocket(void *arg);
 VOID        LibTCPFreeSocket(PTCP_PCB pcb);
 err_t       LibTCPBind(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 PTCP_PCB    LibTCPListen(PCONNECTION_ENDPOINT Connection, const u8_t backlog);
-err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len, u32_t *sent, const int safe);
+err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u32_t len, const int more, u32_t *sent);
+void        LibTCPQueueSend(PCONNECTION_ENDPOINT Connection);
 err_t       LibTCPConnect(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 err_t       LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shut_tx);
 err_t       LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback);
@@ -114,6 +114,7 @@ err_t       LibTCPGetPeerName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t
 err_t       LibTCPGetHostName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port);
 void        LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg);
 void        LibTCPSetNoDelay(PTCP_PCB pcb, BOOLEAN Set);
+err_t       LibTCPSetBufferSize(PCONNECTION_ENDPOINT Connection, const u32_t size, const int receive);
 void        LibTCPGetSocketStatus(PTCP_PCB pcb, PULONG State);
 
 /* IP functions */
@@ -100,6 +100,70 @@ PQUEUE_ENTRY LibTCPDequeuePacket(PCONNECTION_ENDPOINT Connection)
     return qp;
 }
 
+/* Must be called from the tcpip thread */
+static
+void
+LibTCPUpdateReceiveWindow(PCONNECTION_ENDPOINT Connection)
+{
+    PTCP_PCB pcb;
+    ULONG Consumed;
+    u16_t Chunk;
+
+    LockObject(Connection);
+    Consumed = Connection->ReceiveConsumed;
+    Connection->ReceiveConsumed = 0;
+    Connection->ReceiveUpdatePending = FALSE;
+    UnlockObject(Connection);
+
+    /* The PCB may have died while this update was queued */
+    pcb = Connection->SocketContext;
+    if (!pcb)
+        return;
+
+    /* A scaled window can be opened by more than tcp_recved() takes at once */
+    while (Consumed != 0)
+    {
+        Chunk = (u16_t)MIN(Consumed, 0xFFFF);
+        tcp_recved(pcb, Chunk);
+        Consumed -= Chunk;
+    }
+}
+
+static
+void
+LibTCPRecvedCallback(void *arg)
+{
+    PCONNECTION_ENDPOINT Connection = arg;
+
+    LibTCPUpdateReceiveWindow(Connection);
+
+    DereferenceObject(Connection);
+}
+
+/* The receive window is only reopened once the data has actually been handed to the client.
+ * Acknowledging it on arrival made the advertised window meaningless, since the packet queue
+ * could grow without bound behind a slow reader, and it starved the receive buffer autotuning
+ * in lwIP of any idea of the rate at which the application drains the socket. */
+static
+void
+LibTCPNotifyConsumed(PCONNECTION_ENDPOINT Connection)
+{
+    /* We hold the connection lock here */
+    if (Connection->ReceiveUpdatePending)
+        return;
+
+    ReferenceObject(Connection);
+    if (tcpip_callback_with_block(LibTCPRecvedCallback, Connection, 0) == ERR_OK)
+    {
+        Connection->ReceiveUpdatePending = TRUE;
+    }
+    else
+    {
+        /* The tcpip mailbox is full; the next read or InternalPollEventHandler will try again */
+        DereferenceObject(Connection);
+    }
+}
+
 NTSTATUS LibTCPGetDataFromConnectionQueue(PCONNECTION_ENDPOINT Connection, PUCHAR RecvBuffer, UINT RecvLen, UINT *Received)
 {
     PQUEUE_ENTRY qp;
@@ -160,6 +224,9 @@ NTSTATUS LibTCPGetDataFromConnectionQueue(PCONNECTION_ENDPOINT Connection, PUCHA
             if (!RecvLen)
                 break;
         }
+
+        Connection->ReceiveConsumed += *Received;
+        LibTCPNotifyConsumed(Connection);
     }
     else
     {
@@ -230,8 +297,6 @@ InternalRecvEventHandler(void *arg, PTCP_PCB pcb, struct pbuf *p, const err_t er
     {
         LibTCPEnqueuePacket(Connection, p);
 
-        tcp_recved(pcb, p->tot_len);
-
         TCPRecvEventHandler(arg);
     }
     else if (err == ERR_OK)
@@ -263,6 +328,22 @@ InternalRecvEventHandler(void *arg, PTCP_PCB pcb, struct pbuf *p, const err_t er
     return ERR_OK;
 }
 
+static
+err_t
+InternalPollEventHandler(void *arg, PTCP_PCB pcb)
+{
+    PCONNECTION_ENDPOINT Connection = arg;
+
+    /* Make sure the socket didn't get closed */
+    if (!arg) return ERR_OK;
+
+    /* Pick up a window update that LibTCPNotifyConsumed could not queue */
+    if (Connection->ReceiveConsumed != 0 && !Connection->ReceiveUpdatePending)
+        LibTCPUpdateReceiveWindow(Connection);
+
+    return ERR_OK;
+}
+
 /* This function MUST return an error value that is not ERR_ABRT or ERR_OK if the connection
  * is not accepted to avoid leaking the new PCB */
 static
@@ -496,36 +577,30 @@ LibTCPListen(PCONNECTION_ENDPOINT Connection, const u8_t backlog)
     return NULL;
 }
 
-static
-void
-LibTCPSendCallback(void *arg)
+/* lwIP copies the data, so a send request can complete as soon as all of it was taken.
+ * A whole batch of queued requests is handed to lwIP per trip to the tcpip thread, from
+ * TCPSendEventHandler. Must be called from the tcpip thread. */
+err_t
+LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u32_t len, const int more, u32_t *sent)
 {
-    struct lwip_callback_msg *msg = arg;
-    PTCP_PCB pcb = msg->Input.Send.Connection->SocketContext;
-    ULONG SendLength;
-    UCHAR SendFlags;
-
-    ASSERT(msg);
+    PTCP_PCB pcb = Connection->SocketContext;
+    u32_t SendLength;
+    u8_t SendFlags;
+    err_t Error;
 
-    if (!msg->Input.Send.Connection->SocketContext)
-    {
-        msg->Output.Send.Error = ERR_CLSD;
-        goto done;
-    }
+    *sent = 0;
 
-    if (msg->Input.Send.Connection->SendShutdown)
-    {
-        msg->Output.Send.Error = ERR_CLSD;
-        goto done;
-    }
+    if (!pcb || Connection->SendShutdown)
+        return ERR_CLSD;
 
     SendFlags = TCP_WRITE_FLAG_COPY;
-    SendLength = msg->Input.Send.DataLength;
+    if (more)
+        SendFlags |= TCP_WRITE_FLAG_MORE;
+    SendLength = len;
     if (tcp_sndbuf(pcb) == 0)
     {
         /* No buffer space so return pending */
-        msg->Output.Send.Error = ERR_INPROGRESS;
-        goto done;
+        return ERR_INPROGRESS;
     }
     else if (tcp_sndbuf(pcb) < SendLength)
     {
@@ -536,61 +611,54 @@ LibTCPSendCallback(void *arg)
         SendFlags |= TCP_WRITE_FLAG_MORE;
     }
 
-    msg->Output.Send.Error = tcp_write(pcb,
-                                       msg->Input.Send.Data,
-                                       SendLength,
-                                       SendFlags);
-    if (msg->Output.Send.Error == ERR_OK)
+    /* tcp_write() takes 16-bit lengths */
+    if (SendLength > 0xFFFF)
+    {
+        SendLength = 0xFFFF;
+        SendFlags |= TCP_WRITE_FLAG_MORE;
+    }
+
+    Error = tcp_write(pcb, dataptr, (u16_t)SendLength, SendFlags);
+    if (Error == ERR_OK)
     {
         /* Queued successfully so try to send it */
-        tcp_output((PTCP_PCB)msg->Input.Send.Connection->SocketContext);
-        msg->Output.Send.Information = SendLength;
+        tcp_output(pcb);
+        *sent = SendLength;
     }
-    else if (msg->Output.Send.Error == ERR_MEM)
+    else if (Error == ERR_MEM)
     {
         /* The queue is too long */
-        msg->Output.Send.Error = ERR_INPROGRESS;
+        Error = ERR_INPROGRESS;
     }
 
-done:
-    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+    return Error;
 }
 
-err_t
-LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len, u32_t *sent, const int safe)
+static
+void
+LibTCPQueueSendCallback(void *arg)
 {
-    err_t ret;
-    struct lwip_callback_msg *msg;
-
-    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
-    if (msg)
-    {
-        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
-        msg->Input.Send.Connection = Connection;
-        msg->Input.Send.Data = dataptr;
-        msg->Input.Send.DataLength = len;
+    PCONNECTION_ENDPOINT Connection = arg;
 
-        if (safe)
-            LibTCPSendCallback(msg);
-        else
-            tcpip_callback_with_block(LibTCPSendCallback, msg, 1);
+    TCPSendEventHandler(Connection, 0);
 
-        if (WaitForEventSafely(&msg->Event))
-            ret = msg->Output.Send.Error;
-        else
-            ret = ERR_CLSD;
+    DereferenceObject(Connection);
+}
 
-        if (ret == ERR_OK)
-            *sent = msg->Output.Send.Information;
-        else
-            *sent = 0;
+/* Wakes up the tcpip thread to push the queued send requests into lwIP */
+void
+LibTCPQueueSend(PCONNECTION_ENDPOINT Connection)
+{
+    ReferenceObject(Connection);
 
-        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+    if (tcpip_callback_with_block(LibTCPQueueSendCallback, Connection, 1) != ERR_OK)
+    {
+        LockObject(Connection);
+        Connection->SendPumpPending = FALSE;
+        UnlockObject(Connection);
 
-        return ret;
+        DereferenceObject(Connection);
     }
-
-    return ERR_MEM;
 }
 
 static
@@ -610,6 +678,7 @@ LibTCPConnectCallback(void *arg)
 
     tcp_recv((PTCP_PCB)msg->Input.Connect.Connection->SocketContext, InternalRecvEventHandler);
     tcp_sent((PTCP_PCB)msg->Input.Connect.Connection->SocketContext, InternalSendEventHandler);
+    tcp_poll((PTCP_PCB)msg->Input.Connect.Connection->SocketContext, InternalPollEventHandler, 2);
 
     Error = tcp_connect((PTCP_PCB)msg->Input.Connect.Connection->SocketContext,
                         msg->Input.Connect.IpAddress, ntohs(msg->Input.Connect.Port),
@@ -824,6 +893,7 @@ LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg)
     tcp_arg(pcb, NULL);
     tcp_recv(pcb, InternalRecvEventHandler);
     tcp_sent(pcb, InternalSendEventHandler);
+    tcp_poll(pcb, InternalPollEventHandler, 2);
     tcp_err(pcb, InternalErrorEventHandler);
     tcp_arg(pcb, arg);
 
@@ -865,6 +935,61 @@ LibTCPSetNoDelay(
         pcb->flags &= ~TF_NODELAY;
 }
 
+static
+void
+LibTCPSetBufferSizeCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PTCP_PCB pcb = msg->Input.SetBuffer.Connection->SocketContext;
+
+    ASSERT(msg);
+
+    if (!pcb)
+    {
+        msg->Output.SetBuffer.Error = ERR_CLSD;
+        goto done;
+    }
+
+    if (msg->Input.SetBuffer.Receive)
+        tcp_setrcvbuf(pcb, msg->Input.SetBuffer.Size);
+    else
+        tcp_setsndbuf(pcb, msg->Input.SetBuffer.Size);
+
+    msg->Output.SetBuffer.Error = ERR_OK;
+
+done:
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPSetBufferSize(PCONNECTION_ENDPOINT Connection, const u32_t size, const int receive)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+        msg->Input.SetBuffer.Connection = Connection;
+        msg->Input.SetBuffer.Size = size;
+        msg->Input.SetBuffer.Receive = receive;
+
+        tcpip_callback_with_block(LibTCPSetBufferSizeCallback, msg, 1);
+
+        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.SetBuffer.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
 void
 LibTCPGetSocketStatus(
     PTCP_PCB pcb,
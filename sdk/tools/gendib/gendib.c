@@ -77,6 +77,10 @@
  * video memory. Accessing video memory from the CPU is slooooooow, so let's
  * try to do this as little as possible, even if that means we have to do some
  * extra operations using main memory.
+ * When the source has the same format as the destination and needs no color
+ * translation, named rops don't have to assemble the source pixel by pixel.
+ * If the source is dword aligned with the destination, their center loop
+ * works on whole dwords of both, unrolled FAST_UNROLL times.
  */
 
 #include <stdarg.h>
@@ -116,6 +120,8 @@
 
 #define ROPCODE_GENERIC     256 /* Special case */
 
+#define FAST_UNROLL         4
+
 typedef struct _ROPINFO
 {
     unsigned RopCode;
@@ -502,12 +508,108 @@ CreateSetSinglePixel(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
     Output(Out, "DestPtr = (PULONG)((char *) DestPtr + %u);\n", Bpp / 8);
 }
 
+static int
+UsesFastCenter(unsigned Bpp, PROPINFO RopInfo, int Flags, unsigned SourceBpp)
+{
+    if (ROPCODE_GENERIC == RopInfo->RopCode)
+    {
+        return 0;
+    }
+    if (RopInfo->UsesPattern && 0 != (Flags & FLAG_PATTERNSURFACE))
+    {
+        return 0;
+    }
+    if (RopInfo->UsesSource)
+    {
+        return 0 != (Flags & FLAG_TRIVIALXLATE) && Bpp == SourceBpp;
+    }
+
+    return 1;
+}
+
 static void
-CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
-              unsigned SourceBpp)
+CreateCenter(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
+             unsigned SourceBpp)
 {
     unsigned Partial;
 
+    MARK(Out);
+    Output(Out, "for (i = 0; i < CenterCount; i++)\n");
+    Output(Out, "{\n");
+    if (RopInfo->UsesSource && 0 == (Flags & FLAG_FORCENOUSESSOURCE))
+    {
+        for (Partial = 0; Partial < 32 / Bpp; Partial++)
+        {
+            CreateGetSource(Out, Bpp, RopInfo, Flags, SourceBpp,
+                            Partial * Bpp);
+            MARK(Out);
+        }
+        Output(Out, "\n");
+    }
+    if (RopInfo->UsesPattern && 0 != (Flags & FLAG_PATTERNSURFACE))
+    {
+        for (Partial = 0; Partial < 32 / Bpp; Partial++)
+        {
+            if (0 == Partial)
+            {
+                Output(Out, "Pattern = DIB_GetSourceIndex(BltInfo->PatternSurface, PatternX, PatternY);\n");
+            }
+            else
+            {
+                Output(Out, "Pattern |= DIB_GetSourceIndex(BltInfo->PatternSurface, PatternX, PatternY) << %u;\n", Partial * Bpp);
+            }
+            Output(Out, "if (BltInfo->PatternSurface->sizlBitmap.cx <= ++PatternX)\n");
+            Output(Out, "{\n");
+            Output(Out, "PatternX -= BltInfo->PatternSurface->sizlBitmap.cx;\n");
+            Output(Out, "}\n");
+        }
+        Output(Out, "\n");
+    }
+    CreateOperation(Out, Bpp, RopInfo, SourceBpp, 32);
+    Output(Out, ";\n");
+    MARK(Out);
+    Output(Out, "\n");
+    Output(Out, "DestPtr++;\n");
+    Output(Out, "}\n");
+}
+
+static void
+CreateFastDword(FILE *Out, unsigned Bpp, PROPINFO RopInfo, unsigned SourceBpp)
+{
+    if (RopInfo->UsesSource)
+    {
+        Output(Out, "Source = *SourcePtr++;\n");
+    }
+    CreateOperation(Out, Bpp, RopInfo, SourceBpp, 32);
+    Output(Out, ";\n");
+    Output(Out, "DestPtr++;\n");
+}
+
+static void
+CreateFastCenter(FILE *Out, unsigned Bpp, PROPINFO RopInfo,
+                 unsigned SourceBpp)
+{
+    unsigned Unroll;
+
+    MARK(Out);
+    Output(Out, "for (i = 0; i + %u <= CenterCount; i += %u)\n",
+           FAST_UNROLL, FAST_UNROLL);
+    Output(Out, "{\n");
+    for (Unroll = 0; Unroll < FAST_UNROLL; Unroll++)
+    {
+        CreateFastDword(Out, Bpp, RopInfo, SourceBpp);
+    }
+    Output(Out, "}\n");
+    Output(Out, "for (; i < CenterCount; i++)\n");
+    Output(Out, "{\n");
+    CreateFastDword(Out, Bpp, RopInfo, SourceBpp);
+    Output(Out, "}\n");
+}
+
+static void
+CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
+              unsigned SourceBpp)
+{
     MARK(Out);
     if (RopInfo->UsesSource)
     {
@@ -594,43 +696,31 @@ CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
             Output(Out, "}\n");
             Output(Out, "\n");
         }
-        Output(Out, "for (i = 0; i < CenterCount; i++)\n");
-        Output(Out, "{\n");
-        if (RopInfo->UsesSource && 0 == (Flags & FLAG_FORCENOUSESSOURCE))
+        if (! UsesFastCenter(Bpp, RopInfo, Flags, SourceBpp))
         {
-            for (Partial = 0; Partial < 32 / Bpp; Partial++)
-            {
-                CreateGetSource(Out, Bpp, RopInfo, Flags, SourceBpp,
-                                Partial * Bpp);
-                MARK(Out);
-            }
-            Output(Out, "\n");
+            CreateCenter(Out, Bpp, RopInfo, Flags, SourceBpp);
         }
-        if (RopInfo->UsesPattern && 0 != (Flags & FLAG_PATTERNSURFACE))
+        else if (RopInfo->UsesSource && SourceBpp <= 16)
         {
-            for (Partial = 0; Partial < 32 / Bpp; Partial++)
-            {
-                if (0 == Partial)
-                {
-                    Output(Out, "Pattern = DIB_GetSourceIndex(BltInfo->PatternSurface, PatternX, PatternY);\n");
-                }
-                else
-                {
-                    Output(Out, "Pattern |= DIB_GetSourceIndex(BltInfo->PatternSurface, PatternX, PatternY) << %u;\n", Partial * Bpp);
-                }
-                Output(Out, "if (BltInfo->PatternSurface->sizlBitmap.cx <= ++PatternX)\n");
-                Output(Out, "{\n");
-                Output(Out, "PatternX -= BltInfo->PatternSurface->sizlBitmap.cx;\n");
-                Output(Out, "}\n");
-            }
-            Output(Out, "\n");
+            /* An untouched dword of source pixels is still at SourcePtr - 1 */
+            Output(Out, "if (%u == SourcePixels)\n", 32 / Bpp);
+            Output(Out, "{\n");
+            Output(Out, "SourcePtr--;\n");
+            Output(Out, "SourcePixels = 0;\n");
+            Output(Out, "}\n");
+            Output(Out, "if (0 == SourcePixels)\n");
+            Output(Out, "{\n");
+            CreateFastCenter(Out, Bpp, RopInfo, SourceBpp);
+            Output(Out, "}\n");
+            Output(Out, "else\n");
+            Output(Out, "{\n");
+            CreateCenter(Out, Bpp, RopInfo, Flags, SourceBpp);
+            Output(Out, "}\n");
+        }
+        else
+        {
+            CreateFastCenter(Out, Bpp, RopInfo, SourceBpp);
         }
-        CreateOperation(Out, Bpp, RopInfo, SourceBpp, 32);
-        Output(Out, ";\n");
-        MARK(Out);
-        Output(Out, "\n");
-        Output(Out, "DestPtr++;\n");
-        Output(Out, "}\n");
         Output(Out, "\n");
         if (32 != Bpp)
         {
@@ -16,6 +16,8 @@
 #define ROP4_PATPAINT     ((((0x00FB0A09) >> 8) & 0xff00) | (((0x00FB0A09) >> 16) & 0x00ff))
 #define ROP4_WHITENESS    ((((0x00FF0062) >> 8) & 0xff00) | (((0x00FF0062) >> 16) & 0x00ff))
 
+/* Pixels per XLATEOBJ_vXlateSpan call when a line goes through a stack buffer */
+#define DIB_XLATE_SPAN    64
 
 typedef struct _BLTINFO
 {
@@ -142,7 +142,10 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
   LONG     i, j, sx, sy, xColor, f1;
   PBYTE    SourceBits, DestBits, SourceLine, DestLine;
   PBYTE    SourceBits_4BPP, SourceLine_4BPP;
+  ULONG    aulSpan[DIB_XLATE_SPAN];
+  ULONG    k, cx, cxSpan;
   DestBits = (PBYTE)BltInfo->DestSurface->pvScan0 + (BltInfo->DestRect.top * BltInfo->DestSurface->lDelta) + 2 * BltInfo->DestRect.left;
+  cx = BltInfo->DestRect.right - BltInfo->DestRect.left;
 
   switch(BltInfo->SourceSurface->iBitmapFormat)
   {
@@ -345,16 +348,22 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
       SourceBits = SourceLine;
       DestBits = DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
+      /* Translate the line in pieces through a buffer on the stack */
+      for (k = 0; k < cx; k += cxSpan)
       {
-        xColor = (*(SourceBits + 2) << 0x10) +
-          (*(SourceBits + 1) << 0x08) + (*(SourceBits));
-
-        *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-          BltInfo->XlateSourceToDest, xColor);
-
-        SourceBits += 3;
-        DestBits += 2;
+        cxSpan = min(cx - k, DIB_XLATE_SPAN);
+        for (i = 0; i < (LONG)cxSpan; i++)
+        {
+          aulSpan[i] = (*(SourceBits + 2) << 0x10) +
+            (*(SourceBits + 1) << 0x08) + (*(SourceBits));
+          SourceBits += 3;
+        }
+        XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, aulSpan, aulSpan, cxSpan);
+        for (i = 0; i < (LONG)cxSpan; i++)
+        {
+          ((WORD *)DestBits)[i] = (WORD)aulSpan[i];
+        }
+        DestBits += 2 * cxSpan;
       }
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -373,13 +382,16 @@ DIB_16BPP_BitBltSrcCopy(PBLTINFO BltInfo)
       SourceBits = SourceLine;
       DestBits = DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
+      for (k = 0; k < cx; k += cxSpan)
       {
-        *((WORD *)DestBits) = (WORD)XLATEOBJ_iXlate(
-          BltInfo->XlateSourceToDest,
-          *((PDWORD) SourceBits));
-        SourceBits += 4;
-        DestBits += 2;
+        cxSpan = min(cx - k, DIB_XLATE_SPAN);
+        XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, aulSpan, (PULONG)SourceBits, cxSpan);
+        for (i = 0; i < (LONG)cxSpan; i++)
+        {
+          ((WORD *)DestBits)[i] = (WORD)aulSpan[i];
+        }
+        SourceBits += 4 * cxSpan;
+        DestBits += 2 * cxSpan;
       }
 
       SourceLine += BltInfo->SourceSurface->lDelta;
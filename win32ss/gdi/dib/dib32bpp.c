@@ -53,6 +53,7 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
   PBYTE    SourceBits, DestBits, SourceLine, DestLine;
   PBYTE    SourceBits_4BPP, SourceLine_4BPP;
   PDWORD   Source32, Dest32;
+  ULONG    cx = BltInfo->DestRect.right - BltInfo->DestRect.left;
 
   DestBits = (PBYTE)BltInfo->DestSurface->pvScan0
     + (BltInfo->DestRect.top * BltInfo->DestSurface->lDelta)
@@ -118,15 +119,14 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
-      DestBits = DestLine;
+      Dest32 = (PDWORD)DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
+      /* Widen the indices into the destination and translate them there */
+      for (i = 0; i < (LONG)cx; i++)
       {
-        xColor = *SourceBits;
-        *((PDWORD) DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
-        SourceBits += 1;
-        DestBits += 4;
+        Dest32[i] = SourceBits[i];
       }
+      XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, Dest32, Dest32, cx);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -140,15 +140,13 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
-      DestBits = DestLine;
+      Dest32 = (PDWORD)DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
+      for (i = 0; i < (LONG)cx; i++)
       {
-        xColor = *((PWORD) SourceBits);
-        *((PDWORD) DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
-        SourceBits += 2;
-        DestBits += 4;
+        Dest32[i] = ((PWORD)SourceBits)[i];
       }
+      XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, Dest32, Dest32, cx);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -164,17 +162,16 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
     for (j = BltInfo->DestRect.top; j < BltInfo->DestRect.bottom; j++)
     {
       SourceBits = SourceLine;
-      DestBits = DestLine;
+      Dest32 = (PDWORD)DestLine;
 
-      for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
+      for (i = 0; i < (LONG)cx; i++)
       {
-        xColor = (*(SourceBits + 2) << 0x10) +
+        Dest32[i] = (*(SourceBits + 2) << 0x10) +
           (*(SourceBits + 1) << 0x08) +
           (*(SourceBits));
-        *((PDWORD)DestBits) = (DWORD)XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, xColor);
         SourceBits += 3;
-        DestBits += 4;
       }
+      XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, Dest32, Dest32, cx);
 
       SourceLine += BltInfo->SourceSurface->lDelta;
       DestLine += BltInfo->DestSurface->lDelta;
@@ -220,12 +217,8 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         {
           if (BltInfo->DestRect.left < BltInfo->SourcePoint.x)
           {
-            Dest32 = (DWORD *) DestBits;
-            Source32 = (DWORD *) SourceBits;
-            for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-            {
-              *Dest32++ = XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, *Source32++);
-            }
+            /* Spans run forward, which is safe when moving left */
+            XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, (PULONG)DestBits, (PULONG)SourceBits, cx);
           }
           else
           {
@@ -248,12 +241,8 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
         {
           if (BltInfo->DestRect.left < BltInfo->SourcePoint.x)
           {
-            Dest32 = (DWORD *) DestBits;
-            Source32 = (DWORD *) SourceBits;
-            for (i = BltInfo->DestRect.left; i < BltInfo->DestRect.right; i++)
-            {
-              *Dest32++ = XLATEOBJ_iXlate(BltInfo->XlateSourceToDest, *Source32++);
-            }
+            /* Spans run forward, which is safe when moving left */
+            XLATEOBJ_vXlateSpan(BltInfo->XlateSourceToDest, (PULONG)DestBits, (PULONG)SourceBits, cx);
           }
           else
           {
@@ -279,6 +268,50 @@ DIB_32BPP_BitBltSrcCopy(PBLTINFO BltInfo)
   return TRUE;
 }
 
+/* Source rectangle is the size of the destination and inside the bitmap */
+static __inline BOOLEAN
+IsUnstretchedSource(SURFOBJ *SourceSurf, RECTL *DestRect, RECTL *SourceRect)
+{
+  return (SourceRect->right - SourceRect->left == DestRect->right - DestRect->left &&
+          SourceRect->bottom - SourceRect->top == DestRect->bottom - DestRect->top &&
+          SourceRect->left >= 0 && SourceRect->top >= 0 &&
+          SourceRect->right <= SourceSurf->sizlBitmap.cx &&
+          SourceRect->bottom <= SourceSurf->sizlBitmap.cy);
+}
+
+/* Copies the pixels of a 32bpp line that do not match the color key */
+static VOID
+TransparentSpan32(PULONG Dst, const ULONG *Src, ULONG cx,
+                  XLATEOBJ *ColorTranslation, ULONG iTransColor)
+{
+  ULONG aulSpan[DIB_XLATE_SPAN];
+  ULONG i, cxSpan;
+  const ULONG *Color;
+
+  iTransColor &= 0x00FFFFFF;
+  for (; cx != 0; cx -= cxSpan, Src += cxSpan, Dst += cxSpan)
+  {
+    cxSpan = min(cx, DIB_XLATE_SPAN);
+
+    /* The key is compared against the untranslated source */
+    if (ColorTranslation && !(ColorTranslation->flXlate & XO_TRIVIAL))
+    {
+      XLATEOBJ_vXlateSpan(ColorTranslation, aulSpan, Src, cxSpan);
+      Color = aulSpan;
+    }
+    else
+    {
+      Color = Src;
+    }
+
+    for (i = 0; i < cxSpan; i++)
+    {
+      if ((Src[i] ^ iTransColor) & 0x00FFFFFF)
+        Dst[i] = Color[i];
+    }
+  }
+}
+
 BOOLEAN
 DIB_32BPP_TransparentBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
                          RECTL*  DestRect,  RECTL *SourceRect,
@@ -297,6 +330,24 @@ DIB_32BPP_TransparentBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
   SrcHeight = SourceRect->bottom - SourceRect->top;
   SrcWidth = SourceRect->right - SourceRect->left;
 
+  if (SourceSurf->iBitmapFormat == BMF_32BPP &&
+      IsUnstretchedSource(SourceSurf, DestRect, SourceRect))
+  {
+    PBYTE SourceLine = (PBYTE)SourceSurf->pvScan0 +
+      SourceRect->top * SourceSurf->lDelta + (SourceRect->left << 2);
+    PBYTE DestLine = (PBYTE)DestSurf->pvScan0 +
+      DestRect->top * DestSurf->lDelta + (DestRect->left << 2);
+
+    for (Y = 0; Y < DstHeight; Y++)
+    {
+      TransparentSpan32((PULONG)DestLine, (PULONG)SourceLine, DstWidth,
+                        ColorTranslation, iTransColor);
+      SourceLine += SourceSurf->lDelta;
+      DestLine += DestSurf->lDelta;
+    }
+    return TRUE;
+  }
+
   DestBits = (ULONG*)((PBYTE)DestSurf->pvScan0 +
     (DestRect->left << 2) +
     DestRect->top * DestSurf->lDelta);
@@ -341,6 +392,58 @@ Clamp8(ULONG val)
   return (val > 255) ? 255 : (UCHAR)val;
 }
 
+/*
+ * The span version works on two channels at once, in the 16 bit lanes of a
+ * ULONG, and gives the same results as the per-pixel code below.
+ */
+
+/* x / 255 for both lanes of x, each lane at most 255 * 255 */
+#define DIV255_2X16(x) \
+  ((((x) + 0x00010001 + (((x) >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF)
+
+/* Multiplies all four channels with Factor / 255 */
+static __inline ULONG
+ScalePixel32(ULONG ul, ULONG Factor)
+{
+  ULONG rb = (ul & 0x00FF00FF) * Factor;
+  ULONG ag = ((ul >> 8) & 0x00FF00FF) * Factor;
+
+  return DIV255_2X16(rb) | (DIV255_2X16(ag) << 8);
+}
+
+/* Adds all four channels, saturating at 255 */
+static __inline ULONG
+AddPixel32(ULONG ul1, ULONG ul2)
+{
+  ULONG rb = (ul1 & 0x00FF00FF) + (ul2 & 0x00FF00FF);
+  ULONG ag = ((ul1 >> 8) & 0x00FF00FF) + ((ul2 >> 8) & 0x00FF00FF);
+
+  rb |= (rb & 0x01000100) - ((rb & 0x01000100) >> 8);
+  ag |= (ag & 0x01000100) - ((ag & 0x01000100) >> 8);
+  return (rb & 0x00FF00FF) | ((ag & 0x00FF00FF) << 8);
+}
+
+static VOID
+AlphaBlendSpan32(PULONG Dst, const ULONG *Src, ULONG cx, BLENDFUNCTION BlendFunc)
+{
+  ULONG SrcPixel, Alpha;
+  ULONG ConstAlpha = BlendFunc.SourceConstantAlpha;
+  BOOLEAN PerPixelAlpha = (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0;
+
+  for (; cx != 0; cx--, Dst++, Src++)
+  {
+    SrcPixel = *Src;
+    if (ConstAlpha != 255)
+      SrcPixel = ScalePixel32(SrcPixel, ConstAlpha);
+
+    Alpha = PerPixelAlpha ? (SrcPixel >> 24) : ConstAlpha;
+    if (Alpha == 255)
+      *Dst = SrcPixel;
+    else if (Alpha != 0 || SrcPixel != 0)
+      *Dst = AddPixel32(ScalePixel32(*Dst, 255 - Alpha), SrcPixel);
+  }
+}
+
 BOOLEAN
 DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
@@ -383,6 +486,39 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
 
+  /* Whole lines at once when the source needs no stretching */
+  if (SrcBpp == 32 && IsUnstretchedSource(Source, DestRect, SourceRect))
+  {
+    ULONG aulSpan[DIB_XLATE_SPAN];
+    ULONG cx, cxSpan;
+    PULONG Src;
+
+    for (Rows = 0; Rows < DestRect->bottom - DestRect->top; Rows++)
+    {
+      Src = (PULONG)((ULONG_PTR)Source->pvScan0 + ((SourceRect->top + Rows) * Source->lDelta) +
+        (SourceRect->left << 2));
+      Dst = (PULONG)((ULONG_PTR)Dest->pvScan0 + ((DestRect->top + Rows) * Dest->lDelta) +
+        (DestRect->left << 2));
+
+      for (cx = DestRect->right - DestRect->left; cx != 0; cx -= cxSpan)
+      {
+        cxSpan = min(cx, DIB_XLATE_SPAN);
+        if (ColorTranslation && !(ColorTranslation->flXlate & XO_TRIVIAL))
+        {
+          XLATEOBJ_vXlateSpan(ColorTranslation, aulSpan, Src, cxSpan);
+          AlphaBlendSpan32(Dst, aulSpan, cxSpan, BlendFunc);
+        }
+        else
+        {
+          AlphaBlendSpan32(Dst, Src, cxSpan, BlendFunc);
+        }
+        Src += cxSpan;
+        Dst += cxSpan;
+      }
+    }
+    return TRUE;
+  }
+
   Rows = 0;
    SrcY = SourceRect->top;
    while (++Rows <= DestRect->bottom - DestRect->top)
@@ -260,6 +260,95 @@ CallDibBitBlt(SURFOBJ* OutputObj,
     return Result;
 }
 
+typedef struct _BLT_BAND_CONTEXT
+{
+    PBLTRECTFUNC BltRectFunc;
+    SURFOBJ *OutputObj;
+    SURFOBJ *InputObj;
+    XLATEOBJ *ColorTranslation;
+    RECTL OutputRect;
+    POINTL InputPoint;
+    BRUSHOBJ *pbo;
+    POINTL *BrushOrigin;
+    ROP4 Rop4;
+} BLT_BAND_CONTEXT, *PBLT_BAND_CONTEXT;
+
+static BOOLEAN APIENTRY
+BltBand(PVOID pvContext,
+        RECTL* prclBand)
+{
+    PBLT_BAND_CONTEXT pContext = pvContext;
+    POINTL Pt;
+
+    Pt.x = pContext->InputPoint.x + prclBand->left - pContext->OutputRect.left;
+    Pt.y = pContext->InputPoint.y + prclBand->top - pContext->OutputRect.top;
+    return (*pContext->BltRectFunc)(pContext->OutputObj,
+                                    pContext->InputObj,
+                                    NULL,
+                                    pContext->ColorTranslation,
+                                    prclBand,
+                                    &Pt,
+                                    NULL,
+                                    pContext->pbo,
+                                    pContext->BrushOrigin,
+                                    pContext->Rop4);
+}
+
+/* Runs BltRectFunc on one clipped rectangle, split into bands if it's worth it */
+static BOOLEAN
+BltRect(PBLTRECTFUNC BltRectFunc,
+        SURFOBJ* OutputObj,
+        SURFOBJ* InputObj,
+        SURFOBJ* Mask,
+        XLATEOBJ* ColorTranslation,
+        RECTL* OutputRect,
+        POINTL* InputPoint,
+        POINTL* MaskOrigin,
+        BRUSHOBJ* pbo,
+        POINTL* BrushOrigin,
+        ROP4 Rop4)
+{
+    BLT_BAND_CONTEXT Context;
+    SURFOBJ *psoPattern;
+    BOOL bSerial = FALSE;
+
+    /* Bands of a blt onto its own source would have to run in order */
+    if (!gbEngTiling || Mask || OutputObj == InputObj ||
+        !IntEngCanTile(OutputObj) || !IntEngCanTile(InputObj))
+    {
+        return (*BltRectFunc)(OutputObj, InputObj, Mask, ColorTranslation,
+                              OutputRect, InputPoint, MaskOrigin, pbo,
+                              BrushOrigin, Rop4);
+    }
+
+    /* Realize the pattern now, the bands must not race for it. If that
+       fails, each band would try again, so don't split the blt then. */
+    if (ROP4_USES_PATTERN(Rop4) && pbo && pbo->iSolidColor == 0xFFFFFFFF)
+    {
+        psoPattern = BRUSHOBJ_psoPattern(pbo);
+        bSerial = (psoPattern == NULL) || !IntEngCanTile(psoPattern);
+    }
+
+    if (bSerial)
+    {
+        return (*BltRectFunc)(OutputObj, InputObj, Mask, ColorTranslation,
+                              OutputRect, InputPoint, MaskOrigin, pbo,
+                              BrushOrigin, Rop4);
+    }
+
+    Context.BltRectFunc = BltRectFunc;
+    Context.OutputObj = OutputObj;
+    Context.InputObj = InputObj;
+    Context.ColorTranslation = ColorTranslation;
+    Context.OutputRect = *OutputRect;
+    Context.InputPoint = *InputPoint;
+    Context.pbo = pbo;
+    Context.BrushOrigin = BrushOrigin;
+    Context.Rop4 = Rop4;
+
+    return IntEngTileRect(OutputRect, OutputRect->top, 1, BltBand, &Context);
+}
+
 INT __cdecl abs(INT nm);
 
 
@@ -498,16 +587,17 @@ EngBitBlt(
     switch (clippingType)
     {
         case DC_TRIVIAL:
-            Ret = (*BltRectFunc)(OutputObj,
-                                 InputObj,
-                                 psoMask,
-                                 pxlo,
-                                 &OutputRect,
-                                 &InputPoint,
-                                 pptlMask,
-                                 pbo,
-                                 &AdjustedBrushOrigin,
-                                 rop4);
+            Ret = BltRect(BltRectFunc,
+                          OutputObj,
+                          InputObj,
+                          psoMask,
+                          pxlo,
+                          &OutputRect,
+                          &InputPoint,
+                          pptlMask,
+                          pbo,
+                          &AdjustedBrushOrigin,
+                          rop4);
             break;
         case DC_RECT:
             /* Clip the blt to the clip rectangle */
@@ -526,16 +616,17 @@ EngBitBlt(
 #endif
                 Pt.x = InputPoint.x + CombinedRect.left - OutputRect.left;
                 Pt.y = InputPoint.y + CombinedRect.top - OutputRect.top;
-                Ret = (*BltRectFunc)(OutputObj,
-                                     InputObj,
-                                     psoMask,
-                                     pxlo,
-                                     &CombinedRect,
-                                     &Pt,
-                                     pptlMask,
-                                     pbo,
-                                     &AdjustedBrushOrigin,
-                                     rop4);
+                Ret = BltRect(BltRectFunc,
+                              OutputObj,
+                              InputObj,
+                              psoMask,
+                              pxlo,
+                              &CombinedRect,
+                              &Pt,
+                              pptlMask,
+                              pbo,
+                              &AdjustedBrushOrigin,
+                              rop4);
             }
             break;
         case DC_COMPLEX:
@@ -580,16 +671,17 @@ EngBitBlt(
 #endif
                         Pt.x = InputPoint.x + CombinedRect.left - OutputRect.left;
                         Pt.y = InputPoint.y + CombinedRect.top - OutputRect.top;
-                        Ret = (*BltRectFunc)(OutputObj,
-                                             InputObj,
-                                             psoMask,
-                                             pxlo,
-                                             &CombinedRect,
-                                             &Pt,
-                                             pptlMask,
-                                             pbo,
-                                             &AdjustedBrushOrigin,
-                                             rop4) && Ret;
+                        Ret = BltRect(BltRectFunc,
+                                      OutputObj,
+                                      InputObj,
+                                      psoMask,
+                                      pxlo,
+                                      &CombinedRect,
+                                      &Pt,
+                                      pptlMask,
+                                      pbo,
+                                      &AdjustedBrushOrigin,
+                                      rop4) && Ret;
                     }
                 }
             }
@@ -36,8 +36,77 @@ const LONG LINC[2] = {-1, 1};
     ec[id] -= dy; \
   }
 
+typedef struct _GRADIENT_BAND_CONTEXT
+{
+    SURFOBJ *psoOutput;
+    XLATEOBJ *pxlo;
+    TRIVERTEX *v1;
+    TRIVERTEX *v2;
+    RECTL rcSG;
+    POINTL Translate;
+    LONG dy;
+    BOOL Horizontal;
+} GRADIENT_BAND_CONTEXT, *PGRADIENT_BAND_CONTEXT;
+
 /* FUNCTIONS ******************************************************************/
 
+/* Fills one clipped rectangle, or a band of it, of a rectangle gradient */
+static
+BOOLEAN
+APIENTRY
+IntEngGradientRectBand(
+    PVOID pvContext,
+    RECTL *FillRect)
+{
+    PGRADIENT_BAND_CONTEXT pContext = pvContext;
+    SURFOBJ *psoOutput = pContext->psoOutput;
+    TRIVERTEX *v1 = pContext->v1, *v2 = pContext->v2;
+    LONG y, dy = pContext->dy, c[3], dc[3], ec[3], ic[3];
+    ULONG Color;
+
+    HVINITCOL(Red, 0);
+    HVINITCOL(Green, 1);
+    HVINITCOL(Blue, 2);
+
+    if (pContext->Horizontal)
+    {
+        for (y = pContext->rcSG.left; y < FillRect->right; y++)
+        {
+            if (y >= FillRect->left)
+            {
+                Color = XLATEOBJ_iXlate(pContext->pxlo, RGB(c[0], c[1], c[2]));
+                DibFunctionsForBitmapFormat[psoOutput->iBitmapFormat].DIB_VLine(
+                    psoOutput, y + pContext->Translate.x, FillRect->top + pContext->Translate.y,
+                    FillRect->bottom + pContext->Translate.y, Color);
+            }
+            HVSTEPCOL(0);
+            HVSTEPCOL(1);
+            HVSTEPCOL(2);
+        }
+
+        return TRUE;
+    }
+
+    /* vertical, every band steps down from the top of the gradient again */
+    for (y = pContext->rcSG.top; y < FillRect->bottom; y++)
+    {
+        if (y >= FillRect->top)
+        {
+            Color = XLATEOBJ_iXlate(pContext->pxlo, RGB(c[0], c[1], c[2]));
+            DibFunctionsForBitmapFormat[psoOutput->iBitmapFormat].DIB_HLine(psoOutput,
+                                                                            FillRect->left + pContext->Translate.x,
+                                                                            FillRect->right + pContext->Translate.x,
+                                                                            y + pContext->Translate.y,
+                                                                            Color);
+        }
+        HVSTEPCOL(0);
+        HVSTEPCOL(1);
+        HVSTEPCOL(2);
+    }
+
+    return TRUE;
+}
+
 BOOL
 FASTCALL
 IntEngGradientFillRect(
@@ -59,7 +128,8 @@ IntEngGradientFillRect(
     ULONG i;
     POINTL Translate;
     INTENG_ENTER_LEAVE EnterLeave;
-    LONG y, dy, c[3], dc[3], ec[3], ic[3];
+    GRADIENT_BAND_CONTEXT Context;
+    LONG dy;
 
     v1 = (pVertex + gRect->UpperLeft);
     v2 = (pVertex + gRect->LowerRight);
@@ -87,69 +157,31 @@ IntEngGradientFillRect(
 
     if((v1->Red != v2->Red || v1->Green != v2->Green || v1->Blue != v2->Blue) && dy > 1)
     {
+        Context.psoOutput = psoOutput;
+        Context.pxlo = pxlo;
+        Context.v1 = v1;
+        Context.v2 = v2;
+        Context.rcSG = rcSG;
+        Context.Translate = Translate;
+        Context.dy = dy;
+        Context.Horizontal = Horizontal;
+
         CLIPOBJ_cEnumStart(pco, FALSE, CT_RECTANGLES, CD_RIGHTDOWN, 0);
         do
         {
             RECTL FillRect;
-            ULONG Color;
-
-            if (Horizontal)
-            {
-                EnumMore = CLIPOBJ_bEnum(pco, (ULONG) sizeof(RectEnum), (PVOID) &RectEnum);
-                for (i = 0; i < RectEnum.c && RectEnum.arcl[i].top <= rcSG.bottom; i++)
-                {
-                    if (RECTL_bIntersectRect(&FillRect, &RectEnum.arcl[i], &rcSG))
-                    {
-                        HVINITCOL(Red, 0);
-                        HVINITCOL(Green, 1);
-                        HVINITCOL(Blue, 2);
-
-                        for (y = rcSG.left; y < FillRect.right; y++)
-                        {
-                            if (y >= FillRect.left)
-                            {
-                                Color = XLATEOBJ_iXlate(pxlo, RGB(c[0], c[1], c[2]));
-                                DibFunctionsForBitmapFormat[psoOutput->iBitmapFormat].DIB_VLine(
-                                    psoOutput, y + Translate.x, FillRect.top + Translate.y, FillRect.bottom + Translate.y, Color);
-                            }
-                            HVSTEPCOL(0);
-                            HVSTEPCOL(1);
-                            HVSTEPCOL(2);
-                        }
-                    }
-                }
-
-                continue;
-            }
 
-            /* vertical */
             EnumMore = CLIPOBJ_bEnum(pco, (ULONG) sizeof(RectEnum), (PVOID) &RectEnum);
             for (i = 0; i < RectEnum.c && RectEnum.arcl[i].top <= rcSG.bottom; i++)
             {
                 if (RECTL_bIntersectRect(&FillRect, &RectEnum.arcl[i], &rcSG))
                 {
-                    HVINITCOL(Red, 0);
-                    HVINITCOL(Green, 1);
-                    HVINITCOL(Blue, 2);
-
-                    for (y = rcSG.top; y < FillRect.bottom; y++)
-                    {
-                        if (y >= FillRect.top)
-                        {
-                            Color = XLATEOBJ_iXlate(pxlo, RGB(c[0], c[1], c[2]));
-                            DibFunctionsForBitmapFormat[psoOutput->iBitmapFormat].DIB_HLine(psoOutput,
-                                                                                            FillRect.left + Translate.x,
-                                                                                            FillRect.right + Translate.x,
-                                                                                            y + Translate.y,
-                                                                                            Color);
-                        }
-                        HVSTEPCOL(0);
-                        HVSTEPCOL(1);
-                        HVSTEPCOL(2);
-                    }
+                    if (IntEngCanTile(psoOutput))
+                        IntEngTileRect(&FillRect, FillRect.top, 1, IntEngGradientRectBand, &Context);
+                    else
+                        IntEngGradientRectBand(&Context, &FillRect);
                 }
             }
-
         }
         while (EnumMore);
 
@@ -165,3 +165,27 @@ IntEngCopyBits(SURFOBJ *psoDest,
 	    XLATEOBJ *pxlo,
 	    RECTL *prclDest,
 	    POINTL *ptlSource);
+
+/* Banded execution of large operations, see tile.c */
+typedef BOOLEAN (APIENTRY *PFN_TILE_BAND)(PVOID pvContext, RECTL *prclBand);
+
+extern BOOL gbEngTiling;
+
+INIT_FUNCTION
+NTSTATUS
+NTAPI
+InitTileImpl(VOID);
+
+BOOL
+FASTCALL
+IntEngCanTile(
+    _In_opt_ SURFOBJ *pso);
+
+BOOL
+FASTCALL
+IntEngTileRect(
+    _In_ const RECTL *prcl,
+    _In_ LONG yOrigin,
+    _In_ LONG cyAlign,
+    _In_ PFN_TILE_BAND pfnBand,
+    _In_ PVOID pvContext);
@@ -67,7 +67,110 @@ CallDibStretchBlt(SURFOBJ* psoDest,
     return bResult;
 }
 
+typedef struct _STRETCH_BAND_CONTEXT
+{
+    SURFOBJ *psoDest;
+    SURFOBJ *psoSource;
+    XLATEOBJ *ColorTranslation;
+    RECTL OutputRect;
+    RECTL InputRect;
+    BRUSHOBJ *pbo;
+    POINTL *BrushOrigin;
+    ROP4 Rop4;
+} STRETCH_BAND_CONTEXT, *PSTRETCH_BAND_CONTEXT;
+
+static BOOLEAN APIENTRY
+StretchBand(PVOID pvContext,
+            RECTL* prclBand)
+{
+    PSTRETCH_BAND_CONTEXT pContext = pvContext;
+    LONG DstHeight = pContext->OutputRect.bottom - pContext->OutputRect.top;
+    LONG SrcHeight = pContext->InputRect.bottom - pContext->InputRect.top;
+    RECTL InputBand;
+
+    /* The band edges are on rows that start a new source row, so this is exact */
+    InputBand.left = pContext->InputRect.left;
+    InputBand.right = pContext->InputRect.right;
+    InputBand.top = pContext->InputRect.top + (prclBand->top - pContext->OutputRect.top) * SrcHeight / DstHeight;
+    InputBand.bottom = pContext->InputRect.top + (prclBand->bottom - pContext->OutputRect.top) * SrcHeight / DstHeight;
+
+    return CallDibStretchBlt(pContext->psoDest, pContext->psoSource, NULL,
+                             pContext->ColorTranslation, prclBand, &InputBand,
+                             NULL, pContext->pbo, pContext->BrushOrigin,
+                             pContext->Rop4);
+}
+
+/* Runs CallDibStretchBlt on one clipped rectangle, split into bands if it's worth it */
+static BOOLEAN APIENTRY
+StretchRect(SURFOBJ* psoDest,
+            SURFOBJ* psoSource,
+            SURFOBJ* Mask,
+            XLATEOBJ* ColorTranslation,
+            RECTL* OutputRect,
+            RECTL* InputRect,
+            POINTL* MaskOrigin,
+            BRUSHOBJ* pbo,
+            POINTL* BrushOrigin,
+            ROP4 Rop4)
+{
+    STRETCH_BAND_CONTEXT Context;
+    LONG DstHeight, SrcHeight, a, b, t;
+    LONG cyAlign = 1;
+    SURFOBJ *psoPattern;
+    BOOL bSerial = FALSE;
+
+    if (!gbEngTiling || Mask || psoDest == psoSource ||
+        !IntEngCanTile(psoDest) || !IntEngCanTile(psoSource))
+    {
+        return CallDibStretchBlt(psoDest, psoSource, Mask, ColorTranslation,
+                                 OutputRect, InputRect, MaskOrigin, pbo,
+                                 BrushOrigin, Rop4);
+    }
+
+    /* Realize the pattern now, the bands must not race for it. If that
+       fails, each band would try again, so don't split the blt then. */
+    if (ROP4_USES_PATTERN(Rop4) && pbo && pbo->iSolidColor == 0xFFFFFFFF)
+    {
+        psoPattern = BRUSHOBJ_psoPattern(pbo);
+        bSerial = (psoPattern == NULL) || !IntEngCanTile(psoPattern);
+    }
+
+    if (bSerial)
+    {
+        return CallDibStretchBlt(psoDest, psoSource, Mask, ColorTranslation,
+                                 OutputRect, InputRect, MaskOrigin, pbo,
+                                 BrushOrigin, Rop4);
+    }
+
+    if (ROP4_USES_SOURCE(Rop4))
+    {
+        DstHeight = OutputRect->bottom - OutputRect->top;
+        SrcHeight = InputRect->bottom - InputRect->top;
+        if (DstHeight <= 0 || SrcHeight <= 0)
+        {
+            return CallDibStretchBlt(psoDest, psoSource, Mask, ColorTranslation,
+                                     OutputRect, InputRect, MaskOrigin, pbo,
+                                     BrushOrigin, Rop4);
+        }
 
+        /* Only cut where (y - top) * SrcHeight / DstHeight has no remainder,
+           then every band maps its rows exactly as the whole rectangle does */
+        for (a = DstHeight, b = SrcHeight; b != 0; a = b, b = t)
+            t = a % b;
+        cyAlign = DstHeight / a;
+    }
+
+    Context.psoDest = psoDest;
+    Context.psoSource = psoSource;
+    Context.ColorTranslation = ColorTranslation;
+    Context.OutputRect = *OutputRect;
+    Context.InputRect = *InputRect;
+    Context.pbo = pbo;
+    Context.BrushOrigin = BrushOrigin;
+    Context.Rop4 = Rop4;
+
+    return IntEngTileRect(OutputRect, OutputRect->top, cyAlign, StretchBand, &Context);
+}
 
 /*
  * @implemented
@@ -231,7 +334,7 @@ EngStretchBltROP(
         AdjustedBrushOrigin = Translate;
     }
 
-    BltRectFunc = CallDibStretchBlt;
+    BltRectFunc = StretchRect;
 
     DstHeight = OutputRect.bottom - OutputRect.top;
     DstWidth = OutputRect.right - OutputRect.left;
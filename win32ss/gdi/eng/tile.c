@@ -0,0 +1,166 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS kernel
+ * PURPOSE:           Banded execution of large software rendering operations
+ * FILE:              win32ss/gdi/eng/tile.c
+ */
+
+#include <win32k.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* Operations smaller than two bands of this many pixels run serially */
+#define TILE_MIN_PIXELS     (128 * 1024)
+#define TILE_MAX_BANDS      8
+
+BOOL gbEngTiling = FALSE;
+static ULONG gcTileBands;
+
+typedef struct _TILE_BAND
+{
+    WORK_QUEUE_ITEM WorkItem;
+    PFN_TILE_BAND pfnBand;
+    PVOID pvContext;
+    RECTL rcl;
+    BOOLEAN bResult;
+    PKEVENT pEvent;
+    PLONG plPending;
+} TILE_BAND, *PTILE_BAND;
+
+/*
+ * Tiling is opt-in. It is enabled with the EngTileBlits value under
+ * GRE_Initialize and only used on multiprocessor machines.
+ */
+INIT_FUNCTION
+NTSTATUS
+NTAPI
+InitTileImpl(VOID)
+{
+    HKEY hkey;
+    DWORD dwValue = 0;
+    NTSTATUS Status;
+
+    Status = RegOpenKey(L"\\Registry\\Machine\\Software\\Microsoft\\Windows NT\\CurrentVersion\\GRE_Initialize",
+                        &hkey);
+    if (NT_SUCCESS(Status))
+    {
+        RegReadDWORD(hkey, L"EngTileBlits", &dwValue);
+        ZwClose(hkey);
+    }
+
+    gcTileBands = min(KeNumberProcessors, TILE_MAX_BANDS);
+    gbEngTiling = (dwValue != 0) && (gcTileBands > 1);
+    DPRINT("Tiled rendering %s, %lu bands\n", gbEngTiling ? "on" : "off", gcTileBands);
+
+    return STATUS_SUCCESS;
+}
+
+/*
+ * The bands are run by system worker threads, which are attached to the
+ * system process. They can only work on surfaces whose bits are in system
+ * space.
+ */
+BOOL
+FASTCALL
+IntEngCanTile(
+    _In_opt_ SURFOBJ *pso)
+{
+    if (pso == NULL)
+        return TRUE;
+
+    return (pso->pvBits != NULL) &&
+           ((ULONG_PTR)pso->pvBits >= (ULONG_PTR)MmSystemRangeStart);
+}
+
+static
+VOID
+NTAPI
+TileWorker(
+    _In_ PVOID Parameter)
+{
+    PTILE_BAND pBand = Parameter;
+
+    pBand->bResult = pBand->pfnBand(pBand->pvContext, &pBand->rcl);
+    if (InterlockedDecrement(pBand->plPending) == 0)
+        KeSetEvent(pBand->pEvent, IO_NO_INCREMENT, FALSE);
+}
+
+/*
+ * Runs pfnBand on horizontal bands of prcl, in parallel when tiling is
+ * enabled and the rectangle is large enough, otherwise once on the whole
+ * rectangle. Band boundaries only depend on the rectangle and the number
+ * of processors, and are multiples of cyAlign rows below yOrigin. The
+ * caller makes sure every band only writes its own pixels and reads
+ * nothing another band writes, so the result is the same as the serial one.
+ */
+BOOL
+FASTCALL
+IntEngTileRect(
+    _In_ const RECTL *prcl,
+    _In_ LONG yOrigin,
+    _In_ LONG cyAlign,
+    _In_ PFN_TILE_BAND pfnBand,
+    _In_ PVOID pvContext)
+{
+    TILE_BAND aBands[TILE_MAX_BANDS];
+    KEVENT Event;
+    LONG lPending;
+    LONGLONG cPixels;
+    LONG cyBand, yTop;
+    ULONG cBands, i;
+    RECTL rcl = *prcl;
+    BOOL bResult;
+
+    cPixels = (LONGLONG)(prcl->right - prcl->left) * (prcl->bottom - prcl->top);
+    if (!gbEngTiling || cPixels < 2 * TILE_MIN_PIXELS || cyAlign <= 0)
+        return pfnBand(pvContext, &rcl);
+
+    cBands = (ULONG)min(cPixels / TILE_MIN_PIXELS, (LONGLONG)gcTileBands);
+
+    /* Round the band height up to the alignment */
+    cyBand = (prcl->bottom - prcl->top + cBands - 1) / cBands;
+    cyBand = (cyBand + cyAlign - 1) / cyAlign * cyAlign;
+
+    /* The first band ends on an aligned row */
+    yTop = prcl->top + cyBand;
+    yTop -= (yTop - yOrigin) % cyAlign;
+    if (yTop <= prcl->top || yTop >= prcl->bottom)
+        return pfnBand(pvContext, &rcl);
+
+    for (cBands = 0; cBands < TILE_MAX_BANDS && rcl.top < prcl->bottom; cBands++)
+    {
+        aBands[cBands].pfnBand = pfnBand;
+        aBands[cBands].pvContext = pvContext;
+        aBands[cBands].rcl.left = prcl->left;
+        aBands[cBands].rcl.right = prcl->right;
+        aBands[cBands].rcl.top = rcl.top;
+        aBands[cBands].rcl.bottom = (cBands == 0) ? yTop : min(rcl.top + cyBand, prcl->bottom);
+        if (cBands == TILE_MAX_BANDS - 1)
+            aBands[cBands].rcl.bottom = prcl->bottom;
+        aBands[cBands].pEvent = &Event;
+        aBands[cBands].plPending = &lPending;
+        rcl.top = aBands[cBands].rcl.bottom;
+    }
+
+    /* The caller does the first band itself */
+    KeInitializeEvent(&Event, NotificationEvent, FALSE);
+    lPending = cBands - 1;
+    for (i = 1; i < cBands; i++)
+    {
+        ExInitializeWorkItem(&aBands[i].WorkItem, TileWorker, &aBands[i]);
+        ExQueueWorkItem(&aBands[i].WorkItem, CriticalWorkQueue);
+    }
+
+    aBands[0].bResult = pfnBand(pvContext, &aBands[0].rcl);
+
+    KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
+
+    bResult = TRUE;
+    for (i = 0; i < cBands; i++)
+        bResult = aBands[i].bResult && bResult;
+
+    return bResult;
+}
+
+/* EOF */
@@ -19,9 +19,19 @@ EXLATEOBJ_iXlateTrivial(
     _In_ PEXLATEOBJ pexlo,
     _In_ ULONG iColor);
 
+_Function_class_(FN_XLATE_SPAN)
+static
+VOID
+FASTCALL
+EXLATEOBJ_vXlateSpanTrivial(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels);
+
 /** Globals *******************************************************************/
 
-EXLATEOBJ gexloTrivial = {{0, XO_TRIVIAL, 0, 0, 0, 0}, EXLATEOBJ_iXlateTrivial};
+EXLATEOBJ gexloTrivial = {{0, XO_TRIVIAL, 0, 0, 0, 0}, EXLATEOBJ_iXlateTrivial, EXLATEOBJ_vXlateSpanTrivial};
 
 static ULONG giUniqueXlate = 0;
 
@@ -351,6 +361,132 @@ EXLATEOBJ_iXlateBitfieldsToPal(PEXLATEOBJ pexlo, ULONG iColor)
 }
 
 
+/** Span functions ************************************************************/
+
+/*
+ * The span functions call the iXlate functions directly, so the compiler
+ * can inline them into the loop instead of making one indirect call per
+ * pixel. They run front to back and load four pixels before storing any,
+ * so a destination at or before the source (pulDst <= pulSrc) is fine even
+ * when the two overlap, as in a blit within one surface moving left.
+ */
+#define DEFINE_XLATE_SPAN(name)                                             \
+_Function_class_(FN_XLATE_SPAN)                                             \
+static                                                                      \
+VOID                                                                        \
+FASTCALL                                                                    \
+EXLATEOBJ_vXlateSpan##name(                                                 \
+    _In_ PEXLATEOBJ pexlo,                                                  \
+    _Out_writes_(cPixels) PULONG pulDst,                                    \
+    _In_reads_(cPixels) const ULONG *pulSrc,                                \
+    _In_ ULONG cPixels)                                                     \
+{                                                                           \
+    ULONG ul0, ul1, ul2, ul3;                                               \
+                                                                            \
+    for (; cPixels >= 4; cPixels -= 4, pulSrc += 4, pulDst += 4)            \
+    {                                                                       \
+        ul0 = pulSrc[0];                                                    \
+        ul1 = pulSrc[1];                                                    \
+        ul2 = pulSrc[2];                                                    \
+        ul3 = pulSrc[3];                                                    \
+        pulDst[0] = EXLATEOBJ_iXlate##name(pexlo, ul0);                     \
+        pulDst[1] = EXLATEOBJ_iXlate##name(pexlo, ul1);                     \
+        pulDst[2] = EXLATEOBJ_iXlate##name(pexlo, ul2);                     \
+        pulDst[3] = EXLATEOBJ_iXlate##name(pexlo, ul3);                     \
+    }                                                                       \
+                                                                            \
+    while (cPixels--)                                                       \
+    {                                                                       \
+        *pulDst++ = EXLATEOBJ_iXlate##name(pexlo, *pulSrc++);               \
+    }                                                                       \
+}
+
+DEFINE_XLATE_SPAN(Table)
+DEFINE_XLATE_SPAN(RGBtoBGR)
+DEFINE_XLATE_SPAN(RGBto555)
+DEFINE_XLATE_SPAN(BGRto555)
+DEFINE_XLATE_SPAN(RGBto565)
+DEFINE_XLATE_SPAN(BGRto565)
+DEFINE_XLATE_SPAN(555toRGB)
+DEFINE_XLATE_SPAN(555toBGR)
+DEFINE_XLATE_SPAN(555to565)
+DEFINE_XLATE_SPAN(565to555)
+DEFINE_XLATE_SPAN(565toRGB)
+DEFINE_XLATE_SPAN(565toBGR)
+DEFINE_XLATE_SPAN(ShiftAndMask)
+
+_Function_class_(FN_XLATE_SPAN)
+static
+VOID
+FASTCALL
+EXLATEOBJ_vXlateSpanTrivial(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels)
+{
+    if (pulDst != pulSrc)
+        RtlMoveMemory(pulDst, pulSrc, cPixels * sizeof(ULONG));
+}
+
+/* For the palette lookups, where the call is not what costs */
+_Function_class_(FN_XLATE_SPAN)
+static
+VOID
+FASTCALL
+EXLATEOBJ_vXlateSpanGeneric(
+    _In_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_reads_(cPixels) const ULONG *pulSrc,
+    _In_ ULONG cPixels)
+{
+    PFN_XLATE pfnXlate = pexlo->pfnXlate;
+
+    while (cPixels--)
+    {
+        *pulDst++ = pfnXlate(pexlo, *pulSrc++);
+    }
+}
+
+static const struct
+{
+    PFN_XLATE pfnXlate;
+    PFN_XLATE_SPAN pfnXlateSpan;
+} gaXlateSpans[] =
+{
+    {EXLATEOBJ_iXlateTrivial, EXLATEOBJ_vXlateSpanTrivial},
+    {EXLATEOBJ_iXlateTable, EXLATEOBJ_vXlateSpanTable},
+    {EXLATEOBJ_iXlateRGBtoBGR, EXLATEOBJ_vXlateSpanRGBtoBGR},
+    {EXLATEOBJ_iXlateRGBto555, EXLATEOBJ_vXlateSpanRGBto555},
+    {EXLATEOBJ_iXlateBGRto555, EXLATEOBJ_vXlateSpanBGRto555},
+    {EXLATEOBJ_iXlateRGBto565, EXLATEOBJ_vXlateSpanRGBto565},
+    {EXLATEOBJ_iXlateBGRto565, EXLATEOBJ_vXlateSpanBGRto565},
+    {EXLATEOBJ_iXlate555toRGB, EXLATEOBJ_vXlateSpan555toRGB},
+    {EXLATEOBJ_iXlate555toBGR, EXLATEOBJ_vXlateSpan555toBGR},
+    {EXLATEOBJ_iXlate555to565, EXLATEOBJ_vXlateSpan555to565},
+    {EXLATEOBJ_iXlate565to555, EXLATEOBJ_vXlateSpan565to555},
+    {EXLATEOBJ_iXlate565toRGB, EXLATEOBJ_vXlateSpan565toRGB},
+    {EXLATEOBJ_iXlate565toBGR, EXLATEOBJ_vXlateSpan565toBGR},
+    {EXLATEOBJ_iXlateShiftAndMask, EXLATEOBJ_vXlateSpanShiftAndMask},
+};
+
+static
+PFN_XLATE_SPAN
+EXLATEOBJ_pfnGetXlateSpan(
+    _In_ PFN_XLATE pfnXlate)
+{
+    ULONG i;
+
+    for (i = 0; i < _countof(gaXlateSpans); i++)
+    {
+        if (gaXlateSpans[i].pfnXlate == pfnXlate)
+            return gaXlateSpans[i].pfnXlateSpan;
+    }
+
+    return EXLATEOBJ_vXlateSpanGeneric;
+}
+
+
 /** Private Functions *********************************************************/
 
 VOID
@@ -374,6 +510,7 @@ EXLATEOBJ_vInitialize(
     pexlo->xlo.flXlate = 0;
     pexlo->xlo.pulXlate = pexlo->aulXlate;
     pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
+    pexlo->pfnXlateSpan = EXLATEOBJ_vXlateSpanTrivial;
     pexlo->hColorTransform = NULL;
     pexlo->ppalSrc = ppalSrc;
     pexlo->ppalDst = ppalDst;
@@ -604,6 +741,8 @@ EXLATEOBJ_vInitialize(
         pexlo->xlo.flXlate = XO_TRIVIAL;
     else
         pexlo->xlo.flXlate &= ~XO_TRIVIAL;
+
+    pexlo->pfnXlateSpan = EXLATEOBJ_pfnGetXlateSpan(pexlo->pfnXlate);
 }
 
 VOID
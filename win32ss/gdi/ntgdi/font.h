@@ -25,7 +25,11 @@ typedef struct _FONT_ENTRY_COLL_MEM
 
 typedef struct _FONT_CACHE_ENTRY
 {
-    LIST_ENTRY ListEntry;
+    LIST_ENTRY ListEntry;   /* LRU list, most recently used first */
+    LIST_ENTRY HashEntry;   /* Chain of the hash bucket */
+    ULONG Hash;
+    UCHAR Slab;             /* Lookaside list the entry came from, or FONT_CACHE_NO_SLAB */
+    SIZE_T Size;            /* Bytes charged against the cache budget */
     int GlyphIndex;
     FT_Face Face;
     FT_BitmapGlyph BitmapGlyph;
@@ -88,10 +88,24 @@ static BOOL             g_RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
     ASSERT(g_FreeTypeLock->Owner != KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/* Glyph bitmaps are cached by (face, glyph, height, render mode, transform).
+ * Lookups go through a hash table, eviction is LRU once the cached entries
+ * and their bitmaps exceed MAX_FONT_CACHE_BYTES. Small bitmaps are stored
+ * right behind their entry, in blocks from a few lookaside lists. */
+#define MAX_FONT_CACHE_BYTES    (2 * 1024 * 1024)
+#define FONT_CACHE_HASH_SIZE    1024    /* must be a power of two */
+#define FONT_CACHE_NO_SLAB      0xFF
+
+static const SIZE_T g_FontCacheSlabSizes[] = { 256, 1024, 4096 };
+#define FONT_CACHE_SLABS        _countof(g_FontCacheSlabSizes)
 
 static LIST_ENTRY g_FontCacheListHead;
+static LIST_ENTRY g_FontCacheHashTable[FONT_CACHE_HASH_SIZE];
+static PPAGED_LOOKASIDE_LIST g_FontCacheSlabs;
+static SIZE_T g_FontCacheSize;
 static UINT g_FontCacheNumEntries;
+static ULONG g_FontCacheHits;
+static ULONG g_FontCacheMisses;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -258,11 +272,22 @@ RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 {
     ASSERT_FREETYPE_LOCK_HELD();
 
+    /* A bitmap stored behind the entry is not FreeType's to free */
+    if (Entry->BitmapGlyph->bitmap.buffer == (PUCHAR)(Entry + 1))
+        Entry->BitmapGlyph->bitmap.buffer = NULL;
+
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
-    ExFreePoolWithTag(Entry, TAG_FONT);
+    RemoveEntryList(&Entry->HashEntry);
+
+    ASSERT(g_FontCacheSize >= Entry->Size);
+    g_FontCacheSize -= Entry->Size;
     g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
+
+    if (Entry->Slab != FONT_CACHE_NO_SLAB)
+        ExFreeToPagedLookasideList(&g_FontCacheSlabs[Entry->Slab], Entry);
+    else
+        ExFreePoolWithTag(Entry, TAG_FONT);
 }
 
 static void
@@ -660,10 +685,35 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    UINT i;
 
     InitializeListHead(&g_FontListHead);
     InitializeListHead(&g_FontCacheListHead);
+    for (i = 0; i < FONT_CACHE_HASH_SIZE; i++)
+    {
+        InitializeListHead(&g_FontCacheHashTable[i]);
+    }
+    g_FontCacheSize = 0;
     g_FontCacheNumEntries = 0;
+
+    /* Lookaside lists must be allocated from non paged pool */
+    g_FontCacheSlabs = ExAllocatePoolWithTag(NonPagedPool,
+                                             FONT_CACHE_SLABS * sizeof(PAGED_LOOKASIDE_LIST),
+                                             TAG_FONT);
+    if (g_FontCacheSlabs == NULL)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < FONT_CACHE_SLABS; i++)
+    {
+        ExInitializePagedLookasideList(&g_FontCacheSlabs[i],
+                                       NULL,
+                                       NULL,
+                                       0,
+                                       g_FontCacheSlabSizes[i],
+                                       TAG_FONT,
+                                       0);
+    }
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FontListLock == NULL)
@@ -3130,6 +3180,26 @@ SameScaleMatrix(
             FLOATOBJ_Equal(&pmx1->efM22, &pmx2->efM22));
 }
 
+/* The transform is left out, it is compared when walking the bucket */
+static __inline ULONG
+GlyphCacheHash(
+    FT_Face Face,
+    INT GlyphIndex,
+    INT Height,
+    FT_Render_Mode RenderMode)
+{
+    ULONG Hash;
+
+    Hash = (ULONG)((ULONG_PTR)Face >> 4);
+    Hash = Hash * 31 + (ULONG)GlyphIndex;
+    Hash = Hash * 31 + (ULONG)Height;
+    Hash = Hash * 31 + (ULONG)RenderMode;
+    return Hash * 0x9E3779B1;
+}
+
+#define GLYPH_CACHE_BUCKET(Hash) \
+    (&g_FontCacheHashTable[((Hash) >> 16) & (FONT_CACHE_HASH_SIZE - 1)])
+
 FT_BitmapGlyph APIENTRY
 ftGdiGlyphCacheGet(
     FT_Face Face,
@@ -3138,17 +3208,22 @@ ftGdiGlyphCacheGet(
     FT_Render_Mode RenderMode,
     PMATRIX pmx)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY Bucket, CurrentEntry;
     PFONT_CACHE_ENTRY FontEntry;
+    ULONG Hash;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    Hash = GlyphCacheHash(Face, GlyphIndex, Height, RenderMode);
+    Bucket = GLYPH_CACHE_BUCKET(Hash);
+
+    for (CurrentEntry = Bucket->Flink;
+         CurrentEntry != Bucket;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        if ((FontEntry->Face == Face) &&
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
+        if ((FontEntry->Hash == Hash) &&
+            (FontEntry->Face == Face) &&
             (FontEntry->GlyphIndex == GlyphIndex) &&
             (FontEntry->Height == Height) &&
             (FontEntry->RenderMode == RenderMode) &&
@@ -3156,13 +3231,22 @@ ftGdiGlyphCacheGet(
             break;
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == Bucket)
     {
+        g_FontCacheMisses++;
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
+    /* The counters are for measuring text rendering, they may wrap */
+    g_FontCacheHits++;
+    if (((g_FontCacheHits + g_FontCacheMisses) & 0xFFFF) == 0)
+    {
+        DPRINT("Glyph cache: %lu hits, %lu misses, %u entries, %Iu bytes\n",
+               g_FontCacheHits, g_FontCacheMisses, g_FontCacheNumEntries, g_FontCacheSize);
+    }
+
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&g_FontCacheListHead, &FontEntry->ListEntry);
     return FontEntry->BitmapGlyph;
 }
 
@@ -3222,6 +3306,8 @@ ftGdiGlyphCacheSet(
     PFONT_CACHE_ENTRY NewEntry;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
+    SIZE_T BitmapSize, Size;
+    UCHAR Slab;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
@@ -3240,20 +3326,11 @@ ftGdiGlyphCacheSet(
         return NULL;
     };
 
-    NewEntry = ExAllocatePoolWithTag(PagedPool, sizeof(FONT_CACHE_ENTRY), TAG_FONT);
-    if (!NewEntry)
-    {
-        DPRINT1("Alloc failure caching glyph.\n");
-        FT_Done_Glyph(GlyphCopy);
-        return NULL;
-    }
-
     BitmapGlyph = (FT_BitmapGlyph)GlyphCopy;
     FT_Bitmap_New(&AlignedBitmap);
     if(FT_Bitmap_Convert(GlyphSlot->library, &BitmapGlyph->bitmap, &AlignedBitmap, 4))
     {
         DPRINT1("Conversion failed\n");
-        ExFreePoolWithTag(NewEntry, TAG_FONT);
         FT_Bitmap_Done(GlyphSlot->library, &AlignedBitmap);
         FT_Done_Glyph((FT_Glyph)BitmapGlyph);
         return NULL;
@@ -3262,6 +3339,45 @@ ftGdiGlyphCacheSet(
     FT_Bitmap_Done(GlyphSlot->library, &BitmapGlyph->bitmap);
     BitmapGlyph->bitmap = AlignedBitmap;
 
+    /* Pick the smallest slab that holds the entry and its bitmap */
+    BitmapSize = (SIZE_T)abs(AlignedBitmap.pitch) * AlignedBitmap.rows;
+    Size = sizeof(FONT_CACHE_ENTRY) + BitmapSize;
+    for (Slab = 0; Slab < FONT_CACHE_SLABS; Slab++)
+    {
+        if (Size <= g_FontCacheSlabSizes[Slab])
+            break;
+    }
+
+    if (Slab < FONT_CACHE_SLABS)
+    {
+        NewEntry = ExAllocateFromPagedLookasideList(&g_FontCacheSlabs[Slab]);
+        Size = g_FontCacheSlabSizes[Slab];
+    }
+    else
+    {
+        /* The bitmap stays with FreeType */
+        Slab = FONT_CACHE_NO_SLAB;
+        NewEntry = ExAllocatePoolWithTag(PagedPool, sizeof(FONT_CACHE_ENTRY), TAG_FONT);
+    }
+
+    if (!NewEntry)
+    {
+        DPRINT1("Alloc failure caching glyph.\n");
+        FT_Done_Glyph((FT_Glyph)BitmapGlyph);
+        return NULL;
+    }
+
+    if (Slab != FONT_CACHE_NO_SLAB && BitmapSize != 0)
+    {
+        RtlCopyMemory(NewEntry + 1, AlignedBitmap.buffer, BitmapSize);
+        FT_Bitmap_Done(GlyphSlot->library, &BitmapGlyph->bitmap);
+        BitmapGlyph->bitmap = AlignedBitmap;
+        BitmapGlyph->bitmap.buffer = (PUCHAR)(NewEntry + 1);
+    }
+
+    NewEntry->Hash = GlyphCacheHash(Face, GlyphIndex, Height, RenderMode);
+    NewEntry->Slab = Slab;
+    NewEntry->Size = Size;
     NewEntry->GlyphIndex = GlyphIndex;
     NewEntry->Face = Face;
     NewEntry->BitmapGlyph = BitmapGlyph;
@@ -3270,10 +3386,16 @@ ftGdiGlyphCacheSet(
     NewEntry->mxWorldToDevice = *pmx;
 
     InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
+    InsertHeadList(GLYPH_CACHE_BUCKET(NewEntry->Hash), &NewEntry->HashEntry);
+    g_FontCacheSize += Size;
+    g_FontCacheNumEntries++;
+
+    /* Evict the least recently used glyphs, but never the new one */
+    while (g_FontCacheSize > MAX_FONT_CACHE_BYTES &&
+           g_FontCacheListHead.Blink != &NewEntry->ListEntry)
     {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        RemoveCachedEntry(CONTAINING_RECORD(g_FontCacheListHead.Blink,
+                                            FONT_CACHE_ENTRY, ListEntry));
     }
 
     return BitmapGlyph;
@@ -15,6 +15,7 @@
 
 extern ULONG gulFirstFree;
 extern ULONG gulFirstUnused;
+extern LONG gcCachedFreeEntries;
 extern PENTRY gpentHmgr;
 
 ULONG gulLogUnique = 0;
@@ -389,11 +390,12 @@ DbgGdiHTIntegrityCheck(VOID)
 		}
 	}
 
-	if (RESERVE_ENTRIES_COUNT + nDeleted + nFree + nUsed != GDI_HANDLE_COUNT)
+	/* Free entries reserved by processes are on none of the lists */
+	if (RESERVE_ENTRIES_COUNT + nDeleted + nFree + nUsed + gcCachedFreeEntries != GDI_HANDLE_COUNT)
 	{
 		r = 0;
-		DPRINT1("Number of all entries incorrect: RESERVE_ENTRIES_COUNT = %lu, nDeleted = %lu, nFree = %lu, nUsed = %lu\n",
-		        RESERVE_ENTRIES_COUNT, nDeleted, nFree, nUsed);
+		DPRINT1("Number of all entries incorrect: RESERVE_ENTRIES_COUNT = %lu, nDeleted = %lu, nFree = %lu, nUsed = %lu, nCached = %ld\n",
+		        RESERVE_ENTRIES_COUNT, nDeleted, nFree, nUsed, gcCachedFreeEntries);
 	}
 
 	KeLeaveCriticalRegion();
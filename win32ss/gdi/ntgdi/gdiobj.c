@@ -142,6 +142,11 @@ enum
     REF_MASK_INUSE = 0x00ffffff,
 };
 
+/* Number of free entries a process takes from or returns to the global
+   free list at once, and the number it keeps at most */
+#define GDI_FREE_BATCH      16
+#define GDI_FREE_CACHE_MAX  (4 * GDI_FREE_BATCH)
+
 /* GLOBALS *******************************************************************/
 
 /* Per session handle table globals */
@@ -150,6 +155,9 @@ PENTRY gpentHmgr;
 PULONG gpaulRefCount;
 volatile ULONG gulFirstFree;
 volatile ULONG gulFirstUnused;
+volatile LONG gcCachedFreeEntries;
+static LIST_ENTRY gleFreeEntryCaches; /* Processes that reserve free entries */
+static EX_PUSH_LOCK gplFreeEntryCaches;
 static PPAGED_LOOKASIDE_LIST gpaLookasideList;
 
 static VOID NTAPI GDIOBJ_vCleanup(PVOID ObjectBody);
@@ -304,6 +312,8 @@ InitGdiHandleTable(void)
 
     gulFirstFree = 0;
     gulFirstUnused = RESERVE_ENTRIES_COUNT;
+    InitializeListHead(&gleFreeEntryCaches);
+    ExInitializePushLock(&gplFreeEntryCaches);
 
     GdiHandleTable = (PVOID)gpentHmgr;
 
@@ -377,15 +387,215 @@ DecrementGdiHandleCount(ULONG ulProcessId)
     if (NT_SUCCESS(Status)) ObDereferenceObject(pep);
 }
 
+/* Returns the index of the next entry in a chain of free entries */
+static
+ULONG
+ENTRY_idxChainNext(ULONG idx)
+{
+    return GDI_HANDLE_GET_INDEX(gpentHmgr[idx].einfo.hFree);
+}
+
+/* Pops up to cMax entries from a free list with a single exchange.
+   The popped entries stay linked through einfo.pobj. Returns the number
+   of popped entries and the index of the first one. */
+static
+ULONG
+ENTRY_cPopFreeChain(
+    volatile ULONG *pulFirstFree,
+    ULONG cMax,
+    PULONG piFirst)
+{
+    ULONG iFirst, iNext, iPrev, iLast, cEntries;
+
+    do
+    {
+        /* Get the index and sequence number of the first free entry */
+        iFirst = InterlockedReadUlong(pulFirstFree);
+        if (!(iFirst & GDI_HANDLE_INDEX_MASK))
+            return 0;
+
+        /* Walk the chain. If another thread changes the list meanwhile, the
+           links might be stale, but then the sequence number has changed
+           and the exchange below fails */
+        iLast = iFirst & GDI_HANDLE_INDEX_MASK;
+        for (cEntries = 1; cEntries < cMax; cEntries++)
+        {
+            iNext = ENTRY_idxChainNext(iLast);
+            if (!iNext) break;
+            iLast = iNext;
+        }
+
+        /* The entry after the last one becomes the first free entry */
+        iNext = ENTRY_idxChainNext(iLast);
+        iNext |= (iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000;
+
+        /* Try to exchange the FirstFree value */
+        iPrev = InterlockedCompareExchange((LONG*)pulFirstFree,
+                                           iNext,
+                                           iFirst);
+    }
+    while (iPrev != iFirst);
+
+    *piFirst = iFirst & GDI_HANDLE_INDEX_MASK;
+    return cEntries;
+}
+
+/* Pushes a chain of free entries, linked through einfo.pobj, to a free list */
+static
+VOID
+ENTRY_vPushFreeChain(
+    volatile ULONG *pulFirstFree,
+    ULONG idxFirst,
+    ULONG idxLast)
+{
+    ULONG iToFree, iFirst, iPrev;
+
+    do
+    {
+        /* Get the current first free index and sequence number */
+        iFirst = InterlockedReadUlong(pulFirstFree);
+
+        /* Link the last entry to the first free entry */
+        gpentHmgr[idxLast].einfo.pobj = UlongToPtr(iFirst & GDI_HANDLE_INDEX_MASK);
+
+        /* Combine new index and increased sequence number in iToFree */
+        iToFree = idxFirst | ((iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000);
+
+        /* Try to atomically update the first free entry */
+        iPrev = InterlockedCompareExchange((LONG*)pulFirstFree,
+                                           iToFree,
+                                           iFirst);
+    }
+    while (iPrev != iFirst);
+}
+
+/* Returns a batch of the free entries reserved by a process to the
+   global free list */
+static
+BOOL
+ENTRY_bReturnFreeBatch(PPROCESSINFO ppi)
+{
+    ULONG idxFirst, idxLast, cEntries, i;
+
+    cEntries = ENTRY_cPopFreeChain(&ppi->ulGdiFirstFree, GDI_FREE_BATCH, &idxFirst);
+    if (cEntries == 0)
+        return FALSE;
+
+    for (i = 1, idxLast = idxFirst; i < cEntries; i++)
+        idxLast = ENTRY_idxChainNext(idxLast);
+
+    ENTRY_vPushFreeChain(&gulFirstFree, idxFirst, idxLast);
+    InterlockedExchangeAdd(&ppi->cGdiFreeEntries, -(LONG)cEntries);
+    InterlockedExchangeAdd(&gcCachedFreeEntries, -(LONG)cEntries);
+    return TRUE;
+}
+
+/* Takes a free entry from the ones reserved by the current process. When
+   there are none left, a batch is taken from the global free list, or from
+   the unused entries, and the rest of it is kept for later. */
 static
 PENTRY
-ENTRY_pentPopFreeEntry(VOID)
+ENTRY_pentPopProcessFreeEntry(PPROCESSINFO ppi)
+{
+    ULONG idxFirst, idxLast, cEntries, i;
+
+    if (ENTRY_cPopFreeChain(&ppi->ulGdiFirstFree, 1, &idxFirst))
+    {
+        InterlockedDecrement(&ppi->cGdiFreeEntries);
+        InterlockedDecrement(&gcCachedFreeEntries);
+        return &gpentHmgr[idxFirst];
+    }
+
+    cEntries = ENTRY_cPopFreeChain(&gulFirstFree, GDI_FREE_BATCH, &idxFirst);
+    if (cEntries == 0)
+    {
+        /* Reserve a batch of unused entries, they are already zeroed.
+           Never move FirstUnused past the end of the table, or a concurrent
+           ENTRY_pentPopGlobalFreeEntry could see it exhausted. */
+        do
+        {
+            idxFirst = InterlockedReadUlong(&gulFirstUnused);
+
+            /* Leave the last ones to ENTRY_pentPopFreeEntry */
+            if (idxFirst + GDI_FREE_BATCH > GDI_HANDLE_COUNT)
+                return NULL;
+        }
+        while (InterlockedCompareExchange((LONG*)&gulFirstUnused,
+                                          idxFirst + GDI_FREE_BATCH,
+                                          idxFirst) != (LONG)idxFirst);
+
+        cEntries = GDI_FREE_BATCH;
+        for (i = idxFirst; i < idxFirst + cEntries - 1; i++)
+            gpentHmgr[i].einfo.pobj = UlongToPtr(i + 1);
+    }
+
+    /* Keep all but the first entry */
+    if (cEntries > 1)
+    {
+        for (i = 1, idxLast = idxFirst; i < cEntries; i++)
+            idxLast = ENTRY_idxChainNext(idxLast);
+
+        InterlockedExchangeAdd(&ppi->cGdiFreeEntries, cEntries - 1);
+        InterlockedExchangeAdd(&gcCachedFreeEntries, cEntries - 1);
+        ENTRY_vPushFreeChain(&ppi->ulGdiFirstFree,
+                             ENTRY_idxChainNext(idxFirst),
+                             idxLast);
+    }
+
+    return &gpentHmgr[idxFirst];
+}
+
+/* Returns the free entries reserved by all processes to the global free
+   list. Used when the handle table runs out of entries, so that entries
+   kept by processes that no longer need them can still be used. */
+static
+BOOL
+ENTRY_bReclaimFreeEntries(VOID)
+{
+    PLIST_ENTRY ple;
+    PPROCESSINFO ppi;
+    BOOL bReclaimed = FALSE;
+
+    if (gcCachedFreeEntries <= 0)
+        return FALSE;
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockShared(&gplFreeEntryCaches);
+
+    for (ple = gleFreeEntryCaches.Flink; ple != &gleFreeEntryCaches; ple = ple->Flink)
+    {
+        ppi = CONTAINING_RECORD(ple, PROCESSINFO, leGdiFreeEntries);
+        while (ENTRY_bReturnFreeBatch(ppi))
+            bReclaimed = TRUE;
+    }
+
+    ExReleasePushLockShared(&gplFreeEntryCaches);
+    KeLeaveCriticalRegion();
+
+    return bReclaimed;
+}
+
+static
+PPROCESSINFO
+ENTRY_ppiFreeEntryCache(VOID)
+{
+    PPROCESSINFO ppi = PsGetCurrentProcessWin32Process();
+
+    /* Dying processes return their entries and don't take new ones */
+    if (ppi && !(ppi->W32PF_flags & W32PF_TERMINATED))
+        return ppi;
+
+    return NULL;
+}
+
+/* Takes an entry from the global free list, or an unused one */
+static
+PENTRY
+ENTRY_pentPopGlobalFreeEntry(VOID)
 {
     ULONG iFirst, iNext, iPrev;
     PENTRY pentFree;
 
-    DPRINT("Enter InterLockedPopFreeEntry\n");
-
     do
     {
         /* Get the index and sequence number of the first free entry */
@@ -400,12 +610,8 @@ ENTRY_pentPopFreeEntry(VOID)
             /* Check if we have unused entries left */
             if (iFirst >= GDI_HANDLE_COUNT)
             {
-                DPRINT1("No more GDI handles left!\n");
-#if DBG_ENABLE_GDIOBJ_BACKTRACES
-                DbgDumpGdiHandleTableWithBT();
-#endif
                 InterlockedDecrement((LONG*)&gulFirstUnused);
-                return 0;
+                return NULL;
             }
 
             /* Return the old entry */
@@ -426,6 +632,39 @@ ENTRY_pentPopFreeEntry(VOID)
     }
     while (iPrev != iFirst);
 
+    return pentFree;
+}
+
+static
+PENTRY
+ENTRY_pentPopFreeEntry(VOID)
+{
+    PENTRY pentFree = NULL;
+    PPROCESSINFO ppi;
+
+    DPRINT("Enter InterLockedPopFreeEntry\n");
+
+    /* Try the entries reserved by the current process first */
+    ppi = ENTRY_ppiFreeEntryCache();
+    if (ppi)
+        pentFree = ENTRY_pentPopProcessFreeEntry(ppi);
+
+    if (!pentFree)
+        pentFree = ENTRY_pentPopGlobalFreeEntry();
+
+    /* Take back what the processes keep for themselves and try again */
+    if (!pentFree && ENTRY_bReclaimFreeEntries())
+        pentFree = ENTRY_pentPopGlobalFreeEntry();
+
+    if (!pentFree)
+    {
+        DPRINT1("No more GDI handles left!\n");
+#if DBG_ENABLE_GDIOBJ_BACKTRACES
+        DbgDumpGdiHandleTableWithBT();
+#endif
+        return NULL;
+    }
+
     /* Sanity check: is entry really free? */
     ASSERT(((ULONG_PTR)pentFree->einfo.pobj & ~GDI_HANDLE_INDEX_MASK) == 0);
 
@@ -438,7 +677,8 @@ static
 VOID
 ENTRY_vPushFreeEntry(PENTRY pentFree)
 {
-    ULONG iToFree, iFirst, iPrev, idxToFree;
+    ULONG idxToFree;
+    PPROCESSINFO ppi;
 
     DPRINT("Enter ENTRY_vPushFreeEntry\n");
 
@@ -454,23 +694,20 @@ ENTRY_vPushFreeEntry(PENTRY pentFree)
     InterlockedExchangeAdd((LONG*)&gpaulRefCount[idxToFree], REF_INC_REUSE);
     pentFree->FullUnique += 0x0100;
 
-    do
+    /* Keep the entry for the current process, if it has room left */
+    ppi = ENTRY_ppiFreeEntryCache();
+    if (!ppi)
     {
-        /* Get the current first free index and sequence number */
-        iFirst = InterlockedReadUlong(&gulFirstFree);
-
-        /* Set the einfo.pobj member to the index of the first free entry */
-        pentFree->einfo.pobj = UlongToPtr(iFirst & GDI_HANDLE_INDEX_MASK);
+        ENTRY_vPushFreeChain(&gulFirstFree, idxToFree, idxToFree);
+        return;
+    }
 
-        /* Combine new index and increased sequence number in iToFree */
-        iToFree = idxToFree | ((iFirst & ~GDI_HANDLE_INDEX_MASK) + 0x10000);
+    ENTRY_vPushFreeChain(&ppi->ulGdiFirstFree, idxToFree, idxToFree);
+    InterlockedIncrement(&gcCachedFreeEntries);
 
-        /* Try to atomically update the first free entry */
-        iPrev = InterlockedCompareExchange((LONG*)&gulFirstFree,
-                                           iToFree,
-                                           iFirst);
-    }
-    while (iPrev != iFirst);
+    /* Too many, return a batch to the global free list */
+    if (InterlockedIncrement(&ppi->cGdiFreeEntries) > GDI_FREE_CACHE_MAX)
+        ENTRY_bReturnFreeBatch(ppi);
 }
 
 static
@@ -1541,6 +1778,17 @@ GDI_MapHandleTable(PEPROCESS pProcess)
     return pvMappedView;
 }
 
+VOID NTAPI
+GDI_InitProcessFreeEntries(PPROCESSINFO ppi)
+{
+    /* Let ENTRY_bReclaimFreeEntries find the entries this process reserves */
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&gplFreeEntryCaches);
+    InsertTailList(&gleFreeEntryCaches, &ppi->leGdiFreeEntries);
+    ExReleasePushLockExclusive(&gplFreeEntryCaches);
+    KeLeaveCriticalRegion();
+}
+
 BOOL NTAPI
 GDI_CleanupForProcess(struct _EPROCESS *Process)
 {
@@ -1573,11 +1821,22 @@ GDI_CleanupForProcess(struct _EPROCESS *Process)
         }
     }
 
+    /* Return the free entries reserved by the process */
+    ppi = PsGetCurrentProcessWin32Process();
+    if (ppi->leGdiFreeEntries.Flink)
+    {
+        KeEnterCriticalRegion();
+        ExAcquirePushLockExclusive(&gplFreeEntryCaches);
+        RemoveEntryList(&ppi->leGdiFreeEntries);
+        ExReleasePushLockExclusive(&gplFreeEntryCaches);
+        KeLeaveCriticalRegion();
+    }
+    while (ENTRY_bReturnFreeBatch(ppi));
+
 #if DBG
     DbgGdiHTIntegrityCheck();
 #endif
 
-    ppi = PsGetCurrentProcessWin32Process();
     DPRINT("Completed cleanup for process %p\n", Process->UniqueProcessId);
     if (ppi->GDIHandleCount != 0)
     {
@@ -198,3 +198,4 @@ BOOL    NTAPI GDIOBJ_ConvertToStockObj(HGDIOBJ *hObj);
 POBJ    NTAPI GDIOBJ_AllocObjWithHandle(ULONG ObjectType, ULONG cjSize);
 PGDIOBJ NTAPI GDIOBJ_ShareLockObj(HGDIOBJ hObj, DWORD ObjectType);
 PVOID   NTAPI GDI_MapHandleTable(PEPROCESS Process);
+VOID    NTAPI GDI_InitProcessFreeEntries(PPROCESSINFO ppi);
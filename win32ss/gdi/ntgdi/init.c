@@ -31,6 +31,7 @@ GdiProcessCreate(PEPROCESS Process)
     /* Map the GDI handle table to user land */
     Process->Peb->GdiSharedHandleTable = GDI_MapHandleTable(Process);
     Process->Peb->GdiDCAttributeList = GDI_BATCH_LIMIT;
+    GDI_InitProcessFreeEntries(ppiCurrent);
 
     /* Create pools for GDI object attributes */
     ppiCurrent->pPoolDcAttr = GdiPoolCreate(sizeof(DC_ATTR), 'acdG');
@@ -963,7 +963,8 @@ REGION_RegionOp(
     PREGION reg2,   /* 2nd region in operation */
     overlapProcp overlapFunc,     /* Function to call for over-lapping bands */
     nonOverlapProcp nonOverlap1Func, /* Function to call for non-overlapping bands in region 1 */
-    nonOverlapProcp nonOverlap2Func)  /* Function to call for non-overlapping bands in region 2 */
+    nonOverlapProcp nonOverlap2Func,  /* Function to call for non-overlapping bands in region 2 */
+    ULONG cRects)     /* Expected number of rectangles in the result */
 {
     RECTL *r1;                         /* Pointer into first region */
     RECTL *r2;                         /* Pointer into 2d region */
@@ -999,9 +1000,14 @@ REGION_RegionOp(
     /* Allocate a reasonable number of rectangles for the new region. The idea
      * is to allocate enough so the individual functions don't need to
      * reallocate and copy the array, which is time consuming, yet we don't
-     * have to worry about using too much memory. I hope to be able to
+     * have to worry about using too much memory. The caller knows the
+     * operation, so it gives us the estimate. I hope to be able to
      * nuke the Xrealloc() at the end of this function eventually. */
-    newReg->rdh.nRgnSize = max(reg1->rdh.nCount + 1, reg2->rdh.nCount) * 2 * sizeof(RECT);
+    if (cRects > MAXULONG / sizeof(RECT))
+    {
+        return FALSE;
+    }
+    newReg->rdh.nRgnSize = max(cRects, 1) * sizeof(RECT);
 
     newReg->Buffer = ExAllocatePoolWithTag(PagedPool,
                                            newReg->rdh.nRgnSize,
@@ -1322,7 +1328,8 @@ REGION_IntersectRegion(
                         reg2,
                         REGION_IntersectO,
                         NULL,
-                        NULL))
+                        NULL,
+                        reg1->rdh.nCount + reg2->rdh.nCount))
             return FALSE;
     }
 
@@ -1544,7 +1551,8 @@ REGION_UnionRegion(
                     reg2,
                     REGION_UnionO,
                     REGION_UnionNonO,
-                    REGION_UnionNonO)))
+                    REGION_UnionNonO,
+                    (reg1->rdh.nCount + reg2->rdh.nCount) * 2)))
     {
     newReg->rdh.rcBound.left = min(reg1->rdh.rcBound.left, reg2->rdh.rcBound.left);
     newReg->rdh.rcBound.top = min(reg1->rdh.rcBound.top, reg2->rdh.rcBound.top);
@@ -1747,7 +1755,8 @@ REGION_SubtractRegion(
                     regS,
                     REGION_SubtractO,
                     REGION_SubtractNonO1,
-                    NULL))
+                    NULL,
+                    (regM->rdh.nCount + regS->rdh.nCount) * 2))
         return FALSE;
 
     /* Can't alter newReg's extents before we call miRegionOp because
@@ -2597,6 +2606,32 @@ IntGdiGetRgnBox(
 }
 
 
+/*
+ * Returns the first rectangle of the band that contains or follows y.
+ * Regions are y-x banded: the bands are sorted from top to bottom and all
+ * rectangles of a band share its top and bottom, so the bottoms never
+ * decrease through the buffer and we can do a binary search on them.
+ */
+static
+PRECTL
+REGION_pFindBand(
+    _In_ PREGION prgn,
+    _In_ LONG y)
+{
+    ULONG iLow = 0, iHigh = prgn->rdh.nCount, iMid;
+
+    while (iLow < iHigh)
+    {
+        iMid = iLow + (iHigh - iLow) / 2;
+        if (prgn->Buffer[iMid].bottom <= y)
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
+    }
+
+    return &prgn->Buffer[iLow];
+}
+
 BOOL
 FASTCALL
 REGION_PtInRegion(
@@ -2604,15 +2639,18 @@ REGION_PtInRegion(
     INT X,
     INT Y)
 {
-    ULONG i;
-    PRECT r;
+    PRECTL prcl, prclEnd;
 
     if (prgn->rdh.nCount > 0 && INRECT(prgn->rdh.rcBound, X, Y))
     {
-        r =  prgn->Buffer;
-        for (i = 0; i < prgn->rdh.nCount; i++)
+        prclEnd = prgn->Buffer + prgn->rdh.nCount;
+
+        /* The rectangles of a band are sorted from left to right */
+        for (prcl = REGION_pFindBand(prgn, Y);
+             (prcl < prclEnd) && (prcl->top <= Y) && (prcl->left <= X);
+             prcl++)
         {
-            if (INRECT(r[i], X, Y))
+            if (prcl->right > X)
                 return TRUE;
         }
     }
@@ -2656,7 +2694,8 @@ REGION_RectInRegion(
     /* This is (just) a useful optimization */
     if ((Rgn->rdh.nCount > 0) && EXTENTCHECK(&Rgn->rdh.rcBound, &rc))
     {
-        for (pCurRect = Rgn->Buffer, pRectEnd = pCurRect +
+        /* Skip the bands above the rectangle */
+        for (pCurRect = REGION_pFindBand(Rgn, rc.top), pRectEnd = Rgn->Buffer +
                                                 Rgn->rdh.nCount; pCurRect < pRectEnd; pCurRect++)
         {
             if (pCurRect->bottom <= rc.top)
@@ -721,6 +721,7 @@ typedef struct _WND
     UINT InternalPosInitialized:1;
     UINT HideFocus:1; /* WS_EX_UISTATEFOCUSRECTHIDDEN ? */
     UINT HideAccel:1; /* WS_EX_UISTATEKBACCELHIDDEN ? */
+    UINT DirtyChildren:1; /* Some descendant may have something to paint */
 
     /* Scrollbar info */
     PSBINFOEX pSBInfoex; // convert to PSBINFO
@@ -1189,6 +1189,7 @@ IntDefWindowProc(
              {
                 IntSetStyle( Wnd, WS_VISIBLE, 0 );
                 Wnd->state |= WNDS_SENDNCPAINT;
+                IntSetDirtyParents(Wnd);
              }
           }
           else
@@ -989,6 +989,7 @@ DriverEntry(
 
     NT_ROF(InitBrushImpl());
     NT_ROF(InitPDEVImpl());
+    NT_ROF(InitTileImpl());
     NT_ROF(InitLDEVImpl());
     NT_ROF(InitDeviceImpl());
     NT_ROF(InitDcImpl());
@@ -14,6 +14,81 @@ BOOL UserExtTextOutW(HDC hdc, INT x, INT y, UINT flags, PRECTL lprc,
 
 /* PRIVATE FUNCTIONS **********************************************************/
 
+/*
+ * Dirty state tracking
+ *
+ * A window that has an update region or one of the paint flags set marks
+ * all of its parents with DirtyChildren. The painting walks skip children
+ * of windows without it. The mark is only cleared by a walk that has seen
+ * all children of a window, and none of them has something to paint or a
+ * mark of its own.
+ */
+
+BOOL FASTCALL
+IntHasPendingPaint(PWND Wnd)
+{
+   return Wnd->hrgnUpdate != NULL ||
+          (Wnd->state & (WNDS_INTERNALPAINT|WNDS_SENDNCPAINT|WNDS_SENDERASEBACKGROUND));
+}
+
+VOID FASTCALL
+IntSetDirtyParents(PWND Wnd)
+{
+   for (Wnd = Wnd->spwndParent; Wnd && !Wnd->DirtyChildren; Wnd = Wnd->spwndParent)
+   {
+      Wnd->DirtyChildren = TRUE;
+   }
+}
+
+static
+VOID
+IntCheckDirtyChildren(PWND Wnd)
+{
+   PWND Child;
+
+   for (Child = Wnd->spwndChild; Child; Child = Child->spwndNext)
+   {
+      if (Child->DirtyChildren || IntHasPendingPaint(Child))
+         return;
+   }
+
+   Wnd->DirtyChildren = FALSE;
+}
+
+/*
+ * Clips a region to a rectangle. Rectangular regions, which most
+ * invalidations use, are clipped without a temporary region.
+ */
+static
+INT
+IntClipRgnToRect(PREGION Rgn, const RECTL *prcl)
+{
+   PREGION RgnRect;
+   RECTL rcl;
+   INT RgnType = NULLREGION;
+
+   if (Rgn->rdh.nCount <= 1)
+   {
+      if (Rgn->rdh.nCount == 0 || !RECTL_bIntersectRect(&rcl, &Rgn->rdh.rcBound, prcl))
+      {
+         REGION_SetRectRgn(Rgn, 0, 0, 0, 0);
+         return NULLREGION;
+      }
+
+      REGION_SetRectRgn(Rgn, rcl.left, rcl.top, rcl.right, rcl.bottom);
+      return SIMPLEREGION;
+   }
+
+   RgnRect = IntSysCreateRectpRgnIndirect(prcl);
+   if (RgnRect)
+   {
+      RgnType = IntGdiCombineRgn(Rgn, Rgn, RgnRect, RGN_AND);
+      REGION_Delete(RgnRect);
+   }
+
+   return RgnType;
+}
+
 /**
  * @name IntIntersectWithParents
  *
@@ -445,6 +520,7 @@ co_IntPaintWindows(PWND Wnd, ULONG Flags, BOOL Recurse)
                   if (!co_IntSendMessage(hWnd, WM_ERASEBKGND, (WPARAM)hDC, 0))
                   {
                      Wnd->state |= (WNDS_SENDERASEBACKGROUND|WNDS_ERASEBACKGROUND);
+                     IntSetDirtyParents(Wnd);
                   }
                   UserReleaseDC(Wnd, hDC, FALSE);
                }
@@ -468,31 +544,37 @@ co_IntPaintWindows(PWND Wnd, ULONG Flags, BOOL Recurse)
 
    if (!(Flags & RDW_NOCHILDREN) &&
        !(Wnd->style & WS_MINIMIZE) &&
+       Wnd->DirtyChildren &&
         ( Flags & RDW_ALLCHILDREN ||
          (Flags & RDW_CLIPCHILDREN && Wnd->style & WS_CLIPCHILDREN) ) )
    {
       HWND *List, *phWnd;
+      PWND Child;
       PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
 
       if ((List = IntWinListChildren(Wnd)))
       {
          for (phWnd = List; *phWnd; ++phWnd)
          {
-            if ((Wnd = UserGetWindowObject(*phWnd)) == NULL)
+            if ((Child = UserGetWindowObject(*phWnd)) == NULL)
                continue;
 
-            if (Wnd->head.pti != pti && Wnd->style & WS_CHILD)
+            if (Child->head.pti != pti && Child->style & WS_CHILD)
                continue;
 
-            if (Wnd->style & WS_VISIBLE)
+            if (Child->style & WS_VISIBLE &&
+                (Child->DirtyChildren || IntHasPendingPaint(Child)))
             {
                USER_REFERENCE_ENTRY Ref;
-               UserRefObjectCo(Wnd, &Ref);
-               co_IntPaintWindows(Wnd, Flags, TRUE);
-               UserDerefObjectCo(Wnd);
+               UserRefObjectCo(Child, &Ref);
+               co_IntPaintWindows(Child, Flags, TRUE);
+               UserDerefObjectCo(Child);
             }
          }
          ExFreePoolWithTag(List, USERTAG_WINDOWLIST);
+
+         if (IntIsWindow(hWnd))
+            IntCheckDirtyChildren(Wnd);
       }
    }
 }
@@ -550,12 +632,21 @@ co_IntUpdateWindows(PWND Wnd, ULONG Flags, BOOL Recurse)
 
    if (!(Flags & RDW_NOCHILDREN)  && 
         (Flags & RDW_ALLCHILDREN) &&
+        Wnd->DirtyChildren &&
         !UserIsDesktopWindow(Wnd))
    {
       PWND Child;
 
       for (Child = Wnd->spwndChild; Child; Child = Child->spwndNext)
       {
+         /* Nothing to paint in this subtree */
+         if (!Child->DirtyChildren &&
+             Child->hrgnUpdate == NULL &&
+             !(Child->state & WNDS_INTERNALPAINT))
+         {
+            continue;
+         }
+
          /* transparent window, check for non-transparent sibling to paint first, then skip it */
          if ( Child->ExStyle & WS_EX_TRANSPARENT &&
              ( Child->hrgnUpdate != NULL || Child->state & WNDS_INTERNALPAINT ) )
@@ -579,6 +670,8 @@ co_IntUpdateWindows(PWND Wnd, ULONG Flags, BOOL Recurse)
              UserDerefObjectCo(Child);
          }
       }
+
+      IntCheckDirtyChildren(Wnd);
    }
 }
 
@@ -642,14 +735,7 @@ IntInvalidateWindows(PWND Wnd, PREGION Rgn, ULONG Flags)
        */
       if ((Flags & RDW_INVALIDATE) != 0 && (Flags & RDW_FRAME) == 0)
       {
-         PREGION RgnClient;
-
-         RgnClient = IntSysCreateRectpRgnIndirect(&Wnd->rcClient);
-         if (RgnClient)
-         {
-             RgnType = IntGdiCombineRgn(Rgn, Rgn, RgnClient, RGN_AND);
-             REGION_Delete(RgnClient);
-         }
+         RgnType = IntClipRgnToRect(Rgn, &Wnd->rcClient);
       }
 
       /*
@@ -658,12 +744,7 @@ IntInvalidateWindows(PWND Wnd, PREGION Rgn, ULONG Flags)
 
       if (!Wnd->hrgnClip || (Wnd->style & WS_MINIMIZE))
       {
-         PREGION RgnWindow = IntSysCreateRectpRgnIndirect(&Wnd->rcWindow);
-         if (RgnWindow)
-         {
-             RgnType = IntGdiCombineRgn(Rgn, Rgn, RgnWindow, RGN_AND);
-             REGION_Delete(RgnWindow);
-         }
+         RgnType = IntClipRgnToRect(Rgn, &Wnd->rcWindow);
       }
       else
       {
@@ -807,6 +888,11 @@ IntInvalidateWindows(PWND Wnd, PREGION Rgn, ULONG Flags)
       }
    }
 
+   if (IntHasPendingPaint(Wnd))
+   {
+      IntSetDirtyParents(Wnd);
+   }
+
    /*
     * Process children if needed
     */
@@ -816,9 +902,26 @@ IntInvalidateWindows(PWND Wnd, PREGION Rgn, ULONG Flags)
          ((Flags & RDW_ALLCHILDREN) || !(Wnd->style & WS_CLIPCHILDREN)))
    { 
       PWND Child;
+      RECTL rcl;
 
       for (Child = Wnd->spwndChild; Child; Child = Child->spwndNext)
       {
+         if (Flags & (RDW_INVALIDATE|RDW_INTERNALPAINT|RDW_ERASE|RDW_FRAME))
+         {
+            /* Children outside of the region are left alone */
+            if (Rgn > PRGN_WINDOW &&
+                !(Flags & RDW_INTERNALPAINT) &&
+                !RECTL_bIntersectRect(&rcl, &Rgn->rdh.rcBound, &Child->rcWindow))
+            {
+               continue;
+            }
+         }
+         else if (!Child->DirtyChildren && !IntHasPendingPaint(Child))
+         {
+            /* Nothing to validate in a clean subtree */
+            continue;
+         }
+
          if (Child->style & WS_VISIBLE)
          {
             /*
@@ -1055,6 +1158,7 @@ PaintSuspendedWindow(PWND pwnd, HRGN hrgnOrig)
 
       // Set updates for this window.
       pwnd->state |= WNDS_SENDNCPAINT|WNDS_SENDERASEBACKGROUND|WNDS_UPDATEDIRTY;
+      IntSetDirtyParents(pwnd);
 
       // DCX_KEEPCLIPRGN is set. Check it anyway.
       if (hrgnTemp > HRGN_WINDOW && GreIsHandleValid(hrgnTemp)) GreDeleteObject(hrgnTemp);
@@ -1148,11 +1252,14 @@ IntFindWindowToRepaint(PWND Window, PTHREADINFO Thread)
          }
       }
       /* find a child of the specified window that needs repainting */
-      if (Window->spwndChild)
+      if (Window->spwndChild && Window->DirtyChildren)
       {
          hChild = IntFindWindowToRepaint(Window->spwndChild, Thread);
          if (hChild != NULL)
             return hChild;
+
+         /* All of the children have been searched */
+         IntCheckDirtyChildren(Window);
       }
    }
    return Window;
@@ -1502,6 +1609,7 @@ IntBeginPaint(PWND Window, PPAINTSTRUCT Ps)
       if ( Ps->fErase )
       {
          Window->state |= (WNDS_SENDERASEBACKGROUND|WNDS_ERASEBACKGROUND);
+         IntSetDirtyParents(Window);
       }
    }
    else
@@ -283,6 +283,9 @@ typedef struct _PROCESSINFO
     struct _GDI_POOL* pPoolDcAttr;
     struct _GDI_POOL* pPoolBrushAttr;
     struct _GDI_POOL* pPoolRgnAttr;
+    volatile ULONG ulGdiFirstFree;   /* Free GDI handle entries reserved for this process */
+    volatile LONG cGdiFreeEntries;
+    LIST_ENTRY leGdiFreeEntries;     /* Link in the list of processes reserving entries */
 
 #if DBG
     BYTE DbgChannelLevel[DbgChCount];
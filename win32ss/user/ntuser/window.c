@@ -929,6 +929,12 @@ IntLinkWindow(
 
         Wnd->spwndParent->spwndChild = Wnd;
     }
+
+    /* Let the painting walks find what is left to paint in the new place */
+    if (Wnd->DirtyChildren || IntHasPendingPaint(Wnd))
+    {
+        IntSetDirtyParents(Wnd);
+    }
 }
 
 /*
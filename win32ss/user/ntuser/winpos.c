@@ -1703,6 +1703,7 @@ ForceNCPaintErase(PWND Wnd, HRGN hRgn, PREGION pRgn)
       if (!co_IntSendMessage(UserHMGetHandle(Wnd), WM_ERASEBKGND, (WPARAM)hDC, 0))
       {
           Wnd->state |= (WNDS_SENDERASEBACKGROUND|WNDS_ERASEBACKGROUND);
+          IntSetDirtyParents(Wnd);
       }
       UserReleaseDC(Wnd, hDC, FALSE);
    }
@@ -1942,6 +1943,7 @@ co_WinPosSetWindowPos(
    {
       TRACE("Set WNDS_SENDNCPAINT %p\n",Window);
       Window->state |= WNDS_SENDNCPAINT;
+      IntSetDirtyParents(Window);
    }
 
    if (!(WinPos.flags & SWP_NOREDRAW))
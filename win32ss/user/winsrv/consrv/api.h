@@ -106,6 +106,7 @@ CSR_API(SrvInvalidateBitMapRect);
 CSR_API(SrvSetConsolePalette);
 CSR_API(SrvReadConsoleOutput);
 CSR_API(SrvWriteConsole);
+CSR_API(SrvMapConsoleOutputBuffer);
 CSR_API(SrvWriteConsoleOutput);
 CSR_API(SrvReadConsoleOutputString);
 CSR_API(SrvWriteConsoleOutputString);
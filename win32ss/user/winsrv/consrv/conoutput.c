@@ -412,13 +412,14 @@ DoWriteConsole(IN PCSR_API_MESSAGE ApiMessage,
 {
     NTSTATUS Status;
     PCONSOLE_WRITECONSOLE WriteConsoleRequest = &((PCONSOLE_API_MESSAGE)ApiMessage)->Data.WriteConsoleRequest;
+    PCONSOLE_PROCESS_DATA ProcessData = ConsoleGetPerProcessData(ClientThread->Process);
     PTEXTMODE_SCREEN_BUFFER ScreenBuffer;
 
-    PVOID Buffer;
+    PVOID Buffer, BufferCopy = NULL;
     ULONG NrCharactersWritten = 0;
     ULONG CharSize = (WriteConsoleRequest->Unicode ? sizeof(WCHAR) : sizeof(CHAR));
 
-    Status = ConSrvGetTextModeBuffer(ConsoleGetPerProcessData(ClientThread->Process),
+    Status = ConSrvGetTextModeBuffer(ProcessData,
                                      WriteConsoleRequest->OutputHandle,
                                      &ScreenBuffer, GENERIC_WRITE, FALSE);
     if (!NT_SUCCESS(Status)) return Status;
@@ -442,6 +443,24 @@ DoWriteConsole(IN PCSR_API_MESSAGE ApiMessage,
     else
     {
         Buffer = WriteConsoleRequest->Buffer;
+
+        /*
+         * The client can still write to the output buffer we share with it,
+         * so work on a copy that does not change while it is being parsed.
+         */
+        if (ProcessData->OutputBufferServerView != NULL &&
+            (ULONG_PTR)Buffer - (ULONG_PTR)ProcessData->OutputBufferServerView < CONSOLE_OUTPUT_BUFFER_SIZE)
+        {
+            BufferCopy = ConsoleAllocHeap(0, WriteConsoleRequest->NumBytes);
+            if (BufferCopy == NULL)
+            {
+                Status = STATUS_NO_MEMORY;
+                goto Quit;
+            }
+
+            RtlCopyMemory(BufferCopy, Buffer, WriteConsoleRequest->NumBytes);
+            Buffer = BufferCopy;
+        }
     }
 
     DPRINT("Calling ConDrvWriteConsole\n");
@@ -482,6 +501,7 @@ DoWriteConsole(IN PCSR_API_MESSAGE ApiMessage,
     }
 
 Quit:
+    if (BufferCopy) ConsoleFreeHeap(BufferCopy);
     ConSrvReleaseScreenBuffer(ScreenBuffer, FALSE);
     return Status;
 }
@@ -682,6 +702,24 @@ CON_API(SrvWriteConsole,
          */
         // WriteConsoleRequest->Buffer = WriteConsoleRequest->StaticBuffer;
     }
+    else if (ApiMessage->CsrCaptureData == NULL &&
+             ProcessData->OutputBufferServerView != NULL)
+    {
+        /*
+         * Without a capture buffer, the string is in the output buffer
+         * we share with the client. Translate it to our view of it.
+         */
+        ULONG_PTR Offset = (ULONG_PTR)WriteConsoleRequest->Buffer -
+                           (ULONG_PTR)ProcessData->OutputBufferClientView;
+
+        if (Offset > CONSOLE_OUTPUT_BUFFER_SIZE ||
+            WriteConsoleRequest->NumBytes > CONSOLE_OUTPUT_BUFFER_SIZE - Offset)
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        WriteConsoleRequest->Buffer = (PVOID)((ULONG_PTR)ProcessData->OutputBufferServerView + Offset);
+    }
     else
     {
         if (!CsrValidateMessageBuffer(ApiMessage,
@@ -700,6 +738,89 @@ CON_API(SrvWriteConsole,
     return Status;
 }
 
+/*
+ * Maps the output buffer shared with the client process (ReactOS-specific).
+ * The client copies its larger WriteConsole strings there, which saves the
+ * capture buffer allocations and copies on both sides, and lifts the limit
+ * the size of the CSR port heap puts on a single write.
+ */
+/* API_NUMBER: ConsolepMapOutputBuffer */
+CON_API_NOCONSOLE(SrvMapConsoleOutputBuffer,
+                  CONSOLE_MAPOUTPUTBUFFER, MapOutputBufferRequest)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+    HANDLE SectionHandle;
+    LARGE_INTEGER SectionSize;
+    PVOID ServerView = NULL, ClientView = NULL;
+    SIZE_T ViewSize;
+
+    DPRINT("SrvMapConsoleOutputBuffer\n");
+
+    RtlEnterCriticalSection(&ProcessData->HandleTableLock);
+
+    if (ProcessData->OutputBufferServerView == NULL)
+    {
+        SectionSize.QuadPart = CONSOLE_OUTPUT_BUFFER_SIZE;
+        Status = NtCreateSection(&SectionHandle,
+                                 SECTION_ALL_ACCESS,
+                                 NULL,
+                                 &SectionSize,
+                                 PAGE_READWRITE,
+                                 SEC_COMMIT,
+                                 NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Cannot create the output buffer section, Status = 0x%08lx\n", Status);
+            goto Quit;
+        }
+
+        ViewSize = 0;
+        Status = NtMapViewOfSection(SectionHandle,
+                                   NtCurrentProcess(),
+                                   &ServerView,
+                                   0,
+                                   0,
+                                   NULL,
+                                   &ViewSize,
+                                   ViewUnmap,
+                                   0,
+                                   PAGE_READWRITE);
+        if (NT_SUCCESS(Status))
+        {
+            ViewSize = 0;
+            Status = NtMapViewOfSection(SectionHandle,
+                                       ProcessData->Process->ProcessHandle,
+                                       &ClientView,
+                                       0,
+                                       0,
+                                       NULL,
+                                       &ViewSize,
+                                       ViewUnmap,
+                                       0,
+                                       PAGE_READWRITE);
+            if (!NT_SUCCESS(Status))
+                NtUnmapViewOfSection(NtCurrentProcess(), ServerView);
+        }
+        NtClose(SectionHandle);
+
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Cannot map the output buffer, Status = 0x%08lx\n", Status);
+            goto Quit;
+        }
+
+        ProcessData->OutputBufferServerView = ServerView;
+        ProcessData->OutputBufferClientView = ClientView;
+    }
+
+    MapOutputBufferRequest->Buffer = ProcessData->OutputBufferClientView;
+    MapOutputBufferRequest->Size   = CONSOLE_OUTPUT_BUFFER_SIZE;
+
+Quit:
+    RtlLeaveCriticalSection(&ProcessData->HandleTableLock);
+    return Status;
+}
+
 NTSTATUS NTAPI
 ConDrvReadConsoleOutputString(IN PCONSOLE Console,
                               IN PTEXTMODE_SCREEN_BUFFER Buffer,
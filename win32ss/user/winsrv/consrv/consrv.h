@@ -49,6 +49,9 @@ typedef struct _CONSOLE_PROCESS_DATA
     ULONG HandleTableSize;
     struct _CONSOLE_IO_HANDLE* /* PCONSOLE_IO_HANDLE */ HandleTable; // Length-varying table
 
+    PVOID OutputBufferServerView;   // Output buffer shared with the process,
+    PVOID OutputBufferClientView;   // see SrvMapConsoleOutputBuffer.
+
     LPTHREAD_START_ROUTINE CtrlRoutine;
     LPTHREAD_START_ROUTINE PropRoutine; // We hold the property dialog handler there, till all the GUI thingie moves out from CSRSS.
     // LPTHREAD_START_ROUTINE ImeRoutine;
@@ -981,6 +981,17 @@ OnPaint(PGUI_CONSOLE_DATA GuiData)
     /* Do nothing if the window is hidden */
     if (!GuiData->IsWindowVisible) return;
 
+    /*
+     * Scroll the window before painting anything, so that freshly painted
+     * cells are not moved by the pending scroll later on.
+     */
+    if (GuiData->FrameScrolledLines != 0 &&
+        ConDrvValidateConsoleUnsafe((PCONSOLE)GuiData->Console, CONSOLE_RUNNING, TRUE))
+    {
+        GuiFlushPendingFrame(GuiData);
+        LeaveCriticalSection(&GuiData->Console->Lock);
+    }
+
     BeginPaint(GuiData->hWindow, &ps);
     if (ps.hdc != NULL &&
         ps.rcPaint.left < ps.rcPaint.right &&
@@ -1251,6 +1262,9 @@ OnTimer(PGUI_CONSOLE_DATA GuiData)
 
     if (!ConDrvValidateConsoleUnsafe((PCONSOLE)Console, CONSOLE_RUNNING, TRUE)) return;
 
+    /* Paint the stream output written since the last frame */
+    GuiFlushPendingFrame(GuiData);
+
     Buff = GuiData->ActiveBuffer;
 
     if (GetType(Buff) == TEXTMODE_BUFFER)
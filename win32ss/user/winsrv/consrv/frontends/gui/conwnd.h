@@ -94,4 +94,8 @@ typedef struct _GUI_CONSOLE_DATA
     BOOL  LineSelection;                    /* TRUE if line-oriented selection (a la *nix terminals), FALSE if block-oriented selection (default on Windows) */
 
     GUI_CONSOLE_INFO GuiInfo;   /* GUI terminal settings */
+
+    BOOLEAN IsFramePending;     /* TRUE if stream output waits for the next frame */
+    UINT FrameScrolledLines;    /* Lines scrolled since the last frame            */
+    SMALL_RECT FrameRegion;     /* Cells written since the last frame             */
 } GUI_CONSOLE_DATA, *PGUI_CONSOLE_DATA;
@@ -20,9 +20,9 @@
 #include "guiterm.h"
 #include "resource.h"
 
-// HACK!! Remove it when the hack in GuiWriteStream is fixed
-#define CONGUI_UPDATE_TIME    0
 #define CONGUI_UPDATE_TIMER   1
+/* Stream output is painted at most once per frame */
+#define CONGUI_FRAME_TIME     20
 
 #define PM_CREATE_CONSOLE     (WM_APP + 1)
 #define PM_DESTROY_CONSOLE    (WM_APP + 2)
@@ -84,11 +84,51 @@ DrawRegion(PGUI_CONSOLE_DATA GuiData,
     /**UpdateWindow(GuiData->hWindow);**/
 }
 
+/*
+ * Scrolls the window and invalidates what GuiWriteStream accumulated
+ * since the last frame. The console must be locked.
+ */
+VOID
+GuiFlushPendingFrame(PGUI_CONSOLE_DATA GuiData)
+{
+    PCONSOLE_SCREEN_BUFFER Buff = GuiData->ActiveBuffer;
+    UINT ScrolledLines = GuiData->FrameScrolledLines;
+    RECT ScrollRect;
+
+    if (!GuiData->IsFramePending) return;
+    GuiData->IsFramePending = FALSE;
+    GuiData->FrameScrolledLines = 0;
+
+    if (Buff == NULL || GetType(Buff) != TEXTMODE_BUFFER) return;
+
+    if (0 != ScrolledLines)
+    {
+        ScrollRect.left = 0;
+        ScrollRect.top = 0;
+        ScrollRect.right = Buff->ViewSize.X * GuiData->CharWidth;
+        ScrollRect.bottom = GuiData->FrameRegion.Top * GuiData->CharHeight;
+
+        ScrollWindowEx(GuiData->hWindow,
+                       0,
+                       -(int)(ScrolledLines * GuiData->CharHeight),
+                       &ScrollRect,
+                       NULL,
+                       NULL,
+                       NULL,
+                       SW_INVALIDATE);
+    }
+
+    DrawRegion(GuiData, &GuiData->FrameRegion);
+}
+
 VOID
 InvalidateCell(PGUI_CONSOLE_DATA GuiData,
                SHORT x, SHORT y)
 {
     SMALL_RECT CellRect = { x, y, x, y };
+
+    /* A pending scroll would move the cell away */
+    if (GuiData->FrameScrolledLines != 0) GuiFlushPendingFrame(GuiData);
     DrawRegion(GuiData, &CellRect);
 }
 
@@ -634,6 +674,7 @@ GuiDrawRegion(IN OUT PFRONTEND This,
     /* Do nothing if the window is hidden */
     if (!GuiData->IsWindowVisible) return;
 
+    if (GuiData->FrameScrolledLines != 0) GuiFlushPendingFrame(GuiData);
     DrawRegion(GuiData, Region);
 }
 
@@ -648,8 +689,7 @@ GuiWriteStream(IN OUT PFRONTEND This,
 {
     PGUI_CONSOLE_DATA GuiData = This->Context;
     PCONSOLE_SCREEN_BUFFER Buff;
-    SHORT CursorEndX, CursorEndY;
-    RECT ScrollRect;
+    PSMALL_RECT FrameRegion = &GuiData->FrameRegion;
 
     if (NULL == GuiData || NULL == GuiData->hWindow) return;
 
@@ -659,45 +699,39 @@ GuiWriteStream(IN OUT PFRONTEND This,
     Buff = GuiData->ActiveBuffer;
     if (GetType(Buff) != TEXTMODE_BUFFER) return;
 
-    if (0 != ScrolledLines)
+    /*
+     * Coalesce the output into one region and one scroll per frame, so that
+     * large outputs do not repaint the window for every line. The region of
+     * the previous writes moves up with the lines scrolled since then.
+     */
+    if (GuiData->IsFramePending)
     {
-        ScrollRect.left = 0;
-        ScrollRect.top = 0;
-        ScrollRect.right = Buff->ViewSize.X * GuiData->CharWidth;
-        ScrollRect.bottom = Region->Top * GuiData->CharHeight;
-
-        ScrollWindowEx(GuiData->hWindow,
-                       0,
-                       -(int)(ScrolledLines * GuiData->CharHeight),
-                       &ScrollRect,
-                       NULL,
-                       NULL,
-                       NULL,
-                       SW_INVALIDATE);
+        FrameRegion->Top    = (SHORT)max((LONG)FrameRegion->Top    - (LONG)ScrolledLines, 0);
+        FrameRegion->Bottom = (SHORT)max((LONG)FrameRegion->Bottom - (LONG)ScrolledLines, 0);
+        FrameRegion->Left   = min(FrameRegion->Left  , Region->Left  );
+        FrameRegion->Top    = min(FrameRegion->Top   , Region->Top   );
+        FrameRegion->Right  = max(FrameRegion->Right , Region->Right );
+        FrameRegion->Bottom = max(FrameRegion->Bottom, Region->Bottom);
+        GuiData->FrameScrolledLines = min(GuiData->FrameScrolledLines + ScrolledLines,
+                                          (UINT)Buff->ScreenBufferSize.Y);
     }
-
-    DrawRegion(GuiData, Region);
-
-    if (CursorStartX < Region->Left || Region->Right < CursorStartX
-            || CursorStartY < Region->Top || Region->Bottom < CursorStartY)
+    else
     {
-        InvalidateCell(GuiData, CursorStartX, CursorStartY);
-    }
+        *FrameRegion = *Region;
+        GuiData->FrameScrolledLines = ScrolledLines;
+        GuiData->IsFramePending = TRUE;
 
-    CursorEndX = Buff->CursorPosition.X;
-    CursorEndY = Buff->CursorPosition.Y;
-    if ((CursorEndX < Region->Left || Region->Right < CursorEndX
-            || CursorEndY < Region->Top || Region->Bottom < CursorEndY)
-            && (CursorEndX != CursorStartX || CursorEndY != CursorStartY))
-    {
-        InvalidateCell(GuiData, CursorEndX, CursorEndY);
+        /* The update timer paints the frame, see OnTimer */
+        SetTimer(GuiData->hWindow, CONGUI_UPDATE_TIMER, CONGUI_FRAME_TIME, NULL);
     }
 
-    // HACK!!
-    // Set up the update timer (very short interval) - this is a "hack" for getting the OS to
-    // repaint the window without having it just freeze up and stay on the screen permanently.
+    /* The old and new caret cells are repainted with the frame */
+    FrameRegion->Left   = min(FrameRegion->Left  , min(CursorStartX, Buff->CursorPosition.X));
+    FrameRegion->Top    = min(FrameRegion->Top   , min(CursorStartY, Buff->CursorPosition.Y));
+    FrameRegion->Right  = max(FrameRegion->Right , max(CursorStartX, Buff->CursorPosition.X));
+    FrameRegion->Bottom = max(FrameRegion->Bottom, max(CursorStartY, Buff->CursorPosition.Y));
+
     Buff->CursorBlinkOn = TRUE;
-    SetTimer(GuiData->hWindow, CONGUI_UPDATE_TIMER, CONGUI_UPDATE_TIME, NULL);
 }
 
 /* static */ VOID NTAPI
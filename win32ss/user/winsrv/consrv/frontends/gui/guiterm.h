@@ -60,6 +60,8 @@ SmallRectToRect(PGUI_CONSOLE_DATA GuiData, PRECT Rect, PSMALL_RECT SmallRect)
 
 VOID
 GuiConsoleMoveWindow(PGUI_CONSOLE_DATA GuiData);
+VOID
+GuiFlushPendingFrame(PGUI_CONSOLE_DATA GuiData);
 
 
 /* conwnd.c */
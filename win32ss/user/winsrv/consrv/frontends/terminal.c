@@ -499,6 +499,93 @@ ConioNextLine(PTEXTMODE_SCREEN_BUFFER Buff, PSMALL_RECT UpdateRect, PUINT Scroll
     UpdateRect->Bottom = Buff->CursorPosition.Y;
 }
 
+/*
+ * Returns how many characters from Buffer can be written as they are on
+ * the current line: no control characters in processed mode, and no
+ * full-width characters.
+ */
+static UINT
+ConioGetPlainRun(PTEXTMODE_SCREEN_BUFFER Buff,
+                 PWCHAR Buffer,
+                 UINT Length,
+                 BOOLEAN bCJK)
+{
+    BOOLEAN bProcessed = !!(Buff->Mode & ENABLE_PROCESSED_OUTPUT);
+    UINT Run, MaxRun;
+    WCHAR Char;
+
+    MaxRun = min(Length, (UINT)(Buff->ScreenBufferSize.X - Buff->CursorPosition.X));
+    for (Run = 0; Run < MaxRun; Run++)
+    {
+        Char = Buffer[Run];
+        if (bProcessed && (Char == L'\r' || Char == L'\n' || Char == L'\b' ||
+                           Char == L'\t' || Char == L'\a'))
+        {
+            break;
+        }
+        if (bCJK && IS_FULL_WIDTH(Char))
+            break;
+    }
+
+    return Run;
+}
+
+/*
+ * Writes a run found by ConioGetPlainRun at the cursor position. A line
+ * is contiguous in the screen buffer, so the cells are filled in one go.
+ */
+static VOID
+ConioWritePlainRun(PTEXTMODE_SCREEN_BUFFER Buff,
+                   PWCHAR Buffer,
+                   UINT Run,
+                   BOOL Attrib)
+{
+    PCHAR_INFO Ptr;
+    WORD Attribute = Buff->ScreenDefaultAttrib & ~COMMON_LVB_SBCSDBCS;
+    UINT j;
+
+    Ptr = ConioCoordToPointer(Buff, Buff->CursorPosition.X, Buff->CursorPosition.Y);
+
+    /* Kill the leading byte of a full-width character we start in the middle of */
+    if ((Ptr->Attributes & COMMON_LVB_TRAILING_BYTE) && Buff->CursorPosition.X > 0)
+    {
+        Ptr[-1].Char.UnicodeChar = L' ';
+        if (Attrib)
+            Ptr[-1].Attributes = Buff->ScreenDefaultAttrib;
+        Ptr[-1].Attributes &= ~COMMON_LVB_SBCSDBCS;
+    }
+
+    if (Attrib)
+    {
+        for (j = 0; j < Run; j++)
+        {
+            Ptr[j].Char.UnicodeChar = Buffer[j];
+            Ptr[j].Attributes = Attribute;
+        }
+    }
+    else
+    {
+        for (j = 0; j < Run; j++)
+        {
+            Ptr[j].Char.UnicodeChar = Buffer[j];
+            Ptr[j].Attributes &= ~COMMON_LVB_SBCSDBCS;
+        }
+    }
+
+    Buff->CursorPosition.X += Run;
+    Ptr += Run;
+
+    /* If the following cell is the trailing byte of a full-width character, reset it */
+    if (Buff->CursorPosition.X < Buff->ScreenBufferSize.X &&
+        (Ptr->Attributes & COMMON_LVB_TRAILING_BYTE))
+    {
+        Ptr->Char.UnicodeChar = L' ';
+        if (Attrib)
+            Ptr->Attributes = Buff->ScreenDefaultAttrib;
+        Ptr->Attributes &= ~COMMON_LVB_SBCSDBCS;
+    }
+}
+
 static NTSTATUS
 ConioWriteConsole(PFRONTEND FrontEnd,
                   PTEXTMODE_SCREEN_BUFFER Buff,
@@ -508,7 +595,7 @@ ConioWriteConsole(PFRONTEND FrontEnd,
 {
     PCONSRV_CONSOLE Console = FrontEnd->Console;
 
-    UINT i;
+    UINT i, Run;
     PCHAR_INFO Ptr;
     SMALL_RECT UpdateRect;
     SHORT CursorStartX, CursorStartY;
@@ -696,6 +783,34 @@ ConioWriteConsole(PFRONTEND FrontEnd,
                 continue;
             }
         }
+
+        /* Fast path for runs of plain characters, as found in build logs and text files */
+        Run = ConioGetPlainRun(Buff, &Buffer[i], Length - i, bCJK);
+        if (Run > 1)
+        {
+            UpdateRect.Left = min(UpdateRect.Left, Buff->CursorPosition.X);
+            ConioWritePlainRun(Buff, &Buffer[i], Run, Attrib);
+            UpdateRect.Right = max(UpdateRect.Right, Buff->CursorPosition.X - 1);
+            i += Run - 1;
+
+            if (Buff->CursorPosition.X >= Buff->ScreenBufferSize.X)
+            {
+                if (Buff->Mode & ENABLE_WRAP_AT_EOL_OUTPUT)
+                {
+                    /* Wrapping mode: Go to next line */
+                    Buff->CursorPosition.X = 0;
+                    CursorStartX = Buff->CursorPosition.X;
+                    ConioNextLine(Buff, &UpdateRect, &ScrolledLines);
+                }
+                else
+                {
+                    /* The cursor wraps back to its starting position on the same line */
+                    Buff->CursorPosition.X = CursorStartX;
+                }
+            }
+            continue;
+        }
+
         UpdateRect.Left  = min(UpdateRect.Left , Buff->CursorPosition.X);
         UpdateRect.Right = max(UpdateRect.Right, Buff->CursorPosition.X);
 
@@ -118,6 +118,8 @@ PCSR_API_ROUTINE ConsoleServerApiDispatchTable[ConsolepMaxApiNumber - CONSRV_FIR
     // SrvSetConsoleCurrentFont,               // Added in Vista+
     // SrvSetScreenBufferInfo,                 // Added in Vista+
     // SrvConsoleClientConnect,                // Added in Win7
+
+    SrvMapConsoleOutputBuffer,              // ReactOS-specific
 };
 
 BOOLEAN ConsoleServerApiServerValidTable[ConsolepMaxApiNumber - CONSRV_FIRST_API_NUMBER] =
@@ -214,6 +216,8 @@ BOOLEAN ConsoleServerApiServerValidTable[ConsolepMaxApiNumber - CONSRV_FIRST_API
     // FALSE,   // SrvSetConsoleCurrentFont,
     // FALSE,   // SrvSetScreenBufferInfo,
     // FALSE,   // SrvConsoleClientConnect,
+
+    FALSE,   // SrvMapConsoleOutputBuffer
 };
 
 /*
@@ -315,6 +319,8 @@ PCHAR ConsoleServerApiNameTable[ConsolepMaxApiNumber - CONSRV_FIRST_API_NUMBER]
     // "SetConsoleCurrentFont",
     // "SetScreenBufferInfo",
     // "ConsoleClientConnect",
+
+    "MapConsoleOutputBuffer",
 };
 #endif
 
@@ -546,6 +552,14 @@ ConSrvDisconnect(IN PCSR_PROCESS CsrProcess)
         ConSrvRemoveConsole(ProcessData);
     }
 
+    /* The client view goes away with the process */
+    if (ProcessData->OutputBufferServerView != NULL)
+    {
+        NtUnmapViewOfSection(NtCurrentProcess(), ProcessData->OutputBufferServerView);
+        ProcessData->OutputBufferServerView = NULL;
+        ProcessData->OutputBufferClientView = NULL;
+    }
+
     RtlDeleteCriticalSection(&ProcessData->HandleTableLock);
 }
 